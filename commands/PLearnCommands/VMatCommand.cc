@@ -65,17 +65,17 @@ VMatCommand::VMatCommand():
         "       To display statistics for that field \n"
         "   or: vmat bbox <dataset> [<extra_percent>] \n"
         "       To display the data bounding box (i.e., for each field, its min and max, possibly extended by +-extra_percent ex: 0.10 for +-10% of the data range )\n"
-        "   or: vmat cat <dataset>... [--precision=N] [<optional_vpl_filtering_code>]\n"
-        "       To display the dataset \n"
+        "   or: vmat cat <dataset>... [--precision=N] [<pipeline_options>] [<optional_vpl_filtering_code>]\n"
+        "       To display the dataset (see below for the <pipeline_options>)\n"
         "   or: vmat sascat <dataset.vmat> <dataset.txt>\n"
         "       To output in <dataset.txt> the dataset in SAS-like tab-separated format with field names on the first line\n"
         "   or: vmat view <dataset>...\n"
         "       Interactive display to browse on the data. \n"
         "       ( will work only if your executable includes commands/PLearnCommands/VMatViewCommand.h )\n"
-        "   or: vmat stats <dataset> \n"
+        "   or: vmat stats <dataset> [<pipeline_options>]\n"
         "       Will display basic statistics for each field \n"
-        "   or: vmat convert <source> <destination> [--cols=col1,col2,col3,...] [--mat_to_mem] [--save_vmat] [--force_float]\n"
-        "       To convert any dataset into a .amat, .pmat, .dmat, .vmat, .csv or .arff format. \n"
+        "   or: vmat convert <source> <destination> [--cols=col1,col2,col3,...] [--mat_to_mem] [--save_vmat] [--force_float] [<pipeline_options>]\n"
+        "       To convert any dataset into a .amat, .pmat, .dmat, .colmat, .vmat, .csv or .arff format. \n"
         "       The extension of the destination is used to determine the format you want. \n"
         "       WARNING: In dmat format, all double are currently casted to float!\n"
         "       If the option --cols is specified, it requests to keep only the given columns\n"
@@ -87,6 +87,8 @@ VMatCommand::VMatCommand():
         "       If the option --update is specified, we generate the <destination> only when the <source> file is newer\n"
         "         then the destination file or when the destination file is missing\n"
         "       If .pmat is specified as the destination file, the option --force_float will save the data in float format\n"
+        "       If .colmat (columnar directory) is specified as the destination, the option --block_length=N sets\n"
+        "         the number of rows encoded together in each column (default = 1024)\n"
         "       If .csv (Comma-Separated Value) is specified as the destination file, the \n"
         "       following additional options are also supported:\n"
         "         --skip-missings: if a row (after selecting the appropriate columns) contains\n"
@@ -102,6 +104,12 @@ VMatCommand::VMatCommand():
         "         --precision=N:   a maximum of N digits is printed after the decimal point\n"
         "         --date-cols=col1,col2,...:  we flag the specified columns as a date\n"
         "                                     we also convert the date from CYYMMDD to YYYYMMDD (if necessary)\n"
+        "       The rows are read by blocks, ahead of the writer, by several threads; this is\n"
+        "       controlled by the <pipeline_options> (also accepted by 'cat' and 'stats'):\n"
+        "         --threads=N:      number of reading threads (default = number of cores, 0 = none)\n"
+        "         --block_rows=N:   number of rows read at once (default = about 1M values)\n"
+        "         --memory_cap=MB:  maximum memory used by the blocks in flight (default = 256)\n"
+        "         --throughput:     report the number of rows and MB read per second\n"
         "   or: vmat gendef <source> [binnum1 binnum2 ...] \n"
         "       Generate stats for dataset (will put them in its associated metadatadir). \n"
         "   or: vmat genvmat <source_dataset> <dest_vmat> [binned{num} | onehot{num} | normalized]\n"
@@ -190,6 +190,7 @@
 #include <plearn_learners/nearest_neighbors/BallTreeNearestNeighbors.h>
 #include <plearn_learners/nearest_neighbors/ExhaustiveNearestNeighbors.h>
 #include <plearn_learners/nearest_neighbors/GenericNearestNeighbors.h>
+#include <plearn_learners/nearest_neighbors/HNSWNearestNeighbors.h>
 
 // Experimental
 #include <plearn_learners_experimental/DeepFeatureExtractorNNet.h>
@@ -271,6 +272,7 @@
 #include <plearn/vmat/BootstrapVMatrix.h>
 #include <plearn/vmat/CenteredVMatrix.h>
 #include <plearn/vmat/ClassSubsetVMatrix.h>
+#include <plearn/vmat/ColumnarVMatrix.h>
 #include <plearn/vmat/CompactVMatrix.h>
 #include <plearn/vmat/CompactFileVMatrix.h>
 #include <plearn/vmat/CompressedVMatrix.h>
@@ -303,6 +305,7 @@
 #include <plearn/vmat/PLearnerOutputVMatrix.h>
 #include <plearn/vmat/PairsVMatrix.h>
 #include <plearn/vmat/PrecomputedVMatrix.h>
+#include <plearn/vmat/PrefetchVMatrix.h>
 #include <plearn/vmat/ProcessDatasetVMatrix.h>
 #include <plearn/vmat/ProcessingVMatrix.h>
 #include <plearn/vmat/ProcessSymbolicSequenceVMatrix.h>
@@ -74,9 +74,14 @@
 #include <plearn/var/test/VariablesTest.h>
 #include <plearn/var/test/VarUtilsTest.h>
 #include <plearn/vmat/test/AutoVMatrixTest.h>
+#include <plearn/vmat/test/ColumnarVMatrixTest.h>
 #include <plearn/vmat/test/FileVMatrixTest.h>
+#include <plearn/vmat/test/FilteredVMatrixTest.h>
 #include <plearn/vmat/test/IndexedVMatrixTest.h>
 #include <plearn/vmat/test/RowBufferedVMatrixTest.h>
+#include <plearn/vmat/test/TextFilesVMatrixTest.h>
+#include <plearn/vmat/test/VMatLanguageTest.h>
+#include <plearn/vmat/test/VMatPipelineTest.h>
 #include <plearn_learners/online/test/MaxSubsampling2DModule/MaxSubsamplingTest.h>
 
 #include <plearn/python/test/InstanceSnippetTest.h>
@@ -49,6 +49,7 @@
 #include <plearn/io/fileutils.h>          //!< For isfile().
 #include <plearn/io/pl_log.h>
 #include <plearn/io/PyPLearnScript.h>
+#include <plearn/vmat/ColumnarVMatrix.h>
 #include <plearn/vmat/DiskVMatrix.h>
 #include <plearn/vmat/FileVMatrix.h>
 #include <plearn/vmat/VMat.h>
@@ -176,6 +177,8 @@ VMat getDataSet(const PPath& dataset_path)
     else if (isdir(dataset)) {
         if (ext == "dmat")
             vm = new DiskVMatrix(dataset);
+        else if (ext == "colmat")
+            vm = new ColumnarVMatrix(dataset);
         else
             PLERROR("In getDataSet - Unknown extension for VMat directory: %s", ext.c_str());
     }
@@ -243,6 +246,7 @@ string getDataSetHelp() {
         + exts + string(
         "- a directory with extension:\n"
         "  .dmat   : Disk VMatrix\n"
+        "  .colmat : Columnar VMatrix\n"
         "\n"
         "Optionally, arguments for scripts can be given with the following syntax:\n"
         "  path/file.ext::arg1=val1::arg2=val2::arg3=val3\n");
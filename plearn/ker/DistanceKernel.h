@@ -76,6 +76,11 @@ public:
     virtual string info() const
     { return "L"+tostring(n); }
 
+    //! Whether this kernel is the (possibly squared) euclidean distance, so
+    //! that nearest neighbors searches may compute it directly.
+    bool isEuclidean() const
+    { return fast_exact_is_equal(n, 2.0) && !ignore_missing; }
+
     virtual real evaluate(const Vec& x1, const Vec& x2) const;
     virtual real evaluate_i_j(int i, int j) const;
 
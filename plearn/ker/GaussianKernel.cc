@@ -42,6 +42,10 @@
 
 #include "GaussianKernel.h"
 #include <plearn/math/TMat_maths.h>
+#include <plearn/math/simd_kernels.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 //#define GK_DEBUG
 
@@ -61,14 +65,16 @@ PLEARN_IMPLEMENT_OBJECT(GaussianKernel,
 ////////////////////
 GaussianKernel::GaussianKernel()
     : scale_by_sigma(false),
-      sigma(1)
+      sigma(1),
+      n_threads(1)
 {
     build_();
 }
 
 GaussianKernel::GaussianKernel(real the_sigma)
     : scale_by_sigma(false),
-      sigma(the_sigma)
+      sigma(the_sigma),
+      n_threads(1)
 {
     build_();
 }
@@ -84,6 +90,12 @@ void GaussianKernel::declareOptions(OptionList& ol)
     declareOption(ol, "scale_by_sigma", &GaussianKernel::scale_by_sigma, OptionBase::buildoption,
                   "If set to 1, the kernel will be scaled by sigma^2 / 2");
 
+    declareOption(ol, "n_threads", &GaussianKernel::n_threads,
+                  OptionBase::buildoption | OptionBase::nosave,
+                  "Number of threads used by computeGramMatrix (-1 means as many as\n"
+                  "OpenMP provides). When different from 1, the Gram matrix is computed\n"
+                  "by blocks, with one matrix product per block.");
+
     inherited::declareOptions(ol);
 }
 
@@ -259,6 +271,95 @@ real GaussianKernel::evaluate_x_i(const Vec& x, int i, real squared_norm_of_x) c
         return evaluateFromDotAndSquaredNorm(squared_norm_of_x, data->dot(i,x), sqn_i); 
 }
 
+///////////////////////
+// computeGramMatrix //
+///////////////////////
+void GaussianKernel::computeGramMatrix(Mat K) const
+{
+    if (n_threads == 1 || (cache_gram_matrix && gram_matrix_is_cached)
+        || report_progress) {
+        inherited::computeGramMatrix(K);
+        return;
+    }
+    if (!data)
+        PLERROR("GaussianKernel::computeGramMatrix should be called only after setDataForKernelMatrix");
+    if (K.length() != data.length() || K.width() != data.length())
+        PLERROR("GaussianKernel::computeGramMatrix: the argument matrix K should be\n"
+                "of size %d x %d (currently of size %d x %d)",
+                data.length(), data.length(), K.length(), K.width());
+
+    const int l = data->length();
+    const int tile = 128;
+    const int n_tiles = (l + tile - 1) / tile;
+    Mat X = data.toMat();
+    const int m = K.mod();
+    real* pK = K.data();
+
+    // Views are created here since Mat reference counts are not thread-safe.
+    TVec<Mat> blocks(n_tiles);
+    for (int t = 0; t < n_tiles; t++)
+        blocks[t] = X.subMat(t * tile, 0, min(tile, l - t * tile), data_inputsize);
+
+    // Tiles (ti, tj) of the lower triangle, with tj <= ti.
+    TVec<int> tile_i, tile_j;
+    for (int ti = 0; ti < n_tiles; ti++)
+        for (int tj = 0; tj <= ti; tj++) {
+            tile_i.append(ti);
+            tile_j.append(tj);
+        }
+    const int n_pairs = tile_i.length();
+
+#ifdef _OPENMP
+    int nt = 1;
+    if (!omp_in_parallel())
+        nt = n_threads > 0 ? n_threads : omp_get_max_threads();
+    nt = max(1, min(nt, n_pairs));
+#pragma omp parallel num_threads(nt) if(nt > 1)
+#endif
+    {
+        Mat products(tile, tile);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic,1)
+#endif
+        for (int p = 0; p < n_pairs; p++) {
+            const int ti = tile_i[p], tj = tile_j[p];
+            const int i0 = ti * tile, j0 = tj * tile;
+            const int ni = min(tile, l - i0), nj = min(tile, l - j0);
+            Mat prod = products.subMat(0, 0, ni, nj);
+            productTranspose(prod, blocks[ti], blocks[tj]);
+            for (int a = 0; a < ni; a++) {
+                const int i = i0 + a;
+                const real sqn_i = squarednorms[i];
+                const real* prod_a = prod[a];
+                const int nb = (ti == tj) ? a + 1 : nj;
+                for (int b = 0; b < nb; b++) {
+                    const int j = j0 + b;
+                    const real sqn_j = squarednorms[j];
+                    real sqnorm_of_diff;
+                    if (isUnsafe(sqn_i, sqn_j))
+                        sqnorm_of_diff = simdSquaredDistance(X[i], X[j],
+                                                             data_inputsize);
+                    else
+                        sqnorm_of_diff = (sqn_i + sqn_j) - (prod_a[b] + prod_a[b]);
+                    // Negative values only come from rounding errors (and an
+                    // error could not be reported from a thread anyway).
+                    if (sqnorm_of_diff < 0)
+                        sqnorm_of_diff = 0;
+                    const real Kij = evaluateFromSquaredNormOfDifference(sqnorm_of_diff);
+                    pK[(ptrdiff_t)i * m + j] = Kij;
+                    pK[(ptrdiff_t)j * m + i] = Kij;
+                }
+            }
+        }
+    }
+
+    if (cache_gram_matrix) {
+        gram_matrix.resize(l,l);
+        gram_matrix << K;
+        gram_matrix_is_cached = true;
+    }
+}
+
 //////////////
 // isUnsafe //
 //////////////
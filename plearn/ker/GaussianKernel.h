@@ -63,6 +63,7 @@ public:
     //! Build options below.
     bool scale_by_sigma;
     real sigma;
+    int n_threads;
 
 protected:
 
@@ -96,6 +97,10 @@ public:
     virtual real evaluate_i_x(int i, const Vec& x, real squared_norm_of_x=-1) const; //!<  returns evaluate(data(i),x)
     virtual real evaluate_x_i(const Vec& x, int i, real squared_norm_of_x=-1) const; //!<  returns evaluate(x,data(i))
 
+    //! Overridden to compute the Gram matrix by blocks of dot products,
+    //! on several threads when 'n_threads' is not 1.
+    virtual void computeGramMatrix(Mat K) const;
+
     virtual void setParameters(Vec paramvec);
 
 protected:
@@ -148,16 +148,19 @@ void KroneckerBaseKernel::computeGramMatrix(Mat K) const
     int  cache_mod = m_data_cache.mod();
 
     real *data_start = &m_data_cache(0,0);
-    real Kij = m_default_value;
-    real *Ki, *Kji;
-    real *xi = data_start;
-    
-    for (int i=0 ; i<l ; ++i, xi += cache_mod) {
-        Ki  = K[i];
-        Kji = &K[0][i];
+
+    // Rows are independent, hence may be split across threads
+#ifdef _OPENMP
+    int nt = gramThreads(l);
+#pragma omp parallel for schedule(dynamic, 64) num_threads(nt) if(nt > 1)
+#endif
+    for (int i=0 ; i<l ; ++i) {
+        real Kij = m_default_value;
+        real *Ki = K.data() + (ptrdiff_t)i * m;
+        real *xi = data_start + (ptrdiff_t)i * cache_mod;
         real *xj = data_start;
 
-        for (int j=0; j<=i; ++j, Kji += m, xj += cache_mod) {
+        for (int j=0; j<=i; ++j, xj += cache_mod) {
             if (kronecker_num > 0) {
                 real  product = 1.0;
                 int*  cur_index = kronecker_indexes;
@@ -70,7 +70,9 @@ PLEARN_IMPLEMENT_ABSTRACT_OBJECT(
 //#####  MemoryCachedKernel::MemoryCachedKernel  ##############################
 
 MemoryCachedKernel::MemoryCachedKernel()
-    : m_cache_threshold(1000000)
+    : m_cache_threshold(1000000),
+      m_n_threads(1),
+      m_gram_use_gemm(false)
 {
     cache_gram_matrix = true;
 }
@@ -86,6 +88,22 @@ void MemoryCachedKernel::declareOptions(OptionList& ol)
         "Threshold on the number of elements to cache the data VMatrix into a\n"
         "real matrix.  Above this threshold, the VMatrix is left as-is, and\n"
         "element access remains virtual.  (Default value = 1000000)\n");
+
+    declareOption(
+        ol, "n_threads", &MemoryCachedKernel::m_n_threads,
+        OptionBase::buildoption | OptionBase::nosave,
+        "Number of threads used to compute the Gram matrix and its\n"
+        "derivatives (-1 means as many as OpenMP provides).  The results do\n"
+        "not depend on it.  (Default value = 1)\n");
+
+    declareOption(
+        ol, "gram_use_gemm", &MemoryCachedKernel::m_gram_use_gemm,
+        OptionBase::buildoption | OptionBase::nosave,
+        "If true, kernels based on a weighted euclidean distance compute the\n"
+        "distances of the Gram matrix as |x|^2 + |y|^2 - 2 x.y, with one matrix\n"
+        "product per block of the Gram matrix.  Much faster when the input\n"
+        "size is large, but less accurate for points that are very close\n"
+        "relatively to their norm.  (Default value = false)\n");
     
     // Now call the parent class' declareOptions
     inherited::declareOptions(ol);
@@ -118,6 +136,21 @@ void MemoryCachedKernel::makeDeepCopyFromShallowCopy(CopiesMap& copies)
 }
 
 
+//#####  gramThreads  #########################################################
+
+int MemoryCachedKernel::gramThreads(int l) const
+{
+    int n_used = 1;
+#ifdef _OPENMP
+    // When called from a parallel region, the nested region would only
+    // have one thread.
+    if (!omp_in_parallel())
+        n_used = m_n_threads > 0 ? m_n_threads : omp_get_max_threads();
+#endif
+    return max(1, min(n_used, l));
+}
+
+
 //#####  setDataForKernelMatrix  ##############################################
 
 void MemoryCachedKernel::setDataForKernelMatrix(VMat the_data)
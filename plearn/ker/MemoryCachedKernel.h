@@ -41,6 +41,11 @@
 #define MemoryCachedKernel_INC
 
 #include <plearn/ker/Kernel.h>
+#include <plearn/math/TMat_maths.h>
+#include <plearn/math/simd_kernels.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace PLearn {
 
@@ -65,7 +70,9 @@ namespace PLearn {
  *  This class also provides utility functions to derived classes to compute
  *  the Gram matrix and its derivative (with respect to kernel hyperparameters)
  *  without requiring virtual function calls in data access or evaluation
- *  function.
+ *  function.  These utilities may split the work across several threads
+ *  (option 'n_threads'); each element is then computed exactly as in the
+ *  serial case.
  */
 class MemoryCachedKernel : public Kernel
 {
@@ -81,6 +88,22 @@ public:
      */
     int m_cache_threshold;
 
+    /**
+     *  Number of threads used to compute the Gram matrix and its
+     *  derivatives (-1 means as many as OpenMP provides).  (Default value =
+     *  1)
+     */
+    int m_n_threads;
+
+    /**
+     *  If true, kernels based on a weighted euclidean distance compute the
+     *  distances of the Gram matrix as |x|^2 + |y|^2 - 2 x.y, with one matrix
+     *  product per block of the Gram matrix.  Much faster when the input
+     *  size is large, but less accurate for points that are very close
+     *  relatively to their norm.  (Default value = false)
+     */
+    bool m_gram_use_gemm;
+
 public:
     //#####  Public Member Functions  #########################################
 
@@ -180,6 +203,24 @@ protected:
      */
     template <class DerivedClass>
     void evaluateAllIXNV(const Vec& x, const Vec& k_xi_x, int istart) const;
+
+    //! Number of threads to use for an l x l Gram matrix (or derivative); 1
+    //! when called from a parallel region.
+    int gramThreads(int l) const;
+
+    /**
+     *  Interface for derived classes whose kernel depends on the inputs
+     *  through a weighted distance d(x,y) = sum_k |x_k - y_k|^p / w_k, with
+     *  p = 1 or 2 and the weights w given in 'weights'.  For each element
+     *  (i,j) of the lower triangle of the Gram matrix (j <= i), calls
+     *  op(i, j, d(x_i, x_j)).  The triangle is walked by square tiles, split
+     *  across the threads given by 'n_threads', so 'op' may be called
+     *  concurrently for different elements.  When p == 2 and
+     *  'gram_use_gemm' is true, the distances of a tile are obtained from a
+     *  matrix product on the scaled inputs.  Requires the data cache.
+     */
+    template <class Op>
+    void computeDistanceGramNV(const Vec& weights, int p, const Op& op) const;
     
     
 private:
@@ -292,17 +333,21 @@ void MemoryCachedKernel::computeGramMatrixDerivNV(Mat& KD, const DerivedClass* T
 
     int W = nExamples();
     KD.resize(W,W);
-    
-    real KDij;
-    real* KDi;
-    real  K  = MISSING_VALUE;
-    real* Ki = 0;                       // Current row of kernel matrix, if cached
 
+    // Rows are independent; kernel evaluations are only done in the calling
+    // thread, since they may not be thread-safe.
+#ifdef _OPENMP
+    int nt = (gram_matrix_is_cached || !require_K) ? gramThreads(W) : 1;
+#pragma omp parallel for schedule(dynamic, 16) num_threads(nt) if(nt > 1)
+#endif
     for (int i=0 ; i<W ; ++i) {
-        KDi  = KD[i];
+        real  KDij;
+        real* KDi = KD[i];
+        real  K   = MISSING_VALUE;
+        real* Ki  = 0;                  // Current row of kernel matrix, if cached
         if (gram_matrix_is_cached)
             Ki = gram_matrix[i];
-        
+
         for (int j=0 ; j <= i ; ++j) {
             // Access the current kernel value depending on whether it's cached
             if (Ki)
@@ -321,6 +366,107 @@ void MemoryCachedKernel::computeGramMatrixDerivNV(Mat& KD, const DerivedClass* T
 }
 
 
+//#####  computeDistanceGramNV  ###############################################
+
+template <class Op>
+void MemoryCachedKernel::computeDistanceGramNV(const Vec& weights, int p,
+                                               const Op& op) const
+{
+    PLASSERT( p == 1 || p == 2 );
+    PLASSERT( m_data_cache.isNotNull() );
+    const int tile = 128;
+    int l = m_data_cache.length();
+    int n = dataInputsize();
+    int cache_mod = m_data_cache.mod();
+    if (l == 0)
+        return;
+    const real* data_start = m_data_cache.data();
+    const real* w = weights.data();
+
+    // Tiles (ti,tj) of the lower triangle, row-major.
+    int n_tiles = (l + tile - 1) / tile;
+    TVec<int> tile_i, tile_j;
+    for (int ti = 0; ti < n_tiles; ++ti)
+        for (int tj = 0; tj <= ti; ++tj) {
+            tile_i.append(ti);
+            tile_j.append(tj);
+        }
+
+    // With matrix products: the inputs are scaled so that d(x,y) is the
+    // plain squared distance of the scaled inputs.  Views on the blocks of
+    // rows are created here since the reference counting of Mat is not
+    // thread-safe.
+    bool use_gemm = m_gram_use_gemm && p == 2;
+    Mat scaled;
+    Vec sq_norms;
+    TVec<Mat> blocks;
+    if (use_gemm) {
+        scaled.resize(l, n);
+        sq_norms.resize(l);
+        for (int i = 0; i < l; ++i) {
+            const real* xi = data_start + i * cache_mod;
+            real* si = scaled[i];
+            for (int k = 0; k < n; ++k)
+                si[k] = xi[k] / sqrt(w[k]);
+            sq_norms[i] = simdDot(si, si, n);
+        }
+        blocks.resize(n_tiles);
+        for (int t = 0; t < n_tiles; ++t)
+            blocks[t] = scaled.subMatRows(t * tile, min(tile, l - t * tile));
+    }
+
+#ifdef _OPENMP
+    int nt = gramThreads(l);
+#pragma omp parallel num_threads(nt) if(nt > 1)
+#endif
+    {
+        // Only this thread touches this buffer, so it may be allocated here.
+        Mat products;
+        if (use_gemm)
+            products.resize(tile, tile);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+        for (int t = 0; t < tile_i.length(); ++t) {
+            int i0 = tile_i[t] * tile;
+            int i1 = min(l, i0 + tile);
+            int j0 = tile_j[t] * tile;
+            int j1 = min(l, j0 + tile);
+            if (use_gemm) {
+                Mat tile_products = products.subMat(0, 0, i1 - i0, j1 - j0);
+                productTranspose(tile_products, blocks[tile_i[t]],
+                                 blocks[tile_j[t]]);
+                for (int i = i0; i < i1; ++i) {
+                    const real* pi = tile_products[i - i0] - j0;
+                    for (int j = j0, j_end = min(j1, i + 1); j < j_end; ++j) {
+                        real d = sq_norms[i] + sq_norms[j] - 2 * pi[j];
+                        op(i, j, (i == j || d < 0) ? 0 : d);
+                    }
+                }
+            }
+            else {
+                for (int i = i0; i < i1; ++i) {
+                    const real* xi = data_start + i * cache_mod;
+                    for (int j = j0, j_end = min(j1, i + 1); j < j_end; ++j) {
+                        const real* xj = data_start + j * cache_mod;
+                        real sum_wt = 0.0;
+                        if (p == 2)
+                            for (int k = 0; k < n; ++k) {
+                                real diff = xi[k] - xj[k];
+                                sum_wt += (diff * diff) / w[k];
+                            }
+                        else
+                            for (int k = 0; k < n; ++k)
+                                sum_wt += fabs(xi[k] - xj[k]) / w[k];
+                        op(i, j, sum_wt);
+                    }
+                }
+            }
+        }
+    }
+}
+
+
 //#####  evaluateAllIXNV  #####################################################
 
 template <class DerivedClass>
@@ -215,6 +215,34 @@ void RationalQuadraticARDKernel::evaluate_all_i_x(const Vec& x1, const Vec& k_xi
 }
 
 
+namespace {
+
+//! Gram matrix update of RationalQuadraticARDKernel for one element, given
+//! the weighted squared distance of its two points; also fills the cache of
+//! the pow terms.
+struct RationalQuadraticGramOp
+{
+    real* K;
+    int   K_mod;
+    real* pow_cache;
+    int   pow_cache_mod;
+    real  sf;
+    real  alpha;
+
+    void operator()(int i, int j, real sum_wt) const
+    {
+        real* Kij = K + (ptrdiff_t)i * K_mod + j;
+        real inner_pow = 1 + sum_wt / (2.*alpha);
+        real pow_alpha = pow(inner_pow, -alpha);
+        real Kij_cur   = *Kij * sf * pow_alpha;       // Mind *Kij here
+        pow_cache[(ptrdiff_t)i * pow_cache_mod + j] = Kij_cur / inner_pow;
+        *Kij = Kij_cur;
+    }
+};
+
+} // end of anonymous namespace
+
+
 //#####  computeGramMatrix  ###################################################
 
 void RationalQuadraticARDKernel::computeGramMatrix(Mat K) const
@@ -242,64 +270,15 @@ void RationalQuadraticARDKernel::computeGramMatrix(Mat K) const
     
     // Prepare the cache for the pow terms
     m_pow_minus_alpha_minus_1.resize(K.length(), K.width());
-    int   pow_cache_mod = m_pow_minus_alpha_minus_1.mod();
-    real* pow_cache_row = m_pow_minus_alpha_minus_1.data();
-    
-    // Compute Gram Matrix
-    int  l = data->length();
-    int  m = K.mod();
-    int  n = dataInputsize();
-    int  cache_mod = m_data_cache.mod();
 
-    real *data_start = &m_data_cache(0,0);
-    real *Ki = K[0];                         // Start of current row
-    real *Kij;                               // Current element along row
-    real *input_sigma_data = m_input_sigma.data();
-    real *xi = data_start;
-    
-    for (int i=0 ; i<l
-             ; ++i, xi += cache_mod, pow_cache_row+=pow_cache_mod, Ki+=m)
-    {
-        Kij = Ki;
-        real *xj = data_start;
-        real *pow_cache_cur = pow_cache_row;
-
-        // This whole loop can be optimized further when a Kronecker term is 0
-        for (int j=0; j<=i; ++j, xj += cache_mod) {
-            // Kernel evaluation per se
-            real *x1 = xi;
-            real *x2 = xj;
-            real *p_inpsigma = input_sigma_data;
-            real sum_wt = 0.0;
-            int  k = n;
-
-            // Use Duff's device to unroll the following loop:
-            //     while (k--) {
-            //         real diff = *x1++ - *x2++;
-            //         sum_wt += (diff * diff) / *p_inpsigma++;
-            //     }
-            real diff;
-            switch (k % 8) {
-            case 0: do { diff = *x1++ - *x2++; sum_wt += (diff*diff) / *p_inpsigma++;
-            case 7:      diff = *x1++ - *x2++; sum_wt += (diff*diff) / *p_inpsigma++;
-            case 6:      diff = *x1++ - *x2++; sum_wt += (diff*diff) / *p_inpsigma++;
-            case 5:      diff = *x1++ - *x2++; sum_wt += (diff*diff) / *p_inpsigma++;
-            case 4:      diff = *x1++ - *x2++; sum_wt += (diff*diff) / *p_inpsigma++;
-            case 3:      diff = *x1++ - *x2++; sum_wt += (diff*diff) / *p_inpsigma++;
-            case 2:      diff = *x1++ - *x2++; sum_wt += (diff*diff) / *p_inpsigma++;
-            case 1:      diff = *x1++ - *x2++; sum_wt += (diff*diff) / *p_inpsigma++;
-                       } while((k -= 8) > 0);
-            }
+    // Multiplicatively update kernel matrix (already pre-filled with
+    // Kronecker terms, or 1.0 if no Kronecker terms, as per build_).
+    int l = data->length();
+    RationalQuadraticGramOp op = {
+        K.data(), K.mod(), m_pow_minus_alpha_minus_1.data(),
+        m_pow_minus_alpha_minus_1.mod(), sf, alpha };
+    computeDistanceGramNV(m_input_sigma, 2, op);
 
-            // Multiplicatively update kernel matrix (already pre-filled with
-            // Kronecker terms, or 1.0 if no Kronecker terms, as per build_).
-            real inner_pow   = 1 + sum_wt / (2.*alpha);
-            real pow_alpha   = pow(inner_pow, -alpha);
-            real Kij_cur     = *Kij * sf * pow_alpha;       // Mind *Kij here
-            *pow_cache_cur++ = Kij_cur / inner_pow;
-            *Kij++           = Kij_cur;
-        }
-    }
     if (cache_gram_matrix) {
         gram_matrix.resize(l,l);
         gram_matrix << K;
@@ -464,26 +443,28 @@ void RationalQuadraticARDKernel::computeGramMatrixDerivIspInputSigma(Mat& KD,
     // Variables that walk over the data matrix
     int  cache_mod = m_data_cache.mod();
     real *data_start = &m_data_cache(0,0);
-    real *xi = data_start+arg;               // Iterator on data rows
 
     // Variables that walk over the pow cache
     int   pow_cache_mod = m_pow_minus_alpha_minus_1.mod();
     real *pow_cache_row = m_pow_minus_alpha_minus_1.data();
-    real *pow_cache_cur;
     
     // Variables that walk over the kernel derivative matrix (KD)
     KD.resize(l,l);
-    real* KDi = KD.data();                   // Start of row i
-    real* KDij;                              // Current element on row i
+    real* KDi = KD.data();                   // Start of row 0
     int   KD_mod = KD.mod();
 
-    // Iterate on rows of derivative matrix
-    for (int i=0 ; i<l ; ++i, xi += cache_mod, KDi += KD_mod,
-             pow_cache_row += pow_cache_mod)
+    // Iterate on rows of derivative matrix; they are independent, hence
+    // may be split across threads
+#ifdef _OPENMP
+    int nt = gramThreads(l);
+#pragma omp parallel for schedule(dynamic, 16) num_threads(nt) if(nt > 1)
+#endif
+    for (int i=0 ; i<l ; ++i)
     {
-        KDij = KDi;
-        real *xj  = data_start+arg;           // Inner iterator on data rows
-        pow_cache_cur = pow_cache_row;
+        real *xi   = data_start + arg + (ptrdiff_t)i * cache_mod;
+        real *KDij = KDi + (ptrdiff_t)i * KD_mod;
+        real *xj   = data_start+arg;          // Inner iterator on data rows
+        real *pow_cache_cur = pow_cache_row + (ptrdiff_t)i * pow_cache_mod;
 
         // Iterate on columns of derivative matrix
         for (int j=0 ; j <= i
@@ -517,27 +498,28 @@ void RationalQuadraticARDKernel::computeGramMatrixDerivIspAlpha(Mat& KD) const
 
     // Variables that walk over the pre-computed kernel matrix (K) 
     int  k_mod = gram_matrix.mod();
-    real *Ki = &gram_matrix(0,0);            // Current row of kernel matrix
-    real *Kij;                               // Current element of kernel matrix
+    real *K0 = &gram_matrix(0,0);            // First row of kernel matrix
 
     // Variables that walk over the pow cache
     int   pow_cache_mod = m_pow_minus_alpha_minus_1.mod();
     real *pow_cache_row = m_pow_minus_alpha_minus_1.data();
-    real *pow_cache_cur;
 
     // Variables that walk over the kernel derivative matrix (KD)
     KD.resize(l,l);
-    real* KDi = KD.data();                   // Start of row i
-    real* KDij;                              // Current element on row i
+    real* KDi = KD.data();                   // Start of row 0
     int   KD_mod = KD.mod();
 
-    // Iterate on rows of derivative matrix
-    for (int i=0 ; i<l ; ++i, Ki += k_mod,
-             KDi += KD_mod, pow_cache_row += pow_cache_mod)
+    // Iterate on rows of derivative matrix; they are independent, hence
+    // may be split across threads
+#ifdef _OPENMP
+    int nt = gramThreads(l);
+#pragma omp parallel for schedule(dynamic, 16) num_threads(nt) if(nt > 1)
+#endif
+    for (int i=0 ; i<l ; ++i)
     {
-        Kij  = Ki;
-        KDij = KDi;
-        pow_cache_cur   = pow_cache_row;
+        real *Kij  = K0 + (ptrdiff_t)i * k_mod;
+        real *KDij = KDi + (ptrdiff_t)i * KD_mod;
+        real *pow_cache_cur = pow_cache_row + (ptrdiff_t)i * pow_cache_mod;
 
         // Iterate on columns of derivative matrix
         for (int j=0 ; j <= i ; ++j, ++Kij, ++pow_cache_cur)
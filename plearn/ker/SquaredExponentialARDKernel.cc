@@ -155,6 +155,26 @@ real SquaredExponentialARDKernel::evaluate(const Vec& x1, const Vec& x2) const
 }
 
 
+namespace {
+
+//! Gram matrix update of SquaredExponentialARDKernel for one element, given
+//! the weighted squared distance of its two points.
+struct SquaredExponentialGramOp
+{
+    real* K;
+    int   K_mod;
+    real  sf;
+
+    void operator()(int i, int j, real sum_wt) const
+    {
+        real* Kij = K + (ptrdiff_t)i * K_mod + j;
+        *Kij = *Kij * sf * exp(-0.5 * sum_wt);
+    }
+};
+
+} // end of anonymous namespace
+
+
 //#####  computeGramMatrix  ###################################################
 
 void SquaredExponentialARDKernel::computeGramMatrix(Mat K) const
@@ -179,55 +199,12 @@ void SquaredExponentialARDKernel::computeGramMatrix(Mat K) const
         m_input_sigma[i] = softplus(m_input_sigma[i]);
     }
 
-    // Compute Gram Matrix
-    int  l = data->length();
-    int  m = K.mod();
-    int  n = dataInputsize();
-    int  cache_mod = m_data_cache.mod();
+    // Multiplicatively update kernel matrix (already pre-filled with
+    // Kronecker terms, or 1.0 if no Kronecker terms, as per build_).
+    int l = data->length();
+    SquaredExponentialGramOp op = { K.data(), K.mod(), sf };
+    computeDistanceGramNV(m_input_sigma, 2, op);
 
-    real *data_start = &m_data_cache(0,0);
-    real *Ki = K[0];                         // Start of current row
-    real *Kij;                               // Current element along row
-    real *input_sigma_data = m_input_sigma.data();
-    real *xi = data_start;
-    
-    for (int i=0 ; i<l ; ++i, xi += cache_mod, Ki+=m)
-    {
-        Kij = Ki;
-        real *xj = data_start;
-
-        for (int j=0; j<=i; ++j, xj += cache_mod) {
-            // Kernel evaluation per se
-            real *x1 = xi;
-            real *x2 = xj;
-            real *p_inpsigma = input_sigma_data;
-            real sum_wt = 0.0;
-            int  k = n;
-
-            // Use Duff's device to unroll the following loop:
-            //     while (k--) {
-            //         real diff = *x1++ - *x2++;
-            //         sum_wt += (diff * diff) / *p_inpsigma++;
-            //     }
-            real diff;
-            switch (k % 8) {
-            case 0: do { diff = *x1++ - *x2++; sum_wt += (diff*diff) / *p_inpsigma++;
-            case 7:      diff = *x1++ - *x2++; sum_wt += (diff*diff) / *p_inpsigma++;
-            case 6:      diff = *x1++ - *x2++; sum_wt += (diff*diff) / *p_inpsigma++;
-            case 5:      diff = *x1++ - *x2++; sum_wt += (diff*diff) / *p_inpsigma++;
-            case 4:      diff = *x1++ - *x2++; sum_wt += (diff*diff) / *p_inpsigma++;
-            case 3:      diff = *x1++ - *x2++; sum_wt += (diff*diff) / *p_inpsigma++;
-            case 2:      diff = *x1++ - *x2++; sum_wt += (diff*diff) / *p_inpsigma++;
-            case 1:      diff = *x1++ - *x2++; sum_wt += (diff*diff) / *p_inpsigma++;
-                       } while((k -= 8) > 0);
-            }
-
-            // Multiplicatively update kernel matrix (already pre-filled with
-            // Kronecker terms, or 1.0 if no Kronecker terms, as per build_).
-            real Kij_cur = *Kij * sf * exp(-0.5 * sum_wt);
-            *Kij++ = Kij_cur;
-        }
-    }
     if (cache_gram_matrix) {
         gram_matrix.resize(l,l);
         gram_matrix << K;
@@ -343,26 +320,28 @@ void SquaredExponentialARDKernel::computeGramMatrixDerivIspInputSigma(Mat& KD,
     // Variables that walk over the data matrix
     int  cache_mod = m_data_cache.mod();
     real *data_start = &m_data_cache(0,0);
-    real *xi = data_start+arg;               // Iterator on data rows
 
     // Variables that walk over the gram cache
     int   gram_cache_mod = gram_matrix.mod();
     real *gram_cache_row = gram_matrix.data();
-    real *gram_cache_cur;
     
     // Variables that walk over the kernel derivative matrix (KD)
     KD.resize(l,l);
-    real* KDi = KD.data();                   // Start of row i
-    real* KDij;                              // Current element on row i
+    real* KDi = KD.data();                   // Start of row 0
     int   KD_mod = KD.mod();
 
-    // Iterate on rows of derivative matrix
-    for (int i=0 ; i<l ; ++i, xi += cache_mod, KDi += KD_mod,
-             gram_cache_row += gram_cache_mod)
+    // Iterate on rows of derivative matrix; they are independent, hence
+    // may be split across threads
+#ifdef _OPENMP
+    int nt = gramThreads(l);
+#pragma omp parallel for schedule(dynamic, 16) num_threads(nt) if(nt > 1)
+#endif
+    for (int i=0 ; i<l ; ++i)
     {
-        KDij = KDi;
-        real *xj  = data_start+arg;           // Inner iterator on data rows
-        gram_cache_cur = gram_cache_row;
+        real *xi   = data_start + arg + (ptrdiff_t)i * cache_mod;
+        real *KDij = KDi + (ptrdiff_t)i * KD_mod;
+        real *xj   = data_start+arg;          // Inner iterator on data rows
+        real *gram_cache_cur = gram_cache_row + (ptrdiff_t)i * gram_cache_mod;
 
         // Iterate on columns of derivative matrix
         for (int j=0 ; j <= i
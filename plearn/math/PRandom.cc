@@ -61,6 +61,7 @@ PRandom::PRandom(int32_t seed):
     normal_distribution(0),
     uniform_01(0),
     the_seed(0),
+    bulk_counter(0),
     fixed_seed(0),
     seed_(seed)
 {
@@ -74,6 +75,7 @@ PRandom::PRandom(const PRandom& rhs):
 #endif
     rgen                    (*(rhs.get_rgen())),
     the_seed                (rhs.get_the_seed()),
+    bulk_counter            (rhs.get_bulk_counter()),
     fixed_seed              (rhs.get_fixed_seed()),
     seed_                   (rhs.get_seed())
 {
@@ -97,6 +99,7 @@ PRandom PRandom::operator=(const PRandom& rhs)
 #endif
     rgen =          *(rhs.get_rgen());
     the_seed =      rhs.get_the_seed();
+    bulk_counter =  rhs.get_bulk_counter();
     fixed_seed =    rhs.get_fixed_seed();
     seed_ =         rhs.get_seed();
 
@@ -210,6 +213,218 @@ PP<PRandom> PRandom::common(bool random_seed)
     }
 }
 
+//////////////////
+// Bulk methods //
+//////////////////
+
+//! Compute block 'block' of the Philox4x32-10 stream with key 'seed' (see
+//! Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC 2011).
+static inline void philoxBlock(uint64_t block, uint32_t seed, uint32_t* words)
+{
+    uint32_t c0 = uint32_t(block);
+    uint32_t c1 = uint32_t(block >> 32);
+    uint32_t c2 = 0;
+    uint32_t c3 = 0;
+    uint32_t k0 = seed;
+    uint32_t k1 = 0;
+    for (int r = 0; r < 10; r++) {
+        uint64_t p0 = uint64_t(0xD2511F53) * c0;
+        uint64_t p1 = uint64_t(0xCD9E8D57) * c2;
+        uint32_t hi0 = uint32_t(p0 >> 32);
+        uint32_t hi1 = uint32_t(p1 >> 32);
+        c0 = hi1 ^ c1 ^ k0;
+        c1 = uint32_t(p1);
+        c2 = hi0 ^ c3 ^ k1;
+        c3 = uint32_t(p0);
+        k0 += 0x9E3779B9;
+        k1 += 0xBB67AE85;
+    }
+    words[0] = c0;
+    words[1] = c1;
+    words[2] = c2;
+    words[3] = c3;
+}
+
+//! Convert a random 32 bits word to a number uniformly distributed in (0,1).
+static inline double wordToUniform(uint32_t w)
+{
+    return (w + 0.5) * (1.0 / 4294967296.0);
+}
+
+//! Fill the 'length' x 'width' matrix starting at 'data' (with rows 'mod'
+//! elements apart), by blocks of four consecutive elements of a row. Each
+//! block of a row is given a block of the Philox stream, starting at
+//! 'first_block', and is filled by op(row, col, count, words).
+template<class Op>
+static void philoxFill(uint32_t seed, uint64_t first_block,
+                       int length, int width, const Op& op)
+{
+    int blocks_per_row = (width + 3) / 4;
+    int n_blocks = length * blocks_per_row;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (n_blocks >= 4096)
+#endif
+    for (int b = 0; b < n_blocks; b++) {
+        int row = b / blocks_per_row;
+        int col = 4 * (b % blocks_per_row);
+        uint32_t words[4];
+        philoxBlock(first_block + b, seed, words);
+        op(row, col, min(4, width - col), words);
+    }
+}
+
+//! Write uniform samples in [min, max).
+struct BulkUniformOp
+{
+    real* data;
+    int mod;
+    real min;
+    real max;
+
+    void operator()(int row, int col, int count, const uint32_t* words) const
+    {
+        real* dest = data + row * mod + col;
+        for (int i = 0; i < count; i++) {
+            real r = real(wordToUniform(words[i]) * (max - min) + min);
+            // Same as bounded_uniform().
+            dest[i] = r >= max ? max * RAND_RNMX : r;
+        }
+    }
+};
+
+//! Write normal samples, computed with the Box-Muller transform.
+struct BulkNormalOp
+{
+    real* data;
+    int mod;
+    real mean;
+    real stddev;
+
+    void operator()(int row, int col, int count, const uint32_t* words) const
+    {
+        real* dest = data + row * mod + col;
+        for (int i = 0; i < count; i += 2) {
+            double radius = std::sqrt(-2 * std::log(wordToUniform(words[i])));
+            double angle = 2 * M_PI * wordToUniform(words[i + 1]);
+            dest[i] = real(radius * std::cos(angle)) * stddev + mean;
+            if (i + 1 < count)
+                dest[i + 1] = real(radius * std::sin(angle)) * stddev + mean;
+        }
+    }
+};
+
+//! Write binomial samples.
+struct BulkBinomialOp
+{
+    real* data;
+    int mod;
+    const real* probabilities;
+    int probabilities_mod;
+
+    void operator()(int row, int col, int count, const uint32_t* words) const
+    {
+        real* dest = data + row * mod + col;
+        const real* pp = probabilities + row * probabilities_mod + col;
+        for (int i = 0; i < count; i++)
+            dest[i] = pp[i] < wordToUniform(words[i]) ? 0 : 1;
+    }
+};
+
+//////////////////
+// bulk_uniform //
+//////////////////
+void PRandom::bulk_uniform(const Vec& dest, real min, real max)
+{
+    if (dest.isEmpty())
+        return;
+    BulkUniformOp op = { dest.data(), 0, min, max };
+    philoxFill(the_seed, bulk_counter, 1, dest.length(), op);
+    bulk_counter += (dest.length() + 3) / 4;
+}
+
+void PRandom::bulk_uniform(const Mat& dest, real min, real max)
+{
+    if (dest.isEmpty())
+        return;
+    BulkUniformOp op = { dest.data(), dest.mod(), min, max };
+    philoxFill(the_seed, bulk_counter, dest.length(), dest.width(), op);
+    bulk_counter += uint64_t(dest.length()) * ((dest.width() + 3) / 4);
+}
+
+/////////////////
+// bulk_normal //
+/////////////////
+void PRandom::bulk_normal(const Vec& dest, real mean, real stddev)
+{
+    if (dest.isEmpty())
+        return;
+    BulkNormalOp op = { dest.data(), 0, mean, stddev };
+    philoxFill(the_seed, bulk_counter, 1, dest.length(), op);
+    bulk_counter += (dest.length() + 3) / 4;
+}
+
+void PRandom::bulk_normal(const Mat& dest, real mean, real stddev)
+{
+    if (dest.isEmpty())
+        return;
+    BulkNormalOp op = { dest.data(), dest.mod(), mean, stddev };
+    philoxFill(the_seed, bulk_counter, dest.length(), dest.width(), op);
+    bulk_counter += uint64_t(dest.length()) * ((dest.width() + 3) / 4);
+}
+
+///////////////////
+// bulk_binomial //
+///////////////////
+void PRandom::bulk_binomial(const Vec& dest, const Vec& probabilities)
+{
+    PLASSERT( dest.length() == probabilities.length() );
+    if (dest.isEmpty())
+        return;
+    BulkBinomialOp op = { dest.data(), 0, probabilities.data(), 0 };
+    philoxFill(the_seed, bulk_counter, 1, dest.length(), op);
+    bulk_counter += (dest.length() + 3) / 4;
+}
+
+void PRandom::bulk_binomial(const Mat& dest, const Mat& probabilities)
+{
+    PLASSERT( dest.length() == probabilities.length() &&
+              dest.width() == probabilities.width() );
+    if (dest.isEmpty())
+        return;
+    BulkBinomialOp op = { dest.data(), dest.mod(),
+                          probabilities.data(), probabilities.mod() };
+    philoxFill(the_seed, bulk_counter, dest.length(), dest.width(), op);
+    bulk_counter += uint64_t(dest.length()) * ((dest.width() + 3) / 4);
+}
+
+//////////////////////
+// bulk_multinomial //
+//////////////////////
+void PRandom::bulk_multinomial(const Mat& distributions,
+                               const TVec<int>& samples)
+{
+    PLASSERT( samples.length() == distributions.length() );
+    int n = distributions.width();
+    int* dest = samples.data();
+    // One block per row, of which only the first word is used.
+    for (int k = 0; k < distributions.length(); k++) {
+        uint32_t words[4];
+        philoxBlock(bulk_counter + k, the_seed, words);
+        real u = real(wordToUniform(words[0]));
+        const real* pi = distributions[k];
+        real s = pi[0];
+        int i = 0;
+        while (i < n && s < u) {
+            i++;
+            if (i < n)
+                s += pi[i];
+        }
+        // As in multinomial_sample(), improbable but...
+        dest[k] = i == n ? n - 1 : i;
+    }
+    bulk_counter += distributions.length();
+}
+
 ////////////////
 // exp_sample //
 ////////////////
@@ -311,6 +526,7 @@ void PRandom::manual_seed(int32_t x)
 void PRandom::manual_seed_(int32_t x)
 {
     the_seed = uint32_t(x);
+    bulk_counter = 0;
     rgen.seed(the_seed);
     if (uniform_01) {
         // The boost::uniform_01 object must be re-constructed from the updated
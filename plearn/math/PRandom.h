@@ -90,6 +90,10 @@ protected:
     //! The actual seed used by the random number generator.
     uint32_t the_seed;
 
+    //! Index of the next block of the counter-based stream used by the
+    //! bulk_* methods.
+    uint64_t bulk_counter;
+
     // *********************
     // * protected options *
     // *********************
@@ -138,6 +142,7 @@ public:
     { return uniform_01; }
 
     uint32_t get_the_seed()   const { return the_seed; }
+    uint64_t get_bulk_counter() const { return bulk_counter; }
     int32_t  get_fixed_seed() const { return fixed_seed; }
     int32_t  get_seed()       const { return seed_; }
 #ifdef BOUNDCHECK
@@ -244,6 +249,35 @@ public:
     //! parameter lambda = 1.
     real exp_sample();
 
+    /**
+     *  The bulk_* methods below draw their samples from a counter-based
+     *  generator (Philox4x32-10) keyed by the seed, rather than from the
+     *  Mersenne twister used by the other methods: the samples put in
+     *  dest(i,j) only depend on the seed, on the number of blocks consumed by
+     *  the previous bulk calls, and on (i,j). They are thus filled in
+     *  parallel (when OpenMP is available) without changing the result, and
+     *  are much faster than element-by-element sampling.
+     */
+
+    //! Fill 'dest' with samples uniformly distributed in [min, max).
+    void bulk_uniform(const Vec& dest, real min = 0, real max = 1);
+    void bulk_uniform(const Mat& dest, real min = 0, real max = 1);
+
+    //! Fill 'dest' with samples from a normal distribution with mean 'mean'
+    //! and standard deviation 'stddev'.
+    void bulk_normal(const Vec& dest, real mean = 0, real stddev = 1);
+    void bulk_normal(const Mat& dest, real mean = 0, real stddev = 1);
+
+    //! Set dest[i] to 1 with probability 'probabilities[i]', and to 0
+    //! otherwise (same as binomial_sample(), except that the probabilities
+    //! are not checked). 'dest' and 'probabilities' may be the same.
+    void bulk_binomial(const Vec& dest, const Vec& probabilities);
+    void bulk_binomial(const Mat& dest, const Mat& probabilities);
+
+    //! Set samples[k] to a sample of the discrete distribution given by row
+    //! k of 'distributions' (same as multinomial_sample() on each row).
+    void bulk_multinomial(const Mat& distributions, const TVec<int>& samples);
+
     /* TODO Implement.
     //! Return a random number generated from a gamma distribution.
     real gamma_sample(int ia);
@@ -102,7 +102,9 @@ PLEARN_IMPLEMENT_OBJECT(
     "  - PZ1t         -  One-tailed probability of the Z-Statistic\n"
     "  - PZ2t         -  Two-tailed probability of the Z-Statistic\n"
     "  - PSEUDOQ(q)   -  Return the location of the pseudo-quantile q, where 0 < q < 1.\n"
-    "                    NOTE that bin counting must be enabled, i.e. maxnvalues != 0\n"
+    "                    NOTE that bin counting must be enabled, i.e. maxnvalues != 0,\n"
+    "                    or the quantile sketch, i.e. quantile_sketch_compression > 0\n"
+    "  - MEDIAN       -  The median, i.e. PSEUDOQ(0.5)\n"
     "  - IQR          -  The interquartile range, i.e. PSEUDOQ(0.75) - PSEUDOQ(0.25)\n"
     "  - PRR          -  The pseudo robust range, i.e. PSEUDOQ(0.99) - PSEUDOQ(0.01)\n"
     "  - LIFT(f)      -  Lift computed at fraction f (0 <= f <= 1)\n"
@@ -155,6 +157,7 @@ StatsCollector::StatsCollector(int the_maxnvalues)
     : epsilon(0.0),
       maxnvalues(the_maxnvalues),
       no_removal_warnings(false),
+      quantile_sketch_compression(0),
       nmissing_(0.),
       nnonmissing_(0.), 
       sumsquarew_(0.),
@@ -231,6 +234,23 @@ void StatsCollector::declareOptions(OptionList& ol)
         "\n"
         "Default: false (0)." );
 
+    declareOption(
+        ol, "quantile_sketch_compression",
+        &StatsCollector::quantile_sketch_compression,
+        OptionBase::buildoption | OptionBase::nosave,
+        "If positive, the quantiles (PSEUDOQ, MEDIAN, IQR, PRR) are estimated\n"
+        "with a bounded-memory t-digest sketch of this compression, instead of\n"
+        "the 'counts' map (which may then be disabled with maxnvalues = 0).\n"
+        "The sketch keeps about 'quantile_sketch_compression' centroids, and\n"
+        "the rank error of PSEUDOQ(q) is at most about\n"
+        "  pi * sqrt(q(1-q)) / quantile_sketch_compression\n"
+        "e.g. 0.016 for the median and 0.003 for q = 0.01 with a compression\n"
+        "of 100 (errors are usually much smaller on i.i.d. data). Sketches are\n"
+        "combined by merge(), also after a save and reload. This option and\n"
+        "the sketch are only saved when the sketch is used. The\n"
+        "remove_observation mechanism cannot be used with it.\n"
+        "Default: 0 (no sketch).\n");
+
 
     // learnt options
     declareOption(
@@ -321,6 +341,12 @@ void StatsCollector::declareOptions(OptionList& ol)
         "well as a last element which maps FLT_MAX, so that we do not miss\n"
         "anything (remains empty if maxnvalues == 0).");
 
+    declareOption(
+        ol, "quantile_sketch", &StatsCollector::quantile_sketch,
+        OptionBase::learntoption | OptionBase::nosave,
+        "The t-digest quantile sketch (compression, min, max, total weight\n"
+        "and centroids). Saved only when quantile_sketch_compression > 0.");
+
     declareOption(
         ol, "count_ids", &StatsCollector::count_ids,
         OptionBase::learntoption | OptionBase::nosave,
@@ -484,6 +510,9 @@ void StatsCollector::build_()
     if(storeCounts() && counts.size()==0)
         counts[FLT_MAX] = StatsCollectorCounts();
 
+    if (quantile_sketch_compression > 0)
+        quantile_sketch.setCompression(quantile_sketch_compression);
+
     // If no values are kept, then we always see more than 0 values.
     if (maxnvalues == 0)
         more_than_maxnvalues = true;
@@ -507,6 +536,17 @@ void StatsCollector::build()
     build_();
 }
 
+//////////////////////
+// getOptionsToSave //
+//////////////////////
+string StatsCollector::getOptionsToSave() const
+{
+    string res = inherited::getOptionsToSave();
+    if (quantile_sketch_compression > 0)
+        res += "quantile_sketch_compression quantile_sketch ";
+    return res;
+}
+
 ////////////
 // forget //
 ////////////
@@ -530,6 +570,7 @@ void StatsCollector::forget()
     approximate_counts.clear();
     sorted = false;
     counts.clear();
+    quantile_sketch.forget();
     build_();
 }
 
@@ -583,6 +624,9 @@ void StatsCollector::update(real val, real weight)
             binary_ = false;
         if(!fast_exact_is_equal(val,int(round(val))))
             integer_ = false;
+
+        if (quantile_sketch_compression > 0)
+            quantile_sketch.update(val, weight);
             
         if (storeCounts())
         {
@@ -643,6 +687,10 @@ void StatsCollector::remove_observation(real val, real weight)
     }
     else
     {
+        if (quantile_sketch_compression > 0)
+            PLERROR("The remove observation mechanism is incompatible with "
+                    "quantile_sketch_compression > 0.");
+
         sorted = false;
         nnonmissing_ -= weight;
         sumsquarew_  -= weight * weight;
@@ -1022,6 +1070,9 @@ real StatsCollector::pseudo_quantile(real q) const
     real previous_position = MISSING_VALUE;
     if (fast_exact_is_equal(nnonmissing_, 0))
         return MISSING_VALUE;
+
+    if (quantile_sketch_compression > 0)
+        return real(quantile_sketch.quantile(q));
   
     for ( ; it != end ; ++it ) {
         current_total = previous_total + it->second.n + it->second.nbelow;
@@ -1161,6 +1212,7 @@ real StatsCollector::getStat(const string& statname) const
         statistics["PZ2t"]        = STATFUN(&StatsCollector::zpr2t);
         statistics["IQR"]         = STATFUN(&StatsCollector::iqr);
         statistics["PRR"]         = STATFUN(&StatsCollector::prr);
+        statistics["MEDIAN"]      = STATFUN(&StatsCollector::median);
         statistics["NIPS_LIFT"]   = STATFUN(&StatsCollector::nips_lift);
         statistics["MEAN_LIFT"]   = STATFUN(&StatsCollector::mean_lift);
         statistics["PRBP"]        = STATFUN(&StatsCollector::prbp);
@@ -1427,6 +1479,9 @@ void StatsCollector::merge(const StatsCollector& other)
 {
     if(storeCounts() && other.maxnvalues != -1)
         PLERROR("Cannot merge stats collectors w/counts if 'other' stats col. has maxnvalues != -1");
+    if(quantile_sketch_compression > 0 && other.quantile_sketch_compression <= 0
+       && other.nnonmissing_ > 0)
+        PLERROR("Cannot merge stats collectors w/quantile sketch if 'other' stats col. has no sketch");
 
     if(fast_exact_is_equal(nnonmissing_,0))    // this was empty before merge
     {
@@ -1473,6 +1528,9 @@ void StatsCollector::merge(const StatsCollector& other)
     last_= other.last_; // assume this is first and other is last.
     sorted = false;
 
+    if (quantile_sketch_compression > 0)
+        quantile_sketch.merge(other.quantile_sketch);
+
     if (storeCounts())//now merge counts
     {        
         int nextid= 0;
@@ -48,6 +48,7 @@
 #include <plearn/base/general.h>
 #include <plearn/base/RealMapping.h>
 #include "TMat.h"
+#include "TDigest.h"
 
 namespace PLearn {
 using namespace std;
@@ -171,6 +172,15 @@ public:
      */
     bool no_removal_warnings;
 
+    /**
+     * If positive, the quantiles (PSEUDOQ, MEDIAN, IQR, PRR) are estimated
+     * with a t-digest of this compression instead of the 'counts' map. It
+     * uses a bounded amount of memory, and its rank error is at most about
+     * pi * sqrt(q(1-q)) / quantile_sketch_compression (see TDigest).
+     * Default: 0 (quantiles computed from 'counts').
+     */
+    double quantile_sketch_compression;
+
     // ** Learnt options **
 
     double nmissing_;      //!< (weighted) number of missing values
@@ -204,6 +214,10 @@ protected:
 
     //! Set to 1 when the values stored in 'counts' are sorted and stored in 'sorted_values'.
     mutable bool sorted;
+
+    //! Quantile sketch, used if quantile_sketch_compression > 0 (and only
+    //! saved in that case, see getOptionsToSave()).
+    TDigest quantile_sketch;
       
 private:
 
@@ -272,6 +286,7 @@ public:
     real zpr2t() const;                        //!< two-tailed P(zstat())
     real iqr() const                    { return pseudo_quantile(0.75) - pseudo_quantile(0.25); }
     real prr() const                    { return pseudo_quantile(0.99) - pseudo_quantile(0.01); }
+    real median() const                 { return pseudo_quantile(0.5); }
     //! Return LIFT(k/n). 'n_pos_in_k' is filled with the number of positive examples
     //! in the first k examples. If provided, 'n_pos_in_k_minus_1' must be the number
     //! of positive examples in the first (k-1) examples. If provided, pos_fraction
@@ -294,6 +309,11 @@ public:
     //! simply calls inherited::build() then build_()
     virtual void build();
 
+    //! Also saves 'quantile_sketch_compression' and 'quantile_sketch' when
+    //! the sketch is used, so that the serialized form of the other
+    //! collectors is unchanged.
+    virtual string getOptionsToSave() const;
+
     //! clears all statistics, allowing to restart collecting them
     void forget();
 
@@ -321,6 +341,10 @@ public:
     
     int getMaxNValues(){return maxnvalues;}
 
+    //! Return the quantile sketch (only meaningful if
+    //! quantile_sketch_compression > 0).
+    const TDigest& getQuantileSketch() const { return quantile_sketch; }
+
     //! returns a Mat with x,y coordinates for plotting the cdf
     //! only if normalized will the cdf go to 1, otherwise it will go to nsamples
     Mat cdf(bool normalized=true) const;
@@ -328,7 +352,8 @@ public:
     /**
      * Return the position of the pseudo-quantile Q.  This is derived from
      * the bin-mapping, so maxnvalues must not be zero for this function
-     * to return something meaningful.
+     * to return something meaningful, unless the quantile sketch is used
+     * (quantile_sketch_compression > 0).
      */
     real pseudo_quantile(real q) const;
 
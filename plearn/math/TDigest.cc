@@ -0,0 +1,267 @@
+// -*- C++ -*-
+
+// TDigest.cc
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file TDigest.cc */
+
+#include "TDigest.h"
+#include <plearn/base/general.h>
+#include <plearn/base/plerror.h>
+#include <algorithm>
+#include <cmath>
+
+namespace PLearn {
+using namespace std;
+
+namespace {
+
+//! Largest rank (in [0,1]) that a centroid starting at rank q0 may reach,
+//! i.e. k^-1(k(q0) + 1) for the scale function k(q) = c / (2 pi) asin(2q-1).
+double rankLimit(double q0, double compression)
+{
+    double k = std::asin(std::max(-1.0, std::min(1.0, 2 * q0 - 1)))
+             + 2 * M_PI / compression;
+    if (k >= M_PI / 2)
+        return 1;
+    return (std::sin(k) + 1) / 2;
+}
+
+} // end of anonymous namespace
+
+TDigest::TDigest(double the_compression)
+    : compression_(the_compression),
+      centroids_weight(0),
+      buffer_weight(0),
+      min_(MISSING_VALUE),
+      max_(MISSING_VALUE)
+{
+    setCompression(the_compression);
+}
+
+void TDigest::setCompression(double the_compression)
+{
+    if (the_compression <= 0)
+        PLERROR("In TDigest::setCompression - The compression must be "
+                "positive (got %g)", the_compression);
+    compression_ = the_compression;
+}
+
+void TDigest::forget()
+{
+    centroids.clear();
+    buffer.clear();
+    centroids_weight = 0;
+    buffer_weight = 0;
+    min_ = max_ = MISSING_VALUE;
+}
+
+void TDigest::update(double value, double weight)
+{
+    PLASSERT( weight >= 0 );
+    if (weight == 0)
+        return;
+    if (isEmpty())
+        min_ = max_ = value;
+    else if (value < min_)
+        min_ = value;
+    else if (value > max_)
+        max_ = value;
+    buffer.push_back(make_pair(value, weight));
+    buffer_weight += weight;
+    if (buffer.size() >= max(size_t(16), size_t(5 * compression_)))
+        compress();
+}
+
+void TDigest::merge(const TDigest& other)
+{
+    if (other.isEmpty())
+        return;
+    if (isEmpty()) {
+        min_ = other.min_;
+        max_ = other.max_;
+    } else {
+        min_ = min(min_, other.min_);
+        max_ = max(max_, other.max_);
+    }
+    // The centroids of 'other' are added as weighted values. Copies are
+    // made first in case 'other' is this digest.
+    vector< pair<double, double> > other_centroids(other.centroids);
+    vector< pair<double, double> > other_buffer(other.buffer);
+    double other_weight = other.totalWeight();
+    buffer.insert(buffer.end(), other_centroids.begin(), other_centroids.end());
+    buffer.insert(buffer.end(), other_buffer.begin(), other_buffer.end());
+    buffer_weight += other_weight;
+    compress();
+}
+
+void TDigest::compress() const
+{
+    if (buffer.empty())
+        return;
+
+    // All the centroids and buffered values, by increasing mean.
+    sort(buffer.begin(), buffer.end());
+    vector< pair<double, double> > all(centroids.size() + buffer.size());
+    std::merge(centroids.begin(), centroids.end(),
+               buffer.begin(), buffer.end(), all.begin());
+    double total = centroids_weight + buffer_weight;
+    buffer.clear();
+    buffer_weight = 0;
+    centroids.clear();
+
+    // Greedily merge consecutive values as long as the resulting centroid
+    // does not cover more than one unit of the scale function.
+    double q0 = 0;
+    double q_limit = rankLimit(q0, compression_);
+    pair<double, double> current = all[0];
+    for (size_t i = 1; i < all.size(); i++) {
+        double w = all[i].second;
+        if (q0 + (current.second + w) / total <= q_limit) {
+            current.second += w;
+            current.first += (all[i].first - current.first) * w / current.second;
+        } else {
+            centroids.push_back(current);
+            q0 += current.second / total;
+            q_limit = rankLimit(q0, compression_);
+            current = all[i];
+        }
+    }
+    centroids.push_back(current);
+    centroids_weight = total;
+}
+
+int TDigest::nCentroids() const
+{
+    compress();
+    return int(centroids.size());
+}
+
+double TDigest::quantile(double q) const
+{
+    compress();
+    if (centroids.empty())
+        return MISSING_VALUE;
+    if (q <= 0)
+        return min_;
+    if (q >= 1)
+        return max_;
+
+    // Each centroid is located at the middle of the ranks it covers, and the
+    // quantile is linearly interpolated between the centroids (or between
+    // the extreme centroids and the min / max values).
+    int n = int(centroids.size());
+    double t = q * centroids_weight;
+    double first_half = centroids[0].second / 2;
+    if (t < first_half)
+        return min_ + (centroids[0].first - min_) * t / first_half;
+    double cum = 0;
+    for (int i = 0; i < n - 1; i++) {
+        double left = cum + centroids[i].second / 2;
+        double right = cum + centroids[i].second + centroids[i+1].second / 2;
+        if (t < right)
+            return centroids[i].first + (centroids[i+1].first - centroids[i].first)
+                                        * (t - left) / (right - left);
+        cum += centroids[i].second;
+    }
+    double last_half = centroids[n-1].second / 2;
+    double left = centroids_weight - last_half;
+    return centroids[n-1].first
+        + (max_ - centroids[n-1].first) * min(1.0, (t - left) / last_half);
+}
+
+double TDigest::cdf(double x) const
+{
+    compress();
+    if (centroids.empty())
+        return MISSING_VALUE;
+    if (x < min_)
+        return 0;
+    if (x >= max_)
+        return 1;
+
+    // Inverse of the interpolation done in quantile().
+    int n = int(centroids.size());
+    double first_half = centroids[0].second / 2;
+    if (x < centroids[0].first)
+        return first_half * (x - min_) / (centroids[0].first - min_)
+            / centroids_weight;
+    double cum = 0;
+    for (int i = 0; i < n - 1; i++) {
+        if (x < centroids[i+1].first) {
+            double left = cum + centroids[i].second / 2;
+            double right = cum + centroids[i].second + centroids[i+1].second / 2;
+            double frac = (x - centroids[i].first)
+                        / (centroids[i+1].first - centroids[i].first);
+            return (left + frac * (right - left)) / centroids_weight;
+        }
+        cum += centroids[i].second;
+    }
+    double last_half = centroids[n-1].second / 2;
+    double left = centroids_weight - last_half;
+    return (left + last_half * (x - centroids[n-1].first)
+                 / (max_ - centroids[n-1].first)) / centroids_weight;
+}
+
+PStream& operator<<(PStream& out, const TDigest& d)
+{
+    d.compress();
+    out << d.compression_ << d.min_ << d.max_ << d.centroids_weight
+        << d.centroids;
+    return out;
+}
+
+PStream& operator>>(PStream& in, TDigest& d)
+{
+    double compression;
+    in >> compression >> d.min_ >> d.max_ >> d.centroids_weight
+       >> d.centroids;
+    d.setCompression(compression);
+    d.buffer.clear();
+    d.buffer_weight = 0;
+    return in;
+}
+
+} // end of namespace PLearn
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
@@ -0,0 +1,153 @@
+// -*- C++ -*-
+
+// TDigest.h
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file TDigest.h */
+
+#ifndef TDigest_INC
+#define TDigest_INC
+
+#include <vector>
+#include <utility>
+#include <plearn/io/PStream.h>
+
+namespace PLearn {
+using namespace std;
+
+/**
+ * Bounded-memory approximation of the distribution of a stream of weighted
+ * values, used to estimate its quantiles (the "merging t-digest" of Dunning
+ * and Ertl).
+ *
+ * The values are summarized by a sorted list of centroids (mean, weight).
+ * The scale function k(q) = compression / (2 pi) * asin(2q - 1) limits the
+ * range of ranks covered by a centroid: a centroid around the quantile q
+ * holds at most a fraction 2 pi sqrt(q(1-q)) / compression of the total
+ * weight. Since quantile() interpolates between the centers of the
+ * centroids, its rank error is at most about pi sqrt(q(1-q)) / compression,
+ * i.e. 0.016 for the median and 0.003 for q = 0.01 with a compression of
+ * 100. The error is much smaller in practice when the values are i.i.d.
+ *
+ * The memory used is bounded by about 'compression' centroids, plus a buffer
+ * of 5 * compression values that are merged into the centroids when it is
+ * full. Two digests can be merged, which makes it possible to compute the
+ * quantiles of a dataset in parallel chunks, and they can be serialized
+ * (see operator<<), so that a saved digest can still be merged with others.
+ */
+class TDigest
+{
+public:
+    //! A compression of 100 gives about 1% rank accuracy in the middle of
+    //! the distribution.
+    explicit TDigest(double the_compression = 100);
+
+    //! Change the compression. The values already seen are kept; the new
+    //! compression is used from the next compression of the centroids.
+    void setCompression(double the_compression);
+
+    double compression() const { return compression_; }
+
+    //! Forget all the values seen so far.
+    void forget();
+
+    //! Add a value with the given (positive) weight.
+    void update(double value, double weight = 1.0);
+
+    //! Add all the values summarized by 'other'.
+    void merge(const TDigest& other);
+
+    //! Total weight of the values seen so far.
+    double totalWeight() const { return centroids_weight + buffer_weight; }
+
+    bool isEmpty() const { return totalWeight() <= 0; }
+
+    //! Approximate value of the quantile q (0 <= q <= 1), or MISSING_VALUE
+    //! if no value was seen.
+    double quantile(double q) const;
+
+    //! Approximate fraction of the total weight of values <= x, or
+    //! MISSING_VALUE if no value was seen.
+    double cdf(double x) const;
+
+    //! Number of centroids after merging the buffered values.
+    int nCentroids() const;
+
+    friend PStream& operator<<(PStream& out, const TDigest& d);
+    friend PStream& operator>>(PStream& in, TDigest& d);
+
+protected:
+    //! Merge the buffered values into the centroids.
+    void compress() const;
+
+    double compression_;
+
+    // The centroids and the buffer are mutable because compress() is called
+    // lazily by the const accessors (quantile(), cdf(), ...). Merging the
+    // buffer into the centroids on each update() would cost a sort of the
+    // centroids per value, and compress() does not change the values
+    // summarized by the digest. As a consequence, a TDigest must not be
+    // read from several threads at the same time.
+
+    //! Centroids, sorted by increasing mean.
+    mutable vector< pair<double, double> > centroids;
+    mutable double centroids_weight;
+
+    //! Values not yet merged into the centroids.
+    mutable vector< pair<double, double> > buffer;
+    mutable double buffer_weight;
+
+    double min_;
+    double max_;
+};
+
+//! Serialize the compression, the min and max values, the total weight and
+//! the centroids (the buffered values are merged into the centroids first).
+PStream& operator<<(PStream& out, const TDigest& d);
+PStream& operator>>(PStream& in, TDigest& d);
+
+} // end of namespace PLearn
+
+#endif
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
@@ -50,6 +50,7 @@
 #include <algorithm>
 #include <limits>
 #include <plearn/sys/Profiler.h>
+#include "simd_kernels.h"
 
 namespace PLearn {
 using namespace std;
@@ -236,12 +237,7 @@ T sumsquare(const TVec<T>& x)
 {
     if (x.length() == 0)
         return T(0);
-    T* v = x.data();
-    T res = square(v[0]);
-    int l = x.length();
-    for(int i=1; i<l; i++)
-        res += square(v[i]);
-    return res;
+    return simdSumSquare(x.data(), x.length());
 }
 
 //! returns the sum of absolute values of elements
@@ -419,13 +415,9 @@ T sum(const TVec<T>& vec, bool ignore_missing)
 template<class T>
 T sum(const TVec<T>& vec)
 {
-    T res = T(0);
     if (vec.size() == 0)
-        return res;
-    T* v = vec.data();
-    for(int i=0; i<vec.length(); i++)
-        res += v[i];
-    return res;
+        return T(0);
+    return simdSum(vec.data(), vec.length());
 }
 
 //! Returns the sum of the log of the elements
@@ -1078,7 +1070,11 @@ T powdistance(const TVec<T>& vec1, const TVec<T>& vec2, double n,
     T diff = 0;
     T* v1 = vec1.data();
     T* v2 = vec2.data();
-    if(fast_exact_is_equal(n, 1.0)) // L1 distance
+    if (!ignore_missing && fast_exact_is_equal(n, 1.0))
+        return simdL1Distance(v1, v2, length);
+    else if (!ignore_missing && fast_exact_is_equal(n, 2.0))
+        return simdSquaredDistance(v1, v2, length);
+    else if(fast_exact_is_equal(n, 1.0)) // L1 distance
     {
         for(int i=0; i<length; i++, v1++, v2++)
             if (!ignore_missing || (!is_missing(*v1) && !is_missing(*v2))) {
@@ -1200,13 +1196,8 @@ inline void operator+=(const TVec<T>& vec1, const TVec<T>& vec2)
     if(vec1.size() != vec2.size())
         PLERROR("In operator+=, vec1 and vec2 vectors must have the same length");
 #endif
-    if (vec1.size() > 0 && vec2.size() > 0) {
-        T* v1 = vec1.data();
-        T* v2 = vec2.data();
-        int l = vec1.length();
-        for(int i=0; i<l; i++)
-            *v1++ += *v2++;
-    }
+    if (vec1.size() > 0 && vec2.size() > 0)
+        simdAddAcc(vec1.data(), vec2.data(), vec1.length());
 }
 
 template<class T>
@@ -1270,12 +1261,8 @@ void operator*=(const TVec<T>& vec1, const TVec<T>& vec2)
 template<class T>
 void operator*=(const TVec<T>& vec, T factor)
 {
-    if (vec.size() > 0) {
-        T* p = vec.data();
-        int l = vec.length();
-        for (int i=0;i<l;i++)
-            *p++ *= factor;
-    }
+    if (vec.size() > 0)
+        simdScale(vec.data(), factor, vec.length());
 }
 
 template<class T>
@@ -1542,14 +1529,9 @@ T dot(const TVec<T>& vec1, const TVec<T>& vec2)
     if(vec1.length()!=vec2.length())
         PLERROR("In T operator*(const TVec<T>& vec1, const TVec<T>& vec2) (dot product) the 2 vecs must have the same length.");
 #endif
-    T res = 0;
-    if (vec1.size() > 0 && vec2.size() > 0) {
-        T* v1 = vec1.data();
-        T* v2 = vec2.data();
-        for(int i=0; i<vec1.length(); i++)
-            res += v1[i]*v2[i];
-    }
-    return res;
+    if (vec1.size() > 0 && vec2.size() > 0)
+        return simdDot(vec1.data(), vec2.data(), vec1.length());
+    return T(0);
 }
 
 //! Special dot product that allows TVec's of different types,
@@ -2642,10 +2624,8 @@ void multiplyAcc(const TVec<T>& vec, const TVec<T>& x, T scale)
     int n=x.length();
     if (vec.length()!=n)
         PLERROR("TVec::multiplyAcc this has length_=%d and x has length_=%d", vec.length(),n);
-    T* p=vec.data();
-    T* xp=x.data();
-    for (int i=0;i<n;i++)
-        *p++ += scale * *xp++;
+    if (n > 0)
+        simdMultiplyAcc(vec.data(), x.data(), scale, n);
 }
 
 //!  TVec[i] = (1-alpha)*TVec[i]+x[i]*alpha;
@@ -2827,13 +2807,7 @@ void product(const TVec<T>& result, const TMat<T>& m, const TVec<T>& v)
     T *rp = result.data();
     T *vp = v.data();
     for (int i=0;i<l;i++)
-    {
-        const T* mi = m[i];
-        T s = 0;
-        for (int j=0;j<w;j++)
-            s += mi[j] * vp[j];
-        rp[i] = s;
-    }
+        rp[i] = simdDot(m[i], vp, w);
 }
 
 //!  result[i] += sum_j m[i,j] * v[j]
@@ -2863,12 +2837,9 @@ void productAcc(const TVec<T>& result, const TMat<T>& m, const TVec<T>& v)
     int deltam = m.mod()-m.width();
     for (int i=0;i<l;i++)
     {
-        T *vp = vdata;
-        T s = *rp;
-        for (int j=0;j<w;j++)
-            s += *mp++ * *vp++;
-        *rp++ = s;
-        mp += deltam;
+        *rp = simdDotAcc(*rp, mp, vdata, w);
+        ++rp;
+        mp += w + deltam;
     }
 }
 
@@ -2914,13 +2885,10 @@ void productScaleAcc(const TVec<T>& result, const TMat<T>& m, const TVec<T>& v,
     int deltam = m.mod()-m.width();
     for (int i=0;i<l;i++)
     {
-        T *vp = vdata;
-        T s = 0;
-        for (int j=0;j<w;j++)
-            s += *mp++ * *vp++;
+        T s = simdDot(mp, vdata, w);
         *rp = alpha * s + beta * (*rp);
         ++rp;
-        mp += deltam;
+        mp += w + deltam;
     }
 }
 
@@ -2955,12 +2923,7 @@ void transposeProduct(const TVec<T>& result, const TMat<T>& m, const TVec<T>& v)
     T *vp = v.data();
     result.clear();
     for (int j=0;j<l;j++)
-    {
-        const T* mj = m[j];
-        T vj = vp[j];
-        for (int i=0;i<result.length();i++)
-            rp[i] += mj[i] * vj;
-    }
+        simdMultiplyAcc(rp, m[j], vp[j], result.length());
     Profiler::pl_profile_end("transposeProduct T");
 }
 
@@ -3005,19 +2968,10 @@ void transposeProductAcc(const TVec<T>& result, const TMat<T>& m,
         if(vj!=0)
         {
             if(vj==1)
-            {
-                T* rp = rdata;
-                for (int i=0;i<w;i++)
-                    *rp++ += *mp++;
-                mp += deltam;
-            }
+                simdAddAcc(rdata, mp, w);
             else
-            {
-                T* rp = rdata;
-                for (int i=0;i<w;i++)
-                    *rp++ += vj * *mp++;
-                mp += deltam;
-            }
+                simdMultiplyAcc(rdata, mp, vj, w);
+            mp += w + deltam;
         }
         else mp += w + deltam;
     }
@@ -3832,25 +3786,14 @@ void externalProductAcc(const TMat<T>& mat, const TVec<T>& v1, const TVec<T>& v2
 
     if(mat.isCompact())
     {
-        T* pv1 = v_1;
-        for(int i=0; i<l; i++)
-        {
-            T* pv2 = v_2;
-            T val = *pv1++;
-            for(int j=0; j<w; j++)
-                *mp++ += val * *pv2++;
-        }
+        for(int i=0; i<l; i++, mp += w)
+            simdMultiplyAcc(mp, v_2, v_1[i], w);
     }
     else
     {
         cerr << "!";
         for (int i=0;i<l;i++)
-        {
-            T* mi = mat[i];
-            T v1i = v_1[i];
-            for (int j=0;j<w;j++)
-                mi[j] += v1i * v_2[j];
-        }
+            simdMultiplyAcc(mat[i], v_2, v_1[i], w);
     }
 }
 
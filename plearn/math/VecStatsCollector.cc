@@ -56,6 +56,7 @@ VecStatsCollector::VecStatsCollector()
       m_full_update_frequency(-1),
       m_window_nan_code(0),
       no_removal_warnings(false), // Window mechanism
+      quantile_sketch_compression(0),
       sum_non_missing_weights(0),
       sum_non_missing_square_weights(0),
       m_num_incremental(0)
@@ -147,6 +148,16 @@ void VecStatsCollector::declareOptions(OptionList& ol)
         "To disable this feature, set 'no_removal_warnings' to true.\n"
         "\n"
         "Default: false (0)." );
+
+    declareOption(
+        ol, "quantile_sketch_compression",
+        &VecStatsCollector::quantile_sketch_compression,
+        OptionBase::buildoption | OptionBase::nosave,
+        "Forwarded to the 'quantile_sketch_compression' option of the\n"
+        "enclosed StatsCollectors: if positive, their quantiles are estimated\n"
+        "with a bounded-memory t-digest sketch (see StatsCollector).\n"
+        "\n"
+        "Default: 0 (no sketch)." );
   
     declareOption(
         ol, "stats", &VecStatsCollector::stats, OptionBase::learntoption,
@@ -362,6 +373,7 @@ void VecStatsCollector::update(const Vec& x, real weight)
             stats[k].epsilon             = epsilon;
             stats[k].maxnvalues          = maxnvalues;
             stats[k].no_removal_warnings = no_removal_warnings;
+            stats[k].quantile_sketch_compression = quantile_sketch_compression;
             stats[k].forget();
         }
         if(compute_covariance)
@@ -874,6 +886,7 @@ void VecStatsCollector::merge(VecStatsCollector& other)
             // compute a lift statistics).
             stats[k].maxnvalues          = maxnvalues;
             stats[k].no_removal_warnings = no_removal_warnings;
+            stats[k].quantile_sketch_compression = quantile_sketch_compression;
             stats[k].forget();
         }
         if(compute_covariance)
@@ -130,6 +130,15 @@ public:
      */
     bool no_removal_warnings;
 
+    /**
+     *  Forwarded to the 'quantile_sketch_compression' option of the enclosed
+     *  StatsCollectors: if positive, their quantiles are estimated with a
+     *  bounded-memory t-digest sketch.
+     *
+     *  Default: 0 (no sketch).
+     */
+    double quantile_sketch_compression;
+
     
     // ******************
     // * learnt options *
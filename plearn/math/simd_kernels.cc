@@ -0,0 +1,467 @@
+// -*- C++ -*-
+
+// simd_kernels.cc
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file simd_kernels.cc */
+
+#include "simd_kernels.h"
+#include <stdlib.h>
+#include <string.h>
+
+// The vectorised kernels are compiled with GCC target options, so that they
+// do not require the whole library to be compiled for a given CPU. Implicit
+// contraction into fused multiply-adds is disabled, so that only the
+// kernels explicitly using P::fmadd round differently from the scalar ones.
+#if defined(__GNUC__) && !defined(__INTEL_COMPILER) \
+    && (defined(__x86_64__) || defined(__i386__)) \
+    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define PL_SIMD_X86
+#if __GNUC__ >= 5
+#define PL_SIMD_AVX512
+#endif
+#include <immintrin.h>
+#endif
+
+namespace PLearn {
+
+//////////////////////
+// Scalar kernels   //
+//////////////////////
+// They perform the same operations as the loops of TMat_maths_impl.h.
+
+template<class T>
+static T scalarDot(const T* x, const T* y, int n)
+{
+    T res = 0;
+    for (int i = 0; i < n; i++)
+        res += x[i] * y[i];
+    return res;
+}
+
+template<class T>
+static T scalarSum(const T* x, int n)
+{
+    T res = 0;
+    for (int i = 0; i < n; i++)
+        res += x[i];
+    return res;
+}
+
+template<class T>
+static T scalarSumSquare(const T* x, int n)
+{
+    T res = 0;
+    for (int i = 0; i < n; i++)
+        res += x[i] * x[i];
+    return res;
+}
+
+template<class T>
+static T scalarSquaredDistance(const T* x, const T* y, int n)
+{
+    T res = 0;
+    for (int i = 0; i < n; i++) {
+        T diff = x[i] - y[i];
+        res += diff * diff;
+    }
+    return res;
+}
+
+template<class T>
+static T scalarL1Distance(const T* x, const T* y, int n)
+{
+    T res = 0;
+    for (int i = 0; i < n; i++) {
+        T diff = x[i] - y[i];
+        if (diff >= 0)
+            res += diff;
+        else
+            res -= diff;
+    }
+    return res;
+}
+
+template<class T>
+static void scalarMultiplyAcc(T* y, const T* x, T a, int n)
+{
+    for (int i = 0; i < n; i++)
+        y[i] += a * x[i];
+}
+
+template<class T>
+static void scalarScale(T* x, T a, int n)
+{
+    for (int i = 0; i < n; i++)
+        x[i] *= a;
+}
+
+template<class T>
+static void scalarAddAcc(T* y, const T* x, int n)
+{
+    for (int i = 0; i < n; i++)
+        y[i] += x[i];
+}
+
+template<class T>
+static void fillScalarKernels(SimdKernelTable<T>& table)
+{
+    table.dot = &scalarDot<T>;
+    table.sum = &scalarSum<T>;
+    table.sumsquare = &scalarSumSquare<T>;
+    table.squared_distance = &scalarSquaredDistance<T>;
+    table.l1_distance = &scalarL1Distance<T>;
+    table.multiply_acc = &scalarMultiplyAcc<T>;
+    table.scale = &scalarScale<T>;
+    table.add_acc = &scalarAddAcc<T>;
+}
+
+// The tables are statically initialised with the scalar kernels, so that
+// they may be used before the dynamic initialisation below.
+SimdKernelTable<double> simd_double_kernels = {
+    &scalarDot<double>, &scalarSum<double>, &scalarSumSquare<double>,
+    &scalarSquaredDistance<double>, &scalarL1Distance<double>,
+    &scalarMultiplyAcc<double>, &scalarScale<double>, &scalarAddAcc<double>
+};
+
+SimdKernelTable<float> simd_float_kernels = {
+    &scalarDot<float>, &scalarSum<float>, &scalarSumSquare<float>,
+    &scalarSquaredDistance<float>, &scalarL1Distance<float>,
+    &scalarMultiplyAcc<float>, &scalarScale<float>, &scalarAddAcc<float>
+};
+
+#ifdef PL_SIMD_X86
+
+////////////////////
+// SSE2 kernels   //
+////////////////////
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#pragma GCC optimize("fp-contract=off")
+namespace sse2 {
+
+struct DoublePacket
+{
+    typedef double T;
+    typedef __m128d V;
+    enum { width = 2 };
+    static V zero() { return _mm_setzero_pd(); }
+    static V load(const T* p) { return _mm_loadu_pd(p); }
+    static void store(T* p, V v) { _mm_storeu_pd(p, v); }
+    static V set1(T a) { return _mm_set1_pd(a); }
+    static V add(V a, V b) { return _mm_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm_sub_pd(a, b); }
+    static V mul(V a, V b) { return _mm_mul_pd(a, b); }
+    static V fmadd(V a, V b, V c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+    static V abs(V a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+    static T hsum(V a)
+    {
+        T buf[width];
+        store(buf, a);
+        return buf[0] + buf[1];
+    }
+};
+
+struct FloatPacket
+{
+    typedef float T;
+    typedef __m128 V;
+    enum { width = 4 };
+    static V zero() { return _mm_setzero_ps(); }
+    static V load(const T* p) { return _mm_loadu_ps(p); }
+    static void store(T* p, V v) { _mm_storeu_ps(p, v); }
+    static V set1(T a) { return _mm_set1_ps(a); }
+    static V add(V a, V b) { return _mm_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static V fmadd(V a, V b, V c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static V abs(V a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static T hsum(V a)
+    {
+        T buf[width];
+        store(buf, a);
+        return (buf[0] + buf[1]) + (buf[2] + buf[3]);
+    }
+};
+
+#include "simd_kernels_impl.h"
+
+} // end of namespace sse2
+#pragma GCC pop_options
+
+////////////////////
+// AVX2 kernels   //
+////////////////////
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#pragma GCC optimize("fp-contract=off")
+namespace avx2 {
+
+struct DoublePacket
+{
+    typedef double T;
+    typedef __m256d V;
+    enum { width = 4 };
+    static V zero() { return _mm256_setzero_pd(); }
+    static V load(const T* p) { return _mm256_loadu_pd(p); }
+    static void store(T* p, V v) { _mm256_storeu_pd(p, v); }
+    static V set1(T a) { return _mm256_set1_pd(a); }
+    static V add(V a, V b) { return _mm256_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+    static V fmadd(V a, V b, V c) { return _mm256_fmadd_pd(a, b, c); }
+    static V abs(V a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+    static T hsum(V a)
+    {
+        T buf[width];
+        store(buf, a);
+        return (buf[0] + buf[1]) + (buf[2] + buf[3]);
+    }
+};
+
+struct FloatPacket
+{
+    typedef float T;
+    typedef __m256 V;
+    enum { width = 8 };
+    static V zero() { return _mm256_setzero_ps(); }
+    static V load(const T* p) { return _mm256_loadu_ps(p); }
+    static void store(T* p, V v) { _mm256_storeu_ps(p, v); }
+    static V set1(T a) { return _mm256_set1_ps(a); }
+    static V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static V fmadd(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+    static V abs(V a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static T hsum(V a)
+    {
+        T buf[width];
+        store(buf, a);
+        return ((buf[0] + buf[1]) + (buf[2] + buf[3]))
+             + ((buf[4] + buf[5]) + (buf[6] + buf[7]));
+    }
+};
+
+#include "simd_kernels_impl.h"
+
+} // end of namespace avx2
+#pragma GCC pop_options
+
+#ifdef PL_SIMD_AVX512
+
+//////////////////////
+// AVX-512 kernels  //
+//////////////////////
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#pragma GCC optimize("fp-contract=off")
+namespace avx512 {
+
+struct DoublePacket
+{
+    typedef double T;
+    typedef __m512d V;
+    enum { width = 8 };
+    static V zero() { return _mm512_setzero_pd(); }
+    static V load(const T* p) { return _mm512_loadu_pd(p); }
+    static void store(T* p, V v) { _mm512_storeu_pd(p, v); }
+    static V set1(T a) { return _mm512_set1_pd(a); }
+    static V add(V a, V b) { return _mm512_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm512_sub_pd(a, b); }
+    static V mul(V a, V b) { return _mm512_mul_pd(a, b); }
+    static V fmadd(V a, V b, V c) { return _mm512_fmadd_pd(a, b, c); }
+    static V abs(V a)
+    {
+        // AVX-512F has no floating point 'and' instruction.
+        return _mm512_castsi512_pd(
+            _mm512_and_epi64(_mm512_castpd_si512(a),
+                             _mm512_set1_epi64(0x7FFFFFFFFFFFFFFFLL)));
+    }
+    static T hsum(V a)
+    {
+        T buf[width];
+        store(buf, a);
+        return ((buf[0] + buf[1]) + (buf[2] + buf[3]))
+             + ((buf[4] + buf[5]) + (buf[6] + buf[7]));
+    }
+};
+
+struct FloatPacket
+{
+    typedef float T;
+    typedef __m512 V;
+    enum { width = 16 };
+    static V zero() { return _mm512_setzero_ps(); }
+    static V load(const T* p) { return _mm512_loadu_ps(p); }
+    static void store(T* p, V v) { _mm512_storeu_ps(p, v); }
+    static V set1(T a) { return _mm512_set1_ps(a); }
+    static V add(V a, V b) { return _mm512_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+    static V fmadd(V a, V b, V c) { return _mm512_fmadd_ps(a, b, c); }
+    static V abs(V a)
+    {
+        return _mm512_castsi512_ps(
+            _mm512_and_epi32(_mm512_castps_si512(a),
+                             _mm512_set1_epi32(0x7FFFFFFF)));
+    }
+    static T hsum(V a)
+    {
+        T buf[width];
+        store(buf, a);
+        T res = 0;
+        for (int i = 0; i < width; i += 2)
+            res += buf[i] + buf[i + 1];
+        return res;
+    }
+};
+
+#include "simd_kernels_impl.h"
+
+} // end of namespace avx512
+#pragma GCC pop_options
+
+#endif // PL_SIMD_AVX512
+#endif // PL_SIMD_X86
+
+////////////////
+// Dispatch   //
+////////////////
+
+static SimdInstructionSet current_instruction_set = SIMD_SCALAR;
+static bool current_reorder = false;
+
+SimdInstructionSet simdBestInstructionSet()
+{
+#ifdef PL_SIMD_X86
+    __builtin_cpu_init();
+#ifdef PL_SIMD_AVX512
+    if (__builtin_cpu_supports("avx512f"))
+        return SIMD_AVX512;
+#endif
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return SIMD_SSE2;
+#endif
+    return SIMD_SCALAR;
+}
+
+SimdInstructionSet simdInstructionSet()
+{
+    return current_instruction_set;
+}
+
+bool simdReorder()
+{
+    return current_reorder;
+}
+
+const char* simdInstructionSetName(SimdInstructionSet isa)
+{
+    switch (isa) {
+    case SIMD_SSE2:
+        return "sse2";
+    case SIMD_AVX2:
+        return "avx2";
+    case SIMD_AVX512:
+        return "avx512";
+    default:
+        return "scalar";
+    }
+}
+
+SimdInstructionSet setSimdInstructionSet(SimdInstructionSet isa,
+                                         bool reorder)
+{
+    SimdInstructionSet best = simdBestInstructionSet();
+    if (isa > best)
+        isa = best;
+    fillScalarKernels(simd_double_kernels);
+    fillScalarKernels(simd_float_kernels);
+    switch (isa) {
+#ifdef PL_SIMD_X86
+#ifdef PL_SIMD_AVX512
+    case SIMD_AVX512:
+        avx512::fillKernelTables(simd_double_kernels, simd_float_kernels,
+                                 reorder);
+        break;
+#endif
+    case SIMD_AVX2:
+        avx2::fillKernelTables(simd_double_kernels, simd_float_kernels,
+                               reorder);
+        break;
+    case SIMD_SSE2:
+        sse2::fillKernelTables(simd_double_kernels, simd_float_kernels,
+                               reorder);
+        break;
+#endif
+    default:
+        isa = SIMD_SCALAR;
+        reorder = false;
+        break;
+    }
+    current_instruction_set = isa;
+    current_reorder = reorder;
+    return isa;
+}
+
+//! Select the kernels at startup, according to the CPU and to the
+//! PLEARN_SIMD and PLEARN_SIMD_REORDER environment variables.
+static SimdInstructionSet initSimdKernels()
+{
+    SimdInstructionSet isa = SIMD_AVX512;
+    const char* env = getenv("PLEARN_SIMD");
+    if (env)
+        for (int i = SIMD_SCALAR; i <= SIMD_AVX512; i++)
+            if (!strcmp(env, simdInstructionSetName(SimdInstructionSet(i))))
+                isa = SimdInstructionSet(i);
+    const char* reorder = getenv("PLEARN_SIMD_REORDER");
+    return setSimdInstructionSet(isa, reorder && strcmp(reorder, "0"));
+}
+
+static SimdInstructionSet initial_instruction_set = initSimdKernels();
+
+} // end of namespace PLearn
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
@@ -0,0 +1,288 @@
+// -*- C++ -*-
+
+// simd_kernels.h
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file simd_kernels.h */
+
+#ifndef simd_kernels_INC
+#define simd_kernels_INC
+
+namespace PLearn {
+
+/**
+ * Vectorised kernels for the most used vector primitives of TMat_maths.
+ *
+ * Each kernel exists in a scalar version, which performs exactly the same
+ * operations (in the same order) as the plain loops of TMat_maths_impl.h,
+ * and in SSE2, AVX2 (with FMA) and AVX-512 versions. The best version
+ * supported by the CPU is selected at startup; the PLEARN_SIMD environment
+ * variable ("scalar", "sse2", "avx2" or "avx512") may be used to choose a
+ * lower one.
+ *
+ * By default, only the element-wise kernels (multiply_acc, scale and
+ * add_acc) are vectorised, without fused multiply-adds: they give exactly
+ * the same results as the scalar loops. The vectorised reductions (dot,
+ * sum, sumsquare and the distances) use several accumulators and fused
+ * multiply-adds, thus do not round as the scalar loops do and may change
+ * results in the last bits; they are only used when the
+ * PLEARN_SIMD_REORDER environment variable is set (to anything but "0").
+ *
+ * All kernels work on unaligned data, and can be called with n == 0.
+ */
+
+//! Instruction sets, by increasing order.
+enum SimdInstructionSet {
+    SIMD_SCALAR = 0,
+    SIMD_SSE2,
+    SIMD_AVX2,
+    SIMD_AVX512
+};
+
+//! Table of the kernels for one floating point type.
+template<class T>
+struct SimdKernelTable
+{
+    //! Return sum_i x[i] * y[i].
+    T (*dot)(const T* x, const T* y, int n);
+    //! Return sum_i x[i].
+    T (*sum)(const T* x, int n);
+    //! Return sum_i x[i]^2.
+    T (*sumsquare)(const T* x, int n);
+    //! Return sum_i (x[i] - y[i])^2.
+    T (*squared_distance)(const T* x, const T* y, int n);
+    //! Return sum_i |x[i] - y[i]|.
+    T (*l1_distance)(const T* x, const T* y, int n);
+    //! y[i] += a * x[i].
+    void (*multiply_acc)(T* y, const T* x, T a, int n);
+    //! x[i] *= a.
+    void (*scale)(T* x, T a, int n);
+    //! y[i] += x[i].
+    void (*add_acc)(T* y, const T* x, int n);
+};
+
+//! Kernels currently used (they are the scalar ones until the static
+//! initialisation of simd_kernels.cc is done).
+extern SimdKernelTable<double> simd_double_kernels;
+extern SimdKernelTable<float> simd_float_kernels;
+
+//! Best instruction set supported by both the CPU and this build.
+SimdInstructionSet simdBestInstructionSet();
+
+//! Instruction set of the kernels currently used.
+SimdInstructionSet simdInstructionSet();
+
+//! Whether the kernels currently used may sum in a different order than
+//! the scalar ones (see setSimdInstructionSet).
+bool simdReorder();
+
+//! Name of an instruction set ("scalar", "sse2", "avx2" or "avx512").
+const char* simdInstructionSetName(SimdInstructionSet isa);
+
+//! Use the kernels of 'isa', or of the best supported instruction set below
+//! it, and return the instruction set actually used. Unless 'reorder' is
+//! true, the kernels whose vectorised version would not give exactly the
+//! same results as the scalar one keep using the scalar version. This must
+//! not be called while other threads may use the kernels.
+SimdInstructionSet setSimdInstructionSet(SimdInstructionSet isa,
+                                         bool reorder = false);
+
+// The functions below are called by the loops of TMat_maths_impl.h. The
+// templates are used for types other than double and float, and do the
+// same as the scalar kernels.
+
+template<class T>
+inline T simdDot(const T* x, const T* y, int n)
+{
+    T res = 0;
+    for (int i = 0; i < n; i++)
+        res += x[i] * y[i];
+    return res;
+}
+
+inline double simdDot(const double* x, const double* y, int n)
+{ return simd_double_kernels.dot(x, y, n); }
+
+inline float simdDot(const float* x, const float* y, int n)
+{ return simd_float_kernels.dot(x, y, n); }
+
+//! Return acc + sum_i x[i] * y[i]. Unless the kernels may reorder the sums
+//! (see simdReorder()), the products are added one by one to 'acc', as
+//! accumulating loops such as productAcc() always did.
+template<class T>
+inline T simdDotAcc(T acc, const T* x, const T* y, int n)
+{
+    for (int i = 0; i < n; i++)
+        acc += x[i] * y[i];
+    return acc;
+}
+
+inline double simdDotAcc(double acc, const double* x, const double* y, int n)
+{
+    if (simdReorder())
+        return acc + simd_double_kernels.dot(x, y, n);
+    for (int i = 0; i < n; i++)
+        acc += x[i] * y[i];
+    return acc;
+}
+
+inline float simdDotAcc(float acc, const float* x, const float* y, int n)
+{
+    if (simdReorder())
+        return acc + simd_float_kernels.dot(x, y, n);
+    for (int i = 0; i < n; i++)
+        acc += x[i] * y[i];
+    return acc;
+}
+
+template<class T>
+inline T simdSum(const T* x, int n)
+{
+    T res = 0;
+    for (int i = 0; i < n; i++)
+        res += x[i];
+    return res;
+}
+
+inline double simdSum(const double* x, int n)
+{ return simd_double_kernels.sum(x, n); }
+
+inline float simdSum(const float* x, int n)
+{ return simd_float_kernels.sum(x, n); }
+
+template<class T>
+inline T simdSumSquare(const T* x, int n)
+{
+    T res = 0;
+    for (int i = 0; i < n; i++)
+        res += x[i] * x[i];
+    return res;
+}
+
+inline double simdSumSquare(const double* x, int n)
+{ return simd_double_kernels.sumsquare(x, n); }
+
+inline float simdSumSquare(const float* x, int n)
+{ return simd_float_kernels.sumsquare(x, n); }
+
+template<class T>
+inline T simdSquaredDistance(const T* x, const T* y, int n)
+{
+    T res = 0;
+    for (int i = 0; i < n; i++) {
+        T diff = x[i] - y[i];
+        res += diff * diff;
+    }
+    return res;
+}
+
+inline double simdSquaredDistance(const double* x, const double* y, int n)
+{ return simd_double_kernels.squared_distance(x, y, n); }
+
+inline float simdSquaredDistance(const float* x, const float* y, int n)
+{ return simd_float_kernels.squared_distance(x, y, n); }
+
+template<class T>
+inline T simdL1Distance(const T* x, const T* y, int n)
+{
+    T res = 0;
+    for (int i = 0; i < n; i++) {
+        T diff = x[i] - y[i];
+        if (diff >= 0)
+            res += diff;
+        else
+            res -= diff;
+    }
+    return res;
+}
+
+inline double simdL1Distance(const double* x, const double* y, int n)
+{ return simd_double_kernels.l1_distance(x, y, n); }
+
+inline float simdL1Distance(const float* x, const float* y, int n)
+{ return simd_float_kernels.l1_distance(x, y, n); }
+
+template<class T>
+inline void simdMultiplyAcc(T* y, const T* x, T a, int n)
+{
+    for (int i = 0; i < n; i++)
+        y[i] += a * x[i];
+}
+
+inline void simdMultiplyAcc(double* y, const double* x, double a, int n)
+{ simd_double_kernels.multiply_acc(y, x, a, n); }
+
+inline void simdMultiplyAcc(float* y, const float* x, float a, int n)
+{ simd_float_kernels.multiply_acc(y, x, a, n); }
+
+template<class T>
+inline void simdScale(T* x, T a, int n)
+{
+    for (int i = 0; i < n; i++)
+        x[i] *= a;
+}
+
+inline void simdScale(double* x, double a, int n)
+{ simd_double_kernels.scale(x, a, n); }
+
+inline void simdScale(float* x, float a, int n)
+{ simd_float_kernels.scale(x, a, n); }
+
+template<class T>
+inline void simdAddAcc(T* y, const T* x, int n)
+{
+    for (int i = 0; i < n; i++)
+        y[i] += x[i];
+}
+
+inline void simdAddAcc(double* y, const double* x, int n)
+{ simd_double_kernels.add_acc(y, x, n); }
+
+inline void simdAddAcc(float* y, const float* x, int n)
+{ simd_float_kernels.add_acc(y, x, n); }
+
+} // end of namespace PLearn
+
+#endif
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
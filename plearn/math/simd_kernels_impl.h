@@ -0,0 +1,235 @@
+// -*- C++ -*-
+
+// simd_kernels_impl.h
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file simd_kernels_impl.h */
+
+// This file has no include guard: it is included by simd_kernels.cc once
+// for each instruction set, in a namespace where the DoublePacket and
+// FloatPacket types are defined, with the corresponding target options.
+//
+// A packet type P must define the element type T, the register type V, the
+// number of elements 'width' and the static functions zero, load, store,
+// set1, add, sub, mul, fmadd (a * b + c), abs and hsum (sum of the elements
+// of a register).
+
+//! Operations summed by SimdKernels::reduce.
+template<class P>
+struct DotOp
+{
+    typedef typename P::T T;
+    typedef typename P::V V;
+    static V step(V acc, V x, V y) { return P::fmadd(x, y, acc); }
+    static T step(T acc, T x, T y) { return acc + x * y; }
+};
+
+template<class P>
+struct SumOp
+{
+    typedef typename P::T T;
+    typedef typename P::V V;
+    static V step(V acc, V x, V) { return P::add(acc, x); }
+    static T step(T acc, T x, T) { return acc + x; }
+};
+
+template<class P>
+struct SumSquareOp
+{
+    typedef typename P::T T;
+    typedef typename P::V V;
+    static V step(V acc, V x, V) { return P::fmadd(x, x, acc); }
+    static T step(T acc, T x, T) { return acc + x * x; }
+};
+
+template<class P>
+struct SquaredDistanceOp
+{
+    typedef typename P::T T;
+    typedef typename P::V V;
+    static V step(V acc, V x, V y)
+    {
+        V diff = P::sub(x, y);
+        return P::fmadd(diff, diff, acc);
+    }
+    static T step(T acc, T x, T y)
+    {
+        T diff = x - y;
+        return acc + diff * diff;
+    }
+};
+
+template<class P>
+struct L1DistanceOp
+{
+    typedef typename P::T T;
+    typedef typename P::V V;
+    static V step(V acc, V x, V y) { return P::add(acc, P::abs(P::sub(x, y))); }
+    static T step(T acc, T x, T y)
+    {
+        T diff = x - y;
+        return diff >= 0 ? acc + diff : acc - diff;
+    }
+};
+
+template<class P>
+struct SimdKernels
+{
+    typedef typename P::T T;
+    typedef typename P::V V;
+
+    //! Sum Op::step over x and y, with four independent accumulators to
+    //! hide the latency of the additions.
+    template<class Op>
+    static T reduce(const T* x, const T* y, int n)
+    {
+        const int w = P::width;
+        V a0 = P::zero();
+        V a1 = a0;
+        V a2 = a0;
+        V a3 = a0;
+        int i = 0;
+        for (; i + 4 * w <= n; i += 4 * w) {
+            a0 = Op::step(a0, P::load(x + i), P::load(y + i));
+            a1 = Op::step(a1, P::load(x + i + w), P::load(y + i + w));
+            a2 = Op::step(a2, P::load(x + i + 2 * w), P::load(y + i + 2 * w));
+            a3 = Op::step(a3, P::load(x + i + 3 * w), P::load(y + i + 3 * w));
+        }
+        for (; i + w <= n; i += w)
+            a0 = Op::step(a0, P::load(x + i), P::load(y + i));
+        T res = P::hsum(P::add(P::add(a0, a1), P::add(a2, a3)));
+        for (; i < n; i++)
+            res = Op::step(res, x[i], y[i]);
+        return res;
+    }
+
+    static T dot(const T* x, const T* y, int n)
+    { return reduce< DotOp<P> >(x, y, n); }
+
+    static T sum(const T* x, int n)
+    { return reduce< SumOp<P> >(x, x, n); }
+
+    static T sumsquare(const T* x, int n)
+    { return reduce< SumSquareOp<P> >(x, x, n); }
+
+    static T squared_distance(const T* x, const T* y, int n)
+    { return reduce< SquaredDistanceOp<P> >(x, y, n); }
+
+    static T l1_distance(const T* x, const T* y, int n)
+    { return reduce< L1DistanceOp<P> >(x, y, n); }
+
+    static void multiply_acc(T* y, const T* x, T a, int n)
+    {
+        const int w = P::width;
+        V va = P::set1(a);
+        int i = 0;
+        for (; i + w <= n; i += w)
+            P::store(y + i, P::fmadd(va, P::load(x + i), P::load(y + i)));
+        for (; i < n; i++)
+            y[i] += a * x[i];
+    }
+
+    //! Same as multiply_acc, with the product rounded before the addition
+    //! (as in the scalar loop) instead of a fused multiply-add.
+    static void multiply_acc_exact(T* y, const T* x, T a, int n)
+    {
+        const int w = P::width;
+        V va = P::set1(a);
+        int i = 0;
+        for (; i + w <= n; i += w)
+            P::store(y + i, P::add(P::load(y + i),
+                                   P::mul(va, P::load(x + i))));
+        for (; i < n; i++)
+            y[i] += a * x[i];
+    }
+
+    static void scale(T* x, T a, int n)
+    {
+        const int w = P::width;
+        V va = P::set1(a);
+        int i = 0;
+        for (; i + w <= n; i += w)
+            P::store(x + i, P::mul(P::load(x + i), va));
+        for (; i < n; i++)
+            x[i] *= a;
+    }
+
+    static void add_acc(T* y, const T* x, int n)
+    {
+        const int w = P::width;
+        int i = 0;
+        for (; i + w <= n; i += w)
+            P::store(y + i, P::add(P::load(y + i), P::load(x + i)));
+        for (; i < n; i++)
+            y[i] += x[i];
+    }
+
+    //! Set the kernels of 'table'. Unless 'reorder' is true, only the
+    //! element-wise kernels giving the same results as the scalar ones are
+    //! set, and the reductions are left unchanged.
+    static void fill(SimdKernelTable<T>& table, bool reorder)
+    {
+        if (reorder) {
+            table.dot = &dot;
+            table.sum = &sum;
+            table.sumsquare = &sumsquare;
+            table.squared_distance = &squared_distance;
+            table.l1_distance = &l1_distance;
+            table.multiply_acc = &multiply_acc;
+        } else
+            table.multiply_acc = &multiply_acc_exact;
+        table.scale = &scale;
+        table.add_acc = &add_acc;
+    }
+};
+
+//! Use the kernels of this instruction set (see SimdKernels::fill).
+inline void fillKernelTables(SimdKernelTable<double>& double_table,
+                             SimdKernelTable<float>& float_table,
+                             bool reorder)
+{
+    SimdKernels<DoublePacket>::fill(double_table, reorder);
+    SimdKernels<FloatPacket>::fill(float_table, reorder);
+}
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
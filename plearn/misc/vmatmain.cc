@@ -46,6 +46,7 @@
 #include <plearn/vmat/SelectColumnsVMatrix.h>
 #include <plearn/vmat/SubVMatrix.h>
 #include <plearn/vmat/VMatLanguage.h>
+#include <plearn/vmat/VMatPipeline.h>
 #include <plearn/vmat/VVMatrix.h>
 #include <plearn/vmat/VMat.h>
 #include <plearn/vmat/SelectRowsFileIndexVMatrix.h>
@@ -64,46 +65,34 @@ namespace PLearn {
 using namespace std;
 
 /**
- * This function converts a VMat to a CSV (comma-separated value) file with
- * the given name.  One can also specify a list of column names or numbers
- * to keep, as well as whether any missing values on a row cause that row
- * to be skipped during export.  In addition, the number of significant
- * digits after the decimal period can be specified.
- *
- * If the 'convert_date' option is true (whose purpose is to convert CYYMMDD
- * dates into YYYYMMDD dates), then the integer 19000000 is added to the first
- * element of each row (assumed to contain a date column).
+ * Formats the rows streamed by a VMatPipeline as CSV lines (see
+ * save_vmat_as_csv).  This uses the string mappings of the source, and is
+ * thus done in the thread running the pipeline.
  */
-static void save_vmat_as_csv(VMat source, ostream& destination,
-                             bool skip_missings, int precision = 12,
-                             string delimiter = ",",
-                             bool verbose = true,
-                             bool convert_date = false)
+struct CsvRowWriter: public VMatPipelineConsumer
 {
-    char buffer[1000];
-  
-    // First, output the fieldnames in quoted CSV format.  Don't forget
-    // to quote the quotes
-    TVec<string> fields = source->fieldNames();
-    for (int i=0, n=fields.size() ; i<n ; ++i) {
-        string curfield = fields[i];
-        search_replace(curfield, "\"", "\\\"");
-        destination << '"' << curfield << '"';
-        if (i < n-1)
-            destination << delimiter;
-    }
-    destination << "\n";
-
-    PP<ProgressBar> pb;
-    if (verbose)
-        pb = new ProgressBar(cout, "Saving to CSV", source.length());
-
-    // Next, output each line.  Perform missing-value checks if required.
-    for (int i=0, n=source.length() ; i<n ; ++i) {
-        if (pb)
-            pb->update(i+1);
-        Vec currow = source(i);
-        if (! skip_missings || ! currow.hasMissing()) {
+    VMat source;
+    ostream& destination;
+    bool skip_missings;
+    int precision;
+    string delimiter;
+    bool convert_date;
+
+    CsvRowWriter(VMat the_source, ostream& the_destination,
+                 bool the_skip_missings, int the_precision,
+                 const string& the_delimiter, bool the_convert_date):
+        source(the_source), destination(the_destination),
+        skip_missings(the_skip_missings), precision(the_precision),
+        delimiter(the_delimiter), convert_date(the_convert_date)
+    {}
+
+    virtual void consumeBlock(int slot, int first_row, const Mat& block)
+    {
+        char buffer[1000];
+        for (int i=0, n=block.length() ; i<n ; ++i) {
+            Vec currow = block(i);
+            if (skip_missings && currow.hasMissing())
+                continue;
             for (int j=0, m=currow.size() ; j<m ; ++j) {
                 string strval="";
                 if (convert_date && j==0)
@@ -141,6 +130,42 @@ static void save_vmat_as_csv(VMat source, ostream& destination,
             destination << "\n";
         }
     }
+};
+
+/**
+ * This function converts a VMat to a CSV (comma-separated value) file with
+ * the given name.  One can also specify a list of column names or numbers
+ * to keep, as well as whether any missing values on a row cause that row
+ * to be skipped during export.  In addition, the number of significant
+ * digits after the decimal period can be specified.
+ *
+ * If the 'convert_date' option is true (whose purpose is to convert CYYMMDD
+ * dates into YYYYMMDD dates), then the integer 19000000 is added to the first
+ * element of each row (assumed to contain a date column).
+ */
+static void save_vmat_as_csv(VMat source, ostream& destination,
+                             bool skip_missings, int precision = 12,
+                             string delimiter = ",",
+                             bool verbose = true,
+                             bool convert_date = false)
+{
+    // First, output the fieldnames in quoted CSV format.  Don't forget
+    // to quote the quotes
+    TVec<string> fields = source->fieldNames();
+    for (int i=0, n=fields.size() ; i<n ; ++i) {
+        string curfield = fields[i];
+        search_replace(curfield, "\"", "\\\"");
+        destination << '"' << curfield << '"';
+        if (i < n-1)
+            destination << delimiter;
+    }
+    destination << "\n";
+
+    // Next, output each line, the following rows being read by worker
+    // threads meanwhile.  Perform missing-value checks if required.
+    CsvRowWriter writer(source, destination, skip_missings, precision,
+                        delimiter, convert_date);
+    VMatPipeline(verbose ? "Saving to CSV" : "").run(source, writer);
 }
 
   
@@ -611,6 +636,103 @@ VMat getVMat(const PPath& source, const PPath& indexf)
 }
 
 
+/**
+ * Parse the options of the VMatPipeline used by the 'convert', 'cat' and
+ * 'stats' commands:
+ *
+ *     --threads=N       :: number of threads reading rows ahead
+ *     --block_rows=N    :: number of rows read at once
+ *     --memory_cap=MB   :: maximum memory taken by the blocks of rows
+ *     --throughput      :: report the throughput at the end
+ *
+ * Returns false if 'opt' is not one of these.
+ */
+static bool parse_pipeline_option(const string& opt)
+{
+    if (opt.substr(0,10) == "--threads=")
+        VMatPipeline::default_n_workers = toint(opt.substr(10));
+    else if (opt.substr(0,13) == "--block_rows=")
+        VMatPipeline::default_block_length = toint(opt.substr(13));
+    else if (opt.substr(0,13) == "--memory_cap=")
+        VMatPipeline::default_memory_cap = toint(opt.substr(13));
+    else if (opt == "--throughput")
+        VMatPipeline::default_report_throughput = true;
+    else
+        return false;
+    return true;
+}
+
+/**
+ * Prints the rows streamed by a VMatPipeline (for 'vmat cat').  When a VPL
+ * filtering program is given, it is run on each block by the worker that
+ * read it, unless it uses the VPL memory, in which case it must see the
+ * rows in order and is run by the printing thread.
+ */
+struct CatRowPrinter: public VMatPipelineConsumer
+{
+    VMat vm;
+    string code;
+    vector<string> fieldnames;
+
+    //! Program run by the printing thread (programs using the memory).
+    VMatLanguage ordered_program;
+    bool ordered;
+
+    //! One program per worker, and the filter results of each slot.
+    TVec< PP<VMatLanguage> > programs;
+    TVec<Mat> answers;
+
+    CatRowPrinter(VMat the_vm, const string& the_code):
+        vm(the_vm), code(the_code), ordered_program(the_vm), ordered(false)
+    {
+        for(int i=0;i<vm->width();i++)
+            fieldnames.push_back(vm->fieldName(i));
+        if(code.length()>0){
+            ordered_program.compileString(code,fieldnames);
+            ordered = ordered_program.usesMemory();
+        }
+    }
+
+    virtual void start(int n_slots, int n_workers)
+    {
+        answers.resize(n_slots);
+        for(int s=0; s<n_slots; s++)
+            answers[s].resize(0, 1);
+        if(code.length()>0 && !ordered){
+            programs.resize(n_workers);
+            for(int t=0; t<n_workers; t++){
+                programs[t] = new VMatLanguage(vm);
+                programs[t]->compileString(code,fieldnames);
+            }
+        }
+    }
+
+    virtual void processBlock(int worker, int slot, int first_row, Mat& block)
+    {
+        if(programs.length()==0)
+            return;
+        answers[slot].resize(block.length(), 1);
+        programs[worker]->runBatch(block, answers[slot], first_row);
+    }
+
+    virtual void consumeBlock(int slot, int first_row, const Mat& block)
+    {
+        if(code.length()==0){
+            for(int i=0;i<block.length();i++)
+                pout<<block(i)<<endl;
+            return;
+        }
+        Mat& answer = answers[slot];
+        if(ordered){
+            answer.resize(block.length(), 1);
+            ordered_program.runBatch(block, answer, first_row);
+        }
+        for(int i=0;i<block.length();i++)
+            if(!fast_exact_is_equal(answer(i,0), 0))
+                pout<<block(i)<<endl;
+    }
+};
+
 int vmatmain(int argc, char** argv)
 {
   
@@ -657,7 +779,8 @@ int vmatmain(int argc, char** argv)
     {
         if(argc<4)
             PLERROR("Usage: vmat convert <source> <destination> "
-                    "[--mat_to_mem] [--cols=col1,col2,col3,...] [--save_vmat] [--skip-missings] [--precision=N] [--delimiter=CHAR] [--force_float] [--auto_float]");
+                    "[--mat_to_mem] [--cols=col1,col2,col3,...] [--save_vmat] [--skip-missings] [--precision=N] [--delimiter=CHAR] [--force_float] [--auto_float] [--block_length=N] "
+                    "[--threads=N] [--block_rows=N] [--memory_cap=MB] [--throughput]");
 
         PPath source = argv[2];
         PPath destination = argv[3];
@@ -694,6 +817,11 @@ int vmatmain(int argc, char** argv)
          *           :: if the destination is a pmat, we force the pmat file to be in float format
          *     --auto_float
          *           :: if the destination is a pmat, we will store the data in float format if this don't loose any precision compared to double format.
+         *     --block_length=N
+         *           :: if the destination is a colmat, number of rows encoded together in each column
+         *     --threads=N, --block_rows=N, --memory_cap=MB, --throughput
+         *           :: options of the pipeline reading the rows while they are
+         *           :: written (see parse_pipeline_option)
          */
         TVec<string> columns;
         TVec<string> date_columns;
@@ -705,6 +833,7 @@ int vmatmain(int argc, char** argv)
         bool update = false;
         bool force_float = false;
         bool auto_float = false;
+        int block_length = 1024;
 
         string ext = extract_extension(destination);
 
@@ -744,6 +873,10 @@ int vmatmain(int argc, char** argv)
             }else if (curopt == "--auto_float"){
                 PLCHECK(ext==".pmat");
                 auto_float = true;
+            }else if (curopt.substr(0,15) == "--block_length="){
+                PLCHECK(ext==".colmat");
+                block_length = toint(curopt.substr(15));
+            }else if (parse_pipeline_option(curopt)) {
             }else
                 PLWARNING("VMat convert: unrecognized option '%s'; ignoring it...",
                           curopt.c_str());
@@ -771,6 +904,8 @@ int vmatmain(int argc, char** argv)
             vm->savePMAT(destination, force_float, auto_float);
         else if(ext==".dmat")
             vm->saveDMAT(destination);
+        else if(ext==".colmat")
+            vm->saveCOLMAT(destination, block_length);
         else if(ext == ".csv")
         {
             if (destination == "-.csv")
@@ -790,7 +925,7 @@ int vmatmain(int argc, char** argv)
             PLearn::save(destination,vm);
         else
         {
-            cerr << "ERROR: can only convert to .amat .pmat .dmat, .vmat or .csv" << endl
+            cerr << "ERROR: can only convert to .amat .pmat .dmat, .colmat, .vmat or .csv" << endl
                  << "Please specify a destination name with a valid extension " << endl;
         }
         if(save_vmat && extract_extension(source)==".vmat")
@@ -884,6 +1019,10 @@ int vmatmain(int argc, char** argv)
     else if(command=="stats")
     {
         string dbname = argv[2];
+        for (int i=3 ; i < argc && argv[i] ; ++i)
+            if (!parse_pipeline_option(argv[i]))
+                PLWARNING("VMat stats: unrecognized option '%s'; ignoring it...",
+                          argv[i]);
         VMat vm = getVMat(dbname, indexf);
         displayBasicStats(vm);
     }
@@ -1053,6 +1192,8 @@ int vmatmain(int argc, char** argv)
             if(curopt.substr(0,12) == "--precision="){
                 precision = toint(curopt.substr(12));
                 nb_file--;
+            }else if(parse_pipeline_option(curopt)){
+                nb_file--;
             }else if(!isfile(argv[argc-1])){
                 code=argv[argc-1];
                 nb_file--;
@@ -1070,30 +1211,8 @@ int vmatmain(int argc, char** argv)
             if(nb_file>1)
                 pout<<dbname<<endl;
             VMat vm = getVMat(dbname, indexf);
-            Vec tmp(vm.width());
-            if(code.length()>0){
-                VMatLanguage vpl(vm);
-                vector<string> fn; 
-                for(int i=0;i<vm->width();i++)
-                    fn.push_back(vm->fieldName(i));
-                vpl.compileString(code,fn);
-                Vec answer(1);
-                for(int i=0;i<vm.length();i++)
-                {
-                    vpl.run(i,answer);
-                    if(!fast_exact_is_equal(answer[0], 0)) {
-                        vm->getRow(i, tmp);
-                        pout<<tmp<<endl;
-                    }
-                }
-
-            }
-            else
-                for(int i=0;i<vm.length();i++)
-                {
-                    vm->getRow(i,tmp);      
-                    pout<<tmp<<endl;
-                }
+            CatRowPrinter printer(vm, code);
+            VMatPipeline().run(vm, printer);
         }
     }
     else if(command=="catstr")
@@ -133,12 +133,18 @@ void * MemoryMap(const char *filename,tFileHandle & handle, bool read_only,  off
 
         addr = mmap(0, filesize, PROT_READ|PROT_WRITE, MAP_SHARED, handle, 0);
     }
+    if (addr == MAP_FAILED)
+    {
+        close(handle);
+        handle = STORAGE_UNUSED_HANDLE;
+        return 0;
+    }
     return addr;
 }
 
 //////////////////////////////////////////////////
 //void FreeMemoryMap(void * data, tFileHandle handle, int length)
-void memoryUnmap(void * data, tFileHandle handle, int length)
+void memoryUnmap(void * data, tFileHandle handle, off_t length)
 {
     msync((char*)data, length, MS_SYNC);
     munmap((char *)data, length);
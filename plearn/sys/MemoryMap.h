@@ -52,7 +52,7 @@ const int STORAGE_UNUSED_HANDLE = -1;
 //!  or 0 if it fails for some reason.
 void * MemoryMap(const char *filename,tFileHandle & handle, bool read_only, off_t & filesize);
 
-void memoryUnmap(void * mapped_pointer, tFileHandle handle, int length);
+void memoryUnmap(void * mapped_pointer, tFileHandle handle, off_t length);
 
 #endif
 
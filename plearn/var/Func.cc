@@ -93,7 +93,9 @@ Func operator/(Func f, real value)
         VarArray outs(nouts);
         for(int i=0; i<nouts; i++)
             outs[i] = f->outputs[i]/value;
-        return Func(f->inputs, outs);
+        Func res(f->inputs, outs);
+        res->batch_size = f->batch_size;
+        return res;
     }
 }
 
@@ -101,18 +103,19 @@ Func operator/(Func f, real value)
 /** Function **/
 
 Function::Function()
-    :inputsize(-1), outputsize(-1)
+    :batch_size(1), inputsize(-1), outputsize(-1)
 {}
 
 
 Function::Function(const VarArray& the_inputs, const VarArray& the_outputs)
-    :inputs(the_inputs), outputs(the_outputs)
+    :inputs(the_inputs), outputs(the_outputs), batch_size(1)
 {  
     build_();
 }
 
 Function::Function(const VarArray& the_inputs, const VarArray& parameters_to_optimize,const VarArray& the_outputs)
-    : inputs(the_inputs), parameters(parameters_to_optimize), outputs(the_outputs)
+    : inputs(the_inputs), parameters(parameters_to_optimize), outputs(the_outputs),
+      batch_size(1)
 {
     build_();
 }
@@ -140,6 +143,11 @@ void Function::declareOptions(OptionList& ol)
                   "The list of parameters to optimize");
     declareOption(ol, "outputs", &Function::outputs, OptionBase::buildoption,
                   "The list of output variables of this function");
+    declareOption(ol, "batch_size", &Function::batch_size,
+                  OptionBase::buildoption | OptionBase::nosave,
+                  "If > 1, each input and output variable holds a minibatch\n"
+                  "of batch_size samples, one per row, and fprop/fbprop on\n"
+                  "matrices propagate batch_size rows at once.");
   
     // Now call the parent class' declareOptions
     inherited::declareOptions(ol);
@@ -221,6 +229,119 @@ void Function::fprop(const Array<Vec>& in, const Array<Vec>& out) const
     outputs >> out;
 }
 
+//! Copy the rows [start, start+n) of m in the rows of the values (or the
+//! gradients) of vars, the columns of m being split among the variables in
+//! order. The rows after n are filled with the last row (or 0 for
+//! gradients).
+static void rowsToVars(const Mat& m, int start, int n,
+                       const VarArray& vars, bool gradient)
+{
+    int col = 0;
+    for (int k = 0; k < vars.size(); k++)
+    {
+        Mat v = gradient ? vars[k]->matGradient : vars[k]->matValue;
+        int w = v.width();
+        for (int i = 0; i < v.length(); i++)
+        {
+            if (i < n)
+                v(i) << m(start + i).subVec(col, w);
+            else if (gradient)
+                v(i).clear();
+            else
+                v(i) << v(n - 1);
+        }
+        col += w;
+    }
+}
+
+//! Copy the first n rows of the values (or the gradients) of vars in the
+//! rows [start, start+n) of m.
+static void varsToRows(const VarArray& vars, bool gradient,
+                       const Mat& m, int start, int n)
+{
+    int col = 0;
+    for (int k = 0; k < vars.size(); k++)
+    {
+        Mat v = gradient ? vars[k]->matGradient : vars[k]->matValue;
+        int w = v.width();
+        for (int i = 0; i < n; i++)
+            m(start + i).subVec(col, w) << v(i);
+        col += w;
+    }
+}
+
+//! Check that vars hold batch_size rows of m.width() values in total.
+static void checkBatchVars(const VarArray& vars, int batch_size,
+                           const Mat& m, const char* what)
+{
+    int width = 0;
+    for (int k = 0; k < vars.size(); k++)
+    {
+        if (vars[k]->length() != batch_size)
+            PLERROR("In Function - batch_size is %d but %s variable %d has "
+                    "%d rows", batch_size, what, k, vars[k]->length());
+        width += vars[k]->width();
+    }
+    if (width != m.width())
+        PLERROR("In Function - the %s matrix has %d columns, expected %d",
+                what, m.width(), width);
+}
+
+void Function::fprop(const Mat& in, const Mat& out) const
+{
+    PLASSERT( in.length() == out.length() );
+    int n = in.length();
+    if (batch_size <= 1)
+    {
+        for (int i = 0; i < n; i++)
+            fprop(in(i), out(i));
+        return;
+    }
+    checkBatchVars(inputs, batch_size, in, "input");
+    checkBatchVars(outputs, batch_size, out, "output");
+    for (int start = 0; start < n; start += batch_size)
+    {
+        int size = min(batch_size, n - start);
+        rowsToVars(in, start, size, inputs, false);
+        fproppath.fprop();
+        varsToRows(outputs, false, out, start, size);
+    }
+}
+
+void Function::fbprop(const Mat& in, const Mat& out,
+                      const Mat& input_gradient, const Mat& output_gradient)
+{
+    PLASSERT( in.length() == out.length() );
+    PLASSERT( output_gradient.length() == out.length() );
+    int n = in.length();
+    bool with_input_gradient = input_gradient.length() > 0;
+    if (batch_size <= 1)
+    {
+        Vec no_gradient(inputsize);
+        for (int i = 0; i < n; i++)
+            fbprop(in(i), out(i),
+                   with_input_gradient ? input_gradient(i) : no_gradient,
+                   output_gradient(i));
+        return;
+    }
+    checkBatchVars(inputs, batch_size, in, "input");
+    checkBatchVars(outputs, batch_size, out, "output");
+    for (int start = 0; start < n; start += batch_size)
+    {
+        // the padding rows have a null output gradient, so they don't
+        // change the gradient of the parameters
+        int size = min(batch_size, n - start);
+        rowsToVars(in, start, size, inputs, false);
+        inputs.clearGradient();
+        fproppath.clearGradient();
+        rowsToVars(output_gradient, start, size, outputs, true);
+        fproppath.fbprop();
+        varsToRows(outputs, false, out, start, size);
+        if (with_input_gradient)
+            varsToRows(inputs, true, input_gradient, start, size);
+    }
+}
+
 void Function::sizefprop(const Vec& in, const Vec& out) const
 {
     inputs << in;
@@ -86,6 +86,10 @@ public:
     mutable VarArray parameters;  //!< nonInputSources
     mutable VarArray outputs;
 
+    //! If > 1, each input and output variable holds a minibatch of
+    //! batch_size samples, one per row (see fprop(const Mat&, const Mat&)).
+    int batch_size;
+
     // Other variables
     int inputsize;
     int outputsize;
@@ -141,6 +145,15 @@ public:
     void sizefprop(const Vec& in, const Vec& out) const;
     void sizefprop(const Array<Vec>& in, const Array<Vec>& out) const;
 
+/*!   Batched fprop: row i of out is the output for row i of in.  If
+  batch_size > 1, the rows are propagated batch_size at a time, each
+  input (output) variable holding the corresponding columns of batch_size
+  consecutive rows of in (out), so that the matrix variables of the graph
+  work on whole minibatches.  The last minibatch is padded by repeating
+  its last row.  Otherwise the rows are propagated one at a time.
+*/
+    void fprop(const Mat& in, const Mat& out) const;
+
 /*!   when put_gradient_on_first_element_only, a gradient of 1 is put
   in only the first element of the output gradient this is a hack
   that is useful for having a SumOfVariable computing several
@@ -150,6 +163,11 @@ public:
     void fbprop(const Array<Vec>& in, const Array<Vec>& out, 
                 const Array<Vec>& input_gradient, const Array<Vec>& output_gradient);
     
+    //! Batched fbprop, see fprop(const Mat&, const Mat&). The gradients of
+    //! the parameters are accumulated over all the rows.
+    void fbprop(const Mat& in, const Mat& out,
+                const Mat& input_gradient, const Mat& output_gradient);
+
     void sizefbprop(const Vec& in, const Vec& out, const Vec& input_gradient, const Vec& output_gradient);
     void sizefbprop(const Array<Vec>& in, const Array<Vec>& out, 
                 const Array<Vec>& input_gradient, const Array<Vec>& output_gradient);
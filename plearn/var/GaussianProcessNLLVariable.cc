@@ -43,6 +43,11 @@
 #include <plearn/io/pl_log.h>
 #include <plearn/math/TMat_maths.h>
 #include <plearn/io/MatIO.h>
+#include <plearn/base/lexical_cast.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #ifdef USE_BLAS_SPECIALISATIONS
 #include <plearn/math/plapack.h>
@@ -69,13 +74,21 @@ PLEARN_IMPLEMENT_OBJECT(
     "variables.  To get something like Automatic Relevance Determination, you\n"
     "should specify separately each Variable (in the PLearn sense) that\n"
     "corresponds to a given input hyperparameter.\n"
+    "\n"
+    "When constructed with a set of inducing points, the NLL is that of a\n"
+    "sparse approximation (subset-of-regressors or FITC), computed with its\n"
+    "gradient in O(NM^2) time for N inputs and M inducing points.\n"
     );
 
 GaussianProcessNLLVariable::GaussianProcessNLLVariable()
     : m_save_gram_matrix(0),
       m_kernel(0),
       m_noise(0),
-      m_allow_bprop(true)
+      m_allow_bprop(true),
+      m_fitc(false),
+      m_sparse_excess_noise(0),
+      m_sparse_excess_clamped(false),
+      m_sparse_jitter(0)
 { }
 
 
@@ -92,7 +105,35 @@ GaussianProcessNLLVariable::GaussianProcessNLLVariable(
       m_targets(targets),
       m_hyperparam_names(hyperparam_names),
       m_hyperparam_vars(hyperparam_vars),
-      m_allow_bprop(allow_bprop)
+      m_allow_bprop(allow_bprop),
+      m_fitc(false),
+      m_sparse_excess_noise(0),
+      m_sparse_excess_clamped(false),
+      m_sparse_jitter(0)
+{
+    build();
+}
+
+
+GaussianProcessNLLVariable::GaussianProcessNLLVariable(
+    Kernel* kernel, real noise, Mat inputs, Mat targets,
+    const TVec<int>& inducing_indices, bool fitc,
+    const TVec<string>& hyperparam_names, const VarArray& hyperparam_vars,
+    bool allow_bprop)
+    : inherited(hyperparam_vars, 1, 1),
+      m_save_gram_matrix(false),
+      m_kernel(kernel),
+      m_noise(noise),
+      m_inputs(inputs),
+      m_targets(targets),
+      m_hyperparam_names(hyperparam_names),
+      m_hyperparam_vars(hyperparam_vars),
+      m_allow_bprop(allow_bprop),
+      m_inducing_indices(inducing_indices),
+      m_fitc(fitc),
+      m_sparse_excess_noise(0),
+      m_sparse_excess_clamped(false),
+      m_sparse_jitter(0)
 {
     build();
 }
@@ -130,6 +171,21 @@ void GaussianProcessNLLVariable::makeDeepCopyFromShallowCopy(CopiesMap& copies)
     deepCopyField(m_inverse_gram,    copies);
     deepCopyField(m_cholesky_tmp,    copies);
     deepCopyField(m_rhs_tmp,         copies);
+    deepCopyField(m_inducing_indices,     copies);
+    deepCopyField(m_inducing_inputs,      copies);
+    deepCopyField(m_inverse_subgram,      copies);
+    deepCopyField(m_sparse_chol_A,        copies);
+    deepCopyField(m_sparse_U,             copies);
+    deepCopyField(m_sparse_W,             copies);
+    deepCopyField(m_sparse_alpha,         copies);
+    deepCopyField(m_sparse_lambda,        copies);
+    deepCopyField(m_sparse_self,          copies);
+    deepCopyField(m_sparse_P,             copies);
+    deepCopyField(m_sparse_Q,             copies);
+    deepCopyField(m_sparse_self_weights,  copies);
+    deepCopyField(m_sparse_Kmn_plus,      copies);
+    deepCopyField(m_sparse_self_plus,     copies);
+    deepCopyField(m_sparse_row,           copies);
 }
 
 void GaussianProcessNLLVariable::declareOptions(OptionList& ol)
@@ -147,6 +203,13 @@ void GaussianProcessNLLVariable::declareOptions(OptionList& ol)
 void GaussianProcessNLLVariable::build_()
 {
     PLASSERT( m_kernel && m_inputs.isNotNull() && m_targets.isNotNull() );
+
+    const int n = m_inputs.length();
+    for (int a=0, m=m_inducing_indices.size() ; a<m ; ++a)
+        if (m_inducing_indices[a] < 0 || m_inducing_indices[a] >= n)
+            PLERROR("GaussianProcessNLLVariable::build_: inducing point index %d "
+                    "is out of range (there are %d inputs)",
+                    m_inducing_indices[a], n);
 }
 
 
@@ -170,6 +233,11 @@ void GaussianProcessNLLVariable::fprop()
     // Ensure that the current hyperparameter variable values are propagated
     // into kernel options
     m_hyperparam_vars.fprop();
+
+    if (m_inducing_indices.size() > 0) {
+        fpropSparse();
+        return;
+    }
     
     fbpropFragments(m_kernel, m_noise, m_inputs, m_targets, m_allow_bprop,
                     m_save_gram_matrix, m_expdir,
@@ -207,6 +275,10 @@ void GaussianProcessNLLVariable::bprop()
                   "GaussianProcessNLLVariable must be constructed with the option "
                   "'will_bprop'=True in order to call bprop" );
     PLASSERT( m_hyperparam_names.size() == m_hyperparam_vars.size() );
+    if (m_inducing_indices.size() > 0) {
+        bpropSparse();
+        return;
+    }
     PLASSERT( m_alpha_t.width() == m_inverse_gram.width() );
     PLASSERT( m_inverse_gram.width() == m_inverse_gram.length() );
     PLASSERT( m_kernel );
@@ -400,6 +472,375 @@ void GaussianProcessNLLVariable::fbpropFragments(
 #endif
 // #endif
 
+//#####  Sparse Approximations  ##############################################
+
+namespace {
+
+//! Number of columns of the right-hand sides solved at once by a thread
+const int SOLVE_COLUMN_BLOCK = 256;
+
+//! Solve L X = B in place for a lower-triangular L; the columns of B are
+//! split across threads.
+void lowerSolveInPlace(const Mat& L, Mat& B)
+{
+    const int m = L.length();
+    const int n = B.width();
+    const int n_blocks = (n + SOLVE_COLUMN_BLOCK - 1) / SOLVE_COLUMN_BLOCK;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,1) if(n_blocks > 1 && !omp_in_parallel())
+#endif
+    for (int blk = 0 ; blk < n_blocks ; ++blk) {
+        const int c0 = blk * SOLVE_COLUMN_BLOCK;
+        const int nc = min(SOLVE_COLUMN_BLOCK, n - c0);
+        for (int i=0 ; i<m ; ++i) {
+            const real* Li = L[i];
+            real* Bi = B[i] + c0;
+            for (int k=0 ; k<i ; ++k) {
+                const real Lik = Li[k];
+                const real* Bk = B[k] + c0;
+                for (int c=0 ; c<nc ; ++c)
+                    Bi[c] -= Lik * Bk[c];
+            }
+            const real inv_Lii = 1.0 / Li[i];
+            for (int c=0 ; c<nc ; ++c)
+                Bi[c] *= inv_Lii;
+        }
+    }
+}
+
+//! Solve L' X = B in place for a lower-triangular L
+void lowerTransposeSolveInPlace(const Mat& L, Mat& B)
+{
+    const int m = L.length();
+    const int n = B.width();
+    const int n_blocks = (n + SOLVE_COLUMN_BLOCK - 1) / SOLVE_COLUMN_BLOCK;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,1) if(n_blocks > 1 && !omp_in_parallel())
+#endif
+    for (int blk = 0 ; blk < n_blocks ; ++blk) {
+        const int c0 = blk * SOLVE_COLUMN_BLOCK;
+        const int nc = min(SOLVE_COLUMN_BLOCK, n - c0);
+        for (int i=m-1 ; i>=0 ; --i) {
+            real* Bi = B[i] + c0;
+            for (int k=i+1 ; k<m ; ++k) {
+                const real Lki = L[k][i];
+                const real* Bk = B[k] + c0;
+                for (int c=0 ; c<nc ; ++c)
+                    Bi[c] -= Lki * Bk[c];
+            }
+            const real inv_Lii = 1.0 / L[i][i];
+            for (int c=0 ; c<nc ; ++c)
+                Bi[c] *= inv_Lii;
+        }
+    }
+}
+
+//! Multiply column i of B by scale[i]
+void scaleColumns(Mat& B, const Vec& scale)
+{
+    const int n = B.width();
+    const real* s = scale.data();
+    for (int a=0, m=B.length() ; a<m ; ++a) {
+        real* Ba = B[a];
+        for (int i=0 ; i<n ; ++i)
+            Ba[i] *= s[i];
+    }
+}
+
+} // end of anonymous namespace
+
+
+//#####  computeSparseKernelBlocks  ##########################################
+
+void GaussianProcessNLLVariable::computeSparseKernelBlocks(Mat& Kmn,
+                                                           Vec& self_cov) const
+{
+    const int n = m_inputs.length();
+    const int m = m_inducing_indices.size();
+    Kmn.resize(m, n);
+    if (m_fitc) {
+        Vec inducing_self_cov(m);
+        m_kernel->computeTestGramMatrix(m_inducing_inputs, Kmn, inducing_self_cov);
+        self_cov.resize(n);
+        for (int i=0 ; i<n ; ++i) {
+            Vec x = m_inputs(i);
+            self_cov[i] = m_kernel->evaluate(x, x);
+        }
+    }
+    else {
+        self_cov.resize(m);
+        m_kernel->computeTestGramMatrix(m_inducing_inputs, Kmn, self_cov);
+    }
+}
+
+
+//#####  fpropSparse  ########################################################
+
+void GaussianProcessNLLVariable::fpropSparse()
+{
+    PLASSERT( m_kernel );
+    PLASSERT( m_inputs.length() == m_targets.length() );
+    const int n = m_inputs.length();
+    const int m = m_inducing_indices.size();
+    const int targetsize = m_targets.width();
+
+    // Kernel evaluations between the inducing points and all inputs.  Note
+    // that, as for the projected process, K_mn does not contain the
+    // kernel's own noise, which only shows up in the prior variances.
+    m_kernel->setDataForKernelMatrix(m_inputs);
+    m_inducing_inputs.resize(m, m_inputs.width());
+    selectRows(m_inputs, m_inducing_indices, m_inducing_inputs);
+    Mat& V = m_sparse_U;                     // K_mn, then V, then U
+    computeSparseKernelBlocks(V, m_sparse_self);
+
+    // K_mm with a small jitter, and its Cholesky decomposition L_mm
+    m_gram.resize(m, m);
+    selectColumns(V, m_inducing_indices, m_gram);
+    m_sparse_jitter = 1e-6 * trace(m_gram) / m;
+    if (m_sparse_jitter <= 0)
+        m_sparse_jitter = 1e-10;
+    addToDiagonal(m_gram, m_sparse_jitter);
+    choleskyDecomposition(m_gram, m_cholesky_gram);
+
+    // Subset-of-regressors: the noise is 'noise' plus whatever the kernel
+    // puts on its diagonal that K_mm does not have (e.g. its own noise term)
+    if (! m_fitc) {
+        real excess = 0;
+        for (int a=0 ; a<m ; ++a)
+            excess += m_sparse_self[a] - (m_gram(a,a) - m_sparse_jitter);
+        excess /= m;
+        m_sparse_excess_clamped = excess < 0;
+        m_sparse_excess_noise = m_sparse_excess_clamped ? 0 : excess;
+    }
+
+    // V = L_mm^-1 K_mn, and W = K_mm^-1 K_mn = L_mm'^-1 V
+    lowerSolveInPlace(m_cholesky_gram, V);
+    m_sparse_W.resize(m, n);
+    m_sparse_W << V;
+    lowerTransposeSolveInPlace(m_cholesky_gram, m_sparse_W);
+
+    // Diagonal noise Lambda.  For FITC, Lambda_ii = noise + k(x_i,x_i) - Q_ii
+    // with Q_ii = |V_i|^2, which is never below 'noise' but for rounding.
+    const real lambda_floor = max(m_noise, m_sparse_jitter);
+    m_sparse_lambda.resize(n);
+    if (m_fitc) {
+        m_sparse_lambda.clear();
+        real* q = m_sparse_lambda.data();
+        for (int a=0 ; a<m ; ++a) {
+            const real* Va = V[a];
+            for (int i=0 ; i<n ; ++i)
+                q[i] += Va[i] * Va[i];
+        }
+        for (int i=0 ; i<n ; ++i)
+            q[i] = max(lambda_floor, m_noise + m_sparse_self[i] - q[i]);
+    }
+    else
+        m_sparse_lambda.fill(max(lambda_floor, m_noise + m_sparse_excess_noise));
+
+    // A = I + V Lambda^-1 V', and U = chol(A)^-1 V Lambda^-1, such that
+    // Sigma^-1 = (Q_nn + Lambda)^-1 = Lambda^-1 - U'U
+    m_sparse_row.resize(n);
+    for (int i=0 ; i<n ; ++i)
+        m_sparse_row[i] = 1.0 / sqrt(m_sparse_lambda[i]);
+    scaleColumns(V, m_sparse_row);
+    Mat A(m, m);
+    productTranspose(A, V, V);
+    addToDiagonal(A, 1.0);
+    choleskyDecomposition(A, m_sparse_chol_A);
+    lowerSolveInPlace(m_sparse_chol_A, V);
+    scaleColumns(V, m_sparse_row);
+    const Mat& U = V;
+
+    // alpha = Sigma^-1 y = Lambda^-1 y - U'(U y)
+    Mat Uy(m, targetsize);
+    product(Uy, U, m_targets);
+    m_sparse_alpha.resize(n, targetsize);
+    for (int i=0 ; i<n ; ++i) {
+        const real* yi = m_targets[i];
+        real* alpha_i = m_sparse_alpha[i];
+        for (int t=0 ; t<targetsize ; ++t)
+            alpha_i[t] = yi[t] / m_sparse_lambda[i];
+    }
+    transposeProductScaleAcc(m_sparse_alpha, U, Uy, real(-1.), real(1.));
+
+    // The predictive weights are W alpha (equal to the usual
+    // (K_mm + K_mn Lambda^-1 K_nm)^-1 K_mn Lambda^-1 y); they are stored
+    // transposed as in the exact case.
+    m_alpha_t.resize(targetsize, m);
+    transposeTransposeProduct(m_alpha_t, m_sparse_alpha, m_sparse_W);
+
+    // By the matrix determinant lemma, log|Sigma| = log|Lambda| + log|A|, so
+    // that for each target
+    //
+    //     nll = 0.5 * y'*alpha + 0.5 * log|Sigma| + 0.5*n*log(2*pi)
+    real logdet_log2pi = 0;
+    for (int a=0 ; a<m ; ++a)
+        logdet_log2pi += pl_log(m_sparse_chol_A(a,a));
+    for (int i=0 ; i<n ; ++i)
+        logdet_log2pi += 0.5 * pl_log(m_sparse_lambda[i]);
+    logdet_log2pi += 0.5 * n * pl_log(2*M_PI);
+
+    real y_alpha = 0;
+    for (int i=0 ; i<n ; ++i) {
+        const real* yi = m_targets[i];
+        const real* alpha_i = m_sparse_alpha[i];
+        for (int t=0 ; t<targetsize ; ++t)
+            y_alpha += yi[t] * alpha_i[t];
+    }
+    value[0] = 0.5 * y_alpha + targetsize * logdet_log2pi;
+
+    // Inverses required for predictive variances: K_mm^-1, and
+    // (K_mm + K_mn Lambda^-1 K_nm)^-1 = (L_mm A L_mm')^-1
+    if (m_allow_bprop) {
+        Mat inv_chol(m, m);
+        identityMatrix(inv_chol);
+        lowerSolveInPlace(m_cholesky_gram, inv_chol);
+        m_inverse_subgram.resize(m, m);
+        transposeProduct(m_inverse_subgram, inv_chol, inv_chol);
+        lowerSolveInPlace(m_sparse_chol_A, inv_chol);
+        m_inverse_gram.resize(m, m);
+        transposeProduct(m_inverse_gram, inv_chol, inv_chol);
+    }
+}
+
+
+//#####  bpropSparse  ########################################################
+
+void GaussianProcessNLLVariable::bpropSparse()
+{
+    PLASSERT( m_kernel );
+    const int n = m_inputs.length();
+    const int m = m_inducing_indices.size();
+    const int targetsize = m_targets.width();
+    const Mat& U = m_sparse_U;
+    const Mat& W = m_sparse_W;
+    const Mat& alpha = m_sparse_alpha;
+    const real* lambda = m_sparse_lambda.data();
+    Mat G(m, targetsize);
+    transpose(m_alpha_t, G);
+
+    // With Sigma = Q_nn + Lambda and M = (T Sigma^-1 - alpha alpha') / 2
+    // (T being the number of targets), the derivative of the NLL is
+    // trace(M dSigma), where
+    //
+    //     dQ_nn = dK_nm W + W' dK_mn - W' dK_mm W.
+    //
+    // This is linear in dK_mn, dK_mm and in the prior variances; its
+    // coefficients P (m x n), Q (m x m) and self_weights are computed once
+    // here, so that each hyperparameter only costs kernel evaluations.
+    //
+    // First rho_i = M_ii, with diag(Sigma^-1)_i = 1/Lambda_i - |U_i|^2.
+    Vec rho(n);
+    real* prho = rho.data();
+    for (int i=0 ; i<n ; ++i)
+        prho[i] = 1.0 / lambda[i];
+    for (int a=0 ; a<m ; ++a) {
+        const real* Ua = U[a];
+        for (int i=0 ; i<n ; ++i)
+            prho[i] -= Ua[i] * Ua[i];
+    }
+    for (int i=0 ; i<n ; ++i) {
+        const real* alpha_i = alpha[i];
+        real alpha_sq = 0;
+        for (int t=0 ; t<targetsize ; ++t)
+            alpha_sq += alpha_i[t] * alpha_i[t];
+        prho[i] = 0.5 * (targetsize * prho[i] - alpha_sq);
+    }
+
+    // P = 2 W M = T W Sigma^-1 - G alpha', with
+    // W Sigma^-1 = W Lambda^-1 - (W U') U
+    Mat WU(m, m);
+    productTranspose(WU, W, U);
+    Mat& P = m_sparse_P;
+    P.resize(m, n);
+    product(P, WU, U);
+    for (int a=0 ; a<m ; ++a) {
+        const real* Wa = W[a];
+        real* Pa = P[a];
+        for (int i=0 ; i<n ; ++i)
+            Pa[i] = targetsize * (Wa[i] / lambda[i] - Pa[i]);
+    }
+
+    // Q = -W M W' = (G G' - T W Sigma^-1 W') / 2
+    Mat& Q = m_sparse_Q;
+    Q.resize(m, m);
+    productTranspose(Q, P, W);
+    productTransposeScaleAcc(Q, G, G, real(0.5), real(-0.5));
+    productTransposeScaleAcc(P, G, alpha, real(-1.), real(1.));
+
+    // Derivative of the diagonal noise
+    Vec& self_weights = m_sparse_self_weights;
+    if (m_fitc) {
+        // dLambda_ii = dk(x_i,x_i) - dQ_ii, hence P -= 2 W diag(rho) and
+        // Q += W diag(rho) W'
+        Mat& W_rho = m_sparse_Kmn_plus;      // Used as a buffer here
+        W_rho.resize(m, n);
+        W_rho << W;
+        scaleColumns(W_rho, rho);
+        productTransposeScaleAcc(Q, W_rho, W, real(1.), real(1.));
+        P -= W_rho;
+        P -= W_rho;
+        self_weights.resize(n);
+        self_weights << rho;
+    }
+    else {
+        // Lambda = (noise + mean over inducing points of k(x,x) - K_mm) I
+        self_weights.resize(m);
+        self_weights.clear();
+        if (! m_sparse_excess_clamped) {
+            const real c = sum(rho) / m;
+            self_weights.fill(c);
+            for (int a=0 ; a<m ; ++a)
+                Q(a,a) -= c;
+        }
+    }
+
+    // Finite differences for each hyperparameter.  Like
+    // Kernel::computeGramMatrixDerivative, this changes the kernel options
+    // temporarily.
+    const real epsilon = 1e-6;
+    Mat& Kmn_plus = m_sparse_Kmn_plus;
+    m_sparse_row.resize(n);
+    for (int j=0, nhyper=m_hyperparam_names.size() ; j<nhyper ; ++j) {
+        const string& param = m_hyperparam_names[j];
+        string cur_param_str = m_kernel->getOption(param);
+        real cur_param = lexical_cast<real>(cur_param_str);
+
+        m_kernel->changeOption(param, tostring(cur_param + epsilon));
+        m_kernel->build();
+        computeSparseKernelBlocks(Kmn_plus, m_sparse_self_plus);
+
+        m_kernel->changeOption(param, tostring(cur_param - epsilon));
+        m_kernel->build();
+        real diff = 0;
+        for (int a=0 ; a<m ; ++a) {
+            m_kernel->evaluate_all_i_x(m_inducing_inputs(a), m_sparse_row);
+            const real* Kp = Kmn_plus[a];
+            const real* Km = m_sparse_row.data();
+            const real* Pa = P[a];
+            const real* Qa = Q[a];
+            for (int i=0 ; i<n ; ++i)
+                diff += Pa[i] * (Kp[i] - Km[i]);
+            for (int b=0 ; b<m ; ++b) {
+                const int ib = m_inducing_indices[b];
+                diff += Qa[b] * (Kp[ib] - Km[ib]);
+            }
+        }
+        for (int i=0, ns=self_weights.size() ; i<ns ; ++i) {
+            if (self_weights[i] == 0)
+                continue;
+            Vec x = m_fitc ? m_inputs(i) : m_inducing_inputs(i);
+            diff += self_weights[i] * (m_sparse_self_plus[i] - m_kernel->evaluate(x, x));
+        }
+
+        m_kernel->changeOption(param, cur_param_str);
+        m_kernel->build();
+
+        real dnll_dj = diff / (2. * epsilon);
+        m_hyperparam_vars[j]->gradient[0] += dnll_dj * gradient[0];
+    }
+}
+
 //#####  logVarray  ###########################################################
 
 void GaussianProcessNLLVariable::logVarray(const VarArray& varr,
@@ -64,6 +64,16 @@ using namespace std;
  *  variables.  To get something like Automatic Relevance Determination, you
  *  should specify separately each Variable (in the PLearn sense) that
  *  corresponds to a given input hyperparameter.
+ *
+ *  With the second constructor, the NLL is instead that of a sparse
+ *  approximation based on a set of M inducing points taken among the inputs:
+ *  subset-of-regressors (the noise being the kernel's own diagonal excess
+ *  over the inducing points, plus 'noise'), or FITC (fully independent
+ *  training conditional, where each input gets its own noise variance
+ *  k(x,x) - Q(x,x) + 'noise').  Both fprop and bprop then take O(NM^2) time
+ *  and O(NM) memory instead of O(N^3) and O(N^2).  Since Kernel only
+ *  provides the derivative of a symmetric Gram matrix, the derivatives of
+ *  the N x M kernel evaluations are obtained by finite differences.
  */
 class GaussianProcessNLLVariable : public NaryVariable
 {
@@ -110,6 +120,26 @@ public:
                                bool save_gram_matrix = false,
                                PPath expdir = "");
 
+    /**
+     *  Constructor for the sparse approximations of the NLL.
+     *
+     *  @param inducing_indices: indices of the rows of 'inputs' used as
+     *                  inducing points; must not contain duplicates
+     *  @param fitc:    if true, use the FITC approximation; otherwise use
+     *                  subset-of-regressors
+     *  @param allow_bprop: if true, bprops are allowed, and the inverses
+     *                  returned by gramInverse() and subgramInverse() are
+     *                  computed at each fprop
+     *
+     *  Other parameters are as above.
+     */
+    GaussianProcessNLLVariable(Kernel* kernel, real noise,
+                               Mat inputs, Mat targets,
+                               const TVec<int>& inducing_indices, bool fitc,
+                               const TVec<string>& hyperparam_names,
+                               const VarArray& hyperparam_vars,
+                               bool allow_bprop = true);
+
     
     //#####  PLearn::Variable methods #########################################
 
@@ -141,15 +171,22 @@ public:
                                 Mat& gram, Mat& L, Mat& alpha, Mat& inv,
                                 Vec& tmpch, Mat& tmprhs);
 
-    //! Accessor to the last computed 'alpha' matrix in an fprop
+    //! Accessor to the last computed 'alpha' matrix in an fprop.  With a
+    //! sparse approximation, it has one row per inducing point, such that
+    //! predictions are given by k_m(x)' alpha.
     const Mat& alpha() const;
 
     //! Accessor to the last computed gram matrix in an fprop
     const Mat& gram() const { return m_gram; }
     
     //! Accessor to the last computed gram matrix inverse in an fprop
+    //! (with a sparse approximation, this is (K_mm + K_mn Lambda^-1 K_nm)^-1)
     const Mat& gramInverse() const { return m_inverse_gram; }
 
+    //! Accessor to the inverse of the Gram matrix of the inducing points,
+    //! K_mm^-1, last computed in an fprop (sparse approximations only)
+    const Mat& subgramInverse() const { return m_inverse_subgram; }
+
     /// Minor utility function to dump the contents of a varray to a log
     static void logVarray(const VarArray& varr, const string& title="",
                           bool debug=false);
@@ -217,10 +254,70 @@ protected:
     //! Temporary storage for holding the right-hand-side to be solved by Cholesky
     Mat m_rhs_tmp;
 
+    //#####  Sparse Approximations  ###########################################
+
+    //! Indices of the inducing points within m_inputs; empty for the exact NLL
+    TVec<int> m_inducing_indices;
+
+    //! Whether the FITC approximation is used (else subset-of-regressors)
+    bool m_fitc;
+
+    //! Inputs of the inducing points
+    Mat m_inducing_inputs;
+
+    //! Inverse of the Gram matrix of the inducing points
+    Mat m_inverse_subgram;
+
+    //! Cholesky decomposition of I + V Lambda^-1 V', with V = L_mm^-1 K_mn
+    Mat m_sparse_chol_A;
+
+    //! U = chol(A)^-1 V Lambda^-1, such that Sigma^-1 = Lambda^-1 - U'U
+    Mat m_sparse_U;
+
+    //! W = K_mm^-1 K_mn
+    Mat m_sparse_W;
+
+    //! Solution Sigma^-1 y of the full (N x N) approximate system
+    Mat m_sparse_alpha;
+
+    //! Diagonal noise Lambda of the approximation
+    Vec m_sparse_lambda;
+
+    //! Prior variances k(x,x): of all inputs for FITC, of the inducing points
+    //! for subset-of-regressors
+    Vec m_sparse_self;
+
+    //! Noise of subset-of-regressors in excess of 'noise', and whether it had
+    //! to be clamped to zero (in which case it has no derivative)
+    real m_sparse_excess_noise;
+    bool m_sparse_excess_clamped;
+
+    //! Jitter added to the diagonal of K_mm
+    real m_sparse_jitter;
+
+    //! Coefficients of the NLL derivative with respect to K_mn, K_mm and the
+    //! prior variances, respectively
+    Mat m_sparse_P;
+    Mat m_sparse_Q;
+    Vec m_sparse_self_weights;
+
+    //! Buffers for the finite-difference derivatives
+    Mat m_sparse_Kmn_plus;
+    Vec m_sparse_self_plus;
+    Vec m_sparse_row;
+
 protected:
     //! Declares the class options.
     static void declareOptions(OptionList& ol);
 
+    //! Sparse versions of fprop and bprop
+    void fpropSparse();
+    void bpropSparse();
+
+    //! Compute K_mn and the prior variances needed by the sparse
+    //! approximation (see m_sparse_self) with the current hyperparameters
+    void computeSparseKernelBlocks(Mat& Kmn, Vec& self_cov) const;
+
 private:
     //! This does the actual building.
     void build_();
@@ -42,6 +42,7 @@
 
 #include "SumOfVariable.h"
 #include <plearn/display/DisplayUtils.h>
+#include <boost/thread.hpp>
 
 #if USING_MPI
 #include <plearn/sys/PLMPI.h>
@@ -72,7 +73,8 @@ SumOfVariable::SumOfVariable():
     nsamples(0),
     curpos(0),
     loop(false),
-    do_sizeprop(false)
+    do_sizeprop(false),
+    n_threads(1)
 {}
 
 SumOfVariable::SumOfVariable(VMat the_distr, Func the_f, int the_nsamples,
@@ -89,7 +91,8 @@ SumOfVariable::SumOfVariable(VMat the_distr, Func the_f, int the_nsamples,
     input_value(the_distr->width()),
     input_gradient(the_distr->width()),
     output_value(the_f->outputs[0]->size()),
-    do_sizeprop(the_do_sizeprop)
+    do_sizeprop(the_do_sizeprop),
+    n_threads(1)
 {
     if (call_build_)
         build_();
@@ -126,6 +129,10 @@ void SumOfVariable::build_()
             nsamples = distr->length();
         f->inputs.setDontBpropHere(true);
     }
+    // The thread copies will be rebuilt from the new f and distr.
+    thread_f = TVec<Func>();
+    thread_parents = TVec<VarArray>();
+    thread_cursors = TVec< PP<VMatRowCursor> >();
 }
 
 void
@@ -153,6 +160,16 @@ SumOfVariable::declareOptions(OptionList &ol)
                   "move curpos by nsamples, thus a subsequent propagation \n"
                   "call will sum over the *next* nsamples (which will correspond \n"
                   "to the same saples only if nsamples == distr.length()).");
+    declareOption(ol, "n_threads", &SumOfVariable::n_threads,
+                  OptionBase::buildoption | OptionBase::nosave,
+                  "Number of threads used to sum over the nsamples rows when\n"
+                  "MPI is not used. The summation is sequential when nsamples\n"
+                  "is smaller than n_threads, since copying the parameters to\n"
+                  "each thread would then cost more than it saves. Each thread\n"
+                  "propagates a contiguous range of rows through its own deep\n"
+                  "copy of f, and the values and parameter gradients of the\n"
+                  "threads are then summed. The result is the same as with a\n"
+                  "single thread, up to the order of the summation.");
     inherited::declareOptions(ol);
 }
 
@@ -172,6 +189,10 @@ void SumOfVariable::makeDeepCopyFromShallowCopy(CopiesMap& copies)
     inherited::makeDeepCopyFromShallowCopy(copies);
     deepCopyField(distr, copies);
     deepCopyField(f, copies);
+    // The thread copies are not shared, they will be rebuilt when needed.
+    thread_f = TVec<Func>();
+    thread_parents = TVec<VarArray>();
+    thread_cursors = TVec< PP<VMatRowCursor> >();
 }
 
 
@@ -212,17 +233,20 @@ void SumOfVariable::fprop()
         }
         MPI_Allreduce(dummy_value.data(), value.data(), value.length(), PLMPI_REAL, MPI_SUM, MPI_COMM_WORLD);
 #else
-        for(int i=0; i<nsamples; i++)
-        {
-            input_value.resize(distr->width());
-            distr->getRow(curpos, input_value);
-            input_value.resize(distr->inputsize()+distr->targetsize()+distr->weightsize());
-            if(do_sizeprop) f->sizefprop(input_value, output_value);
-            else f->fprop(input_value, output_value);
-            value += output_value;
-            if(++curpos == distr->length())
-                curpos = 0;
-        }
+        if (n_threads > 1 && nsamples > 1 && nsamples >= n_threads)
+            threadedProp(false);
+        else
+            for(int i=0; i<nsamples; i++)
+            {
+                input_value.resize(distr->width());
+                distr->getRow(curpos, input_value);
+                input_value.resize(distr->inputsize()+distr->targetsize()+distr->weightsize());
+                if(do_sizeprop) f->sizefprop(input_value, output_value);
+                else f->fprop(input_value, output_value);
+                value += output_value;
+                if(++curpos == distr->length())
+                    curpos = 0;
+            }
 #endif
     }
 
@@ -281,20 +305,23 @@ void SumOfVariable::fbprop()
             MPI_Bcast(params[i]->gradientdata, buffer.length(), PLMPI_REAL, 0, MPI_COMM_WORLD);
         }
 #else
-        for(int i=0; i<nsamples; i++)
-        {
-            input_value.resize(distr->width());
-            distr->getRow(curpos, input_value);
-            input_value.resize(distr->inputsize()+distr->targetsize()+distr->weightsize());
-            static bool display_fn=false;
-            if (display_fn)
-                displayFunction(f, true, false, 250);
-            if(do_sizeprop) f->sizefbprop(input_value, output_value, input_gradient, gradient);
-            else f->fbprop(input_value, output_value, input_gradient, gradient);
-            value += output_value;
-            if(++curpos == distr->length()) 
-                curpos = 0;
-        }
+        if (n_threads > 1 && nsamples > 1 && nsamples >= n_threads)
+            threadedProp(true);
+        else
+            for(int i=0; i<nsamples; i++)
+            {
+                input_value.resize(distr->width());
+                distr->getRow(curpos, input_value);
+                input_value.resize(distr->inputsize()+distr->targetsize()+distr->weightsize());
+                static bool display_fn=false;
+                if (display_fn)
+                    displayFunction(f, true, false, 250);
+                if(do_sizeprop) f->sizefbprop(input_value, output_value, input_gradient, gradient);
+                else f->fbprop(input_value, output_value, input_gradient, gradient);
+                value += output_value;
+                if(++curpos == distr->length()) 
+                    curpos = 0;
+            }
 #endif
     }
 
@@ -304,6 +331,166 @@ void SumOfVariable::fbprop()
 }
 
 
+
+//! Function object run by each thread of SumOfVariable::threadedProp.
+//! Only plain pointers are used, since the reference counts of PLearn
+//! objects are not thread-safe.
+struct SumOfVariableThread
+{
+    Function* f;
+    VMatRowCursor* cursor;
+    int start;      //!< Row of the first sample.
+    int n;          //!< Number of samples.
+    int size;       //!< inputsize + targetsize + weightsize of the rows.
+    bool do_bprop;
+    bool do_sizeprop;
+
+    //! Buffers of the thread, and sum of the outputs of f.
+    Vec* input_value;
+    Vec* input_gradient;
+    Vec* output_value;
+    Vec* output_gradient;
+    Vec* sum;
+    string* error;
+
+    void operator()()
+    {
+        try {
+            run();
+        } catch (const PLearnError& e) {
+            *error = e.message();
+        }
+    }
+
+    void run()
+    {
+        sum->clear();
+        int pos = start;
+        for (int i = 0; i < n; i++) {
+            input_value->resize(cursor->width());
+            cursor->getRow(pos, *input_value);
+            input_value->resize(size);
+            if (do_bprop) {
+                if (do_sizeprop)
+                    f->sizefbprop(*input_value, *output_value,
+                                  *input_gradient, *output_gradient);
+                else
+                    f->fbprop(*input_value, *output_value,
+                              *input_gradient, *output_gradient);
+            } else {
+                if (do_sizeprop)
+                    f->sizefprop(*input_value, *output_value);
+                else
+                    f->fprop(*input_value, *output_value);
+            }
+            *sum += *output_value;
+            if (++pos == cursor->length())
+                pos = 0;
+        }
+    }
+};
+
+///////////////////////
+// buildThreadCopies //
+///////////////////////
+void SumOfVariable::buildThreadCopies(int n)
+{
+    thread_f.resize(n);
+    thread_parents.resize(n);
+    thread_cursors.resize(n);
+    for (int k = 0; k < n; k++) {
+        CopiesMap copies;
+        thread_f[k] = f->deepCopy(copies);
+        VarArray& parents = thread_parents[k];
+        parents.resize(varray.size());
+        for (int j = 0; j < varray.size(); j++) {
+            CopiesMap::iterator it =
+                copies.find((const Variable*) varray[j]);
+            if (it == copies.end())
+                PLERROR("In SumOfVariable::buildThreadCopies - Parent %d of "
+                        "the function was not copied", j);
+            parents[j] = static_cast<Variable*>(it->second);
+        }
+        thread_cursors[k] = distr->newRowCursor();
+    }
+}
+
+//////////////////
+// threadedProp //
+//////////////////
+void SumOfVariable::threadedProp(bool do_bprop)
+{
+    int len = distr->length();
+    int n = min(n_threads, nsamples);
+    if (thread_f.length() != n || thread_cursors.length() != n)
+        buildThreadCopies(n);
+
+    // Everything shared with the threads is created here, in the main
+    // thread.
+    TVec<Vec> input_values(n);
+    TVec<Vec> input_gradients(n);
+    TVec<Vec> output_values(n);
+    TVec<Vec> output_gradients(n);
+    TVec<Vec> sums(n);
+    TVec<string> errors(n);
+    TVec<SumOfVariableThread> functors(n);
+    TVec<boost::thread*> threads(n);
+    for (int k = 0; k < n; k++) {
+        // The copies must use the current values of the parents of f.
+        VarArray& parents = thread_parents[k];
+        for (int j = 0; j < varray.size(); j++) {
+            parents[j]->value << varray[j]->value;
+            if (do_bprop)
+                parents[j]->gradient.clear();
+        }
+        int start = (int) ((long) nsamples * k / n);
+        int end = (int) ((long) nsamples * (k + 1) / n);
+        input_values[k].resize(distr->width());
+        input_gradients[k].resize(input_gradient.length());
+        output_values[k].resize(output_value.length());
+        sums[k].resize(value.length());
+        if (do_bprop)
+            output_gradients[k] = gradient.copy();
+
+        SumOfVariableThread& th = functors[k];
+        th.f = thread_f[k];
+        th.cursor = thread_cursors[k];
+        th.start = (curpos + start) % len;
+        th.n = end - start;
+        th.size = distr->inputsize() + distr->targetsize()
+                + distr->weightsize();
+        th.do_bprop = do_bprop;
+        th.do_sizeprop = do_sizeprop;
+        th.input_value = &input_values[k];
+        th.input_gradient = &input_gradients[k];
+        th.output_value = &output_values[k];
+        th.output_gradient = &output_gradients[k];
+        th.sum = &sums[k];
+        th.error = &errors[k];
+    }
+    for (int k = 0; k < n; k++)
+        threads[k] = new boost::thread(functors[k]);
+    for (int k = 0; k < n; k++) {
+        threads[k]->join();
+        delete threads[k];
+    }
+    for (int k = 0; k < n; k++)
+        if (!errors[k].empty())
+            PLERROR("In SumOfVariable::threadedProp - Error in thread %d: %s",
+                    k, errors[k].c_str());
+
+    // Reduce the results in the order of the samples.
+    value.clear();
+    for (int k = 0; k < n; k++) {
+        value += sums[k];
+        if (do_bprop)
+            for (int j = 0; j < varray.size(); j++)
+                varray[j]->gradient += thread_parents[k][j]->gradient;
+    }
+    curpos = (int) (((long) curpos + nsamples) % len);
+}
+
+
 void SumOfVariable::symbolicBprop()
 {
     /*
@@ -44,6 +44,7 @@
 #define SumOfVariable_INC
 
 #include "NaryVariable.h"
+#include <plearn/vmat/VMatRowCursor.h>
 
 namespace PLearn {
 using namespace std;
@@ -86,7 +87,19 @@ public:
 
     int beginpos;
     int endpos;
-    
+
+    //! Number of threads among which the samples of a propagation are
+    //! split (when nsamples >= n_threads > 1 and MPI is not used).
+    int n_threads;
+
+protected:
+    //! Per-thread deep copies of f, of its non-input parents (in the same
+    //! order as varray) and per-thread row cursors on distr, created by
+    //! buildThreadCopies().
+    TVec<Func> thread_f;
+    TVec<VarArray> thread_parents;
+    TVec< PP<VMatRowCursor> > thread_cursors;
+
 public:
 
     //! Default constructor.
@@ -123,6 +136,7 @@ public:
             nsamples = distr->length();
 
         curpos = 0;
+        thread_cursors = TVec< PP<VMatRowCursor> >();
     }
 
     void setCurrentSamplePos(int pos)
@@ -153,15 +167,27 @@ public:
 
 protected:
     void build_();
+
+    //! (Re)create the 'n' thread copies of f and the row cursors.
+    void buildThreadCopies(int n);
+
+    //! Sum f over the next nsamples samples with 'n_threads' threads, each
+    //! working on its own copy of f and on a contiguous range of samples.
+    //! The parameter gradients (if 'do_bprop') and the values obtained by
+    //! the threads are then summed in the order of the samples ranges.
+    void threadedProp(bool do_bprop);
 };
 
 DECLARE_OBJECT_PTR(SumOfVariable);
 
 //!  sumOf
-inline Var sumOf(VMat distr, Func f, int nsamples=-1, bool the_do_sizeprop=false)
+inline Var sumOf(VMat distr, Func f, int nsamples=-1, bool the_do_sizeprop=false,
+                 int n_threads=1)
 { 
     if(nsamples<0) nsamples = distr.length();
-    return new SumOfVariable(distr,f,nsamples,the_do_sizeprop); 
+    SumOfVariable* sum = new SumOfVariable(distr,f,nsamples,the_do_sizeprop);
+    sum->n_threads = n_threads;
+    return sum;
 }
 
 //!  deprecated old version do not use!
@@ -172,10 +198,14 @@ inline Var sumOf(Var output, const VarArray& inputs, VMat distr, int nsamples=-1
 }
 
 //!  meanOf
-inline Var meanOf(VMat distr, Func f, int nsamples=-1, bool the_do_sizeprop=false)
+inline Var meanOf(VMat distr, Func f, int nsamples=-1, bool the_do_sizeprop=false,
+                  int n_threads=1)
 { 
     if(nsamples<0) nsamples = distr.length();
-    return new SumOfVariable(distr,f/nsamples,nsamples, the_do_sizeprop); 
+    SumOfVariable* sum =
+        new SumOfVariable(distr,f/nsamples,nsamples, the_do_sizeprop);
+    sum->n_threads = n_threads;
+    return sum;
 }
 
 //!  deprecated old version do not use!
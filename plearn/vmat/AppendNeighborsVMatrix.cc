@@ -43,6 +43,7 @@
 
 #include "AppendNeighborsVMatrix.h"
 #include "GetInputVMatrix.h"
+#include "SubVMatrix.h"
 #include "VMat_computeNearestNeighbors.h"
 #include <plearn/math/TMat_maths_impl.h>
 
@@ -119,6 +120,11 @@ void AppendNeighborsVMatrix::declareOptions(OptionList& ol)
                   "appended to the input part. The index of the current\n"
                   "sample is also appended.\n");
 
+    declareOption(ol, "neighbors_finder", &AppendNeighborsVMatrix::neighbors_finder, OptionBase::buildoption,
+                  "Optional learner used to find the nearest neighbors (e.g. an\n"
+                  "HNSWNearestNeighbors for an approximate search on large data).\n"
+                  "If not provided, an exhaustive euclidean search is performed.\n");
+
     // Now call the parent class' declareOptions
     inherited::declareOptions(ol);
 }
@@ -137,20 +143,34 @@ void AppendNeighborsVMatrix::build_()
         input.resize(source->inputsize());
         target.resize(source->targetsize());
 
-        VMat neighbors_source;
-        if(source->targetsize() + source->weightsize() > 0)
+        if (neighbors_finder)
         {
-            GetInputVMatrix* givm = new GetInputVMatrix(source);
-            neighbors_source = givm;
+            int n = source->length();
+            VMat points = new SubVMatrix(source, 0, 0, n, source->inputsize());
+            points->defineSizes(source->inputsize(), 0, 0);
+            neighbors_finder->computeTrainingNeighborhoods(
+                points, n_neighbors+1, input_parts);
         }
         else
-            neighbors_source = source;
-
-        for (int i=0;i<source->length();i++)
         {
-            source->getExample(i,input,target,weight);
-            TVec<int> neighbors_of_i = input_parts(i);
-            computeNearestNeighbors(neighbors_source,input,neighbors_of_i,-1);
+            VMat neighbors_source;
+            if(source->targetsize() + source->weightsize() > 0)
+            {
+                GetInputVMatrix* givm = new GetInputVMatrix(source);
+                neighbors_source = givm;
+            }
+            else
+                neighbors_source = source;
+
+            // All the rows are searched at once (see the batch version of
+            // computeNearestNeighbors).
+            Mat inputs = neighbors_source->toMat();
+            Mat sq_distances;
+            computeNearestNeighbors(inputs, inputs, n_neighbors+1, input_parts,
+                                    sq_distances);
+            for (int i=0;i<source->length();i++)
+                if (sq_distances(i,n_neighbors)==0)
+                    PLERROR("All neighbors had 0 distance. Use more neighbors. (Row %d)",i);
         }
     }
 
@@ -209,7 +229,7 @@ void AppendNeighborsVMatrix::makeDeepCopyFromShallowCopy(CopiesMap& copies)
     deepCopyField(input_parts, copies);
     deepCopyField(transf, copies);
     deepCopyField(transformation, copies);
-    
+    deepCopyField(neighbors_finder, copies);
 }
 
 } // end of namespace PLearn
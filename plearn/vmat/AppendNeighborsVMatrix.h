@@ -46,6 +46,7 @@
 
 #include "SourceVMatrix.h"
 #include <plearn/var/Func.h>
+#include <plearn_learners/nearest_neighbors/GenericNearestNeighbors.h>
 
 namespace PLearn {
 using namespace std;
@@ -90,6 +91,8 @@ public:
     //! Indication that the nearest neighbor indices should
     //! be appended to the input part.
     bool append_neighbor_indices;
+    //! Optional learner used to find the nearest neighbors
+    PP<GenericNearestNeighbors> neighbors_finder;
 
     // ****************
     // * Constructors *
@@ -0,0 +1,597 @@
+// -*- C++ -*-
+
+// ColumnarVMatrix.cc
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file ColumnarVMatrix.cc */
+
+#include "ColumnarVMatrix.h"
+#include <plearn/base/ProgressBar.h>
+#include <plearn/base/byte_order.h>
+#include <plearn/io/fileutils.h>
+#include <plearn/io/openFile.h>
+#include <plearn/io/pl_io_deprecated.h>
+#include <algorithm>
+
+namespace PLearn {
+using namespace std;
+
+PLEARN_IMPLEMENT_OBJECT(
+    ColumnarVMatrix,
+    "Read-only VMatrix stored column by column in a '.colmat' directory.",
+    "The directory holds a text file 'header' (format version, byte order,\n"
+    "length, width and block length), and for each column j the files\n"
+    "'j.data' (the encoded blocks) and 'j.blocks' (the encoding, position\n"
+    "and statistics of each block). Each block of each column is stored\n"
+    "with the most compact lossless encoding among bit-packed integers, a\n"
+    "dictionary of distinct values, float32 and double.\n"
+    "\n"
+    "Since only the accessed columns are read, selecting a few columns of a\n"
+    "wide matrix (e.g. with a SelectColumnsVMatrix) is much faster than\n"
+    "with a row-major format. Such a directory is created with\n"
+    "'vmat convert <source> <destination>.colmat'.\n");
+
+namespace {
+
+enum {
+    ENCODING_DOUBLE = 0,
+    ENCODING_FLOAT = 1,
+    ENCODING_PACKED_INT = 2,
+    ENCODING_DICTIONARY = 3
+};
+
+//! Maximum number of distinct values for the dictionary encoding.
+const int MAX_DICTIONARY_SIZE = 4096;
+
+//! Number of bits needed to store the integers 0 to m.
+int bitsFor(unsigned int m)
+{
+    int n = 0;
+    while (m) {
+        n++;
+        m >>= 1;
+    }
+    return n;
+}
+
+//! Number of 32-bit words holding n codes of nbits bits.
+int packedLength(int n, int nbits)
+{
+    return int(((int64_t)n * nbits + 31) / 32);
+}
+
+//! Pack the codes on nbits bits each into 'packed'.
+void packCodes(const vector<unsigned int>& codes, int nbits, TVec<int>& packed)
+{
+    packed.resize(packedLength(int(codes.size()), nbits));
+    if (packed.isEmpty())
+        return;
+    packed.fill(0);
+    unsigned int* words = (unsigned int*) packed.data();
+    for (int k = 0; k < int(codes.size()); k++) {
+        int64_t bit = (int64_t)k * nbits;
+        int w = int(bit >> 5);
+        int s = int(bit & 31);
+        uint64_t x = uint64_t(codes[k]) << s;
+        words[w] |= (unsigned int) x;
+        if (s + nbits > 32)
+            words[w + 1] |= (unsigned int)(x >> 32);
+    }
+}
+
+//! Return the k-th code of nbits bits packed in 'words'.
+inline unsigned int unpackCode(const unsigned int* words, int k, int nbits)
+{
+    int64_t bit = (int64_t)k * nbits;
+    int w = int(bit >> 5);
+    int s = int(bit & 31);
+    uint64_t x = uint64_t(words[w]) >> s;
+    if (s + nbits > 32)
+        x |= uint64_t(words[w + 1]) << (32 - s);
+    return (unsigned int)(x & ((uint64_t(1) << nbits) - 1));
+}
+
+} // end of anonymous namespace
+
+/////////////////////
+// ColumnarVMatrix //
+/////////////////////
+ColumnarVMatrix::ColumnarVMatrix():
+    block_length(0),
+    file_bigendian(false)
+{}
+
+ColumnarVMatrix::ColumnarVMatrix(const PPath& the_dirname, bool call_build_):
+    inherited(call_build_),
+    dirname(the_dirname),
+    block_length(0),
+    file_bigendian(false)
+{
+    if (call_build_)
+        build_();
+}
+
+////////////////////
+// declareOptions //
+////////////////////
+void ColumnarVMatrix::declareOptions(OptionList& ol)
+{
+    declareOption(ol, "dirname", &ColumnarVMatrix::dirname,
+                  OptionBase::buildoption,
+                  "Path of the '.colmat' directory.");
+
+    inherited::declareOptions(ol);
+}
+
+///////////
+// build //
+///////////
+void ColumnarVMatrix::build()
+{
+    inherited::build();
+    build_();
+}
+
+////////////
+// build_ //
+////////////
+void ColumnarVMatrix::build_()
+{
+    if (dirname.isEmpty())
+        return;
+    dirname.removeTrailingSlash(); // For safety.
+    if (!isdir(dirname))
+        PLERROR("In ColumnarVMatrix::build_ - Directory '%s' could not be found",
+                dirname.absolute().c_str());
+
+    PPath header = dirname / "header";
+    if (!isfile(header))
+        PLERROR("In ColumnarVMatrix::build_ - Missing header file '%s'",
+                header.absolute().c_str());
+    PStream in = openFile(header, PStream::raw_ascii, "r");
+    string magic, byte_order_str;
+    int version = 0;
+    in >> magic >> version >> byte_order_str >> length_ >> width_ >> block_length;
+    if (magic != "COLMAT" || version != 1)
+        PLERROR("In ColumnarVMatrix::build_ - '%s' is not a version 1 .colmat "
+                "header", header.absolute().c_str());
+    if (block_length <= 0 || length_ < 0 || width_ < 0)
+        PLERROR("In ColumnarVMatrix::build_ - Invalid sizes in '%s'",
+                header.absolute().c_str());
+    file_bigendian = (byte_order_str == "B");
+
+    block_infos.clear();
+    block_infos.resize(width_);
+    cached_block = TVec<int>(width_, -1);
+    cached_values = TVec<Vec>(width_);
+
+    setMetaDataDir(dirname + ".metadata");
+    updateMtime(header);
+
+    //resize the string mappings
+    map_sr = TVec<map<string,real> >(width_);
+    map_rs = TVec<map<real,string> >(width_);
+
+    getFieldInfos();
+    loadAllStringMappings();
+}
+
+////////////////
+// columnFile //
+////////////////
+PPath ColumnarVMatrix::columnFile(int j, bool blocks) const
+{
+    return dirname / (tostring(j) + (blocks ? ".blocks" : ".data"));
+}
+
+////////////////
+// blockInfos //
+////////////////
+const vector<ColumnarVMatrix::BlockInfo>& ColumnarVMatrix::blockInfos(int j) const
+{
+    vector<BlockInfo>& infos = block_infos[j];
+    int n_blocks = nBlocks();
+    if (int(infos.size()) != n_blocks) {
+        PPath fname = columnFile(j, true);
+        FILE* f = fopen(fname.absolute().c_str(), "rb");
+        if (!f)
+            PLERROR("In ColumnarVMatrix::blockInfos - Could not open file %s",
+                    fname.absolute().c_str());
+        infos.resize(n_blocks);
+        int ints[4];
+        double doubles[4];
+        for (int b = 0; b < n_blocks; b++) {
+            fread_int(f, ints, 4, file_bigendian);
+            fread_double(f, doubles, 4, file_bigendian);
+            BlockInfo& info = infos[b];
+            info.encoding = ints[0];
+            info.nbits = ints[1];
+            info.n_missing = ints[2];
+            info.dict_size = ints[3];
+            info.offset = doubles[0];
+            info.base = doubles[1];
+            info.min = doubles[2];
+            info.max = doubles[3];
+        }
+        if (ferror(f) || feof(f)) {
+            fclose(f);
+            infos.clear();
+            PLERROR("In ColumnarVMatrix::blockInfos - Could not read %d blocks "
+                    "from %s", n_blocks, fname.absolute().c_str());
+        }
+        fclose(f);
+    }
+    return infos;
+}
+
+/////////////////
+// decodeBlock //
+/////////////////
+void ColumnarVMatrix::decodeBlock(int j, int b, real* values) const
+{
+    const BlockInfo& info = blockInfos(j)[b];
+    int n = min(block_length, length_ - b * block_length);
+    bool has_missing = info.n_missing > 0;
+
+    // Constant blocks are not stored.
+    if (info.encoding == ENCODING_PACKED_INT && info.nbits == 0) {
+        real value = info.n_missing == n ? MISSING_VALUE : real(info.base);
+        for (int k = 0; k < n; k++)
+            values[k] = value;
+        return;
+    }
+
+    PPath fname = columnFile(j);
+    FILE* f = fopen(fname.absolute().c_str(), "rb");
+    if (!f)
+        PLERROR("In ColumnarVMatrix::decodeBlock - Could not open file %s",
+                fname.absolute().c_str());
+    fseek(f, long(info.offset), SEEK_SET);
+
+    switch (info.encoding) {
+    case ENCODING_DOUBLE:
+        fread_double(f, values, n, file_bigendian);
+        break;
+    case ENCODING_FLOAT:
+        fread_float(f, values, n, file_bigendian);
+        break;
+    case ENCODING_PACKED_INT:
+    case ENCODING_DICTIONARY:
+    {
+        vector<double> dictionary(info.dict_size);
+        if (info.dict_size > 0)
+            fread_double(f, &dictionary[0], info.dict_size, file_bigendian);
+        packed.resize(packedLength(n, info.nbits));
+        if (packed.length() > 0)
+            fread_int(f, packed.data(), packed.length(), file_bigendian);
+        const unsigned int* words =
+            packed.isEmpty() ? 0 : (const unsigned int*) packed.data();
+        unsigned int offset = has_missing ? 1 : 0;
+        for (int k = 0; k < n; k++) {
+            unsigned int code = info.nbits > 0 ? unpackCode(words, k, info.nbits) : 0;
+            if (has_missing && code == 0)
+                values[k] = MISSING_VALUE;
+            else if (info.encoding == ENCODING_PACKED_INT)
+                values[k] = real(info.base + (code - offset));
+            else
+                values[k] = real(dictionary[code - offset]);
+        }
+        break;
+    }
+    default:
+        fclose(f);
+        PLERROR("In ColumnarVMatrix::decodeBlock - Unknown encoding %d for "
+                "block %d of column %d", info.encoding, b, j);
+    }
+    fclose(f);
+}
+
+/////////////////
+// blockValues //
+/////////////////
+const real* ColumnarVMatrix::blockValues(int j, int b) const
+{
+    Vec& values = cached_values[j];
+    if (cached_block[j] != b) {
+        cached_block[j] = -1;
+        values.resize(block_length);
+        decodeBlock(j, b, values.data());
+        cached_block[j] = b;
+    }
+    return values.data();
+}
+
+/////////
+// get //
+/////////
+real ColumnarVMatrix::get(int i, int j) const
+{
+#ifdef BOUNDCHECK
+    if (i < 0 || i >= length_ || j < 0 || j >= width_)
+        PLERROR("In ColumnarVMatrix::get - Requested index (%d,%d) but length "
+                "is %d and width is %d", i, j, length_, width_);
+#endif
+    return blockValues(j, i / block_length)[i % block_length];
+}
+
+///////////////
+// getSubRow //
+///////////////
+void ColumnarVMatrix::getSubRow(int i, int j, Vec v) const
+{
+#ifdef BOUNDCHECK
+    if (i < 0 || i >= length_ || j < 0 || j + v.length() > width_)
+        PLERROR("In ColumnarVMatrix::getSubRow - Requested row %d, columns %d "
+                "to %d, but length is %d and width is %d",
+                i, j, j + v.length() - 1, length_, width_);
+#endif
+    int b = i / block_length;
+    int r = i % block_length;
+    for (int k = 0; k < v.length(); k++)
+        v[k] = blockValues(j + k, b)[r];
+}
+
+////////////
+// getMat //
+////////////
+void ColumnarVMatrix::getMat(int i, int j, Mat m) const
+{
+#ifdef BOUNDCHECK
+    if (i < 0 || i + m.length() > length_ || j < 0 || j + m.width() > width_)
+        PLERROR("In ColumnarVMatrix::getMat - Requested rows %d to %d and "
+                "columns %d to %d, but length is %d and width is %d",
+                i, i + m.length() - 1, j, j + m.width() - 1, length_, width_);
+#endif
+    int end = i + m.length();
+    for (int jj = 0; jj < m.width(); jj++) {
+        int row = i;
+        while (row < end) {
+            int b = row / block_length;
+            int r = row % block_length;
+            int n = min(block_length - r, end - row);
+            const real* values = blockValues(j + jj, b) + r;
+            for (int k = 0; k < n; k++)
+                m(row - i + k, jj) = values[k];
+            row += n;
+        }
+    }
+}
+
+///////////////
+// getColumn //
+///////////////
+void ColumnarVMatrix::getColumn(int j, Vec v) const
+{
+#ifdef BOUNDCHECK
+    if (j < 0 || j >= width_ || v.length() != length_)
+        PLERROR("In ColumnarVMatrix::getColumn - Requested column %d with a "
+                "vector of length %d, but length is %d and width is %d",
+                j, v.length(), length_, width_);
+#endif
+    // Blocks are decoded directly into 'v', without going through the cache.
+    for (int b = 0; b < nBlocks(); b++)
+        decodeBlock(j, b, v.data() + b * block_length);
+}
+
+///////////////
+// writeFrom //
+///////////////
+void ColumnarVMatrix::writeFrom(const VMatrix* source, const PPath& the_dirname,
+                                int the_block_length)
+{
+    if (the_block_length <= 0)
+        PLERROR("In ColumnarVMatrix::writeFrom - The block length must be "
+                "positive (got %d)", the_block_length);
+    int l = source->length();
+    int w = source->width();
+    bool bigendian = (byte_order() == BIG_ENDIAN_ORDER);
+
+    force_rmdir(the_dirname);
+    if (!force_mkdir(the_dirname))
+        PLERROR("In ColumnarVMatrix::writeFrom - Could not create directory %s",
+                the_dirname.absolute().c_str());
+
+    Mat block(min(l, the_block_length), w);
+    Vec column(the_block_length);
+    vector<real> distinct;
+    vector<unsigned int> codes;
+    TVec<int> packed;
+    ProgressBar pb(cout, "Saving to colmat", l);
+
+    for (int start = 0; start < l; start += the_block_length) {
+        int n = min(the_block_length, l - start);
+        Mat rows = block.subMatRows(0, n);
+        source->getMat(start, 0, rows);
+        for (int j = 0; j < w; j++) {
+            // Statistics of the block.
+            int n_missing = 0;
+            real mn = 0;
+            real mx = 0;
+            bool integer = true;
+            bool exact_float = true;
+            distinct.resize(0);
+            for (int k = 0; k < n; k++) {
+                real x = rows(k, j);
+                column[k] = x;
+                if (is_missing(x)) {
+                    n_missing++;
+                    continue;
+                }
+                if (distinct.empty() || x < mn)
+                    mn = x;
+                if (distinct.empty() || x > mx)
+                    mx = x;
+                if (integer && !(fast_exact_is_equal(x, floor(x))
+                                 && fabs(x) < 4503599627370496.0)) // 2^52
+                    integer = false;
+                if (exact_float && !fast_exact_is_equal(real(float(x)), x))
+                    exact_float = false;
+                distinct.push_back(x);
+            }
+            bool has_missing = n_missing > 0;
+            unsigned int offset = has_missing ? 1 : 0;
+            sort(distinct.begin(), distinct.end());
+            distinct.erase(unique(distinct.begin(), distinct.end()),
+                           distinct.end());
+            int n_distinct = int(distinct.size());
+
+            // Pick the smallest encoding.
+            BlockInfo info;
+            info.encoding = ENCODING_DOUBLE;
+            info.nbits = 0;
+            info.n_missing = n_missing;
+            info.dict_size = 0;
+            info.base = 0;
+            info.min = n_distinct > 0 ? mn : MISSING_VALUE;
+            info.max = n_distinct > 0 ? mx : MISSING_VALUE;
+            int64_t best_size = (int64_t)n * 8;
+            if (exact_float && (int64_t)n * 4 < best_size) {
+                info.encoding = ENCODING_FLOAT;
+                best_size = (int64_t)n * 4;
+            }
+            if (n_distinct > 0 && n_distinct <= MAX_DICTIONARY_SIZE) {
+                int nbits = bitsFor(n_distinct - 1 + offset);
+                int64_t size = (int64_t)n_distinct * 8
+                    + (int64_t)packedLength(n, nbits) * 4;
+                if (size <= best_size) {
+                    info.encoding = ENCODING_DICTIONARY;
+                    info.nbits = nbits;
+                    info.dict_size = n_distinct;
+                    best_size = size;
+                }
+            }
+            if (integer && (n_distinct == 0 || mx - mn < 2147483647.0)) {
+                unsigned int range = n_distinct > 0 ? (unsigned int)(mx - mn) : 0;
+                int nbits = bitsFor(range + offset);
+                int64_t size = (int64_t)packedLength(n, nbits) * 4;
+                if (size <= best_size) {
+                    info.encoding = ENCODING_PACKED_INT;
+                    info.nbits = nbits;
+                    info.dict_size = 0;
+                    info.base = n_distinct > 0 ? mn : 0;
+                    best_size = size;
+                }
+            }
+
+            // Append the block to the column file.
+            PPath data_fname = the_dirname / (tostring(j) + ".data");
+            FILE* f = fopen(data_fname.absolute().c_str(), "ab");
+            if (!f)
+                PLERROR("In ColumnarVMatrix::writeFrom - Could not open file %s",
+                        data_fname.absolute().c_str());
+            fseek(f, 0, SEEK_END);
+            info.offset = double(ftell(f));
+            switch (info.encoding) {
+            case ENCODING_DOUBLE:
+                fwrite_double(f, column.data(), n, bigendian);
+                break;
+            case ENCODING_FLOAT:
+                fwrite_float(f, column.data(), n, bigendian);
+                break;
+            default:
+                if (info.nbits == 0 && info.encoding == ENCODING_PACKED_INT)
+                    break;  // Constant block: nothing to store.
+                if (info.encoding == ENCODING_DICTIONARY) {
+                    vector<double> dictionary(distinct.begin(), distinct.end());
+                    fwrite_double(f, &dictionary[0], n_distinct, bigendian);
+                }
+                codes.resize(n);
+                for (int k = 0; k < n; k++) {
+                    real x = column[k];
+                    if (is_missing(x))
+                        codes[k] = 0;
+                    else if (info.encoding == ENCODING_PACKED_INT)
+                        codes[k] = (unsigned int)(x - mn) + offset;
+                    else
+                        codes[k] = (unsigned int)(lower_bound(distinct.begin(),
+                                                              distinct.end(), x)
+                                                  - distinct.begin()) + offset;
+                }
+                packCodes(codes, info.nbits, packed);
+                if (!packed.isEmpty())
+                    fwrite_int(f, packed.data(), packed.length(), bigendian);
+            }
+            fclose(f);
+
+            PPath blocks_fname = the_dirname / (tostring(j) + ".blocks");
+            f = fopen(blocks_fname.absolute().c_str(), "ab");
+            if (!f)
+                PLERROR("In ColumnarVMatrix::writeFrom - Could not open file %s",
+                        blocks_fname.absolute().c_str());
+            int ints[4] = { info.encoding, info.nbits, info.n_missing, info.dict_size };
+            double doubles[4] = { info.offset, info.base, info.min, info.max };
+            fwrite_int(f, ints, 4, bigendian);
+            fwrite_double(f, doubles, 4, bigendian);
+            fclose(f);
+        }
+        pb(start + n);
+    }
+
+    // The header is written last, so that an interrupted conversion does
+    // not leave a readable directory.
+    {
+        PStream out = openFile(the_dirname / "header", PStream::raw_ascii, "w");
+        out << "COLMAT 1 " << string(1, byte_order()) << endl
+            << l << " " << w << " " << the_block_length << endl;
+    }
+
+    ColumnarVMatrix vm(the_dirname);
+    vm.setMetaInfoFrom(source);
+    vm.saveFieldInfos();
+    vm.saveAllStringMappings();
+}
+
+/////////////////////////////////
+// makeDeepCopyFromShallowCopy //
+/////////////////////////////////
+void ColumnarVMatrix::makeDeepCopyFromShallowCopy(CopiesMap& copies)
+{
+    inherited::makeDeepCopyFromShallowCopy(copies);
+    deepCopyField(cached_block, copies);
+    deepCopyField(cached_values, copies);
+    deepCopyField(packed, copies);
+}
+
+} // end of namespace PLearn
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
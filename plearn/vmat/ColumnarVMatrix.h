@@ -0,0 +1,174 @@
+// -*- C++ -*-
+
+// ColumnarVMatrix.h
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file ColumnarVMatrix.h */
+
+#ifndef ColumnarVMatrix_INC
+#define ColumnarVMatrix_INC
+
+#include "VMatrix.h"
+#include <vector>
+
+namespace PLearn {
+using namespace std;
+
+/**
+ * Read-only VMatrix stored column by column in a '.colmat' directory.
+ *
+ * Each column is stored in its own file, split into blocks of
+ * 'blockLength()' rows. Each block is encoded independently, with the most
+ * compact of the following lossless encodings:
+ *  - bit-packed integers (offset by the block minimum), for integer values
+ *    such as those of string-mapped or categorical fields;
+ *  - a dictionary of the distinct values with bit-packed codes;
+ *  - float32, when all values are exactly representable as floats;
+ *  - double.
+ * The minimum, maximum and number of missing values of each block are also
+ * stored with its encoding.
+ *
+ * Only the columns that are accessed are read: selecting a few columns
+ * through a SelectColumnsVMatrix or a SubVMatrix thus only reads the files
+ * of these columns. Decoded blocks are cached (one block per column), so
+ * that rows are best accessed in order.
+ */
+class ColumnarVMatrix: public VMatrix
+{
+    typedef VMatrix inherited;
+
+public:
+    //#####  Public Build Options  ############################################
+
+    //! Path of the '.colmat' directory.
+    PPath dirname;
+
+public:
+    //#####  Public Member Functions  #########################################
+
+    //! Default constructor.
+    ColumnarVMatrix();
+
+    //! Open an existing '.colmat' directory.
+    ColumnarVMatrix(const PPath& the_dirname, bool call_build_ = true);
+
+    //! Write 'source' as a '.colmat' directory, with blocks of
+    //! 'the_block_length' rows. An existing directory is replaced.
+    static void writeFrom(const VMatrix* source, const PPath& the_dirname,
+                          int the_block_length = 1024);
+
+    virtual real get(int i, int j) const;
+    virtual void getSubRow(int i, int j, Vec v) const;
+    virtual void getMat(int i, int j, Mat m) const;
+    virtual void getColumn(int j, Vec v) const;
+
+    //! Number of rows in each block (the last block may be shorter).
+    int blockLength() const { return block_length; }
+
+    //! Number of blocks in each column.
+    int nBlocks() const
+    { return block_length > 0 ? (length_ + block_length - 1) / block_length : 0; }
+
+    PLEARN_DECLARE_OBJECT(ColumnarVMatrix);
+
+    virtual void build();
+
+    virtual void makeDeepCopyFromShallowCopy(CopiesMap& copies);
+
+protected:
+    //! Encoding and statistics of a block of a column.
+    struct BlockInfo
+    {
+        int encoding;
+        int nbits;      //!< Number of bits of the packed codes.
+        int n_missing;
+        int dict_size;  //!< Number of values in the dictionary.
+        double offset;  //!< Position of the block in the column file.
+        double base;    //!< Value of code 0 for packed integers.
+        double min;
+        double max;
+    };
+
+    int block_length;
+
+    //! Whether the data files are big-endian.
+    bool file_bigendian;
+
+    //! Block information of each column, loaded when the column is first
+    //! accessed.
+    mutable vector< vector<BlockInfo> > block_infos;
+
+    //! Index of the block of each column held in 'cached_values' (-1 if
+    //! none).
+    mutable TVec<int> cached_block;
+    mutable TVec<Vec> cached_values;
+
+    //! Buffer for the packed codes of a block.
+    mutable TVec<int> packed;
+
+    static void declareOptions(OptionList& ol);
+
+    //! Return the block information of column 'j', loading it if needed.
+    const vector<BlockInfo>& blockInfos(int j) const;
+
+    //! Return the decoded values of block 'b' of column 'j' (cached).
+    const real* blockValues(int j, int b) const;
+
+    //! Read and decode block 'b' of column 'j' into 'values'.
+    void decodeBlock(int j, int b, real* values) const;
+
+    //! Path of the file holding the data (or block information if
+    //! 'blocks' is true) of column 'j'.
+    PPath columnFile(int j, bool blocks = false) const;
+
+private:
+    void build_();
+};
+
+DECLARE_OBJECT_PTR(ColumnarVMatrix);
+
+} // end of namespace PLearn
+
+#endif
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
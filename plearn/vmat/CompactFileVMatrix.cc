@@ -34,6 +34,7 @@
 
 
 #include "CompactFileVMatrix.h"
+#include "VMatRowCursor.h"
 #include <plearn/io/fileutils.h>
 #include <plearn/io/pl_NSPR_io.h>
 
@@ -433,6 +434,18 @@ void CompactFileVMatrix::getNewRow(int i, const Vec& v) const
         }
     }
 
+    decodeRow(buffer, v);
+
+   if (m_flag)
+        free(buffer);
+}
+
+///////////////
+// decodeRow //
+///////////////
+void CompactFileVMatrix::decodeRow(const unsigned char* buffer,
+                                   const Vec& v) const
+{
     int current_b = -1;
     int current_v = 0;
     int value_b = 0;
@@ -491,9 +504,80 @@ void CompactFileVMatrix::getNewRow(int i, const Vec& v) const
                 current_v += max + 1;
         }
     }
+}
 
-   if (m_flag)
-        free(buffer);
+//! Cursor reading a '.cmat' file through its own file descriptor. It does
+//! not use nor fill the in-memory cache of the CompactFileVMatrix.
+class CompactFileVMatRowCursor: public VMatRowCursor
+{
+public:
+    CompactFileVMatRowCursor(const CompactFileVMatrix* the_vm):
+        VMatRowCursor(the_vm),
+        cvm(the_vm),
+        f(0),
+        buffer(the_vm->compact_width_)
+    {
+        string fname = cvm->filename_.absolute();
+#ifdef USE_NSPR_FILE
+        f = PR_Open(fname.c_str(), PR_RDONLY, 0666);
+#else
+        f = fopen(fname.c_str(), "rb");
+#endif
+        if (!f)
+            PLERROR("In CompactFileVMatRowCursor - Could not open file '%s'",
+                    fname.c_str());
+    }
+
+    virtual ~CompactFileVMatRowCursor()
+    {
+#ifdef USE_NSPR_FILE
+        PR_Close(f);
+#else
+        fclose(f);
+#endif
+    }
+
+protected:
+    const CompactFileVMatrix* cvm;
+
+#ifdef USE_NSPR_FILE
+    PRFileDesc* f;
+#else
+    FILE* f;
+#endif
+
+    TVec<unsigned char> buffer;
+
+    virtual void getNewRows(int i_start, Mat& m)
+    {
+        int cw = cvm->compact_width_;
+#ifdef USE_NSPR_FILE
+        PRInt64 offset = i_start;
+        offset *= cw;
+        offset += cvm->header_length;
+        PR_Seek64(f, offset, PR_SEEK_SET);
+#else
+        fseek(f, cvm->header_length + i_start * cw, SEEK_SET);
+#endif
+        Vec row;
+        for (int k = 0; k < m.length(); k++) {
+#ifdef USE_NSPR_FILE
+            PR_Read(f, buffer.data(), cw);
+#else
+            fread(buffer.data(), cw, 1, f);
+#endif
+            row = m(k);
+            cvm->decodeRow(buffer.data(), row);
+        }
+    }
+};
+
+//////////////////
+// newRowCursor //
+//////////////////
+PP<VMatRowCursor> CompactFileVMatrix::newRowCursor() const
+{
+    return new CompactFileVMatRowCursor(this);
 }
 
 ///////////////
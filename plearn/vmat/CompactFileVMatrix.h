@@ -89,6 +89,7 @@ struct GroupInfo {
 //! same as for Mat).
 class CompactFileVMatrix: public RowBufferedVMatrix
 {
+    friend class CompactFileVMatRowCursor;
 
 private:
     typedef RowBufferedVMatrix inherited;
@@ -122,6 +123,9 @@ protected:
     static void declareOptions(OptionList & ol);
     virtual void getNewRow(int i, const Vec& v) const;
 
+    //! Decode the compacted row stored in 'buffer' into 'v'.
+    void decodeRow(const unsigned char* buffer, const Vec& v) const;
+
     //! Open the current file.
     virtual void openCurrentFile();
     //! Close the current file.
@@ -154,6 +158,9 @@ public:
 
     virtual void build();
 
+    //! Return a cursor with its own file descriptor.
+    virtual PP<VMatRowCursor> newRowCursor() const;
+
     static VMat instantiateFromPPath(const PPath& filename)
     {
         return VMat(new CompactFileVMatrix(filename));
@@ -40,6 +40,7 @@
 
 #include "ConcatRowsVMatrix.h"
 #include "SelectColumnsVMatrix.h"
+#include "VMatRowCursor.h"
 
 namespace PLearn {
 using namespace std;
@@ -445,6 +446,76 @@ void ConcatRowsVMatrix::getSubRow(int i, int j, Vec v) const
     }
 }
 
+//! Cursor reading through cursors on the concatenated VMats.
+class ConcatRowsVMatRowCursor: public VMatRowCursor
+{
+public:
+    ConcatRowsVMatRowCursor(const VMatrix* the_vm,
+                            const TVec< PP<VMatRowCursor> >& the_cursors,
+                            const TMat< map<real, real> >* the_fixed_mappings):
+        VMatRowCursor(the_vm),
+        cursors(the_cursors),
+        start_rows(the_cursors.length() + 1),
+        fixed_mappings(the_fixed_mappings)
+    {
+        start_rows[0] = 0;
+        for (int k = 0; k < cursors.length(); k++)
+            start_rows[k + 1] = start_rows[k] + cursors[k]->length();
+    }
+
+protected:
+    TVec< PP<VMatRowCursor> > cursors;
+
+    //! start_rows[k] is the first row of the k-th VMat in the concatenation.
+    TVec<int> start_rows;
+
+    //! Mappings to fix (null when no mapping needs fixing).
+    const TMat< map<real, real> >* fixed_mappings;
+
+    virtual void getNewRows(int i_start, Mat& m)
+    {
+        int n = m.length();
+        int k = 0;
+        int whichvm = 0;
+        Mat block;
+        while (k < n) {
+            int i = i_start + k;
+            while (i >= start_rows[whichvm + 1])
+                whichvm++;
+            int len = min(n - k, start_rows[whichvm + 1] - i);
+            block = m.subMatRows(k, len);
+            cursors[whichvm]->getRows(i - start_rows[whichvm], len, block);
+            if (fixed_mappings)
+                for (int r = 0; r < len; r++) {
+                    real* row = block[r];
+                    for (int j = 0; j < width_; j++) {
+                        const map<real, real>& fixed =
+                            (*fixed_mappings)(whichvm, j);
+                        if (fixed.empty() || is_missing(row[j]))
+                            continue;
+                        map<real, real>::const_iterator it =
+                            fixed.find(row[j]);
+                        if (it != fixed.end())
+                            row[j] = it->second;
+                    }
+                }
+            k += len;
+        }
+    }
+};
+
+//////////////////
+// newRowCursor //
+//////////////////
+PP<VMatRowCursor> ConcatRowsVMatrix::newRowCursor() const
+{
+    TVec< PP<VMatRowCursor> > cursors(to_concat.length());
+    for (int k = 0; k < to_concat.length(); k++)
+        cursors[k] = to_concat[k]->newRowCursor();
+    return new ConcatRowsVMatRowCursor(
+        this, cursors, need_fix_mappings ? &fixed_mappings : 0);
+}
+
 /////////////////////////////////
 // makeDeepCopyFromShallowCopy //
 /////////////////////////////////
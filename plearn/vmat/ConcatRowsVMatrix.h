@@ -87,6 +87,9 @@ public:
     virtual real get(int i, int j) const;
     virtual void getSubRow(int i, int j, Vec v) const;
 
+    //! Return a cursor reading through cursors on the concatenated VMats.
+    virtual PP<VMatRowCursor> newRowCursor() const;
+
     virtual void reset_dimensions();
 
     virtual real dot(int i1, int i2, int inputsize) const;
@@ -40,6 +40,7 @@
  ******************************************************* */
 
 #include "DiskVMatrix.h"
+#include "VMatRowCursor.h"
 #include <errno.h>
 #include <errno.h>
 #include <plearn/base/stringutils.h>
@@ -365,6 +366,86 @@ void DiskVMatrix::getNewRow(int i, const Vec& v) const
     last_op_was_append= false;
 }
 
+//! Cursor reading a '.dmat' directory through its own file handles.
+class DiskVMatRowCursor: public VMatRowCursor
+{
+public:
+    DiskVMatRowCursor(const DiskVMatrix* the_vm):
+        VMatRowCursor(the_vm),
+        old_format(the_vm->old_format),
+        swap_endians(the_vm->swap_endians),
+        indexf(0),
+        dataf(the_vm->dataf.length())
+    {
+        dataf.fill(0);
+        string indexfname = the_vm->dirname/"indexfile";
+        indexf = fopen(indexfname.c_str(), "rb");
+        if (!indexf)
+            PLERROR("In DiskVMatRowCursor - Could not open file %s",
+                    indexfname.c_str());
+        for (int k = 0; k < dataf.length(); k++) {
+            string fname = the_vm->dirname/(tostring(k)+".data");
+            dataf[k] = fopen(fname.c_str(), "rb");
+            if (!dataf[k])
+                PLERROR("In DiskVMatRowCursor - Could not open file %s",
+                        fname.c_str());
+        }
+    }
+
+    virtual ~DiskVMatRowCursor()
+    {
+        for (int k = 0; k < dataf.length(); k++)
+            if (dataf[k])
+                fclose(dataf[k]);
+        if (indexf)
+            fclose(indexf);
+    }
+
+protected:
+    bool old_format;
+    bool swap_endians;
+    FILE* indexf;
+    TVec<FILE*> dataf;
+
+    virtual void getNewRows(int i_start, Mat& m)
+    {
+        unsigned char filenum;
+        unsigned int position;
+        fseek(indexf, 3*sizeof(int) +
+              i_start*(sizeof(unsigned char)+sizeof(unsigned int)), SEEK_SET);
+        for (int k = 0; k < m.length(); k++) {
+            // Index entries of consecutive rows are contiguous.
+            fread(&filenum, sizeof(unsigned char), 1, indexf);
+            fread(&position, sizeof(unsigned int), 1, indexf);
+            if (swap_endians)
+                endianswap(&position);
+            FILE* f = dataf[int(filenum)];
+            PLASSERT( f );
+            fseek(f, position, SEEK_SET);
+            if (old_format)
+                binread_compressed(f, m[k], width_);
+            else
+                new_read_compressed(f, m[k], width_, swap_endians);
+        }
+    }
+};
+
+//////////////////
+// newRowCursor //
+//////////////////
+PP<VMatRowCursor> DiskVMatrix::newRowCursor() const
+{
+    // Make sure rows appended so far are visible to the new file handles.
+    if (writable) {
+        for (int k = 0; k < dataf.length(); k++)
+            if (dataf[k])
+                fflush(dataf[k]);
+        if (indexf)
+            fflush(indexf);
+    }
+    return new DiskVMatRowCursor(this);
+}
+
 void DiskVMatrix::putRow(int i, Vec v)
 {
     PLERROR("putRow cannot in general be correctly and efficiently implemented for a DiskVMatrix.\n"
@@ -56,6 +56,7 @@ using namespace std;
 //!  Each row is compressed/decompressed through the methods of VecCompressor
 class DiskVMatrix: public RowBufferedVMatrix
 {
+    friend class DiskVMatRowCursor;
     typedef RowBufferedVMatrix inherited;
 
 protected:
@@ -99,6 +100,9 @@ public:
 
     virtual void build();
 
+    //! Return a cursor with its own index and data file handles.
+    virtual PP<VMatRowCursor> newRowCursor() const;
+
     //! Transform a shallow copy into a deep copy.
     virtual void makeDeepCopyFromShallowCopy(CopiesMap& copies);
 
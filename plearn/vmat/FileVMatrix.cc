@@ -39,8 +39,10 @@
  ******************************************************* */
 
 #include "FileVMatrix.h"
+#include "VMatRowCursor.h"
 #include <plearn/io/fileutils.h>
 #include <plearn/io/pl_NSPR_io.h>
+#include <plearn/base/byte_order.h>
 
 namespace PLearn {
 using namespace std;
@@ -60,7 +62,12 @@ PLEARN_IMPLEMENT_OBJECT(
 FileVMatrix::FileVMatrix():
     filename_       (""),
     f               (0),
-    build_new_file  (false)
+    mapped_file     (0),
+    mapped_size     (0),
+    mapped_handle   (STORAGE_UNUSED_HANDLE),
+    mapped_native   (false),
+    build_new_file  (false),
+    memory_map      (false)
 {
     writable=true;
     remove_when_done = track_ref = -1;
@@ -70,7 +77,12 @@ FileVMatrix::FileVMatrix(const PPath& filename, bool writable_):
     inherited       (true),
     filename_       (filename.absolute()),
     f               (0),
-    build_new_file  (!isfile(filename))
+    mapped_file     (0),
+    mapped_size     (0),
+    mapped_handle   (STORAGE_UNUSED_HANDLE),
+    mapped_native   (false),
+    build_new_file  (!isfile(filename)),
+    memory_map      (false)
 {
     remove_when_done = track_ref = -1;
     writable = writable_;
@@ -84,7 +96,12 @@ FileVMatrix::FileVMatrix(const PPath& filename, int the_length, int the_width,
     f               (0),
     file_is_float   (force_float),
     force_float     (force_float),
-    build_new_file  (true)
+    mapped_file     (0),
+    mapped_size     (0),
+    mapped_handle   (STORAGE_UNUSED_HANDLE),
+    mapped_native   (false),
+    build_new_file  (true),
+    memory_map      (false)
 {
     remove_when_done = track_ref = -1;
     writable = true;
@@ -97,7 +114,12 @@ FileVMatrix::FileVMatrix(const PPath& filename, int the_length,
     inherited       (the_length, fieldnames.length(), true),
     filename_       (filename.absolute()),
     f               (0),
-    build_new_file  (true)
+    mapped_file     (0),
+    mapped_size     (0),
+    mapped_handle   (STORAGE_UNUSED_HANDLE),
+    mapped_native   (false),
+    build_new_file  (true),
+    memory_map      (false)
 {
     remove_when_done = track_ref = -1;
     writable = true;
@@ -291,7 +313,16 @@ void FileVMatrix::build_()
                       " of %ld, expected %ld",
                       filename_.c_str(), (long int)info.size, (long int)expectedsize);
 #endif
-        
+
+        if (memory_map) {
+            if (writable)
+                PLWARNING("In FileVMatrix::build_ - The file '%s' cannot be "
+                          "memory-mapped since the matrix is writable: "
+                          "regular file access will be used instead",
+                          filename_.c_str());
+            else
+                mapFile();
+        }
     }
 
     setMetaDataDir(filename_ + ".metadata");
@@ -309,6 +340,7 @@ void FileVMatrix::build_()
 //////////////////////
 void FileVMatrix::closeCurrentFile()
 {
+    unmapFile();
     if (f)
     {
 #ifdef USE_NSPR_FILE
@@ -327,6 +359,13 @@ void FileVMatrix::declareOptions(OptionList & ol)
 {
     declareOption(ol, "filename", &FileVMatrix::filename_, OptionBase::buildoption, "Filename of the matrix");
 
+    declareOption(ol, "memory_map", &FileVMatrix::memory_map,
+                  OptionBase::buildoption,
+        "If true, the file is memory-mapped (only for a non-writable\n"
+        "matrix) and rows are read directly from the mapped pages instead\n"
+        "of through seek and read calls. getExamples() and toMat() then copy\n"
+        "whole blocks of rows from the mapped pages at once.");
+
     declareOption(ol, "remove_when_done", &FileVMatrix::remove_when_done,
             OptionBase::learntoption,
             "Deprecated option! (use TemporaryFileVMatrix instead).");
@@ -352,6 +391,10 @@ void FileVMatrix::makeDeepCopyFromShallowCopy(CopiesMap& copies)
     // are atomic (no context switch to another thread).
 
     f = 0;   // Because we will open again the file (f should not be shared).
+    // Same for the memory mapping, which belongs to the original object.
+    mapped_file = 0;
+    mapped_size = 0;
+    mapped_handle = STORAGE_UNUSED_HANDLE;
     // however reopening the file twice in write mode is certainly a VERY bad idea.
     // thus we switch to read-mode 
     build_new_file = false;
@@ -395,6 +438,311 @@ void FileVMatrix::getNewRow(int i, const Vec& v) const
 #endif
 }
 
+/////////////
+// mapFile //
+/////////////
+void FileVMatrix::mapFile()
+{
+    unmapFile();
+    if (length_ <= 0 || width_ <= 0)
+        return;
+#if !defined(_MSC_VER) && !defined(_MINGW_)
+    mapped_file = (char*) MemoryMap(filename_.absolute().c_str(), mapped_handle,
+                                    true, mapped_size);
+    if (!mapped_file)
+        PLERROR("In FileVMatrix::mapFile - Could not memory-map file '%s'",
+                filename_.c_str());
+    int64_t elemsize = file_is_float ? sizeof(float) : sizeof(double);
+    if (mapped_size < DATAFILE_HEADERLENGTH + int64_t(length_)*width_*elemsize) {
+        unmapFile();
+        PLERROR("In FileVMatrix::mapFile - The file '%s' is too small to "
+                "contain a %d x %d matrix", filename_.c_str(), length_, width_);
+    }
+    mapped_native = (file_is_float == (sizeof(real) == sizeof(float)));
+#ifdef LITTLEENDIAN
+    mapped_native = mapped_native && !file_is_bigendian;
+#endif
+#ifdef BIGENDIAN
+    mapped_native = mapped_native && file_is_bigendian;
+#endif
+#else
+    PLWARNING("In FileVMatrix::mapFile - Memory-mapping is not supported on "
+              "this platform, regular file access will be used instead");
+#endif
+}
+
+///////////////
+// unmapFile //
+///////////////
+void FileVMatrix::unmapFile()
+{
+#if !defined(_MSC_VER) && !defined(_MINGW_)
+    if (mapped_file)
+        memoryUnmap(mapped_file, mapped_handle, mapped_size);
+#endif
+    mapped_file = 0;
+    mapped_size = 0;
+    mapped_handle = STORAGE_UNUSED_HANDLE;
+    mapped_native = false;
+}
+
+////////////////////////
+// copyFromMappedFile //
+////////////////////////
+void FileVMatrix::copyFromMappedFile(int i, int j, real* dest, int n) const
+{
+    PLASSERT( mapped_file );
+    const char* src = mappedElement(i, j);
+    if (mapped_native) {
+        memcpy(dest, src, n * sizeof(real));
+        return;
+    }
+    bool swap = false;
+#ifdef LITTLEENDIAN
+    swap = file_is_bigendian;
+#endif
+#ifdef BIGENDIAN
+    swap = !file_is_bigendian;
+#endif
+    if (file_is_float) {
+        const float* fsrc = (const float*) src;
+        for (int k = 0; k < n; k++) {
+            float x = fsrc[k];
+            if (swap)
+                endianswap(&x);
+            dest[k] = real(x);
+        }
+    } else {
+        const double* dsrc = (const double*) src;
+        for (int k = 0; k < n; k++) {
+            double x = dsrc[k];
+            if (swap)
+                endianswap(&x);
+            dest[k] = real(x);
+        }
+    }
+}
+
+/////////
+// get //
+/////////
+real FileVMatrix::get(int i, int j) const
+{
+    if (!mapped_file)
+        return inherited::get(i, j);
+#ifdef BOUNDCHECK
+    if (i < 0 || i >= length_ || j < 0 || j >= width_)
+        PLERROR("In FileVMatrix::get - Element (%d,%d) outside of a %d x %d "
+                "matrix", i, j, length_, width_);
+#endif
+    real value;
+    copyFromMappedFile(i, j, &value, 1);
+    return value;
+}
+
+////////////
+// getRow //
+////////////
+void FileVMatrix::getRow(int i, Vec v) const
+{
+    if (!mapped_file) {
+        inherited::getRow(i, v);
+        return;
+    }
+#ifdef BOUNDCHECK
+    if (i < 0 || i >= length_)
+        PLERROR("In FileVMatrix::getRow - Row index (%d) outside valid range "
+                "[%d,%d]", i, 0, length_ - 1);
+    if (v.length() != width_)
+        PLERROR("In FileVMatrix::getRow - Length of v (%d) differs from "
+                "matrix width (%d)", v.length(), width_);
+#endif
+    if (width_ > 0)
+        copyFromMappedFile(i, 0, v.data(), width_);
+}
+
+///////////////
+// getSubRow //
+///////////////
+void FileVMatrix::getSubRow(int i, int j, Vec v) const
+{
+    if (!mapped_file) {
+        inherited::getSubRow(i, j, v);
+        return;
+    }
+#ifdef BOUNDCHECK
+    if (i < 0 || i >= length_ || j < 0 || j + v.length() > width_)
+        PLERROR("In FileVMatrix::getSubRow - Subrow (%d,%d:%d) outside of a "
+                "%d x %d matrix", i, j, j + v.length(), length_, width_);
+#endif
+    if (v.length() > 0)
+        copyFromMappedFile(i, j, v.data(), v.length());
+}
+
+////////////
+// getMat //
+////////////
+void FileVMatrix::getMat(int i, int j, Mat m) const
+{
+    if (!mapped_file) {
+        inherited::getMat(i, j, m);
+        return;
+    }
+#ifdef BOUNDCHECK
+    if (i < 0 || i + m.length() > length_ || j < 0 || j + m.width() > width_)
+        PLERROR("In FileVMatrix::getMat - Submatrix (%d,%d) of size %d x %d "
+                "outside of a %d x %d matrix", i, j, m.length(), m.width(),
+                length_, width_);
+#endif
+    if (m.width() > 0)
+        for (int k = 0; k < m.length(); k++)
+            copyFromMappedFile(i + k, j, m[k], m.width());
+}
+
+/////////////////
+// getExamples //
+/////////////////
+void FileVMatrix::getExamples(int i_start, int length, Mat& inputs,
+                              Mat& targets, Vec& weights, Mat* extras,
+                              bool allow_circular)
+{
+    int is = inputsize_;
+    int ts = targetsize_;
+    int ws = weightsize_;
+    int es = extras ? extrasize_ : 0;
+    // Only a block lying entirely in the mapped file is copied directly.
+    if (!mapped_file || i_start < 0 || length < 0
+        || i_start + length > length_
+        || is < 0 || ts < 0 || ws < 0 || ws > 1 || es < 0) {
+        inherited::getExamples(i_start, length, inputs, targets, weights,
+                               extras, allow_circular);
+        return;
+    }
+    inputs.resize(length, is);
+    targets.resize(length, ts);
+    weights.resize(length);
+    if (extras)
+        extras->resize(length, es);
+    if (length == 0)
+        return;
+    if (ws == 0)
+        weights.fill(1);
+    if (ts == 0 && ws == 0 && es == 0 && is == width_ && inputs.isCompact()) {
+        // The whole block is contiguous in both the file and 'inputs'.
+        copyFromMappedFile(i_start, 0, inputs.data(), length * width_);
+        return;
+    }
+    for (int k = 0; k < length; k++) {
+        int i = i_start + k;
+        if (is > 0)
+            copyFromMappedFile(i, 0, inputs[k], is);
+        if (ts > 0)
+            copyFromMappedFile(i, is, targets[k], ts);
+        if (ws > 0)
+            copyFromMappedFile(i, is + ts, weights.data() + k, 1);
+        if (es > 0)
+            copyFromMappedFile(i, is + ts + ws, (*extras)[k], es);
+    }
+}
+
+///////////
+// toMat //
+///////////
+Mat FileVMatrix::toMat() const
+{
+    if (!mapped_file)
+        return inherited::toMat();
+    Mat m(length_, width_);
+    if (m.size() > 0)
+        copyFromMappedFile(0, 0, m.data(), m.size());
+    return m;
+}
+
+//! Cursor reading a '.pmat' file through its own file descriptor, or
+//! directly from the memory-mapped file when available.
+class FileVMatRowCursor: public VMatRowCursor
+{
+public:
+    FileVMatRowCursor(const FileVMatrix* the_vm):
+        VMatRowCursor(the_vm),
+        fvm(the_vm),
+        f(0)
+    {
+        if (fvm->mapped_file)
+            return;
+        string fname = fvm->filename_.absolute();
+#ifdef USE_NSPR_FILE
+        f = PR_Open(fname.c_str(), PR_RDONLY, 0666);
+#else
+        f = fopen(fname.c_str(), "rb");
+#endif
+        if (!f)
+            PLERROR("In FileVMatRowCursor - Could not open file '%s'",
+                    fname.c_str());
+    }
+
+    virtual ~FileVMatRowCursor()
+    {
+        if (f)
+#ifdef USE_NSPR_FILE
+            PR_Close(f);
+#else
+            fclose(f);
+#endif
+    }
+
+protected:
+    const FileVMatrix* fvm;
+
+#ifdef USE_NSPR_FILE
+    PRFileDesc* f;
+#else
+    FILE* f;
+#endif
+
+    virtual void getNewRows(int i_start, Mat& m)
+    {
+        int n = m.length();
+        if (fvm->mapped_file) {
+            for (int k = 0; k < n; k++)
+                fvm->copyFromMappedFile(i_start + k, 0, m[k], width_);
+            return;
+        }
+        int64_t elemsize = fvm->file_is_float ? sizeof(float) : sizeof(double);
+        int64_t offset = DATAFILE_HEADERLENGTH
+            + int64_t(i_start) * width_ * elemsize;
+        bool bigendian = fvm->file_is_bigendian;
+        // Consecutive rows are contiguous in the file: read them at once
+        // when they are also contiguous in 'm'.
+        bool compact = m.isCompact();
+        int nreads = compact ? 1 : n;
+        int nelems = compact ? n * width_ : width_;
+#ifdef USE_NSPR_FILE
+        PR_Seek64(f, offset, PR_SEEK_SET);
+        for (int k = 0; k < nreads; k++)
+            if (fvm->file_is_float)
+                PR_Read_float(f, m[k], nelems, bigendian);
+            else
+                PR_Read_double(f, m[k], nelems, bigendian);
+#else
+        fseek(f, offset, SEEK_SET);
+        for (int k = 0; k < nreads; k++)
+            if (fvm->file_is_float)
+                fread_float(f, m[k], nelems, bigendian);
+            else
+                fread_double(f, m[k], nelems, bigendian);
+#endif
+    }
+};
+
+//////////////////
+// newRowCursor //
+//////////////////
+PP<VMatRowCursor> FileVMatrix::newRowCursor() const
+{
+    return new FileVMatRowCursor(this);
+}
+
 ///////////////
 // putSubRow //
 ///////////////
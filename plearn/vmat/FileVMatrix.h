@@ -45,6 +45,7 @@
 #define FileVMatrix_INC
 
 #include "RowBufferedVMatrix.h"
+#include <plearn/sys/MemoryMap.h>
 #include <nspr/prlong.h>
 // While under development, we use this define to control
 // whether to use the NSPR 64 bit file access or the old std C FILE*
@@ -58,6 +59,7 @@ using namespace std;
 //! same as for Mat).
 class FileVMatrix: public RowBufferedVMatrix
 {
+    friend class FileVMatRowCursor;
 
 private:
 
@@ -76,6 +78,19 @@ protected:
     bool file_is_float;
     bool force_float;
 
+    //! Start of the memory-mapped '.pmat' file (0 when not mapped).
+    char* mapped_file;
+
+    //! Size (in bytes) of the memory-mapped file.
+    off_t mapped_size;
+
+    //! Handle of the memory-mapped file.
+    tFileHandle mapped_handle;
+
+    //! True when the mapped data has the same endianness and element type
+    //! as 'real', so that it can be copied without any conversion.
+    bool mapped_native;
+
 private:
 
     bool build_new_file;
@@ -98,14 +113,60 @@ protected:
     //! Close the current '.pmat' file.
     virtual void closeCurrentFile();
 
+    //! Memory-map the (already opened) '.pmat' file.
+    void mapFile();
+
+    //! Release the memory mapping, if any.
+    void unmapFile();
+
+    //! Pointer to element (i,j) in the memory-mapped file.
+    inline char* mappedElement(int i, int j = 0) const
+    {
+        int64_t elemsize = file_is_float ? sizeof(float) : sizeof(double);
+        return mapped_file + DATAFILE_HEADERLENGTH
+            + (int64_t(i) * width_ + j) * elemsize;
+    }
+
+    //! Copy 'n' elements starting at (i,j) from the memory-mapped file into
+    //! 'dest', converting and byte-swapping them when needed.
+    void copyFromMappedFile(int i, int j, real* dest, int n) const;
+
 public:
 
+    //! If true, the file is memory-mapped in read-only mode instead of
+    //! being accessed through seek and read calls.
+    bool memory_map;
+
      int remove_when_done; //!< Deprecated!
      int track_ref;        //!< Deprecated!
 
     //! Re-write the header with all current field values.
     virtual void updateHeader();
 
+    //! When the file is memory-mapped, these methods bypass the row buffer
+    //! and read directly from the mapped pages.
+    virtual real get(int i, int j) const;
+    virtual void getRow(int i, Vec v) const;
+    virtual void getSubRow(int i, int j, Vec v) const;
+    virtual void getMat(int i, int j, Mat m) const;
+
+    //! When the file is memory-mapped, the examples are copied straight from
+    //! the mapped pages into 'inputs', 'targets', 'weights' and 'extra'
+    //! (which are resized), without going through getRow().
+    virtual void getExamples(int i_start, int length, Mat& inputs, Mat& targets,
+                             Vec& weights, Mat* extra = NULL,
+                             bool allow_circular = false);
+
+    //! Same as getExamples: copies the whole mapped matrix at once.
+    virtual Mat toMat() const;
+
+    //! Return a cursor with its own file descriptor (or reading directly
+    //! from the mapped pages when the file is memory-mapped).
+    virtual PP<VMatRowCursor> newRowCursor() const;
+
+    //! Return true iff the file is currently memory-mapped.
+    bool isMemoryMapped() const { return mapped_file != 0; }
+
     virtual void put(int i, int j, real value);
     virtual void putSubRow(int i, int j, Vec v);
     virtual void appendRow(Vec v);
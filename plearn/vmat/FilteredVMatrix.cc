@@ -41,7 +41,13 @@
 /*! \file FilteredVMatrix.cc */
 
 #include "FilteredVMatrix.h"
+#include "DiskVMatrix.h"
+#include "VMatRowCursor.h"
 #include <plearn/base/ProgressBar.h>
+#include <plearn/io/fileutils.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace PLearn {
 using namespace std;
@@ -64,7 +70,8 @@ FilteredVMatrix::FilteredVMatrix():
     repeat_id_field_name(""),
     repeat_count_field_name(""),
     warn_no_metadatadir(false),
-    report_progress(true)
+    report_progress(true),
+    n_threads(-1)
 {}
 
 FilteredVMatrix::FilteredVMatrix( VMat the_source, const string& program_string,
@@ -78,7 +85,8 @@ FilteredVMatrix::FilteredVMatrix( VMat the_source, const string& program_string,
     repeat_id_field_name(repeat_id_field_name_),
     repeat_count_field_name(repeat_count_field_name_),
     report_progress(the_report_progress),
-    prg(program_string)
+    prg(program_string),
+    n_threads(-1)
 {
     // Note that although VMatrix::build_ would be tempted to call
     // setMetaDataDir when inherited(the_source, true) is called above (if
@@ -90,32 +98,268 @@ FilteredVMatrix::FilteredVMatrix( VMat the_source, const string& program_string,
         build_();
 }
 
+namespace {
+
+//! Number of source rows read and evaluated at once.
+const int FILTER_BLOCK_LENGTH = 4096;
+
+//! Parameters of the 64-bit FNV-1a hash used to check the indexed rows.
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+//! Number of times a row is selected, given the result of the program.
+inline int selectionCount(real result, bool allow_repeat_rows)
+{
+    if (!allow_repeat_rows)
+        return fast_exact_is_equal(result, 0) ? 0 : 1;
+    return max(0, int(round(result)));
+}
+
+//! Append to 'indices' the source rows selected according to 'counts',
+//! counts[0] being the count of source row 'first_row'.
+void appendSelectedRows(TVec<int>& indices, const TVec<int>& counts,
+                        int first_row)
+{
+    for (int i = 0; i < counts.length(); i++)
+        for (int x = counts[i]; x > 0; --x)
+            indices.append(first_row + i);
+}
+
+//! Append the run-length encoding of 'counts' to 'rle', as pairs
+//! (count, number of consecutive rows with this count).
+void appendRunLengths(IntVecFile& rle, const TVec<int>& counts)
+{
+    TVec<int> runs;
+    int i = 0;
+    while (i < counts.length())
+    {
+        int n = 1;
+        while (i + n < counts.length() && counts[i + n] == counts[i])
+            n++;
+        runs.append(counts[i]);
+        runs.append(n);
+        i += n;
+    }
+    if (!runs.isEmpty())
+        rle.append(runs);
+}
+
+} // end of anonymous namespace
+
+////////////////////
+// evaluateFilter //
+////////////////////
+void FilteredVMatrix::evaluateFilter(int first_row, TVec<int>& counts)
+{
+    int l = source.length();
+    int n_rows = max(0, l - first_row);
+    counts.resize(n_rows);
+    if (n_rows == 0)
+        return;
+    PP<ProgressBar> pb;
+    if (report_progress)
+        pb = new ProgressBar("Filtering source vmat", n_rows);
+
+    // Each thread gets at least one block of rows. Programs using the VPL
+    // memory depend on the order in which rows are processed.
+    int nt = 1;
+#ifdef _OPENMP
+    if (n_threads < 0)
+        nt = omp_in_parallel() ? 1 : omp_get_max_threads();
+    else
+        nt = n_threads;
+#endif
+    nt = max(1, min(nt, n_rows / FILTER_BLOCK_LENGTH));
+    if (program.usesMemory())
+        nt = 1;
+
+    // Each thread reads rows through its own cursor and runs its own copy of
+    // the program, all created here since reference counting is not
+    // thread-safe.
+    TVec< PP<VMatRowCursor> > cursors;
+    TVec< PP<VMatLanguage> > programs;
+    if (nt > 1) {
+        try {
+            cursors.resize(nt);
+            programs.resize(nt);
+            vector<string> fieldnames;
+            for (int t = 0; t < nt; t++) {
+                cursors[t] = source->newRowCursor();
+                programs[t] = new VMatLanguage(source);
+                programs[t]->compileString(prg, fieldnames);
+            }
+        } catch (const PLearnError&) {
+            // Some VMatrices cannot be deep-copied to obtain a cursor: fall
+            // back to a single thread.
+            cursors.resize(0);
+            programs.resize(0);
+            nt = 1;
+        }
+    }
+
+    if (nt == 1) {
+        Mat result(min(n_rows, FILTER_BLOCK_LENGTH), 1);
+        for (int i = first_row; i < l; i += FILTER_BLOCK_LENGTH) {
+            int n = min(FILTER_BLOCK_LENGTH, l - i);
+            result.resize(n, 1);
+            program.runBatch(i, result);
+            for (int k = 0; k < n; k++)
+                counts[i - first_row + k] =
+                    selectionCount(result(k, 0), allow_repeat_rows);
+            if (pb)
+                pb->update(i + n - first_row);
+        }
+        return;
+    }
+
+    TVec<Mat> blocks(nt);
+    TVec<Mat> results(nt);
+    for (int t = 0; t < nt; t++) {
+        blocks[t].resize(FILTER_BLOCK_LENGTH, source.width());
+        results[t].resize(FILTER_BLOCK_LENGTH, 1);
+    }
+    int* counts_data = counts.data();
+    bool repeat = allow_repeat_rows;
+    bool failed = false;
+    string error_message;
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nt) schedule(static, 1)
+#endif
+    for (int t = 0; t < nt; t++) {
+        int start = first_row + int((int64_t)n_rows * t / nt);
+        int end = first_row + int((int64_t)n_rows * (t + 1) / nt);
+        Mat& block = blocks[t];
+        Mat& result = results[t];
+        try {
+            for (int i = start; i < end; i += FILTER_BLOCK_LENGTH) {
+                int n = min(FILTER_BLOCK_LENGTH, end - i);
+                cursors[t]->getRows(i, n, block);
+                result.resize(n, 1);
+                programs[t]->runBatch(block, result, i);
+                for (int k = 0; k < n; k++)
+                    counts_data[i - first_row + k] =
+                        selectionCount(result(k, 0), repeat);
+                // The progress bar is only displayed by the first thread.
+                if (t == 0 && pb)
+                    pb->update(int((int64_t)(i + n - start) * nt));
+            }
+        } catch (const PLearnError& e) {
+            // Errors cannot be propagated out of the parallel loop.
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+            {
+                if (!failed) {
+                    failed = true;
+                    error_message = e.message();
+                }
+            }
+        }
+    }
+    if (failed)
+        PLERROR("In FilteredVMatrix::evaluateFilter - %s",
+                error_message.c_str());
+    if (pb)
+        pb->update(n_rows);
+}
+
 ////////////////////////////
 // computeFilteredIndices //
 ////////////////////////////
 void FilteredVMatrix::computeFilteredIndices()
 {
-    int l = source.length();
-    Vec result(1);
-    PP<ProgressBar> pb;
-    if (report_progress)
-        pb = new ProgressBar("Filtering source vmat", l);
+    TVec<int> counts;
+    evaluateFilter(0, counts);
     mem_indices.resize(0);
-    for(int i=0; i<l; i++)
-    {
-        if (report_progress)
-            pb->update(i);
-        program.run(i,result);
-        if(!allow_repeat_rows)
-        {
-            if(!fast_exact_is_equal(result[0], 0))
-                mem_indices.append(i);
+    appendSelectedRows(mem_indices, counts, 0);
+    length_ = mem_indices.length();
+}
+
+///////////////////////
+// filterDescription //
+///////////////////////
+string FilteredVMatrix::filterDescription() const
+{
+    string description = prg + "\n";
+    description += allow_repeat_rows ? "allow_repeat_rows\n" : "filter\n";
+    DiskVMatrix* disk_source = dynamic_cast<DiskVMatrix*>((VMatrix*) source);
+    if (disk_source)
+        description += disk_source->dirname.absolute() + "\n";
+    return description;
+}
+
+////////////////////////
+// indexCanBeExtended //
+////////////////////////
+bool FilteredVMatrix::indexCanBeExtended() const
+{
+    return dynamic_cast<DiskVMatrix*>((VMatrix*) source)
+        && !program.usesMemory();
+}
+
+////////////////////
+// sourceChecksum //
+////////////////////
+uint64_t FilteredVMatrix::sourceChecksum(uint64_t checksum,
+                                         int start, int end) const
+{
+    Mat block;
+    for (int i = start; i < end; i += FILTER_BLOCK_LENGTH) {
+        block.resize(min(FILTER_BLOCK_LENGTH, end - i), source.width());
+        source->getMat(i, 0, block);
+        for (int k = 0; k < block.length(); k++) {
+            const unsigned char* bytes = (const unsigned char*) block[k];
+            const size_t n_bytes = block.width() * sizeof(real);
+            for (size_t b = 0; b < n_bytes; b++) {
+                checksum ^= bytes[b];
+                checksum *= FNV_PRIME;
+            }
         }
-        else
-            for(int x = int(round(result[0])); x > 0; --x)
-                mem_indices.append(i);
     }
-    length_ = mem_indices.length();
+    return checksum;
+}
+
+///////////////////////
+// reusableIndexRows //
+///////////////////////
+int FilteredVMatrix::reusableIndexRows(const PPath& idxfname,
+                                       const PPath& rlefname,
+                                       const PPath& prgfname,
+                                       const PPath& sumfname,
+                                       uint64_t& checksum) const
+{
+    if (!indexCanBeExtended())
+        return -1;
+    if (!isfile(idxfname) || !isfile(rlefname) || !isfile(prgfname)
+        || !isfile(sumfname))
+        return -1;
+    if (loadFileAsString(prgfname) != filterDescription())
+        return -1;
+
+    TVec<int> runs = IntVecFile(rlefname.absolute()).getVec();
+    if (runs.length() % 2 != 0)
+        return -1;
+    int64_t n_rows = 0;
+    int64_t n_selected = 0;
+    for (int k = 0; k < runs.length(); k += 2) {
+        n_selected += (int64_t)runs[k] * runs[k + 1];
+        n_rows += runs[k + 1];
+    }
+    if (n_rows > source.length()
+        || n_selected != IntVecFile(idxfname.absolute()).length())
+        return -1;
+
+    // The source may have been modified or rewritten rather than appended
+    // to: the indexed rows must be unchanged.
+    uint64_t saved_checksum;
+    istringstream saved(loadFileAsString(sumfname));
+    if (!(saved >> hex >> saved_checksum))
+        return -1;
+    checksum = sourceChecksum(FNV_OFFSET_BASIS, 0, int(n_rows));
+    if (checksum != saved_checksum)
+        return -1;
+    return int(n_rows);
 }
 
 ///////////////
@@ -126,6 +370,9 @@ void FilteredVMatrix::openIndex()
     PLASSERT(hasMetaDataDir());
 
     PPath idxfname = getMetaDataDir() / "filtered.idx";
+    PPath rlefname = getMetaDataDir() / "filtered.rle";
+    PPath prgfname = getMetaDataDir() / "filtered.prg";
+    PPath sumfname = getMetaDataDir() / "filtered.sum";
     if(!force_mkdir(getMetaDataDir()))
         PLERROR("In FilteredVMatrix::openIndex - Could not create "
                 "directory %s", getMetaDataDir().absolute().c_str());
@@ -134,16 +381,45 @@ void FilteredVMatrix::openIndex()
     try{
         if(isUpToDate(idxfname))
             indexes.open(idxfname.absolute());
-        else  // let's (re)create the index
+        else
         {
-            computeFilteredIndices();
-            rm(idxfname);       // force remove it
+            // Only evaluate the rows appended to the source since the index
+            // was written, if possible. Otherwise let's (re)create the index.
+            uint64_t checksum = FNV_OFFSET_BASIS;
+            int first_row = reusableIndexRows(idxfname, rlefname, prgfname,
+                                              sumfname, checksum);
+            if (first_row < 0)
+            {
+                first_row = 0;
+                checksum = FNV_OFFSET_BASIS;
+                rm(idxfname);       // force remove it
+                rm(rlefname);
+                saveStringInFile(prgfname, filterDescription());
+            }
+            rm(sumfname);
+            TVec<int> counts;
+            evaluateFilter(first_row, counts);
+            mem_indices.resize(0);
+            appendSelectedRows(mem_indices, counts, first_row);
+
+            IntVecFile rle(rlefname.absolute(), true);
+            appendRunLengths(rle, counts);
+            rle.close();
             indexes.open(idxfname.absolute(), true);
-            for (int i = 0; i < mem_indices.length(); i++)
-                indexes.append(mem_indices[i]);
+            if (!mem_indices.isEmpty())
+                indexes.append(mem_indices);
             indexes.close();
             indexes.open(idxfname.absolute());
             mem_indices = TVec<int>();  // Free memory.
+            // Saved last, so that an interrupted update cannot be mistaken
+            // for a valid index.
+            if (indexCanBeExtended())
+            {
+                checksum = sourceChecksum(checksum, first_row, source.length());
+                ostringstream sum;
+                sum << hex << checksum << endl;
+                saveStringInFile(sumfname, sum.str());
+            }
         }
     }catch(const PLearnError& e){
         unlockMetaDataDir();
@@ -227,6 +503,13 @@ void FilteredVMatrix::declareOptions(OptionList& ol)
     declareOption(ol, "report_progress", &FilteredVMatrix::report_progress, OptionBase::buildoption,
                   "Whether to report the filtering progress or not.");
 
+    declareOption(ol, "n_threads", &FilteredVMatrix::n_threads,
+                  OptionBase::buildoption | OptionBase::nosave,
+                  "Number of threads used to evaluate the program on the source rows\n"
+                  "(-1 means the default number of OpenMP threads). The program is\n"
+                  "always evaluated by a single thread when it uses 'memput' or\n"
+                  "'memget', or when the source rows cannot be read concurrently.");
+
     declareOption(ol, "allow_repeat_rows", &FilteredVMatrix::allow_repeat_rows, OptionBase::buildoption,
                   "When true, the result of the program indicates the number of times this row should be repeated.\n"
                   "Simple filtering when false.");
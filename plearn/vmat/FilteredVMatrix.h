@@ -78,11 +78,44 @@ protected:
     bool warn_no_metadatadir;
     //! Generates the index file if it does not already exist.
     //! If it exists and is up to date, simply opens it.
+    //! Along with the index file "filtered.idx", the metadata directory holds
+    //! "filtered.rle", the run-length encoding of the number of times each
+    //! source row is selected (as pairs (count, number of rows)), and
+    //! "filtered.sum", a checksum of the indexed source rows. When the source
+    //! is a DiskVMatrix whose indexed rows are unchanged (i.e. it has only
+    //! been appended to), they are used to evaluate the program on the new
+    //! rows only.
     void openIndex();
 
     //! Compute the filtered indices.
     void computeFilteredIndices();
 
+    //! Evaluate the program on source rows first_row to source.length()-1,
+    //! filling 'counts' with the number of times each of them is selected.
+    //! The rows are split across 'n_threads' threads when the program does
+    //! not use the VPL memory.
+    void evaluateFilter(int first_row, TVec<int>& counts);
+
+    //! Whether the index files may be extended when rows are appended to
+    //! the source, i.e. the source is a DiskVMatrix and the program does not
+    //! use the VPL memory (whose state is not saved).
+    bool indexCanBeExtended() const;
+
+    //! Return the number of source rows for which the index files in the
+    //! metadata directory can be reused, or -1 if they must be rebuilt.
+    //! The checksum of these rows, which must match the one saved in
+    //! 'sumfname', is stored in 'checksum'.
+    int reusableIndexRows(const PPath& idxfname, const PPath& rlefname,
+                          const PPath& prgfname, const PPath& sumfname,
+                          uint64_t& checksum) const;
+
+    //! Update the checksum 'checksum' with the source rows 'start' to
+    //! 'end' - 1 (a 64-bit FNV-1a hash of their binary representation).
+    uint64_t sourceChecksum(uint64_t checksum, int start, int end) const;
+
+    //! Description of the filtering stored along with the index files.
+    string filterDescription() const;
+
 public:
 
     // ************************
@@ -91,6 +124,7 @@ public:
 
     bool report_progress;
     string prg;  // program string in VPL language
+    int n_threads;
 
     // ****************
     // * Constructors *
@@ -87,6 +87,12 @@ void KNNVMatrix::declareOptions(OptionList& ol)
     declareOption(ol, "report_progress", &KNNVMatrix::report_progress, OptionBase::buildoption,
                   "TODO comment");
 
+    declareOption(ol, "neighbors_finder", &KNNVMatrix::neighbors_finder, OptionBase::buildoption,
+                  "Optional learner used to find the nearest neighbours (e.g. an\n"
+                  "HNSWNearestNeighbors for an approximate search on large data).  If\n"
+                  "not provided, the exact neighbours are deduced from the full matrix\n"
+                  "of pairwise euclidean distances.");
+
 // Kinda useless to declare it as an option if we recompute it in build().
 // TODO See how to be more efficient.
 //  declareOption(ol, "nn", &KNNVMatrix::nn, OptionBase::learntoption,
@@ -214,21 +220,36 @@ void KNNVMatrix::build_() {
                     PLERROR("In KNNVMatrix::build_ - The given k_nn_mat already has data, free it first");
                 }
             }
-            // Compute the pairwise distances.
-            DistanceKernel dk(2);
-            if (report_progress) {
-                dk.report_progress = true;
-                dk.build();
+            if (neighbors_finder) {
+                // Same input part as the one used by the DistanceKernel below.
+                int is = source->inputsize() >= 0 ? source->inputsize()
+                                                  : source->width();
+                VMat points = new SubVMatrix(source, 0, 0, n, is);
+                points->defineSizes(is, 0, 0);
+                TMat<int> neighbors;
+                neighbors_finder->computeTrainingNeighborhoods(
+                    points, knn, neighbors, report_progress);
+                nn.resize(n, knn);
+                for (int i = 0; i < n; i++)
+                    for (int j = 0; j < knn; j++)
+                        nn(i,j) = neighbors(i,j);
+            } else {
+                // Compute the pairwise distances.
+                DistanceKernel dk(2);
+                if (report_progress) {
+                    dk.report_progress = true;
+                    dk.build();
+                }
+                dk.setDataForKernelMatrix(source);
+                Mat distances(n,n);
+                dk.computeGramMatrix(distances);
+                // Deduce the nearest neighbours.
+                nn = dk.computeNeighbourMatrixFromDistanceMatrix(distances);
+                // Only keep the (knn) nearest ones.
+                // TODO Free the memory used by the other neighbours.
+                // TODO Make the matrix be a TMat<int> instead of a Mat.
+                nn.resize(n, knn);
             }
-            dk.setDataForKernelMatrix(source);
-            Mat distances(n,n);
-            dk.computeGramMatrix(distances);
-            // Deduce the nearest neighbours.
-            nn = dk.computeNeighbourMatrixFromDistanceMatrix(distances);
-            // Only keep the (knn) nearest ones.
-            // TODO Free the memory used by the other neighbours.
-            // TODO Make the matrix be a TMat<int> instead of a Mat.
-            nn.resize(n, knn);
             // Store the result.
             if (k_nn_mat) {
                 for (int i = 0; i < n; i++) {
@@ -287,6 +308,7 @@ void KNNVMatrix::makeDeepCopyFromShallowCopy(CopiesMap& copies)
     // TODO Put back when other VMats are fine.
 //  deepCopyField(k_nn_mat, copies);
     deepCopyField(kernel_pij, copies);
+    deepCopyField(neighbors_finder, copies);
 
     PLWARNING("In KNNVMatrix::makeDeepCopyFromShallowCopy - k_nn_mat will not be deep copied");
     //  PLERROR("KNNVMatrix::makeDeepCopyFromShallowCopy not fully (correctly) implemented yet!");
@@ -45,6 +45,7 @@
 #define KNNVMatrix_INC
 
 #include <plearn/ker/Kernel.h>
+#include <plearn_learners/nearest_neighbors/GenericNearestNeighbors.h>
 #include "SourceVMatrix.h"
 
 namespace PLearn {
@@ -83,6 +84,7 @@ public:
     Ker kernel_pij;
     int knn;
     bool report_progress;
+    PP<GenericNearestNeighbors> neighbors_finder;
 
     // ****************
     // * Constructors *
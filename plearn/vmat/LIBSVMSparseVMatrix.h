@@ -102,9 +102,9 @@ public:
 
     virtual void getExample(int i, Vec& input, Vec& target, real& weight);
 
-    void getExamples(int i_start, int length, Mat& inputs, Mat& targets,
-                     Vec& weights, Mat* extra = NULL,
-                     bool allow_circular = false);
+    virtual void getExamples(int i_start, int length, Mat& inputs, Mat& targets,
+                             Vec& weights, Mat* extra = NULL,
+                             bool allow_circular = false);
 
     virtual void getExtra(int i, Vec& extra);
 
@@ -162,14 +162,16 @@ void LocalNeighborsDifferencesVMatrix::build_()
         }
 
         length_ = source->length();
-        neighbors.resize(source->length(),n_neighbors);
         a_row.resize(source->width());
+        // All the rows are searched at once (see the batch version of
+        // computeNearestNeighbors).
+        Mat data = source->toMat();
+        Mat sq_distances;
+        computeNearestNeighbors(data, data, n_neighbors, neighbors,
+                                sq_distances, true);
         for (int i=0;i<source->length();i++)
-        {
-            source->getRow(i,a_row);
-            TVec<int> neighbors_of_i = neighbors(i);
-            computeNearestNeighbors(source,a_row,neighbors_of_i,i);
-        }
+            if (sq_distances(i,n_neighbors-1)==0)
+                PLERROR("All neighbors had 0 distance. Use more neighbors. (Row %d)",i);
     }
 
     updateMtime(source);
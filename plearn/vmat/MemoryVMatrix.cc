@@ -39,6 +39,7 @@
  ******************************************************* */
 
 #include "MemoryVMatrix.h"
+#include "VMatRowCursor.h"
 
 namespace PLearn {
 using namespace std;
@@ -240,6 +241,38 @@ void MemoryVMatrix::getRow(int i, Vec v) const
 void MemoryVMatrix::getMat(int i, int j, Mat m) const
 { m << memory_data.subMat(i,j,m.length(),m.width()); }
 
+//! Cursor copying rows directly from the memory of a MemoryVMatrix.
+class MemoryVMatRowCursor: public VMatRowCursor
+{
+public:
+    MemoryVMatRowCursor(const VMatrix* the_vm, const Mat& the_data):
+        VMatRowCursor(the_vm),
+        data(the_data.isEmpty() ? 0 : the_data.data()),
+        mod(the_data.mod())
+    {}
+
+protected:
+    //! Plain pointer, not to touch the reference count of the storage.
+    const real* data;
+    int mod;
+
+    virtual void getNewRows(int i_start, Mat& m)
+    {
+        for (int k = 0; k < m.length(); k++) {
+            const real* row = data + (i_start + k) * (int64_t) mod;
+            copy(row, row + width_, m[k]);
+        }
+    }
+};
+
+//////////////////
+// newRowCursor //
+//////////////////
+PP<VMatRowCursor> MemoryVMatrix::newRowCursor() const
+{
+    return new MemoryVMatRowCursor(this, memory_data);
+}
+
 ///////////////
 // putSubRow //
 ///////////////
@@ -96,6 +96,7 @@ public:
     virtual void getRow(int i, Vec v) const;
     virtual void getColumn(int i, Vec v) const;
     virtual void getMat(int i, int j, Mat m) const;
+    virtual PP<VMatRowCursor> newRowCursor() const;
     virtual void put(int i, int j, real value);
     virtual void putSubRow(int i, int j, Vec v);
     virtual void putRow(int i, Vec v);
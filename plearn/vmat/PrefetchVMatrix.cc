@@ -0,0 +1,537 @@
+// -*- C++ -*-
+
+// PrefetchVMatrix.cc
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file PrefetchVMatrix.cc */
+
+
+#include "PrefetchVMatrix.h"
+#include "VMatRowCursor.h"
+#include <plearn/base/RemoteDeclareMethod.h>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+namespace PLearn {
+using namespace std;
+
+PLEARN_IMPLEMENT_OBJECT(
+    PrefetchVMatrix,
+    "Prefetches rows of its source in a background thread.",
+    "Rows are read ahead by blocks of 'block_size' consecutive rows (of this\n"
+    "VMatrix), and at most 'queue_size' blocks are kept ready. The expected\n"
+    "access order is sequential, wrapping around at the end, which is the\n"
+    "way learners iterate on their training set (unless 'wrap_around' is\n"
+    "false, e.g. for a single pass on a test set); a shuffled order can be\n"
+    "obtained with the 'indices' option. Accessing a row that has not been\n"
+    "prefetched restarts the prefetching from that row.\n"
+    "\n"
+    "To overlap the computation of a training set with training, give the\n"
+    "learner a PrefetchVMatrix(source = <training set>) as its training set\n"
+    "(e.g. in the 'dataset' of a PTester). Test sets are prefetched by the\n"
+    "learner itself when its 'prefetch_test_rows' option is set.\n"
+    "\n"
+    "The statistics options n_hits, n_waits, n_misses, stall_time and\n"
+    "mean_queue_depth can be used to size the queue: many waits and a long\n"
+    "stall time mean the source cannot keep up with the consumer, while a\n"
+    "mean queue depth close to 'queue_size' means the queue could be made\n"
+    "smaller.\n"
+);
+
+//////////////////
+// Prefetcher //
+//////////////////
+
+//! State of the blocks in the ring.
+enum { BLOCK_FREE, BLOCK_FILLING, BLOCK_READY, BLOCK_IN_USE };
+
+struct PrefetchVMatrix::Prefetcher
+{
+    boost::mutex mx;
+
+    //! Notified whenever the state of a block changes, or 'stop' is set.
+    boost::condition_variable cond;
+
+    //! The ring of blocks, with their state, first row, number of rows and
+    //! the sequence number of the block in the prefetching order.
+    TVec<Mat> blocks;
+    TVec<int> state;
+    TVec<int> start;
+    TVec<int> length;
+    TVec<int> seq;
+
+    //! Next row to be prefetched (n_rows when the end was reached and the
+    //! prefetching does not wrap around).
+    int next_row;
+
+    //! Incremented when prefetching is restarted, so that a block being
+    //! filled when this happens gets discarded.
+    int generation;
+
+    //! Sequence number of the next block to be prefetched.
+    int next_seq;
+
+    bool stop;
+
+    //! Error message of an exception raised in the background thread.
+    string error;
+
+    //! The cursor the source is read through, only used by the background
+    //! thread (but created and destroyed by the main thread).
+    PP<VMatRowCursor> cursor;
+
+    //! Plain pointer to the 'indices' option (null if not used).
+    const int* indices;
+    int n_rows;
+    int block_size;
+    bool wrap_around;
+
+    boost::thread* thread;
+
+    //! Main loop of the background thread.
+    void run();
+
+    //! Read 'len' rows starting at row 'first' into 'm'.
+    void readRows(int first, int len, Mat& m);
+};
+
+//! Function object for the background thread.
+struct PrefetchVMatrixThread
+{
+    PrefetchVMatrix::Prefetcher* prefetcher;
+
+    PrefetchVMatrixThread(PrefetchVMatrix::Prefetcher* prefetcher_)
+        : prefetcher(prefetcher_)
+    {}
+
+    void operator()()
+    {
+        prefetcher->run();
+    }
+};
+
+void PrefetchVMatrix::Prefetcher::run()
+{
+    Mat m;
+    for (;;) {
+        int slot = -1;
+        int first, len, gen;
+        {
+            boost::mutex::scoped_lock lock(mx);
+            for (;;) {
+                if (stop)
+                    return;
+                if (next_row < n_rows) {
+                    slot = state.find(BLOCK_FREE);
+                    if (slot >= 0)
+                        break;
+                }
+                cond.wait(lock);
+            }
+            first = next_row;
+            len = min(block_size, n_rows - first);
+            next_row = first + len;
+            if (wrap_around)
+                next_row %= n_rows;
+            gen = generation;
+            state[slot] = BLOCK_FILLING;
+            start[slot] = first;
+            length[slot] = len;
+        }
+
+        try {
+            m = blocks[slot].subMatRows(0, len);
+            readRows(first, len, m);
+        } catch (const PLearnError& e) {
+            boost::mutex::scoped_lock lock(mx);
+            error = e.message();
+            stop = true;
+            cond.notify_all();
+            return;
+        }
+
+        boost::mutex::scoped_lock lock(mx);
+        if (gen == generation) {
+            state[slot] = BLOCK_READY;
+            seq[slot] = next_seq++;
+        } else
+            state[slot] = BLOCK_FREE;
+        cond.notify_all();
+    }
+}
+
+void PrefetchVMatrix::Prefetcher::readRows(int first, int len, Mat& m)
+{
+    if (!indices) {
+        cursor->getRows(first, len, m);
+        return;
+    }
+    // Rows that are consecutive in the source are read in one call.
+    Mat rows;
+    int k = 0;
+    while (k < len) {
+        int row = indices[first + k];
+        int n = 1;
+        while (k + n < len && indices[first + k + n] == row + n)
+            n++;
+        rows = m.subMatRows(k, n);
+        cursor->getRows(row, n, rows);
+        k += n;
+    }
+}
+
+/////////////////////
+// PrefetchVMatrix //
+/////////////////////
+PrefetchVMatrix::PrefetchVMatrix():
+    block_size(256),
+    queue_size(4),
+    wrap_around(true),
+    n_hits(0),
+    n_waits(0),
+    n_misses(0),
+    stall_time(0),
+    mean_queue_depth(0),
+    prefetcher(0),
+    current_slot(-1),
+    current_start(-1),
+    current_length(0),
+    n_requests(0)
+{}
+
+PrefetchVMatrix::PrefetchVMatrix(VMat the_source, int the_block_size,
+                                 int the_queue_size, bool call_build_):
+    inherited(the_source, call_build_),
+    block_size(the_block_size),
+    queue_size(the_queue_size),
+    wrap_around(true),
+    n_hits(0),
+    n_waits(0),
+    n_misses(0),
+    stall_time(0),
+    mean_queue_depth(0),
+    prefetcher(0),
+    current_slot(-1),
+    current_start(-1),
+    current_length(0),
+    n_requests(0)
+{
+    if (call_build_)
+        build_();
+}
+
+PrefetchVMatrix::~PrefetchVMatrix()
+{
+    stopPrefetching();
+}
+
+////////////////////
+// declareOptions //
+////////////////////
+void PrefetchVMatrix::declareOptions(OptionList& ol)
+{
+    declareOption(ol, "block_size", &PrefetchVMatrix::block_size,
+                  OptionBase::buildoption,
+        "Number of consecutive rows prefetched together.");
+
+    declareOption(ol, "queue_size", &PrefetchVMatrix::queue_size,
+                  OptionBase::buildoption,
+        "Maximum number of blocks prefetched ahead.");
+
+    declareOption(ol, "wrap_around", &PrefetchVMatrix::wrap_around,
+                  OptionBase::buildoption,
+        "Whether the prefetching goes on from the first row once the last\n"
+        "one is reached. If false, it stops at the last row (until a row\n"
+        "that has not been prefetched is accessed).");
+
+    declareOption(ol, "indices", &PrefetchVMatrix::indices,
+                  OptionBase::buildoption,
+        "If not empty, row i of this VMatrix is row indices[i] of the source\n"
+        "(this is typically a shuffled list of all rows of the source).");
+
+    declareOption(ol, "n_hits", &PrefetchVMatrix::n_hits,
+                  OptionBase::learntoption | OptionBase::nosave,
+        "Number of blocks that were ready when requested.");
+
+    declareOption(ol, "n_waits", &PrefetchVMatrix::n_waits,
+                  OptionBase::learntoption | OptionBase::nosave,
+        "Number of blocks that were still being read when requested.");
+
+    declareOption(ol, "n_misses", &PrefetchVMatrix::n_misses,
+                  OptionBase::learntoption | OptionBase::nosave,
+        "Number of blocks that had not been prefetched when requested\n"
+        "(prefetching was then restarted from the requested row).");
+
+    declareOption(ol, "stall_time", &PrefetchVMatrix::stall_time,
+                  OptionBase::learntoption | OptionBase::nosave,
+        "Total time (in seconds) spent waiting for blocks to be read.");
+
+    declareOption(ol, "mean_queue_depth", &PrefetchVMatrix::mean_queue_depth,
+                  OptionBase::learntoption | OptionBase::nosave,
+        "Average number of ready blocks when a new block is requested.");
+
+    inherited::declareOptions(ol);
+}
+
+////////////////////
+// declareMethods //
+////////////////////
+void PrefetchVMatrix::declareMethods(RemoteMethodMap& rmm)
+{
+    rmm.inherited(inherited::_getRemoteMethodMap_());
+
+    declareMethod(
+        rmm, "setIndices", &PrefetchVMatrix::setIndices,
+        (BodyDoc("Change the order in which rows of the source are read."),
+         ArgDoc ("indices", "The new indices (empty for the source order).")));
+
+    declareMethod(
+        rmm, "resetStats", &PrefetchVMatrix::resetStats,
+        (BodyDoc("Reset the prefetching statistics.")));
+}
+
+///////////
+// build //
+///////////
+void PrefetchVMatrix::build()
+{
+    inherited::build();
+    build_();
+}
+
+////////////
+// build_ //
+////////////
+void PrefetchVMatrix::build_()
+{
+    stopPrefetching();
+    if (!source)
+        return;
+    if (block_size <= 0)
+        PLERROR("In PrefetchVMatrix::build_ - 'block_size' must be positive");
+    if (queue_size <= 0)
+        PLERROR("In PrefetchVMatrix::build_ - 'queue_size' must be positive");
+    int n = source->length();
+    for (int i = 0; i < indices.length(); i++)
+        if (indices[i] < 0 || indices[i] >= n)
+            PLERROR("In PrefetchVMatrix::build_ - Index %d is out of the "
+                    "range of source rows [0,%d]", indices[i], n - 1);
+    length_ = indices.isEmpty() ? n : indices.length();
+    width_ = source->width();
+    setMetaInfoFromSource();
+    invalidateBuffer();
+}
+
+////////////////
+// setIndices //
+////////////////
+void PrefetchVMatrix::setIndices(const TVec<int>& the_indices)
+{
+    indices = the_indices.copy();
+    build_();
+}
+
+////////////////
+// resetStats //
+////////////////
+void PrefetchVMatrix::resetStats()
+{
+    n_hits = n_waits = n_misses = 0;
+    stall_time = 0;
+    mean_queue_depth = 0;
+    n_requests = 0;
+}
+
+//////////////////////
+// startPrefetching //
+//////////////////////
+void PrefetchVMatrix::startPrefetching(int start) const
+{
+    PLASSERT( !prefetcher );
+    prefetcher = new Prefetcher();
+    prefetcher->blocks.resize(queue_size);
+    for (int k = 0; k < queue_size; k++)
+        prefetcher->blocks[k].resize(block_size, width_);
+    prefetcher->state.resize(queue_size);
+    prefetcher->state.fill(BLOCK_FREE);
+    prefetcher->start.resize(queue_size);
+    prefetcher->length.resize(queue_size);
+    prefetcher->seq.resize(queue_size);
+    prefetcher->next_row = start;
+    prefetcher->generation = 0;
+    prefetcher->next_seq = 0;
+    prefetcher->stop = false;
+    prefetcher->cursor = source->newRowCursor();
+    prefetcher->indices = indices.isEmpty() ? 0 : indices.data();
+    prefetcher->n_rows = length_;
+    prefetcher->block_size = block_size;
+    prefetcher->wrap_around = wrap_around;
+    prefetcher->thread =
+        new boost::thread(PrefetchVMatrixThread(prefetcher));
+}
+
+/////////////////////
+// stopPrefetching //
+/////////////////////
+void PrefetchVMatrix::stopPrefetching() const
+{
+    current_slot = -1;
+    if (!prefetcher)
+        return;
+    {
+        boost::mutex::scoped_lock lock(prefetcher->mx);
+        prefetcher->stop = true;
+        prefetcher->cond.notify_all();
+    }
+    prefetcher->thread->join();
+    delete prefetcher->thread;
+    delete prefetcher;
+    prefetcher = 0;
+}
+
+//////////////////
+// acquireBlock //
+//////////////////
+void PrefetchVMatrix::acquireBlock(int i) const
+{
+    if (!prefetcher)
+        startPrefetching(i);
+    Prefetcher& p = *prefetcher;
+    boost::mutex::scoped_lock lock(p.mx);
+    if (current_slot >= 0) {
+        p.state[current_slot] = BLOCK_FREE;
+        current_slot = -1;
+        p.cond.notify_all();
+    }
+
+    bool first_try = true;
+    boost::posix_time::ptime wait_start;
+    for (;;) {
+        if (!p.error.empty())
+            PLERROR("In PrefetchVMatrix - Error while prefetching rows: %s",
+                    p.error.c_str());
+        // Look for a ready block containing row i.
+        int found = -1;
+        int n_ready = 0;
+        for (int k = 0; k < queue_size; k++)
+            if (p.state[k] == BLOCK_READY) {
+                n_ready++;
+                if (i >= p.start[k] && i < p.start[k] + p.length[k])
+                    found = k;
+            }
+        if (found >= 0) {
+            // Blocks prefetched before this one were skipped by the
+            // consumer: they will not be used anymore.
+            for (int k = 0; k < queue_size; k++)
+                if (p.state[k] == BLOCK_READY && p.seq[k] < p.seq[found])
+                    p.state[k] = BLOCK_FREE;
+            p.state[found] = BLOCK_IN_USE;
+            p.cond.notify_all();
+            current_slot = found;
+            current_start = p.start[found];
+            current_length = p.length[found];
+            if (first_try) {
+                n_hits++;
+                n_requests++;
+                mean_queue_depth += (n_ready - mean_queue_depth) / n_requests;
+            } else
+                stall_time += (boost::posix_time::microsec_clock::universal_time()
+                               - wait_start).total_microseconds() / 1e6;
+            return;
+        }
+
+        // Is row i being read right now?
+        bool filling = false;
+        for (int k = 0; k < queue_size; k++)
+            if (p.state[k] == BLOCK_FILLING &&
+                i >= p.start[k] && i < p.start[k] + p.length[k])
+                filling = true;
+        if (first_try) {
+            wait_start = boost::posix_time::microsec_clock::universal_time();
+            n_requests++;
+            mean_queue_depth += (n_ready - mean_queue_depth) / n_requests;
+            if (filling)
+                n_waits++;
+            else
+                n_misses++;
+        }
+        if (!filling && (first_try || p.next_row != i)) {
+            // Restart prefetching from row i.
+            for (int k = 0; k < queue_size; k++)
+                if (p.state[k] == BLOCK_READY)
+                    p.state[k] = BLOCK_FREE;
+            p.generation++;
+            p.next_row = i;
+            p.cond.notify_all();
+        }
+        first_try = false;
+        p.cond.wait(lock);
+    }
+}
+
+///////////////
+// getNewRow //
+///////////////
+void PrefetchVMatrix::getNewRow(int i, const Vec& v) const
+{
+    if (current_slot < 0 || i < current_start ||
+        i >= current_start + current_length)
+        acquireBlock(i);
+    v.copyFrom(prefetcher->blocks[current_slot][i - current_start], width_);
+}
+
+/////////////////////////////////
+// makeDeepCopyFromShallowCopy //
+/////////////////////////////////
+void PrefetchVMatrix::makeDeepCopyFromShallowCopy(CopiesMap& copies)
+{
+    inherited::makeDeepCopyFromShallowCopy(copies);
+    deepCopyField(indices, copies);
+    // The copy gets its own background thread when first accessed.
+    prefetcher = 0;
+    current_slot = -1;
+}
+
+} // end of namespace PLearn
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
@@ -0,0 +1,180 @@
+// -*- C++ -*-
+
+// PrefetchVMatrix.h
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file PrefetchVMatrix.h */
+
+
+#ifndef PrefetchVMatrix_INC
+#define PrefetchVMatrix_INC
+
+#include <plearn/vmat/SourceVMatrix.h>
+
+namespace PLearn {
+
+/**
+ * Reads rows of its source ahead of time in a background thread.
+ *
+ * Rows are prefetched by blocks of 'block_size' consecutive rows, into a
+ * ring of 'queue_size' blocks, following the order in which they are
+ * expected to be accessed: sequentially, wrapping around at the end (which
+ * is what learners do with getExample() and getExamples()) unless
+ * 'wrap_around' is false. When 'indices' is provided, row i of this VMatrix
+ * is row indices[i] of the source, which allows to prefetch along a
+ * shuffled order; setIndices() may be used to change this order (e.g. at
+ * each epoch).
+ *
+ * Accessing a row that has not been prefetched restarts the prefetching
+ * from this row, thus random accesses should be avoided. The statistics
+ * options (n_hits, n_waits, n_misses, stall_time, mean_queue_depth) help
+ * tuning 'block_size' and 'queue_size'.
+ *
+ * The source is read through its own cursor (see VMatrix::newRowCursor()),
+ * so that it may safely be read from another thread.
+ */
+class PrefetchVMatrix : public SourceVMatrix
+{
+    typedef SourceVMatrix inherited;
+
+public:
+    //#####  Public Build Options  ############################################
+
+    int block_size;
+    int queue_size;
+    bool wrap_around;
+    TVec<int> indices;
+
+    //#####  Public Learnt Options  ###########################################
+
+    mutable int n_hits;
+    mutable int n_waits;
+    mutable int n_misses;
+    mutable real stall_time;
+    mutable real mean_queue_depth;
+
+public:
+    //#####  Public Member Functions  #########################################
+
+    //! Default constructor.
+    PrefetchVMatrix();
+
+    //! Convenience constructor.
+    PrefetchVMatrix(VMat the_source, int the_block_size = 256,
+                    int the_queue_size = 4, bool call_build_ = true);
+
+    //! Destructor (stops the background thread).
+    virtual ~PrefetchVMatrix();
+
+    //! Change the order in which the rows of the source are accessed (an
+    //! empty vector means the source order). Pending prefetches are lost.
+    void setIndices(const TVec<int>& the_indices);
+
+    //! Reset the statistics options.
+    void resetStats();
+
+    //#####  PLearn::Object Protocol  #########################################
+
+    PLEARN_DECLARE_OBJECT(PrefetchVMatrix);
+
+    //! Simply calls inherited::build() then build_().
+    virtual void build();
+
+    //! Transforms a shallow copy into a deep copy.
+    virtual void makeDeepCopyFromShallowCopy(CopiesMap& copies);
+
+protected:
+    //#####  Protected Member Functions  ######################################
+
+    //! Declares the class options.
+    static void declareOptions(OptionList& ol);
+
+    //! Declares the class methods.
+    static void declareMethods(RemoteMethodMap& rmm);
+
+    //! Fill the vector 'v' with the content of the i-th row.
+    virtual void getNewRow(int i, const Vec& v) const;
+
+private:
+    //#####  Private Member Functions  ########################################
+
+    //! This does the actual building.
+    void build_();
+
+    //! Make the block containing row i the current block, waiting for it to
+    //! be prefetched if needed.
+    void acquireBlock(int i) const;
+
+    //! Start the background thread, prefetching from row 'start'.
+    void startPrefetching(int start) const;
+
+    //! Stop the background thread and release the prefetched blocks.
+    void stopPrefetching() const;
+
+private:
+    //#####  Private Data Members  ############################################
+
+    //! State shared with the background thread (defined in the .cc file).
+    struct Prefetcher;
+    friend struct PrefetchVMatrixThread;
+
+    //! Null as long as no row has been accessed.
+    mutable Prefetcher* prefetcher;
+
+    //! Slot of the ring currently being read (-1 if none), with the first
+    //! row and number of rows of the corresponding block.
+    mutable int current_slot;
+    mutable int current_start;
+    mutable int current_length;
+
+    //! Number of blocks requested so far (to average the queue depth).
+    mutable int n_requests;
+};
+
+DECLARE_OBJECT_PTR(PrefetchVMatrix);
+
+} // end of namespace PLearn
+
+#endif
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
@@ -42,6 +42,7 @@
 
 
 #include "ProcessingVMatrix.h"
+#include "VMatRowCursor.h"
 
 namespace PLearn {
 using namespace std;
@@ -91,6 +92,19 @@ void ProcessingVMatrix::getNewRow(int i, const Vec& v) const
     }
 }
 
+//////////////////
+// newRowCursor //
+//////////////////
+PP<VMatRowCursor> ProcessingVMatrix::newRowCursor() const
+{
+    if(program.usesMemory() || input_prg_.usesMemory()
+       || target_prg_.usesMemory() || weight_prg_.usesMemory()
+       || extra_prg_.usesMemory())
+        PLERROR("In ProcessingVMatrix::newRowCursor - Rows cannot be read "
+                "concurrently when the program uses 'memput' or 'memget'");
+    return inherited::newRowCursor();
+}
+
 void ProcessingVMatrix::declareOptions(OptionList& ol)
 {
     declareOption(ol, "prg", &ProcessingVMatrix::prg, OptionBase::buildoption,
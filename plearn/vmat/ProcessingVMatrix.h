@@ -119,6 +119,11 @@ public:
     //! Transforms a shallow copy into a deep copy
     virtual void makeDeepCopyFromShallowCopy(CopiesMap& copies);
 
+    //! The VPL memory of a cursor would be carried over the rows it reads
+    //! independently of this VMatrix: cursors are thus refused (with a
+    //! PLERROR) when a program uses 'memput' or 'memget'.
+    virtual PP<VMatRowCursor> newRowCursor() const;
+
     //! Declares name and deepCopy methods
     PLEARN_DECLARE_OBJECT(ProcessingVMatrix);
 
@@ -0,0 +1,142 @@
+// -*- C++ -*-
+
+// RowCursorVMatrix.cc
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file RowCursorVMatrix.cc */
+
+
+#include "RowCursorVMatrix.h"
+
+namespace PLearn {
+using namespace std;
+
+PLEARN_IMPLEMENT_OBJECT(
+    RowCursorVMatrix,
+    "VMatrix reading its rows through a cursor on another VMatrix.",
+    "This class is used internally to give each thread its own access path\n"
+    "to a chain of VMatrices (see VMatrix::newRowCursor()); it is not meant\n"
+    "to be built from a script.\n"
+);
+
+//////////////////////
+// RowCursorVMatrix //
+//////////////////////
+RowCursorVMatrix::RowCursorVMatrix()
+{}
+
+RowCursorVMatrix::RowCursorVMatrix(const VMatrix* the_vm):
+    inherited(the_vm->length(), the_vm->width()),
+    cursor(the_vm->newRowCursor())
+{
+    setMetaInfoFrom(the_vm);
+}
+
+RowCursorVMatrix::RowCursorVMatrix(const VMatrix* the_vm,
+                                   PP<VMatRowCursor> the_cursor):
+    inherited(the_vm->length(), the_vm->width()),
+    cursor(the_cursor)
+{
+    setMetaInfoFrom(the_vm);
+}
+
+////////////////////
+// declareOptions //
+////////////////////
+void RowCursorVMatrix::declareOptions(OptionList& ol)
+{
+    inherited::declareOptions(ol);
+}
+
+///////////
+// build //
+///////////
+void RowCursorVMatrix::build()
+{
+    inherited::build();
+    build_();
+}
+
+////////////
+// build_ //
+////////////
+void RowCursorVMatrix::build_()
+{
+    if (!cursor)
+        PLERROR("In RowCursorVMatrix::build_ - This class can only be "
+                "constructed from another VMatrix");
+}
+
+///////////////
+// getNewRow //
+///////////////
+void RowCursorVMatrix::getNewRow(int i, const Vec& v) const
+{
+    Mat m = v.toMat(1, width_);
+    cursor->getRows(i, 1, m);
+}
+
+////////////
+// getMat //
+////////////
+void RowCursorVMatrix::getMat(int i, int j, Mat m) const
+{
+    if (j != 0 || m.width() != width_) {
+        inherited::getMat(i, j, m);
+        return;
+    }
+    cursor->getRows(i, m.length(), m);
+}
+
+/////////////////////////////////
+// makeDeepCopyFromShallowCopy //
+/////////////////////////////////
+void RowCursorVMatrix::makeDeepCopyFromShallowCopy(CopiesMap& copies)
+{
+    PLERROR("In RowCursorVMatrix::makeDeepCopyFromShallowCopy - A "
+            "RowCursorVMatrix cannot be deep-copied");
+}
+
+} // end of namespace PLearn
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
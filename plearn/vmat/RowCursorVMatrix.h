@@ -0,0 +1,124 @@
+// -*- C++ -*-
+
+// RowCursorVMatrix.h
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file RowCursorVMatrix.h */
+
+
+#ifndef RowCursorVMatrix_INC
+#define RowCursorVMatrix_INC
+
+#include <plearn/vmat/RowBufferedVMatrix.h>
+#include <plearn/vmat/VMatRowCursor.h>
+
+namespace PLearn {
+
+/**
+ * A VMatrix whose rows are read through a VMatRowCursor.
+ *
+ * This class is used by SourceVMatrix::newRowCursor(): when deep-copying a
+ * VMatrix to obtain a private copy for a thread, its source is replaced by a
+ * RowCursorVMatrix reading through a cursor on the original source, so that
+ * only the top of the VMatrix chain is actually copied. The meta information
+ * (sizes, field names, string mappings) is copied from the original VMatrix
+ * at construction time.
+ *
+ * It cannot be deep-copied, since it is meant to be used by a single thread.
+ */
+class RowCursorVMatrix : public RowBufferedVMatrix
+{
+    typedef RowBufferedVMatrix inherited;
+
+public:
+    //#####  Public Member Functions  #########################################
+
+    //! Default constructor.
+    RowCursorVMatrix();
+
+    //! Read the rows of 'the_vm' through a new cursor on it.
+    RowCursorVMatrix(const VMatrix* the_vm);
+
+    //! Read rows through the existing cursor, with meta information from
+    //! 'the_vm'.
+    RowCursorVMatrix(const VMatrix* the_vm, PP<VMatRowCursor> the_cursor);
+
+    //! Read whole blocks of rows through the cursor when possible.
+    virtual void getMat(int i, int j, Mat m) const;
+
+    //#####  PLearn::Object Protocol  #########################################
+
+    PLEARN_DECLARE_OBJECT(RowCursorVMatrix);
+
+    //! Simply calls inherited::build() then build_().
+    virtual void build();
+
+    //! Always raises an error: a cursor may not be shared.
+    virtual void makeDeepCopyFromShallowCopy(CopiesMap& copies);
+
+protected:
+    //#####  Protected Member Functions  ######################################
+
+    //! The cursor rows are read from.
+    PP<VMatRowCursor> cursor;
+
+    //! Declares the class options.
+    static void declareOptions(OptionList& ol);
+
+    //! Fill the vector 'v' with the content of the i-th row.
+    virtual void getNewRow(int i, const Vec& v) const;
+
+private:
+    //#####  Private Member Functions  ########################################
+
+    //! This does the actual building.
+    void build_();
+};
+
+DECLARE_OBJECT_PTR(RowCursorVMatrix);
+
+} // end of namespace PLearn
+
+#endif
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
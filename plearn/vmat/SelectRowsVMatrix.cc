@@ -40,6 +40,7 @@
  ******************************************************* */
 
 #include "SelectRowsVMatrix.h"
+#include "VMatRowCursor.h"
 
 namespace PLearn {
 using namespace std;
@@ -94,6 +95,51 @@ real SelectRowsVMatrix::get(int i, int j) const
 void SelectRowsVMatrix::getSubRow(int i, int j, Vec v) const
 { source->getSubRow(selected_indices[i], j, v); }
 
+//! Cursor reading the selected rows through a cursor on the source.
+class SelectRowsVMatRowCursor: public VMatRowCursor
+{
+public:
+    SelectRowsVMatRowCursor(const VMatrix* the_vm,
+                            PP<VMatRowCursor> the_source_cursor,
+                            const TVec<int>& the_indices):
+        VMatRowCursor(the_vm),
+        source_cursor(the_source_cursor),
+        indices(the_indices.isEmpty() ? 0 : the_indices.data())
+    {}
+
+protected:
+    PP<VMatRowCursor> source_cursor;
+
+    //! Plain pointer, not to touch the reference count of the storage.
+    const int* indices;
+
+    virtual void getNewRows(int i_start, Mat& m)
+    {
+        // Rows that are consecutive in the source are read in one call.
+        int n = m.length();
+        int k = 0;
+        Mat block;
+        while (k < n) {
+            int first = indices[i_start + k];
+            int len = 1;
+            while (k + len < n && indices[i_start + k + len] == first + len)
+                len++;
+            block = m.subMatRows(k, len);
+            source_cursor->getRows(first, len, block);
+            k += len;
+        }
+    }
+};
+
+//////////////////
+// newRowCursor //
+//////////////////
+PP<VMatRowCursor> SelectRowsVMatrix::newRowCursor() const
+{
+    return new SelectRowsVMatRowCursor(this, source->newRowCursor(),
+                                       selected_indices);
+}
+
 real SelectRowsVMatrix::dot(int i1, int i2, int inputsize) const
 { return source->dot(int(selected_indices[i1]), int(selected_indices[i2]), inputsize); }
 
@@ -110,6 +110,10 @@ public:
 
     virtual real get(int i, int j) const;
     virtual void getSubRow(int i, int j, Vec v) const;
+
+    //! Return a cursor reading the selected rows through a cursor on the
+    //! source.
+    virtual PP<VMatRowCursor> newRowCursor() const;
     virtual real getStringVal(int col, const string & str) const;
     virtual string getValString(int col, real val) const;
     virtual string getString(int row,int col) const;
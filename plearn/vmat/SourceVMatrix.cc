@@ -42,6 +42,7 @@
 
 
 #include "SourceVMatrix.h"
+#include "RowCursorVMatrix.h"
 #include <plearn/io/fileutils.h>        //!< For 'isfile(..)'.
 #include <plearn/base/stringutils.h>
 
@@ -168,6 +169,22 @@ void SourceVMatrix::getNewRow(int i, const Vec& v) const {
     PLERROR("In SourceVMatrix::getNewRow - getNewRow not implemented for this subclass of SourceVMatrix");
 }
 
+//////////////////
+// newRowCursor //
+//////////////////
+PP<VMatRowCursor> SourceVMatrix::newRowCursor() const
+{
+    if (!source)
+        return inherited::newRowCursor();
+    VMat source_copy = new RowCursorVMatrix(source);
+    CopiesMap copies;
+    copies[(const VMatrix*) source] = (VMatrix*) source_copy;
+    PP<SourceVMatrix> vm_copy = PLearn::deepCopy(this, copies);
+    // The source is not deep-copied when 'deep_copy_source' is false.
+    vm_copy->source = source_copy;
+    return new DeepCopyVMatRowCursor(this, (SourceVMatrix*) vm_copy);
+}
+
 PP<Dictionary> SourceVMatrix::getDictionary(int col) const
 {
     return source->getDictionary(col);
@@ -152,6 +152,11 @@ public:
     //! Gives the possible values of a certain field (column) given the input
     virtual void getValues(const Vec& input, int col, Vec& values) const;
 
+    //! Return a cursor reading from a copy of this VMatrix in which the
+    //! source is replaced by a RowCursorVMatrix on a cursor of the source:
+    //! thus only this VMatrix is copied, not the whole chain below it.
+    virtual PP<VMatRowCursor> newRowCursor() const;
+
 };
 
 DECLARE_OBJECT_PTR(SourceVMatrix);
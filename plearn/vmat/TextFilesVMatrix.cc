@@ -38,17 +38,167 @@
 
 /*! \file TextFilesVMatrix.cc */
 #include "TextFilesVMatrix.h"
+#include "VMatRowCursor.h"
 #include <plearn/base/PDate.h>
 #include <plearn/base/ProgressBar.h>
 #include <plearn/base/stringutils.h>
 #include <plearn/io/load_and_save.h>
 #include <plearn/io/fileutils.h>
+#include <plearn/base/lexical_cast.h>
 #define PL_LOG_MODULE_NAME "TextFilesVMatrix"
 #include <plearn/io/pl_log.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace PLearn {
 using namespace std;
 
+namespace {
+
+//! Size of the chunks read from the text files when building the index.
+const size_t IDX_CHUNK_SIZE = 1 << 24;
+
+inline bool isBlankChar(char c)
+{
+    return c==' ' || c=='\t' || c=='\n' || c=='\r';
+}
+
+//! Same as removeblanks(), on a [begin,end) range.
+inline void trimBlanks(const char*& begin, const char*& end)
+{
+    while(begin<end && isBlankChar(*begin))
+        ++begin;
+    while(end>begin && isBlankChar(end[-1]))
+        --end;
+}
+
+//! Same as isBlank(), on a [begin,end) range.
+bool isBlankText(const char* begin, const char* end)
+{
+    for(const char* p=begin; p<end; p++)
+    {
+        char c = *p;
+        if(c=='#' || c=='\n' || c=='\r')
+            return true;
+        else if(c!=' ' && c!='\t')
+            return false;
+    }
+    return true;
+}
+
+//! Read one full line (newline included, if any) from the current position
+//! of f, and store it in buf from position len on. Returns the new length of
+//! the text in buf, which is always null-terminated.
+size_t appendLine(FILE* f, vector<char>& buf, size_t len)
+{
+    for(;;)
+    {
+        if(buf.size() < len + 2)
+            buf.resize(max(2*buf.size(), len + 4096));
+        if(!fgets(&buf[len], int(buf.size() - len), f))
+            break;
+        len += strlen(&buf[len]);
+        // Stop at the end of the line, or at the end of the file.
+        if(buf[len-1]=='\n' || len + 1 < buf.size())
+            break;
+    }
+    if(buf.size() < len + 1)
+        buf.resize(len + 1);
+    buf[len] = '\0';
+    return len;
+}
+
+//! Parse [begin,end) as a number, with the same result as pl_isnumber().
+//! Plain decimals whose digits fit in 53 bits and whose exponent is small
+//! are converted exactly (as strtod would) without copying anything; other
+//! numbers (nan, inf, hexadecimal, long mantissas...) are handed to
+//! pl_strtod(). Returns false if the text is not a number.
+bool parseNumber(const char* begin, const char* end, real& val)
+{
+#ifndef USEFLOAT
+    static const double powers_of_ten[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+        1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const uint64_t max_mantissa = (uint64_t(1) << 53) - 1;
+    const char* p = begin;
+    bool negative = false;
+    if(p<end && (*p=='-' || *p=='+'))
+        negative = (*p++ == '-');
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int ndigits = 0;
+    bool fast = true;
+    for(; p<end && *p>='0' && *p<='9'; p++, ndigits++)
+    {
+        if(mantissa > (max_mantissa - 9) / 10)
+            fast = false;
+        mantissa = mantissa*10 + (*p - '0');
+    }
+    if(p<end && *p=='.')
+        for(p++; p<end && *p>='0' && *p<='9'; p++, ndigits++, exponent--)
+        {
+            if(mantissa > (max_mantissa - 9) / 10)
+                fast = false;
+            mantissa = mantissa*10 + (*p - '0');
+        }
+    if(ndigits>0 && p<end && (*p=='e' || *p=='E'))
+    {
+        const char* q = p+1;
+        bool negative_exponent = false;
+        if(q<end && (*q=='-' || *q=='+'))
+            negative_exponent = (*q++ == '-');
+        int e = 0;
+        int nexpdigits = 0;
+        for(; q<end && *q>='0' && *q<='9'; q++, nexpdigits++)
+            if(nexpdigits<4)
+                e = e*10 + (*q - '0');
+        if(nexpdigits==0 || nexpdigits>4)
+            fast = false;
+        exponent += negative_exponent ? -e : e;
+        p = q;
+    }
+    if(fast && ndigits>0 && p==end && exponent>=-22 && exponent<=22)
+    {
+        double d = double(mantissa);
+        d = exponent<0 ? d / powers_of_ten[-exponent]
+                       : d * powers_of_ten[exponent];
+        val = negative ? -d : d;
+        return true;
+    }
+#endif
+    // General case: hand a null-terminated copy to the standard parser.
+    size_t len = end - begin;
+    if(len==0)
+        return false;
+    char smallbuf[64];
+    string bigbuf;
+    char* s = smallbuf;
+    if(len < sizeof(smallbuf))
+    {
+        memcpy(smallbuf, begin, len);
+        smallbuf[len] = '\0';
+    }
+    else
+    {
+        bigbuf.assign(begin, end);
+        s = &bigbuf[0];
+    }
+    char* l;
+#ifdef USEFLOAT
+    real d = pl_strtof(s, &l);
+#else
+    real d = pl_strtod(s, &l);
+#endif
+    if(size_t(l - s) != len)
+        return false;
+    val = d;
+    return true;
+}
+
+} // end of anonymous namespace
+
 
 TextFilesVMatrix::TextFilesVMatrix():
     idxfile(0),
@@ -58,7 +208,8 @@ TextFilesVMatrix::TextFilesVMatrix():
     auto_extend_map(true),
     build_vmatrix_stringmap(false),
     reorder_fieldspec_from_headers(false),
-    partial_match(false)
+    partial_match(false),
+    n_threads(-1)
 {}
 
 PLEARN_IMPLEMENT_OBJECT(
@@ -79,6 +230,12 @@ PLEARN_IMPLEMENT_OBJECT(
     "- 1 byte indicating endianness: 'L' or 'B'\n"
     "- 4 byte int for length (number of data rows in the raw text file)\n"
     "- (unsigned char fileno, int pos) indicating in which raw text file and at what position each row starts\n"
+    "\n"
+    "The index is built by reading the text files in large chunks whose lines\n"
+    "are checked on several threads. Similarly, getMat() reads the raw text of\n"
+    "all requested rows at once and parses them on several threads (see\n"
+    "'n_threads'); numeric fields are converted without creating strings.\n"
+    "Saving such a matrix to a .pmat or .dmat file thus parses it in blocks.\n"
     );
 
 
@@ -102,6 +259,21 @@ int TextFilesVMatrix::getIndexOfTextField(const string& fieldname) const
     return -1; // to make the compiler happy
 }
 
+////////////////
+// numThreads //
+////////////////
+int TextFilesVMatrix::numThreads() const
+{
+    int nt = 1;
+#ifdef _OPENMP
+    if (n_threads < 0)
+        nt = omp_in_parallel() ? 1 : omp_get_max_threads();
+    else
+        nt = n_threads;
+#endif
+    return max(1, nt);
+}
+
 void TextFilesVMatrix::buildIdx()
 {
     perr << "Building the index file. Please be patient..." << endl;
@@ -126,8 +298,12 @@ void TextFilesVMatrix::buildIdx()
     length_ = 0;
     fwrite(&length_, 4, 1, idxfile);
 
-    TVec<string> fields;
-    char buf[50000];
+    int nt = numThreads();
+    vector< vector<FieldView> > thread_fields(nt);
+    vector<char> chunk(IDX_CHUNK_SIZE);
+    vector<const char*> line_begin;
+    vector<const char*> line_end;
+    vector<int> nfields;
 
     int lineno = 0;
     for(unsigned char fileno=0; fileno<txtfiles.length(); fileno++)
@@ -139,56 +315,78 @@ void TextFilesVMatrix::buildIdx()
         if(!skipheader.isEmpty())
             nskip = skipheader[int(fileno)];
 
-        // read the data rows and build the index
+        // Read the file by large chunks: the complete lines of each chunk
+        // are checked (possibly in parallel), then appended to the index in
+        // order. The incomplete last line is moved to the next chunk.
+        long chunk_pos = 0; // position in the file of the chunk's first byte
+        size_t filled = 0;
         for(;;)
         {
-            long pos_long = ftell(fi);
-            if (pos_long > INT_MAX)
-                PLERROR("In TextFilesVMatrix::buildIdx - 'pos_long' cannot be "
-                        "more than %d", INT_MAX);
-            int pos = int(pos_long);
-            if(!fgets(buf, sizeof(buf), fi))
-                break;
-
-#ifdef CYGWIN_FGETS_BUGFIX
-            // Bugfix for CYGWIN carriage return bug.
-            // Should be safe to enable in all case, but need to be tester more widely.
-            long new_pos = ftell(fi);
-            long lbuf = long(strlen(buf));
-            if (lbuf+pos != new_pos){
-                if(lbuf+1+pos==new_pos && buf[lbuf-1]=='\n' && buf[lbuf-2]!='\r')
+            if(filled == chunk.size())
+                chunk.resize(2*chunk.size()); // a line longer than a chunk
+            size_t nread = fread(&chunk[filled], 1, chunk.size()-filled, fi);
+            filled += nread;
+            bool eof = nread==0;
+
+            const char* start = &chunk[0];
+            const char* stop = start + filled;
+            const char* p = start;
+            line_begin.resize(0);
+            line_end.resize(0);
+            while(p < stop)
+            {
+                const char* nl = (const char*)memchr(p, '\n', stop-p);
+                if(!nl)
                 {
-                    //bug under windows. fgets return the good string if unix end of lines, but
-                    //change the position suppossing the use of \r\n as carrige return.
-                    //So if their is only a \n, we are a caractere too far.
-                    //if dos end of lines, return \n as end of lines in the strings and put the pos correctly.
-                    
-                    fseek(fi,-1,SEEK_CUR);
-                    
-		    //if unix end of lines
-                    if(fgetc(fi)!='\n')
-                    	fseek(fi,-1,SEEK_CUR);
+                    if(!eof)
+                        break;
+                    nl = stop; // last line of the file, without newline
                 }
-                //in the eof case?
-                else if(lbuf-1+pos==new_pos && buf[lbuf-1]=='\n' && buf[lbuf-2]!='\r')
-                    fseek(fi,+1,SEEK_CUR);
-                else
-                    PLERROR("In TextFilesVMatrix::buildId - The number of characters read "
-                            "does not match the position in the file.");
+                line_begin.push_back(p);
+                line_end.push_back(nl);
+                p = nl<stop ? nl+1 : stop;
             }
+
+            int nlines = int(line_begin.size());
+            nfields.resize(nlines);
+            int nheader = min(nskip, nlines);
+            nskip -= nheader;
+            for(int k=0; k<nheader; k++)
+                nfields[k] = -2;
+
+            // Count the fields of each line (-1 for a blank line).
+            int chunk_nt = max(1, min(nt, (nlines - nheader) / 1000));
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(chunk_nt) schedule(static, 1)
 #endif
+            for(int t=0; t<chunk_nt; t++)
+            {
+                int first = nheader + int((int64_t)(nlines-nheader) * t / chunk_nt);
+                int last = nheader + int((int64_t)(nlines-nheader) * (t+1) / chunk_nt);
+                for(int k=first; k<last; k++)
+                    nfields[k] = isBlankText(line_begin[k], line_end[k])
+                        ? -1 : countFields(line_begin[k], line_end[k],
+                                           thread_fields[t]);
+            }
 
-            buf[sizeof(buf)-1] = '\0';         // ensure null-terminated
-            lineno++;
-            if(nskip>0)
-                --nskip;
-            else if(!isBlank(buf))
+            for(int k=0; k<nlines; k++)
             {
-                fields = splitIntoFields(buf);
-                int nf = fields.length();
-                if(nf!=fieldspec.size()){
-                    fprintf(logfile, "ERROR In file %d line %d: Found %d fields (should be %d):\n %s",fileno,lineno,nf,fieldspec.size(),buf);
-                    PLWARNING("In file %d line %d: Found %d fields (should be %d):\n %s",fileno,lineno,nf,fieldspec.size(),buf);
+                lineno++;
+                int nf = nfields[k];
+                if(nf==-2)
+                    continue;
+                long pos_long = chunk_pos + long(line_begin[k] - start);
+                if (pos_long > INT_MAX)
+                    PLERROR("In TextFilesVMatrix::buildIdx - 'pos_long' cannot be "
+                            "more than %d", INT_MAX);
+                int pos = int(pos_long);
+                if(nf==-1)
+                    PLWARNING("In TextFilesVMatrix::buildIdx() - The line %d is blank",lineno);
+                else if(nf!=fieldspec.size())
+                {
+                    string line(line_begin[k], line_end[k]);
+                    fprintf(logfile, "ERROR In file %d line %d: Found %d fields (should be %d):\n %s\n",fileno,lineno,nf,fieldspec.size(),line.c_str());
+                    PLWARNING("In file %d line %d: Found %d fields (should be %d):\n %s",fileno,lineno,nf,fieldspec.size(),line.c_str());
                 }
                 else  // Row OK! append it to index
                 {
@@ -197,9 +395,15 @@ void TextFilesVMatrix::buildIdx()
                     length_++;
                 }
             }
-            else
-                PLWARNING("In TextFilesVMatrix::buildIdx() - The line %d is blank",lineno);
-        } // end of loop over lines of file
+
+            size_t consumed = p - start;
+            if(consumed < filled)
+                memmove(&chunk[0], &chunk[consumed], filled - consumed);
+            filled -= consumed;
+            chunk_pos += long(consumed);
+            if(eof)
+                break;
+        } // end of loop over chunks of file
     } // end of loop over files
 
     // Write true length and width
@@ -433,6 +637,20 @@ void TextFilesVMatrix::setColumnNamesAndWidth()
     }
     for(int j=0; j<width_; j++)
         declareField(j, fnames[j]);
+
+    field_kind.resize(fieldspec.length());
+    for(int k=0; k<fieldspec.length(); k++)
+    {
+        const string& ftype = fieldspec[k].second;
+        if(ftype=="skip")
+            field_kind[k] = FIELD_SKIP;
+        else if(ftype=="num")
+            field_kind[k] = FIELD_NUM;
+        else if(ftype=="auto")
+            field_kind[k] = FIELD_AUTO;
+        else
+            field_kind[k] = FIELD_OTHER;
+    }
 }
 
 void TextFilesVMatrix::build_()
@@ -472,7 +690,7 @@ void TextFilesVMatrix::setMetaDataDir(const PPath& the_metadatadir){
     for(int k=0; k<nf; k++)
     {
         string fnam = txtfilenames[k];
-        txtfiles[k] = fopen(fnam.c_str(),"r");
+        txtfiles[k] = fopen(fnam.c_str(),"rb");
         if(txtfiles[k]==NULL){
             perror("Can't open file");
             PLERROR("In TextFilesVMatrix::setMetaDataDir - Can't open file %s",
@@ -511,18 +729,24 @@ void TextFilesVMatrix::setMetaDataDir(const PPath& the_metadatadir){
 }
 
 
-string TextFilesVMatrix::getTextRow(int i) const
+size_t TextFilesVMatrix::readTextRow(int i, vector<char>& buf) const
 {
     unsigned char fileno;
     int pos;
     getFileAndPos(i, fileno, pos);
     FILE* f = txtfiles[(int)fileno];
     fseek(f,pos,SEEK_SET);
-    char buf[50000];
+    size_t len = appendLine(f, buf, 0);
+    if(len==0)
+        PLERROR("In TextFilesVMatrix::readTextRow - could not read row %d",i);
+    return len;
+}
 
-    if(!fgets(buf, sizeof(buf), f))
-        PLERROR("In TextFilesVMatrix::getTextRow - fgets for row %d returned NULL",i);
-    return removenewline(buf);
+string TextFilesVMatrix::getTextRow(int i) const
+{
+    vector<char> buf;
+    size_t len = readTextRow(i, buf);
+    return removenewline(string(&buf[0], len));
 }
 
 void TextFilesVMatrix::loadMappings()
@@ -688,6 +912,156 @@ TVec<string> TextFilesVMatrix::splitIntoFields(const string& raw_row) const
     return split_quoted_delimiter(removeblanks(raw_row), delimiter,quote_delimiter);
 }
 
+bool TextFilesVMatrix::splitFieldViews(const char* begin, const char* end,
+                                       vector<FieldView>& fields) const
+{
+    if(quote_delimiter.size()>1)
+        return false;
+    PLASSERT(delimiter.size()==1);
+    const char delim = delimiter[0];
+    const bool quoted = quote_delimiter.size()==1;
+    const char quote = quoted ? quote_delimiter[0] : '\0';
+
+    fields.resize(0);
+    trimBlanks(begin, end);
+    const char* p = begin;
+    for(;;)
+    {
+        const char* e = (const char*)memchr(p, delim, end-p);
+        if(!e)
+            e = end;
+        const char* b = p;
+        bool more = e<end;
+        p = e+1;
+        if(quoted && e>b && *b==quote)
+        {
+            if(e-b>1 && e[-1]==quote)
+                ++b, --e;
+            else if(e-b==1)
+                ++b;
+            else
+            {
+                // The field goes on until a piece ending with the quote
+                // character. If there is no such piece, it is dropped and
+                // the following pieces are read as separate fields.
+                ++b;
+                const char* resume = p;
+                bool resume_more = more;
+                bool closed = false;
+                while(more)
+                {
+                    const char* q = p;
+                    e = (const char*)memchr(q, delim, end-q);
+                    if(!e)
+                        e = end;
+                    more = e<end;
+                    p = e+1;
+                    if(e>q && e[-1]==quote)
+                    {
+                        --e;
+                        closed = true;
+                        break;
+                    }
+                }
+                if(!closed)
+                {
+                    p = resume;
+                    if(!resume_more)
+                        break;
+                    continue;
+                }
+            }
+        }
+        trimBlanks(b, e);
+        fields.push_back(FieldView(b, e));
+        if(!more)
+            break;
+    }
+    return true;
+}
+
+int TextFilesVMatrix::countFields(const char* begin, const char* end,
+                                  vector<FieldView>& fields) const
+{
+    if(splitFieldViews(begin, end, fields))
+        return int(fields.size());
+    return splitIntoFields(string(begin, end)).length();
+}
+
+bool TextFilesVMatrix::fastTransformField(int k, const char* begin,
+                                          const char* end, real* dest) const
+{
+    switch(field_kind[k])
+    {
+    case FIELD_SKIP:
+        return true;
+    case FIELD_NUM:
+    case FIELD_AUTO:
+        if(begin==end)
+        {
+            *dest = MISSING_VALUE;
+            return true;
+        }
+        // Strings of 'auto' fields are looked up in the mapping later.
+        return parseNumber(begin, end, *dest);
+    default:
+        return false;
+    }
+}
+
+void TextFilesVMatrix::parseTextRow(int i, const char* begin, const char* end,
+                                    real* row, vector<FieldView>& fields,
+                                    vector<PendingField>& pending) const
+{
+    if(!splitFieldViews(begin, end, fields))
+    {
+        // Multi-character quotes: use the string-based splitter.
+        TVec<string> strfields = splitIntoFields(string(begin, end));
+        int n = strfields.size();
+        if(n != fieldspec.size())
+            PLERROR("In TextFilesVMatrix::getTextFields - In getting fields of row %d, wrong number of fields: %d (should be %d):\n%s\n",i,n,fieldspec.size(),string(begin,end).c_str());
+        for(int k=0; k<n; k++)
+        {
+            PendingField pf;
+            pf.row = i;
+            pf.field = k;
+            pf.value = removeblanks(strfields[k]);
+            pending.push_back(pf);
+        }
+        return;
+    }
+    int n = int(fields.size());
+    if(n != fieldspec.size())
+        PLERROR("In TextFilesVMatrix::getTextFields - In getting fields of row %d, wrong number of fields: %d (should be %d):\n%s\n",i,n,fieldspec.size(),string(begin,end).c_str());
+    for(int k=0; k<n; k++)
+    {
+        const char* b = fields[k].first;
+        const char* e = fields[k].second;
+        if(!fastTransformField(k, b, e, row + colrange[k].first))
+        {
+            PendingField pf;
+            pf.row = i;
+            pf.field = k;
+            pf.value.assign(b, e);
+            pending.push_back(pf);
+        }
+    }
+}
+
+void TextFilesVMatrix::transformPendingField(const PendingField& pf,
+                                             const Vec& row) const
+{
+    int k = pf.field;
+    Vec dest = row.subVec(colrange[k].first, colrange[k].second);
+    try
+    { transformStringToValue(k, pf.value, dest); }
+    catch(const PLearnError& e)
+    {
+        PLERROR("In TextFilesVMatrix, while parsing field %d (%s) of row %d: \n%s",
+                k,fieldspec[k].first.c_str(),pf.row,e.message().c_str());
+    }
+}
+
 TVec<string> TextFilesVMatrix::getTextFields(int i) const
 {
     string rowi = getTextRow(i);
@@ -936,24 +1310,130 @@ void TextFilesVMatrix::transformStringToValue(int k, string strval, Vec dest) co
 
 void TextFilesVMatrix::getNewRow(int i, const Vec& v) const
 {
-    TVec<string> fields = getTextFields(i);
-    int n = fields.size();
+    size_t len = readTextRow(i, rowbuf);
+    const char* begin = &rowbuf[0];
+    rowpending.resize(0);
+    parseTextRow(i, begin, begin + len, v.data(), rowfields, rowpending);
+    for(size_t p=0; p<rowpending.size(); p++)
+        transformPendingField(rowpending[p], v);
+}
 
-    for(int k=0; k<n; k++)
+////////////
+// getMat //
+////////////
+void TextFilesVMatrix::getMat(int i, int j, Mat m) const
+{
+#ifdef BOUNDCHECK
+    if(i<0 || j<0 || i+m.length()>length() || j+m.width()>width())
+        PLERROR("In TextFilesVMatrix::getMat(i,j,m) OUT OF BOUNDS");
+#endif
+    int n = m.length();
+    if(n <= 1 || m.width() == 0)
+    {
+        inherited::getMat(i, j, m);
+        return;
+    }
+
+    // Locate all rows with a single read of the index.
+    vector<unsigned char> idx(5*n);
+    fseek(idxfile, 5+i*5, SEEK_SET);
+    if(fread(&idx[0], 1, idx.size(), idxfile) != idx.size())
+        PLERROR("In TextFilesVMatrix::getMat - could not read the index of rows %d to %d",
+                i, i+n-1);
+    vector<int> pos(n);
+    for(int r=0; r<n; r++)
+        memcpy(&pos[r], &idx[5*r+1], sizeof(int));
+
+    // Read the raw text of consecutive rows of a same file at once (rows of
+    // a file are indexed in increasing position order).
+    vector<char> text;
+    vector<size_t> line_begin(n);
+    vector<size_t> line_end(n);
+    for(int first=0; first<n; )
     {
-        string fieldname = fieldspec[k].first;
-        string fieldtype = fieldspec[k].second;
-        string strval = fields[k];
-        Vec dest = v.subVec(colrange[k].first, colrange[k].second);
-
-        try
-        { transformStringToValue(k, strval, dest); }
-        catch(const PLearnError& e)
+        int last = first;
+        while(last+1<n && idx[5*(last+1)]==idx[5*first] && pos[last+1]>pos[last])
+            last++;
+        FILE* f = txtfiles[int(idx[5*first])];
+        size_t base = text.size();
+        size_t span = size_t(pos[last] - pos[first]);
+        text.resize(base + span);
+        fseek(f, pos[first], SEEK_SET);
+        if(span>0 && fread(&text[base], 1, span, f) != span)
+            PLERROR("In TextFilesVMatrix::getMat - could not read rows %d to %d",
+                    i+first, i+last);
+        size_t stop = appendLine(f, text, base + span);
+        text.resize(stop);
+        for(int r=first; r<=last; r++)
         {
-            PLERROR("In TextFilesVMatrix, while parsing field %d (%s) of row %d: \n%s",
-                    k,fieldname.c_str(),i,e.message().c_str());
+            line_begin[r] = base + size_t(pos[r] - pos[first]);
+            const char* b = &text[line_begin[r]];
+            const char* nl = (const char*)memchr(b, '\n', stop - line_begin[r]);
+            line_end[r] = nl ? size_t(nl - &text[0]) : stop;
         }
+        first = last+1;
     }
+    if(text.empty())
+        text.resize(1);
+
+    Mat rows = (j==0 && m.width()==width()) ? m : Mat(n, width());
+    int nt = max(1, min(numThreads(), n / 64));
+    vector< vector<FieldView> > thread_fields(nt);
+    vector< vector<PendingField> > thread_pending(nt);
+    const char* textdata = &text[0];
+    bool failed = false;
+    string error_message;
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nt) schedule(static, 1)
+#endif
+    for(int t=0; t<nt; t++)
+    {
+        int first = int((int64_t)n * t / nt);
+        int last = int((int64_t)n * (t+1) / nt);
+        try {
+            for(int r=first; r<last; r++)
+                parseTextRow(i+r, textdata + line_begin[r],
+                             textdata + line_end[r], rows[r],
+                             thread_fields[t], thread_pending[t]);
+        } catch (const PLearnError& e) {
+            // Errors cannot be propagated out of the parallel loop.
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+            {
+                if (!failed) {
+                    failed = true;
+                    error_message = e.message();
+                }
+            }
+        }
+    }
+    if(failed)
+        PLERROR("%s", error_message.c_str());
+
+    // Remaining fields are converted in row order, so that mappings are
+    // extended exactly as they would be by successive calls to getRow().
+    for(int t=0; t<nt; t++)
+    {
+        const vector<PendingField>& pending = thread_pending[t];
+        for(size_t p=0; p<pending.size(); p++)
+            transformPendingField(pending[p], rows(pending[p].row - i));
+    }
+
+    if(rows.data() != m.data())
+        m << rows.subMatColumns(j, m.width());
+}
+
+//////////////////
+// newRowCursor //
+//////////////////
+PP<VMatRowCursor> TextFilesVMatrix::newRowCursor() const
+{
+    if(auto_extend_map)
+        PLERROR("In TextFilesVMatrix::newRowCursor - Rows cannot be read "
+                "concurrently when 'auto_extend_map' is true");
+    return inherited::newRowCursor();
 }
 
 void TextFilesVMatrix::declareOptions(OptionList& ol)
@@ -1033,6 +1513,12 @@ void TextFilesVMatrix::declareOptions(OptionList& ol)
                   "If there is no fieldspec for a fieldname, we will use this"
                   "value. reorder_fieldspec_from_headers must be true.");
 
+    declareOption(ol, "n_threads", &TextFilesVMatrix::n_threads,
+                  OptionBase::buildoption | OptionBase::nosave,
+                  "Number of threads used to check the lines of the text files when\n"
+                  "building the index, and to parse blocks of rows in getMat()\n"
+                  "(-1 means the default number of OpenMP threads).");
+
     // Now call the parent class' declareOptions
     inherited::declareOptions(ol);
 }
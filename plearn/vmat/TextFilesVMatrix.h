@@ -131,6 +131,10 @@ public:
     //! reorder_fieldspec_from_headers must be true.
     string default_spec;
 
+    //! Number of threads used to build the index and to parse blocks of
+    //! rows in getMat() (-1 means as many as OpenMP allows).
+    int n_threads;
+
     // ****************
     // * Constructors *
     // ****************
@@ -151,6 +155,7 @@ private:
     void setColumnNamesAndWidth();
     void getFileAndPos(int i, unsigned char& fileno, int& pos) const;
     void buildIdx();
+    int numThreads() const;
     static void readAndCheckOptionName(PStream& in, const string& optionname, char buf[]);
     void closeCurrentFile();
 
@@ -178,6 +183,63 @@ protected:
     //! Return true iff 'ftype' is a valid type that does not need to be skipped.
     virtual bool isValidNonSkipFieldType(const string& ftype) const;
 
+    //! A field of a raw text row, as a [begin,end) range into the row
+    //! (blanks removed on both sides).
+    typedef pair<const char*, const char*> FieldView;
+
+    //! A field that could not be converted by fastTransformField(), and
+    //! must go through transformStringToValue() (in row order, since it
+    //! may extend a mapping).
+    struct PendingField
+    {
+        int row;
+        int field;
+        string value;
+    };
+
+    //! How each field can be converted without building a string:
+    //! FIELD_OTHER fields always go through transformStringToValue().
+    enum { FIELD_OTHER = 0, FIELD_SKIP, FIELD_NUM, FIELD_AUTO };
+    TVec<int> field_kind;
+
+    //! Buffers reused by getNewRow() to avoid allocating on each row.
+    mutable vector<char> rowbuf;
+    mutable vector<FieldView> rowfields;
+    mutable vector<PendingField> rowpending;
+
+    //! Split the raw text in [begin,end) into fields, exactly as
+    //! splitIntoFields() would, but without copying anything.
+    //! Returns false (and leaves 'fields' untouched) when the quote
+    //! delimiter is longer than one character, in which case
+    //! splitIntoFields() must be used instead.
+    bool splitFieldViews(const char* begin, const char* end,
+                         vector<FieldView>& fields) const;
+
+    //! Number of fields in the raw text [begin,end).
+    int countFields(const char* begin, const char* end,
+                    vector<FieldView>& fields) const;
+
+    //! Convert field k directly into *dest when this does not need a
+    //! mapping or a date parser. Returns false if the field must go
+    //! through transformStringToValue().
+    bool fastTransformField(int k, const char* begin, const char* end,
+                            real* dest) const;
+
+    //! Parse the raw text row i in [begin,end) into 'row' (of length
+    //! width()). Fields that fastTransformField() cannot handle are
+    //! appended to 'pending'. This method does not touch any shared state
+    //! and may be called concurrently.
+    void parseTextRow(int i, const char* begin, const char* end, real* row,
+                      vector<FieldView>& fields,
+                      vector<PendingField>& pending) const;
+
+    //! Convert a field left pending by parseTextRow() into 'row'.
+    void transformPendingField(const PendingField& pf, const Vec& row) const;
+
+    //! Read the full raw text of row i (newline included) into 'buf'.
+    //! Returns the number of characters read.
+    size_t readTextRow(int i, vector<char>& buf) const;
+
 public:
 
     typedef RowBufferedVMatrix inherited;
@@ -219,6 +281,15 @@ public:
 
     virtual void getNewRow(int i, const Vec& v) const;
 
+    //! Overridden to read the raw text of all rows at once and parse them
+    //! on several threads (see 'n_threads').
+    virtual void getMat(int i, int j, Mat m) const;
+
+    //! Cursors read from a deep copy, whose mappings would be extended
+    //! independently of this VMatrix: they are thus refused (with a
+    //! PLERROR) when 'auto_extend_map' is true.
+    virtual PP<VMatRowCursor> newRowCursor() const;
+
     // simply calls inherited::build() then build_()
     virtual void build();
 
@@ -194,7 +194,11 @@ PLEARN_IMPLEMENT_OBJECT(VMatLanguage,
 //////////////////
 // VMatLanguage //
 //////////////////
-VMatLanguage::VMatLanguage(VMat vmsrc)
+VMatLanguage::VMatLanguage(VMat vmsrc):
+    fused_ready(false),
+    fused_valid(false),
+    fused_outputsize(0),
+    optimize_program(true)
 {
     setSource(vmsrc);
     build_();
@@ -238,6 +242,7 @@ void
 VMatLanguage::build_()
 {
     build_opcodes_map();
+    invalidateFusedProgram();
 }
 
 void
@@ -255,6 +260,15 @@ VMatLanguage::declareOptions(OptionList &ol)
                   "The opcodes of the compiled program");
     declareOption(ol, "mappings", &VMatLanguage::mappings, OptionBase::learntoption,
                   "The mappings of the compiled program");
+    declareOption(ol, "optimize_program", &VMatLanguage::optimize_program,
+                  OptionBase::buildoption | OptionBase::nosave,
+                  "If true, the compiled program is lowered, the first time it is run,\n"
+                  "to a register-based form where constant expressions are folded,\n"
+                  "consecutive fields are copied with a single memcpy and mappings are\n"
+                  "looked up in sorted arrays. Programs using 'get', 'select',\n"
+                  "'vecscalmul', 'sumabs', 'nextincal', 'previncal', 'gausshot' or\n"
+                  "'varproduct' are always interpreted. If false, the bytecode\n"
+                  "interpreter is always used.");
 
     inherited::declareOptions(ol);
 }
@@ -269,6 +283,7 @@ void VMatLanguage::setSource(VMat the_source)
         fnames = TVec<string>(vmsource->width());
     setSourceFieldNames(fnames);
     program.resize(0);
+    invalidateFusedProgram();
 }
 
 void VMatLanguage::setSourceFieldNames(TVec<string> the_srcfieldnames)
@@ -283,6 +298,7 @@ void VMatLanguage::clear()
     outputfieldnames.resize(0);
     program.resize(0);
     mappings.resize(0);
+    invalidateFusedProgram();
 }
 
 ////////////////
@@ -664,6 +680,7 @@ void VMatLanguage::compileStream(PStream & in, vector<string>& fieldnames)
 
     program.resize(0);
     mappings.resize(0);
+    invalidateFusedProgram();
 
     // first, warn user if a fieldname appears twice or more in the source matrix
     string fname;
@@ -915,7 +932,8 @@ void VMatLanguage::build_opcodes_map()
     }
 }
 
-void VMatLanguage::run(const Vec& srcvec, const Vec& result, int rowindex) const
+void VMatLanguage::runInterpreted(const Vec& srcvec, const Vec& result,
+                                  int rowindex) const
 {
     if (program.length() == 0 && sourcecode != "")
     {
@@ -1388,12 +1406,640 @@ void VMatLanguage::run(const Vec& srcvec, const Vec& result, int rowindex) const
     pstack >> result;
 }
 
+////////////////////////////////////
+// Lowered (fused) program support //
+////////////////////////////////////
+namespace {
+
+//! Opcodes of the lowered program that do not exist in the VPL bytecode.
+//! Other opcodes of the lowered program are VPL opcodes followed by the
+//! register holding their first operand.
+enum {
+    FOP_COPYFIELDS  = 1000, // dst field n    : regs[dst..] = fields[field..]
+    FOP_COPYCONSTS  = 1001, // dst offset n   : regs[dst..] = constants[offset..]
+    FOP_COPYREGS    = 1002, // dst n          : result[dst..] = regs[dst..]
+    FOP_MAP         = 1003, // dst mapnum     : regs[dst] = map(regs[dst])
+    FOP_MAPFIELD    = 1004, // dst field mapnum : regs[dst] = map(fields[field])
+    FOP_ONEHOT      = 1005, // dst nclasses
+    FOP_THERMOMETER = 1006  // dst nclasses
+};
+
+//! Compile-time content of a stack position while lowering a program.
+//! Constants and source fields are only written to their register when
+//! an instruction actually needs them there.
+struct LoweringSlot
+{
+    enum Kind { Constant, Field, Register };
+    Kind kind;
+    real value;
+    int field;
+
+    LoweringSlot(Kind the_kind, real the_value = 0, int the_field = -1):
+        kind(the_kind), value(the_value), field(the_field)
+    {}
+};
+
+//! Stack effect of the VPL instructions that have a fixed number of inputs
+//! and outputs and can be run in place on the registers.  Returns false
+//! for the instructions that are not handled this way.
+bool fixedStackEffect(int op, int& n_in, int& n_out, bool& pure)
+{
+    pure = true;
+    n_out = 1;
+    switch (op)
+    {
+    case 4:  n_in = 1; n_out = 2; return true; // dup
+    case 5:  n_in = 2; n_out = 2; return true; // exch
+    case 19: case 21: case 22: case 23: case 24: case 25: case 26:
+    case 28: case 29: case 30: case 31: case 37: case 39: case 40:
+    case 43: case 50: case 54: case 57: case 58: case 62: case 63: case 66:
+        n_in = 1; return true;
+    case 7: case 8: case 9: case 10: case 11: case 12: case 13: case 14:
+    case 15: case 16: case 17: case 18: case 32: case 33: case 34:
+    case 41: case 42: case 44: case 45:
+        n_in = 2; return true;
+    case 20: case 36:
+        n_in = 3; return true;
+    case 35: // year_month_day
+        n_in = 1; n_out = 3; return true;
+    case 27: case 38: // rowindex, today
+        pure = false; n_in = 0; return true;
+    case 52: // memput
+        pure = false; n_in = 2; n_out = 0; return true;
+    case 53: // memget
+        pure = false; n_in = 1; return true;
+    default:
+        return false;
+    }
+}
+
+//! Apply a pure instruction from fixedStackEffect() in place: its inputs
+//! are read from s[0], s[1], ... and its outputs written from s[0].
+//! This must give exactly the same results as VMatLanguage::runInterpreted.
+inline void applyFixedArityOp(int op, real* s)
+{
+    switch (op)
+    {
+    case 4: s[1] = s[0]; break; // dup
+    case 5: { const real a = s[0]; s[0] = s[1]; s[1] = a; break; } // exch
+    case 7:  s[0] = s[0] + s[1]; break;
+    case 8:  s[0] = s[0] - s[1]; break;
+    case 9:  s[0] = s[0] * s[1]; break;
+    case 10: s[0] = s[0] / s[1]; break;
+    case 11: s[0] = fast_exact_is_equal((float)s[0], (float)s[1]) ?1 :0; break;
+    case 12: s[0] = !fast_exact_is_equal((float)s[0], (float)s[1]) ?1 :0; break;
+    case 13: s[0] = ((float)s[0]>(float)s[1]) ?1 :0; break;
+    case 14: s[0] = ((float)s[0]>=(float)s[1]) ?1 :0; break;
+    case 15: s[0] = ((float)s[0]<(float)s[1]) ?1 :0; break;
+    case 16: s[0] = ((float)s[0]<=(float)s[1]) ?1 :0; break;
+    case 17: s[0] = (!fast_exact_is_equal(s[0], 0) &&
+                     !fast_exact_is_equal(s[1], 0)) ?1 :0; break;
+    case 18: s[0] = (!fast_exact_is_equal(s[0], 0) ||
+                     !fast_exact_is_equal(s[1], 0)) ?1 :0; break;
+    case 19: s[0] = fast_exact_is_equal(s[0], 0) ?1 :0; break;
+    case 20: s[0] = !fast_exact_is_equal(s[0], 0) ? s[1] : s[2]; break;
+    case 21: s[0] = fabs(s[0]); break;
+    case 22: s[0] = rint(s[0]); break;
+    case 23: s[0] = floor(s[0]); break;
+    case 24: s[0] = ceil(s[0]); break;
+    case 25: s[0] = pl_log(s[0]); break;
+    case 26: s[0] = exp(s[0]); break;
+    case 28: s[0] = isnan(s[0])?1:0; break;
+    case 29: s[0] = float_to_date(s[0]).year; break;
+    case 30: s[0] = float_to_date(s[0]).month; break;
+    case 31: s[0] = float_to_date(s[0]).day; break;
+    case 32: // daydiff
+        if (!isnan(s[0]) && !isnan(s[1]))
+            s[0] = float_to_date(s[0]) - float_to_date(s[1]);
+        else
+            s[0] = MISSING_VALUE;
+        break;
+    case 33: // monthdiff
+        s[0] = (float_to_date(s[0]) - float_to_date(s[1]))*(12.0/365.25);
+        break;
+    case 34: // yeardiff
+        if (is_missing(s[0]) || is_missing(s[1]))
+            s[0] = MISSING_VALUE;
+        else
+            s[0] = (float_to_date(s[0]) - float_to_date(s[1]))/365.25;
+        break;
+    case 35: // year_month_day
+    {
+        PDate d(float_to_date(s[0]));
+        s[0] = d.year;
+        s[1] = d.month;
+        s[2] = d.day;
+        break;
+    }
+    case 36: s[0] = date_to_float(PDate((int)s[0], (int)s[1], (int)s[2])); break;
+    case 37: s[0] = float_to_date(s[0]).dayOfWeek(); break;
+    case 39: s[0] = float_to_date(s[0]).toJulianDay(); break;
+    case 40: s[0] = date_to_float(PDate((int)s[0])); break;
+    case 41: s[0] = s[1]<s[0] ? s[1] : s[0]; break; // min
+    case 42: s[0] = s[1]<s[0] ? s[0] : s[1]; break; // max
+    case 43: s[0] = sqrt(s[0]); break;
+    case 44: s[0] = pow(s[0], s[1]); break;
+    case 45: s[0] = (int)s[0] % (int)s[1]; break; // mod
+    case 50: s[0] = s[0]>0 ? 1. : (s[0]<0 ? -1. : 0.); break;
+    case 54: s[0] = -s[0]; break;
+    case 57: s[0] = float_to_date(s[0]).weekNumber(); break;
+    case 58: s[0] = float_to_date(s[0]).dayOfYear(); break;
+    case 62: s[0] = sigmoid(s[0]); break;
+    case 63: s[0] = cos(s[0]); break;
+    case 66: s[0] = pl_erf(s[0]); break;
+    default:
+        PLASSERT_MSG(false, "BUG IN VMatLanguage: unexpected opcode in lowered program: " +
+                     tostring(op));
+    }
+}
+
+//! Emit the code writing stack positions [from, to) to their registers
+//! (or to the result when 'to_result' is true), copying runs of
+//! consecutive fields and of constants with a single instruction.
+void emitCopies(vector<LoweringSlot>& stack, int from, int to,
+                TVec<int>& code, Vec& constants, bool to_result)
+{
+    int i = from;
+    while (i < to)
+    {
+        const LoweringSlot& slot = stack[i];
+        int n = 1;
+        if (slot.kind == LoweringSlot::Field)
+        {
+            while (i + n < to && stack[i + n].kind == LoweringSlot::Field
+                   && stack[i + n].field == slot.field + n)
+                n++;
+            code.append(FOP_COPYFIELDS);
+            code.append(i);
+            code.append(slot.field);
+            code.append(n);
+        }
+        else if (slot.kind == LoweringSlot::Constant)
+        {
+            while (i + n < to && stack[i + n].kind == LoweringSlot::Constant)
+                n++;
+            code.append(FOP_COPYCONSTS);
+            code.append(i);
+            code.append(constants.length());
+            code.append(n);
+            for (int k = 0; k < n; k++)
+                constants.append(stack[i + k].value);
+        }
+        else
+        {
+            while (i + n < to && stack[i + n].kind == LoweringSlot::Register)
+                n++;
+            if (to_result)
+            {
+                code.append(FOP_COPYREGS);
+                code.append(i);
+                code.append(n);
+            }
+        }
+        if (!to_result)
+            for (int k = i; k < i + n; k++)
+                stack[k].kind = LoweringSlot::Register;
+        i += n;
+    }
+}
+
+} // end of anonymous namespace
+
+real VMatLanguage::FusedMapping::map(real val) const
+{
+    if (is_missing(val))
+        return missing_mapsto;
+    // Same search as the std::map::lower_bound in RealMapping::map(): find
+    // the first range that is not entirely below 'val'.
+    int lo = 0;
+    int hi = high.length();
+    if (hi > 0)
+    {
+        const real* h = high.data();
+        const int* b = brackets.data();
+        while (lo < hi)
+        {
+            const int mid = (lo + hi) / 2;
+            if (h[mid] < val || (fast_exact_is_equal(h[mid], val) && !(b[mid] & 2)))
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (lo < high.length())
+        {
+            const real l = low[lo];
+            if (val >= l && val <= h[lo]
+                && (!fast_exact_is_equal(val, l) || (b[lo] & 1))
+                && (!fast_exact_is_equal(val, h[lo]) || (b[lo] & 2)))
+                return value[lo];
+        }
+    }
+    if (keep_other_as_is)
+        return val;
+    else
+        return other_mapsto;
+}
+
+//////////////////
+// lowerProgram //
+//////////////////
+void VMatLanguage::lowerProgram() const
+{
+    fused_ready = true;
+    fused_valid = false;
+    fused_code.resize(0);
+    fused_epilogue.resize(0);
+    fused_constants.resize(0);
+
+    // Flatten the mappings.
+    fused_mappings.resize(mappings.length());
+    for (int m = 0; m < mappings.length(); m++)
+    {
+        const RealMapping& rm = mappings[m];
+        FusedMapping& fm = fused_mappings[m];
+        const int n = rm.size();
+        fm.low.resize(n);
+        fm.high.resize(n);
+        fm.brackets.resize(n);
+        fm.value.resize(n);
+        int k = 0;
+        for (RealMapping::const_iterator it = rm.begin(); it != rm.end(); ++it, ++k)
+        {
+            fm.low[k] = it->first.low;
+            fm.high[k] = it->first.high;
+            fm.brackets[k] = (it->first.leftbracket == '[' ? 1 : 0)
+                           | (it->first.rightbracket == ']' ? 2 : 0);
+            fm.value[k] = it->second;
+        }
+        fm.missing_mapsto = rm.missing_mapsto;
+        fm.keep_other_as_is = rm.keep_other_as_is;
+        fm.other_mapsto = rm.other_mapsto;
+    }
+
+    // Simulate the stack.  Whenever something unexpected happens (unknown
+    // instruction, stack underflow, out-of-range field...) we simply return
+    // and let the interpreter deal with it.
+    const int n_fields = srcfieldnames.length();
+    vector<LoweringSlot> stack;
+    int max_depth = 0;
+    real args[3];
+    int pc = 0;
+    while (pc < program.length())
+    {
+        const int op = program[pc++];
+        const int depth = int(stack.size());
+        switch (op)
+        {
+        case 0: // insertconstant
+            stack.push_back(LoweringSlot(LoweringSlot::Constant,
+                                         *((float*)&program[pc++])));
+            break;
+        case 1: // getfieldval
+        {
+            const int field = program[pc++];
+            if (field < 0 || field >= n_fields)
+                return;
+            stack.push_back(LoweringSlot(LoweringSlot::Field, 0, field));
+            break;
+        }
+        case 47: // __getfieldsrange
+        {
+            const int first = program[pc++];
+            const int last = program[pc++];
+            if (first < 0 || last >= n_fields)
+                return;
+            for (int f = first; f <= last; f++)
+                stack.push_back(LoweringSlot(LoweringSlot::Field, 0, f));
+            break;
+        }
+        case 49: // length
+            stack.push_back(LoweringSlot(LoweringSlot::Constant, n_fields));
+            break;
+        case 55: // missing
+            stack.push_back(LoweringSlot(LoweringSlot::Constant, MISSING_VALUE));
+            break;
+        case 2: // applymapping
+        {
+            const int mapnum = program[pc++];
+            if (depth < 1 || mapnum < 0 || mapnum >= mappings.length())
+                return;
+            LoweringSlot& top = stack.back();
+            if (top.kind == LoweringSlot::Constant)
+                top.value = mappings[mapnum].map(top.value);
+            else
+            {
+                if (top.kind == LoweringSlot::Field)
+                {
+                    fused_code.append(FOP_MAPFIELD);
+                    fused_code.append(depth - 1);
+                    fused_code.append(top.field);
+                }
+                else
+                {
+                    fused_code.append(FOP_MAP);
+                    fused_code.append(depth - 1);
+                }
+                fused_code.append(mapnum);
+                top.kind = LoweringSlot::Register;
+            }
+            break;
+        }
+        case 3: // pop
+            if (depth < 1)
+                return;
+            stack.pop_back();
+            break;
+        case 4: // dup
+            if (depth < 1)
+                return;
+            if (stack.back().kind != LoweringSlot::Register)
+                stack.push_back(stack.back());
+            else
+            {
+                fused_code.append(op);
+                fused_code.append(depth - 1);
+                stack.push_back(LoweringSlot(LoweringSlot::Register));
+            }
+            break;
+        case 5: // exch
+            if (depth < 2)
+                return;
+            if (stack[depth - 1].kind != LoweringSlot::Register
+                && stack[depth - 2].kind != LoweringSlot::Register)
+                std::swap(stack[depth - 1], stack[depth - 2]);
+            else
+            {
+                emitCopies(stack, depth - 2, depth, fused_code, fused_constants, false);
+                fused_code.append(op);
+                fused_code.append(depth - 2);
+            }
+            break;
+        case 6:  // onehot
+        case 65: // thermometer
+        {
+            // Only handled when the number of classes is known.
+            if (depth < 2 || stack[depth - 1].kind != LoweringSlot::Constant)
+                return;
+            const int nclasses = int(stack[depth - 1].value);
+            stack.pop_back();
+            if (stack.back().kind == LoweringSlot::Constant)
+            {
+                const int index = int(stack.back().value);
+                stack.pop_back();
+                for (int i = 0; i < nclasses; i++)
+                    stack.push_back(LoweringSlot(
+                        LoweringSlot::Constant,
+                        (op == 6 ? i == index : i > index) ? 1 : 0));
+            }
+            else
+            {
+                emitCopies(stack, depth - 2, depth - 1, fused_code, fused_constants, false);
+                fused_code.append(op == 6 ? FOP_ONEHOT : FOP_THERMOMETER);
+                fused_code.append(depth - 2);
+                fused_code.append(nclasses);
+                stack.pop_back();
+                for (int i = 0; i < nclasses; i++)
+                    stack.push_back(LoweringSlot(LoweringSlot::Register));
+            }
+            break;
+        }
+        default:
+        {
+            int n_in, n_out;
+            bool pure;
+            if (!fixedStackEffect(op, n_in, n_out, pure) || depth < n_in)
+                return;
+            const int base = depth - n_in;
+            bool fold = pure;
+            for (int k = 0; fold && k < n_in; k++)
+                fold = stack[base + k].kind == LoweringSlot::Constant;
+            // Leave a modulo by zero to run time, as the interpreter does.
+            if (fold && op == 45 && int(stack[base + 1].value) == 0)
+                fold = false;
+            if (fold)
+            {
+                for (int k = 0; k < n_in; k++)
+                    args[k] = stack[base + k].value;
+                applyFixedArityOp(op, args);
+                stack.resize(base, LoweringSlot(LoweringSlot::Register));
+                for (int k = 0; k < n_out; k++)
+                    stack.push_back(LoweringSlot(LoweringSlot::Constant, args[k]));
+            }
+            else
+            {
+                emitCopies(stack, base, depth, fused_code, fused_constants, false);
+                fused_code.append(op);
+                fused_code.append(base);
+                stack.resize(base, LoweringSlot(LoweringSlot::Register));
+                for (int k = 0; k < n_out; k++)
+                    stack.push_back(LoweringSlot(LoweringSlot::Register));
+            }
+            break;
+        }
+        }
+        max_depth = max(max_depth, int(stack.size()));
+    }
+
+    fused_outputsize = int(stack.size());
+    emitCopies(stack, 0, fused_outputsize, fused_epilogue, fused_constants, true);
+    fused_regs.resize(max(max_depth, 1));
+    fused_valid = true;
+}
+
+//////////////
+// runFused //
+//////////////
+void VMatLanguage::runFused(const real* src, real* result, int rowindex) const
+{
+    real* regs = fused_regs.data();
+    const real* constants = fused_constants.isEmpty() ? 0 : fused_constants.data();
+
+    if (!fused_code.isEmpty())
+    {
+        const int* pc = fused_code.data();
+        const int* const pcend = pc + fused_code.length();
+        while (pc != pcend)
+        {
+            const int op = *pc++;
+            switch (op)
+            {
+            case FOP_COPYFIELDS:
+                memcpy(regs + pc[0], src + pc[1], pc[2] * sizeof(real));
+                pc += 3;
+                break;
+            case FOP_COPYCONSTS:
+                memcpy(regs + pc[0], constants + pc[1], pc[2] * sizeof(real));
+                pc += 3;
+                break;
+            case FOP_MAP:
+                regs[pc[0]] = fused_mappings[pc[1]].map(regs[pc[0]]);
+                pc += 2;
+                break;
+            case FOP_MAPFIELD:
+                regs[pc[0]] = fused_mappings[pc[2]].map(src[pc[1]]);
+                pc += 3;
+                break;
+            case FOP_ONEHOT:
+            case FOP_THERMOMETER:
+            {
+                real* s = regs + pc[0];
+                const int nclasses = pc[1];
+                const int index = int(s[0]);
+                if (op == FOP_ONEHOT)
+                    for (int i = 0; i < nclasses; i++)
+                        s[i] = (i == index ? 1 : 0);
+                else
+                    for (int i = 0; i < nclasses; i++)
+                        s[i] = (i > index ? 1 : 0);
+                pc += 2;
+                break;
+            }
+            case 27: // rowindex
+                regs[*pc++] = real(rowindex);
+                break;
+            case 38: // today
+                regs[*pc++] = date_to_float(PDate::today());
+                break;
+            case 52: // memput
+            {
+                const real* s = regs + *pc++;
+                const int i = int(s[1]);
+                if (mem.size()<i+1)
+                    mem.resize(i+1);
+                mem[i] = s[0];
+                break;
+            }
+            case 53: // memget
+            {
+                real* s = regs + *pc++;
+                s[0] = mem[int(s[0])];
+                break;
+            }
+            default:
+                applyFixedArityOp(op, regs + *pc++);
+            }
+        }
+    }
+
+    if (!fused_epilogue.isEmpty())
+    {
+        const int* pc = fused_epilogue.data();
+        const int* const pcend = pc + fused_epilogue.length();
+        while (pc != pcend)
+        {
+            switch (*pc++)
+            {
+            case FOP_COPYFIELDS:
+                memcpy(result + pc[0], src + pc[1], pc[2] * sizeof(real));
+                pc += 3;
+                break;
+            case FOP_COPYCONSTS:
+                memcpy(result + pc[0], constants + pc[1], pc[2] * sizeof(real));
+                pc += 3;
+                break;
+            case FOP_COPYREGS:
+                memcpy(result + pc[0], regs + pc[0], pc[1] * sizeof(real));
+                pc += 2;
+                break;
+            default:
+                PLASSERT_MSG(false, "BUG IN VMatLanguage::runFused: unexpected epilogue opcode");
+            }
+        }
+    }
+}
+
+/////////
+// run //
+/////////
+void VMatLanguage::run(const Vec& srcvec, const Vec& result, int rowindex) const
+{
+    if (!optimize_program)
+    {
+        runInterpreted(srcvec, result, rowindex);
+        return;
+    }
+
+    if (program.length() == 0 && sourcecode != "")
+    {
+        TVec<string> outnames;
+        const_cast<VMatLanguage*>(this)->compileString(sourcecode, outnames);
+    }
+    if (!fused_ready)
+        lowerProgram();
+    if (!fused_valid)
+    {
+        runInterpreted(srcvec, result, rowindex);
+        return;
+    }
+
+    if (srcvec.length()!=srcfieldnames.length())
+        PLERROR("In VMatLanguage::run, srcvec should have length %d, not %d.",srcfieldnames.length(),srcvec.length());
+    if (fused_outputsize > result.length())
+        PLERROR("Parsing VMatLanguage: left with %d too many items on the stack!",
+                fused_outputsize-result.length());
+    if (fused_outputsize < result.length())
+        PLERROR("Parsing VMatLanguage: left with %d missing items on the stack!",
+                result.length()-fused_outputsize);
+
+    runFused(srcvec.isEmpty() ? 0 : srcvec.data(),
+             result.isEmpty() ? 0 : result.data(), rowindex);
+}
+
+//////////////
+// runBatch //
+//////////////
+void VMatLanguage::runBatch(const Mat& src, const Mat& result, int first_rowindex) const
+{
+    if (src.length() != result.length())
+        PLERROR("In VMatLanguage::runBatch - src and result should have the same "
+                "length (%d != %d)", src.length(), result.length());
+    if (src.length() == 0)
+        return;
+
+    // Compile and lower the program, and check the sizes, on the first row.
+    run(src(0), result(0), first_rowindex);
+    if (!optimize_program || !fused_valid)
+    {
+        for (int i = 1; i < src.length(); i++)
+            runInterpreted(src(i), result(i), first_rowindex + i);
+        return;
+    }
+    const bool has_src = src.width() > 0;
+    const bool has_result = result.width() > 0;
+    for (int i = 1; i < src.length(); i++)
+        runFused(has_src ? src[i] : 0, has_result ? result[i] : 0,
+                 first_rowindex + i);
+}
+
+void VMatLanguage::runBatch(int first_rowindex, const Mat& result) const
+{
+    mybatch.resize(result.length(), srcfieldnames.length());
+    vmsource->getMat(first_rowindex, 0, mybatch);
+    runBatch(mybatch, result, first_rowindex);
+}
+
 void VMatLanguage::run(int rowindex, const Vec& result) const
 {
     vmsource->getRow(rowindex,myvec);
     run(myvec, result, rowindex);
 }
 
+bool VMatLanguage::usesMemory() const
+{
+    int pc = 0;
+    while (pc < program.length())
+    {
+        const int op = program[pc++];
+        if (op == 52 || op == 53) // memput, memget
+            return true;
+        if (op == 0 || op == 1 || op == 2)
+            pc++;
+        else if (op == 47)
+            pc += 2;
+    }
+    return false;
+}
+
 void VMatLanguage::setMemory(const Vec& new_mem) const
 {
     mem.resize(new_mem.size());
@@ -1411,7 +2057,16 @@ void VMatLanguage::makeDeepCopyFromShallowCopy(CopiesMap& copies)
     deepCopyField(mappings, copies);
     deepCopyField(pstack, copies);
     deepCopyField(myvec, copies);
+    deepCopyField(mybatch, copies);
     deepCopyField(mem, copies);
+    // The lowered program shares its buffers with the original object: it
+    // will be rebuilt on first use.
+    invalidateFusedProgram();
+    fused_code = TVec<int>();
+    fused_epilogue = TVec<int>();
+    fused_constants = Vec();
+    fused_regs = Vec();
+    fused_mappings.clear();
 }
 
 
@@ -70,8 +70,36 @@ class VMatLanguage: public Object
     TVec<RealMapping> mappings;
     mutable Vec pstack;
     mutable Vec myvec;
+    mutable Mat mybatch;
     mutable Vec mem;
 
+    //! A mapping flattened into arrays sorted by range, so that it can be
+    //! applied with a binary search instead of a std::map lookup.
+    struct FusedMapping
+    {
+        Vec low;
+        Vec high;
+        TVec<int> brackets;  //!< bit 0: left bound included, bit 1: right bound included
+        Vec value;
+        real missing_mapsto;
+        bool keep_other_as_is;
+        real other_mapsto;
+
+        inline real map(real val) const;
+    };
+
+    //! The program lowered by lowerProgram(): 'fused_code' works in place on
+    //! the 'fused_regs' registers (one register per stack position), and
+    //! 'fused_epilogue' copies the final stack into the result.
+    mutable bool fused_ready;   //!< Whether lowerProgram() has been called.
+    mutable bool fused_valid;   //!< Whether the lowering succeeded.
+    mutable TVec<int> fused_code;
+    mutable TVec<int> fused_epilogue;
+    mutable Vec fused_constants;
+    mutable Vec fused_regs;
+    mutable int fused_outputsize;
+    mutable vector<FusedMapping> fused_mappings;
+
     // maps opcodes strings to opcodes numbers
     static map<string, int> opcodes;
 
@@ -87,10 +115,33 @@ class VMatLanguage: public Object
     void preprocess(PStream& in,                   map<string, string>& defines,
                     string&  processed_sourcecode, vector<string>&      fieldnames );
 
+    //! Compile 'program' into 'fused_code': the stack is simulated at
+    //! compile time so that each stack position becomes a register,
+    //! constant sub-expressions are folded, runs of consecutive fields or
+    //! constants become a single memcpy and a mapping applied to a field is
+    //! fused into one instruction.  If the program uses an instruction whose
+    //! stack effect is only known at run time (e.g. 'select' or 'varproduct'),
+    //! 'fused_valid' is set to false and the interpreter is used instead.
+    void lowerProgram() const;
+
+    //! Run the lowered program on the 'src' row, writing into 'result'.
+    void runFused(const real* src, real* result, int rowindex) const;
+
+    //! Forget the lowered program (to call whenever 'program' changes).
+    inline void invalidateFusedProgram()
+    { fused_ready = false; fused_valid = false; }
+
 public:
     string sourcecode;
 
-    VMatLanguage():vmsource(Mat()) { build_(); }
+    //! Whether to run the lowered form of the program (see lowerProgram())
+    //! rather than the reference interpreter.
+    bool optimize_program;
+
+    VMatLanguage():
+        vmsource(Mat()), fused_ready(false), fused_valid(false),
+        fused_outputsize(0), optimize_program(true)
+    { build_(); }
     VMatLanguage(VMat vmsrc);
 
     PLEARN_DECLARE_OBJECT(VMatLanguage);
@@ -102,6 +153,19 @@ public:
     //! rowindex is only there for instruction 'rowindex' that pushes it on the stack
     virtual void run(const Vec& srcvec, const Vec& result, int rowindex=-1) const;
 
+    //! Same as run(), but always uses the bytecode interpreter.  This is the
+    //! reference implementation the lowered program must agree with.
+    void runInterpreted(const Vec& srcvec, const Vec& result, int rowindex=-1) const;
+
+    //! Executes the program on each row of 'src', storing the outputs in the
+    //! corresponding rows of 'result'.  Row i is given the row index
+    //! first_rowindex + i.
+    void runBatch(const Mat& src, const Mat& result, int first_rowindex=0) const;
+
+    //! Applies the program to rows first_rowindex to
+    //! first_rowindex + result.length() - 1 of the vmsource VMat.
+    void runBatch(int first_rowindex, const Mat& result) const;
+
     //! Gets the row with the given rowindex from the vmsource VMat
     //! and applies program to it.
     void run(int rowindex, const Vec& result) const;
@@ -139,6 +203,10 @@ public:
     inline operator bool() const
     { return program.length()>0; }
 
+    //! Whether the program uses the 'memput' or 'memget' instructions,
+    //! i.e. whether its result on a row may depend on the previous rows.
+    bool usesMemory() const;
+
     //! Make it an empty program by clearing outputfieldnames, program, mappings
     void clear();
 
@@ -0,0 +1,370 @@
+// -*- C++ -*-
+
+// VMatPipeline.cc
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file VMatPipeline.cc */
+
+#include "VMatPipeline.h"
+#include "VMatRowCursor.h"
+#include <plearn/base/ProgressBar.h>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+namespace PLearn {
+using namespace std;
+
+//////////////////////////
+// VMatPipelineConsumer //
+//////////////////////////
+VMatPipelineConsumer::~VMatPipelineConsumer()
+{}
+
+void VMatPipelineConsumer::start(int n_slots, int n_workers)
+{}
+
+void VMatPipelineConsumer::processBlock(int worker, int slot, int first_row,
+                                        Mat& block)
+{}
+
+namespace {
+
+//! Number of values in a block when 'block_length' is 0.
+const int PIPELINE_BLOCK_SIZE = 1 << 20;
+
+inline double secondsSince(const boost::posix_time::ptime& t)
+{
+    return (boost::posix_time::microsec_clock::universal_time() - t)
+        .total_microseconds() / 1e6;
+}
+
+//! State shared by the workers and the consumer.
+struct PipelineState
+{
+    boost::mutex mx;
+
+    //! Notified whenever a block is ready or consumed, or 'stop' is set.
+    boost::condition_variable cond;
+
+    //! The slots, and whether the block they hold is ready to be consumed.
+    Mat* slots;
+    TVec<int> ready;
+    int n_slots;
+
+    //! One cursor per worker (created and destroyed by the main thread).
+    TVec< PP<VMatRowCursor> > cursors;
+
+    VMatPipelineConsumer* consumer;
+
+    int length;
+    int block_length;
+    int n_blocks;
+
+    //! Next block to be read, and next block to be consumed.
+    int next_read;
+    int next_consume;
+
+    bool stop;
+
+    //! Error message of an exception raised in a worker.
+    string error;
+
+    //! Total time spent by the workers waiting for a free slot.
+    double workers_wait;
+
+    //! Main loop of worker 'worker'.
+    void work(int worker);
+};
+
+void PipelineState::work(int worker)
+{
+    for (;;) {
+        int seq;
+        {
+            boost::mutex::scoped_lock lock(mx);
+            boost::posix_time::ptime wait_start =
+                boost::posix_time::microsec_clock::universal_time();
+            while (!stop && next_read < n_blocks
+                   && next_read >= next_consume + n_slots)
+                cond.wait(lock);
+            workers_wait += secondsSince(wait_start);
+            if (stop || next_read >= n_blocks)
+                return;
+            seq = next_read++;
+        }
+
+        int slot = seq % n_slots;
+        int first = seq * block_length;
+        int n = min(block_length, length - first);
+        try {
+            cursors[worker]->getRows(first, n, slots[slot]);
+            consumer->processBlock(worker, slot, first, slots[slot]);
+        } catch (const PLearnError& e) {
+            boost::mutex::scoped_lock lock(mx);
+            if (error.empty())
+                error = e.message();
+            stop = true;
+            cond.notify_all();
+            return;
+        } catch (...) {
+            // No exception may escape a boost::thread.
+            boost::mutex::scoped_lock lock(mx);
+            if (error.empty())
+                error = "Unknown error while reading or processing a block";
+            stop = true;
+            cond.notify_all();
+            return;
+        }
+
+        boost::mutex::scoped_lock lock(mx);
+        ready[slot] = 1;
+        cond.notify_all();
+    }
+}
+
+//! Function object for the worker threads.
+struct PipelineWorker
+{
+    PipelineState* state;
+    int worker;
+
+    PipelineWorker(PipelineState* state_, int worker_)
+        : state(state_), worker(worker_)
+    {}
+
+    void operator()()
+    {
+        state->work(worker);
+    }
+};
+
+} // end of anonymous namespace
+
+//////////////////
+// VMatPipeline //
+//////////////////
+int VMatPipeline::default_block_length = 0;
+int VMatPipeline::default_n_workers = -1;
+int VMatPipeline::default_memory_cap = 256;
+bool VMatPipeline::default_report_throughput = false;
+
+VMatPipeline::VMatPipeline(const string& the_progress_title):
+    block_length(default_block_length),
+    n_workers(default_n_workers),
+    memory_cap(default_memory_cap),
+    progress_title(the_progress_title),
+    report_throughput(default_report_throughput)
+{}
+
+/////////
+// run //
+/////////
+void VMatPipeline::run(const VMatrix* source,
+                       VMatPipelineConsumer& consumer) const
+{
+    int l = source->length();
+    int w = source->width();
+    if (w < 0)
+        PLERROR("In VMatPipeline::run - The source must have a fixed width");
+    int blen = block_length > 0 ? block_length
+                                : max(1, PIPELINE_BLOCK_SIZE / max(1, w));
+    blen = max(1, min(blen, l));
+    int n_blocks = (l + blen - 1) / blen;
+
+    // The number of slots is bounded by the memory cap; there is no point
+    // in having more than two slots per worker.
+    int nw = n_workers >= 0 ? n_workers
+                            : int(boost::thread::hardware_concurrency());
+    double block_mb = double(blen) * max(1, w) * sizeof(real) / (1 << 20);
+    int n_slots = max(1, int(max(0, memory_cap) / block_mb));
+    n_slots = min(n_slots, max(1, min(n_blocks, 2 * nw)));
+    nw = min(nw, min(n_slots, n_blocks));
+    if (n_slots < 2)
+        nw = 0; // no overlap possible: read in this thread
+
+    PipelineState state;
+    if (nw > 0) {
+        try {
+            state.cursors.resize(nw);
+            for (int t = 0; t < nw; t++)
+                state.cursors[t] = source->newRowCursor();
+        } catch (const PLearnError&) {
+            // Some VMatrices cannot be deep-copied to obtain a cursor: fall
+            // back to reading in this thread.
+            state.cursors.resize(0);
+            nw = 0;
+        }
+    }
+    if (nw == 0) {
+        runSerial(source, consumer, blen);
+        return;
+    }
+
+    // All blocks and views are created here since reference counting is
+    // not thread-safe.
+    TVec<Mat> slots(n_slots);
+    for (int s = 0; s < n_slots; s++)
+        slots[s].resize(blen, w);
+    state.slots = slots.data();
+    state.ready.resize(n_slots);
+    state.ready.fill(0);
+    state.n_slots = n_slots;
+    state.consumer = &consumer;
+    state.length = l;
+    state.block_length = blen;
+    state.n_blocks = n_blocks;
+    state.next_read = 0;
+    state.next_consume = 0;
+    state.stop = false;
+    state.workers_wait = 0;
+
+    consumer.start(n_slots, nw);
+    PP<ProgressBar> pb;
+    if (!progress_title.empty())
+        pb = new ProgressBar(progress_title, l);
+
+    boost::posix_time::ptime run_start =
+        boost::posix_time::microsec_clock::universal_time();
+    double consumer_wait = 0;
+    vector<boost::thread*> threads(nw);
+    for (int t = 0; t < nw; t++)
+        threads[t] = new boost::thread(PipelineWorker(&state, t));
+
+    string consumer_error;
+    try {
+        for (int seq = 0; seq < n_blocks; seq++) {
+            int slot = seq % n_slots;
+            {
+                boost::mutex::scoped_lock lock(state.mx);
+                boost::posix_time::ptime wait_start =
+                    boost::posix_time::microsec_clock::universal_time();
+                while (!state.ready[slot] && !state.stop)
+                    state.cond.wait(lock);
+                consumer_wait += secondsSince(wait_start);
+                if (!state.ready[slot])
+                    break; // a worker failed
+            }
+            consumer.consumeBlock(slot, seq * blen, slots[slot]);
+            {
+                boost::mutex::scoped_lock lock(state.mx);
+                state.ready[slot] = 0;
+                state.next_consume++;
+                state.cond.notify_all();
+            }
+            if (pb)
+                pb->update(min(l, (seq + 1) * blen));
+        }
+    } catch (const PLearnError& e) {
+        consumer_error = e.message();
+    } catch (...) {
+        consumer_error = "In VMatPipeline::run - Unknown error while "
+                         "consuming a block";
+    }
+
+    {
+        boost::mutex::scoped_lock lock(state.mx);
+        state.stop = true;
+        state.cond.notify_all();
+    }
+    for (int t = 0; t < nw; t++) {
+        threads[t]->join();
+        delete threads[t];
+    }
+    if (!state.error.empty())
+        PLERROR("In VMatPipeline::run - %s", state.error.c_str());
+    if (!consumer_error.empty())
+        PLERROR("%s", consumer_error.c_str());
+
+    if (report_throughput) {
+        double elapsed = secondsSince(run_start);
+        double mb = double(l) * w * sizeof(real) / (1 << 20);
+        perr << "Streamed " << l << " rows (" << mb << " MB) in " << elapsed
+             << " s: " << (elapsed > 0 ? l / elapsed : 0) << " rows/s, "
+             << (elapsed > 0 ? mb / elapsed : 0) << " MB/s" << endl
+             << "  " << nw << " workers, " << n_slots << " blocks of "
+             << blen << " rows" << endl
+             << "  consumer waited " << consumer_wait << " s for blocks"
+             << " (reading bound), workers waited " << state.workers_wait
+             << " s for free slots (consumer bound)" << endl;
+    }
+}
+
+///////////////
+// runSerial //
+///////////////
+void VMatPipeline::runSerial(const VMatrix* source,
+                             VMatPipelineConsumer& consumer, int blen) const
+{
+    int l = source->length();
+    consumer.start(1, 1);
+    PP<ProgressBar> pb;
+    if (!progress_title.empty())
+        pb = new ProgressBar(progress_title, l);
+    boost::posix_time::ptime run_start =
+        boost::posix_time::microsec_clock::universal_time();
+
+    Mat block(blen, source->width());
+    for (int first = 0; first < l; first += blen) {
+        int n = min(blen, l - first);
+        block.resize(n, source->width());
+        source->getMat(first, 0, block);
+        consumer.processBlock(0, 0, first, block);
+        consumer.consumeBlock(0, first, block);
+        if (pb)
+            pb->update(first + n);
+    }
+
+    if (report_throughput) {
+        double elapsed = secondsSince(run_start);
+        double mb = double(l) * source->width() * sizeof(real) / (1 << 20);
+        perr << "Streamed " << l << " rows (" << mb << " MB) in " << elapsed
+             << " s: " << (elapsed > 0 ? l / elapsed : 0) << " rows/s, "
+             << (elapsed > 0 ? mb / elapsed : 0) << " MB/s" << endl
+             << "  read in the calling thread, by blocks of " << blen
+             << " rows" << endl;
+    }
+}
+
+} // end of namespace PLearn
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
@@ -0,0 +1,140 @@
+// -*- C++ -*-
+
+// VMatPipeline.h
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file VMatPipeline.h */
+
+
+#ifndef VMatPipeline_INC
+#define VMatPipeline_INC
+
+#include <plearn/vmat/VMatrix.h>
+
+namespace PLearn {
+using namespace std;
+
+/**
+ * Receives the blocks of rows streamed by a VMatPipeline.
+ */
+class VMatPipelineConsumer
+{
+public:
+    virtual ~VMatPipelineConsumer();
+
+    //! Called once by VMatPipeline::run() before any block is read, with the
+    //! number of slots (blocks that may be in memory at the same time) and
+    //! of worker threads. Slot and worker numbers given to the other methods
+    //! are below these. Does nothing by default.
+    virtual void start(int n_slots, int n_workers);
+
+    //! Called by worker 'worker' right after it has read the rows starting
+    //! at 'first_row' into the block of slot 'slot'. Several workers may run
+    //! this at the same time, on different slots: reference-counted objects
+    //! (Vec, Mat, PP...) shared with other threads must not be copied or
+    //! created. Does nothing by default.
+    virtual void processBlock(int worker, int slot, int first_row,
+                              Mat& block);
+
+    //! Called from the thread running the pipeline, for each block in row
+    //! order, once it has been read and processed.
+    virtual void consumeBlock(int slot, int first_row, const Mat& block) = 0;
+};
+
+/**
+ * Streams all rows of a VMat, by blocks and in order, to a consumer.
+ *
+ * Worker threads read the following blocks (through their own row cursor,
+ * see VMatrix::newRowCursor()) while the current block is being consumed
+ * by the thread calling run(), so that reading, processing and writing
+ * overlap. Blocks are recycled through a fixed number of slots, whose
+ * total size is bounded by 'memory_cap'.
+ *
+ * When the source cannot give row cursors, or with no worker, the blocks
+ * are read with VMatrix::getMat() in the calling thread instead.
+ */
+class VMatPipeline
+{
+public:
+    //! Number of rows in each block (0 means about 1M values per block).
+    int block_length;
+
+    //! Number of worker threads reading blocks (-1 means the number of
+    //! cores, 0 means reading in the calling thread).
+    int n_workers;
+
+    //! Maximum size (in MB) of the blocks kept in memory. There is always
+    //! at least one block.
+    int memory_cap;
+
+    //! Title of the progress bar (no progress bar if empty).
+    string progress_title;
+
+    //! If true, a summary of the throughput and of the time spent waiting
+    //! by the workers and the consumer is printed on perr at the end.
+    bool report_throughput;
+
+    //! Values the options are initialized with (e.g. from the command line
+    //! of 'vmat').
+    static int default_block_length;
+    static int default_n_workers;
+    static int default_memory_cap;
+    static bool default_report_throughput;
+
+    VMatPipeline(const string& the_progress_title = "");
+
+    //! Stream all rows of 'source' to 'consumer'. 'source' must not be
+    //! used by another thread during the run.
+    void run(const VMatrix* source, VMatPipelineConsumer& consumer) const;
+
+protected:
+    //! Read and consume all blocks in the calling thread.
+    void runSerial(const VMatrix* source, VMatPipelineConsumer& consumer,
+                   int blen) const;
+};
+
+} // end of namespace PLearn
+
+#endif
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
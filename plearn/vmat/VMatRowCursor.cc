@@ -0,0 +1,111 @@
+// -*- C++ -*-
+
+// VMatRowCursor.cc
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file VMatRowCursor.cc */
+
+
+#include "VMatRowCursor.h"
+#include "VMatrix.h"
+
+namespace PLearn {
+using namespace std;
+
+///////////////////
+// VMatRowCursor //
+///////////////////
+VMatRowCursor::VMatRowCursor(const VMatrix* the_vm):
+    vm(the_vm),
+    length_(the_vm->length()),
+    width_(the_vm->width())
+{}
+
+VMatRowCursor::~VMatRowCursor()
+{}
+
+/////////////
+// getRows //
+/////////////
+void VMatRowCursor::getRows(int i_start, int n, Mat& m)
+{
+    if (i_start < 0 || n < 0 || i_start + n > length_)
+        PLERROR("In VMatRowCursor::getRows - Rows %d to %d are out of the "
+                "valid range [0,%d]", i_start, i_start + n - 1, length_ - 1);
+    m.resize(n, width_);
+    if (n > 0 && width_ > 0)
+        getNewRows(i_start, m);
+}
+
+////////////
+// getRow //
+////////////
+void VMatRowCursor::getRow(int i, Vec& v)
+{
+    if (i < 0 || i >= length_)
+        PLERROR("In VMatRowCursor::getRow - Row %d is out of the valid range "
+                "[0,%d]", i, length_ - 1);
+    v.resize(width_);
+    if (width_ > 0) {
+        Mat m = v.toMat(1, width_);
+        getNewRows(i, m);
+    }
+}
+
+///////////////////////////
+// DeepCopyVMatRowCursor //
+///////////////////////////
+DeepCopyVMatRowCursor::DeepCopyVMatRowCursor(const VMatrix* the_vm,
+                                             PP<VMatrix> the_copy):
+    VMatRowCursor(the_vm),
+    vm_copy(the_copy)
+{}
+
+void DeepCopyVMatRowCursor::getNewRows(int i_start, Mat& m)
+{
+    vm_copy->getMat(i_start, 0, m);
+}
+
+} // end of namespace PLearn
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
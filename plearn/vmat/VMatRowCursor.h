@@ -0,0 +1,125 @@
+// -*- C++ -*-
+
+// VMatRowCursor.h
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file VMatRowCursor.h */
+
+
+#ifndef VMatRowCursor_INC
+#define VMatRowCursor_INC
+
+#include <plearn/base/PP.h>
+#include <plearn/math/TMat.h>
+
+namespace PLearn {
+using namespace std;
+
+class VMatrix;
+
+/**
+ * Read access to the rows of a VMatrix that can be used concurrently.
+ *
+ * A cursor holds its own state (file handles, row buffers...) so that
+ * reading rows through it never modifies the VMatrix it was obtained from.
+ * Several cursors on the same VMatrix may thus be used at the same time,
+ * each of them by a single thread.
+ *
+ * Since reference counting is not thread-safe in PLearn, cursors must be
+ * created (with VMatrix::newRowCursor()) and destroyed from the main thread,
+ * worker threads only being handed plain pointers to them. For the same
+ * reason, a cursor only keeps plain pointers to the data it shares with its
+ * VMatrix, which must thus outlive the cursor and not be modified while the
+ * cursor is in use.
+ */
+class VMatRowCursor: public PPointable
+{
+public:
+    VMatRowCursor(const VMatrix* the_vm);
+
+    virtual ~VMatRowCursor();
+
+    //! Fill 'm' (resized to n x width()) with rows i_start to i_start+n-1.
+    void getRows(int i_start, int n, Mat& m);
+
+    //! Fill 'v' (resized to width()) with row i.
+    void getRow(int i, Vec& v);
+
+    int length() const { return length_; }
+    int width() const { return width_; }
+
+protected:
+    //! The VMatrix this cursor reads from.
+    const VMatrix* vm;
+
+    int length_;
+    int width_;
+
+    //! Fill all rows of 'm' with the rows of the VMatrix starting at
+    //! i_start. 'm' has the VMatrix width and the rows are within bounds.
+    virtual void getNewRows(int i_start, Mat& m) = 0;
+};
+
+/**
+ * Default cursor, reading rows from its own deep copy of the VMatrix.
+ * This is always correct, but may be expensive for VMatrices that hold
+ * their data in memory.
+ */
+class DeepCopyVMatRowCursor: public VMatRowCursor
+{
+public:
+    //! 'the_copy' must be a deep copy of 'the_vm' that is not used anywhere
+    //! else.
+    DeepCopyVMatRowCursor(const VMatrix* the_vm, PP<VMatrix> the_copy);
+
+protected:
+    PP<VMatrix> vm_copy;
+
+    virtual void getNewRows(int i_start, Mat& m);
+};
+
+} // end of namespace PLearn
+
+#endif
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
@@ -46,10 +46,26 @@
 #include <plearn/vmat/VMat.h>
 #include <plearn/math/BottomNI.h>
 #include <plearn/math/TMat_maths.h>
+#include <plearn/math/simd_kernels.h>
+#include <algorithm>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace PLearn {
 using namespace std;
 
+namespace {
+
+//! Number of queries and of data rows in a block of the batch search: a
+//! block of distances fits in the L2 cache, and the matrix product is large
+//! enough to run at full speed.
+const int NN_QUERY_BLOCK = 64;
+const int NN_DATA_BLOCK = 512;
+
+} // end of anonymous namespace
+
 // This is an efficient version of the most basic nearest neighbor search, using a Mat and euclidean distance
 void computeNearestNeighbors(VMat dataset, Vec x, TVec<int>& neighbors, int ignore_row)
 {
@@ -75,6 +91,105 @@ void computeNearestNeighbors(VMat dataset, Vec x, TVec<int>& neighbors, int igno
         PLERROR("All neighbors had 0 distance. Use more neighbors. (There were %i other patterns with same values)",neighbs.nZeros());
 }
 
+void computeNearestNeighbors(const Mat& data, const Mat& queries, int K,
+                             TMat<int>& neighbors, Mat& sq_distances,
+                             bool ignore_same_index, int n_threads)
+{
+    int n = data.length();
+    int m = queries.length();
+    int d = data.width();
+    if (queries.width() != d)
+        PLERROR("In computeNearestNeighbors - Queries have width %d, data "
+                "has width %d", queries.width(), d);
+    neighbors.resize(m, K);
+    sq_distances.resize(m, K);
+    neighbors.fill(-1);
+    sq_distances.fill(MISSING_VALUE);
+    if (m == 0 || n == 0 || K <= 0)
+        return;
+
+    Vec data_norms(n);
+    for (int j = 0; j < n; j++)
+        data_norms[j] = simdDot(data[j], data[j], d);
+    Vec query_norms(m);
+    for (int i = 0; i < m; i++)
+        query_norms[i] = simdDot(queries[i], queries[i], d);
+
+    // Views on the blocks are created here since the reference counting of
+    // Mat is not thread-safe.
+    int n_query_blocks = (m + NN_QUERY_BLOCK - 1) / NN_QUERY_BLOCK;
+    int n_data_blocks = (n + NN_DATA_BLOCK - 1) / NN_DATA_BLOCK;
+    TVec<Mat> query_blocks(n_query_blocks);
+    for (int b = 0; b < n_query_blocks; b++)
+        query_blocks[b] = queries.subMatRows(
+            b * NN_QUERY_BLOCK, min(NN_QUERY_BLOCK, m - b * NN_QUERY_BLOCK));
+    TVec<Mat> data_blocks(n_data_blocks);
+    for (int c = 0; c < n_data_blocks; c++)
+        data_blocks[c] = data.subMatRows(
+            c * NN_DATA_BLOCK, min(NN_DATA_BLOCK, n - c * NN_DATA_BLOCK));
+
+#ifdef _OPENMP
+    int nt = 1;
+    if (!omp_in_parallel())
+        nt = min(n_threads > 0 ? n_threads : omp_get_max_threads(),
+                 n_query_blocks);
+#pragma omp parallel num_threads(nt) if(nt > 1)
+#endif
+    {
+        // Only this thread touches these, so they may be allocated here.
+        Mat products(NN_QUERY_BLOCK, NN_DATA_BLOCK);
+        vector< BottomNI<real> > best(NN_QUERY_BLOCK);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+        for (int b = 0; b < n_query_blocks; b++) {
+            const Mat& query_block = query_blocks[b];
+            int q_start = b * NN_QUERY_BLOCK;
+            int q_length = query_block.length();
+            for (int i = 0; i < q_length; i++)
+                best[i].init(K);
+
+            for (int c = 0; c < n_data_blocks; c++) {
+                const Mat& data_block = data_blocks[c];
+                int d_start = c * NN_DATA_BLOCK;
+                int d_length = data_block.length();
+                Mat block_products =
+                    products.subMat(0, 0, q_length, d_length);
+                productTranspose(block_products, query_block, data_block);
+                for (int i = 0; i < q_length; i++) {
+                    const real* products_i = block_products[i];
+                    real norm_i = query_norms[q_start + i];
+                    for (int j = 0; j < d_length; j++) {
+                        int index = d_start + j;
+                        if (ignore_same_index && index == q_start + i)
+                            continue;
+                        real dist = norm_i + data_norms[index]
+                                    - 2 * products_i[j];
+                        best[i].update(dist > 0 ? dist : 0, index);
+                    }
+                }
+            }
+
+            for (int i = 0; i < q_length; i++) {
+                const TVec< pair<real,int> >& found = best[i].getBottomN();
+                pair<real,int>* found_data = found.data();
+                int n_found = found.length();
+                const real* query = queries[q_start + i];
+                for (int k = 0; k < n_found; k++)
+                    found_data[k].first = simdSquaredDistance(
+                        query, data[found_data[k].second], d);
+                sort(found_data, found_data + n_found);
+                int* neighbors_i = neighbors[q_start + i];
+                real* distances_i = sq_distances[q_start + i];
+                for (int k = 0; k < n_found; k++) {
+                    neighbors_i[k] = found_data[k].second;
+                    distances_i[k] = found_data[k].first;
+                }
+            }
+        }
+    }
+}
+
 
 
 } // end of namespace PLearn
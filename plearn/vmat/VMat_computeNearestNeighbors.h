@@ -46,6 +46,7 @@
 
 // Put includes here
 #include <plearn/math/TVec.h>
+#include <plearn/math/TMat.h>
 
 namespace PLearn {
 using namespace std;
@@ -54,6 +55,26 @@ class VMat;
 
 void computeNearestNeighbors(VMat dataset, Vec x, TVec<int>& neighbors, int ignore_row=-1);
 
+/**
+ *  Batch exhaustive euclidean search: row i of 'neighbors' (resized to
+ *  K columns) gets the indices of the K rows of 'data' closest to row i of
+ *  'queries', by increasing distance, and the same row of 'sq_distances' the
+ *  corresponding squared distances.  Missing neighbors (if data has fewer
+ *  than K rows) are -1 / MISSING_VALUE.  If 'ignore_same_index' is true,
+ *  data row i is never returned for query i (for queries == data).
+ *
+ *  The distances are computed by blocks of queries x data rows as
+ *  |x|^2 + |y|^2 - 2 x.y, the dot products with one matrix product per
+ *  block, and the query blocks are split across 'n_threads' threads (-1
+ *  means as many as OpenMP provides).  The K distances returned are then
+ *  recomputed directly, as the expanded form loses precision for close
+ *  points, so only near-ties may be ordered differently from the one-query
+ *  version above.
+ */
+void computeNearestNeighbors(const Mat& data, const Mat& queries, int K,
+                             TMat<int>& neighbors, Mat& sq_distances,
+                             bool ignore_same_index=false, int n_threads=-1);
+
 
 } // end of namespace PLearn
 
@@ -44,29 +44,146 @@
 #include <plearn/base/Object.h>
 #include "VMat_computeStats.h"
 #include <plearn/vmat/VMat.h>
+#include <plearn/vmat/VMatPipeline.h>
+#include <plearn/vmat/VMatRowCursor.h>
 #include <plearn/math/StatsCollector.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace PLearn {
 using namespace std;
 
-TVec<StatsCollector> computeStats(VMat m, int maxnvalues, bool report_progress)
+namespace {
+
+//! Number of values read at once by each thread (row-parallel version).
+const int STATS_BLOCK_SIZE = 1 << 18;
+
+//! Column-parallel version: blocks of rows are read ahead by the worker
+//! threads of a VMatPipeline, and the columns of each block are split among
+//! the OpenMP threads to update the StatsCollectors.
+struct ColumnStatsConsumer: public VMatPipelineConsumer
+{
+    StatsCollector* stats_data;
+    int n_threads;
+
+    ColumnStatsConsumer(StatsCollector* the_stats_data, int the_n_threads):
+        stats_data(the_stats_data), n_threads(the_n_threads)
+    {}
+
+    virtual void consumeBlock(int slot, int first_row, const Mat& block)
+    {
+        int n = block.length();
+        int w = block.width();
+        if (n == 0 || w == 0)
+            return;
+        const real* block_data = block.data();
+        int mod = block.mod();
+        StatsCollector* stats = stats_data;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(n_threads) schedule(dynamic, 8)
+#endif
+        for (int j = 0; j < w; j++) {
+            StatsCollector& st = stats[j];
+            const real* x = block_data + j;
+            for (int i = 0; i < n; i++, x += mod)
+                st.update(*x);
+        }
+    }
+};
+
+//! Row-parallel version: each thread computes the statistics of a
+//! contiguous range of rows, which are then merged in order.
+void computeStatsByRows(VMat m, int maxnvalues, TVec<StatsCollector>& stats,
+                        const TVec< PP<VMatRowCursor> >& cursors,
+                        PP<ProgressBar> pbar)
+{
+    int n_threads = cursors.length();
+    int w = m.width();
+    int l = m.length();
+    int block_length = max(1, STATS_BLOCK_SIZE / max(1, w));
+
+    TVec< TVec<StatsCollector> > thread_stats(n_threads);
+    TVec<Mat> blocks(n_threads);
+    for (int t = 0; t < n_threads; t++) {
+        thread_stats[t] = TVec<StatsCollector>(w, StatsCollector(maxnvalues));
+        blocks[t].resize(block_length, w);
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(n_threads) schedule(static, 1)
+#endif
+    for (int t = 0; t < n_threads; t++) {
+        int start = int((int64_t)l * t / n_threads);
+        int end = int((int64_t)l * (t + 1) / n_threads);
+        StatsCollector* st = thread_stats[t].data();
+        Mat& block = blocks[t];
+        for (int i_block = start; i_block < end; i_block += block_length) {
+            int n = min(block_length, end - i_block);
+            cursors[t]->getRows(i_block, n, block);
+            for (int i = 0; i < n; i++) {
+                const real* x = block[i];
+                for (int j = 0; j < w; j++)
+                    st[j].update(x[j]);
+            }
+            // The progress bar is only displayed by the first thread.
+            if (t == 0 && pbar)
+                pbar->update(int((int64_t)(i_block + n) * n_threads));
+        }
+    }
+
+    stats = thread_stats[0];
+    for (int t = 1; t < n_threads; t++)
+        for (int j = 0; j < w; j++)
+            stats[j].merge(thread_stats[t][j]);
+    if (pbar)
+        pbar->update(l);
+}
+
+} // end of anonymous namespace
+
+TVec<StatsCollector> computeStats(VMat m, int maxnvalues, bool report_progress,
+                                  int n_threads)
 {
     int w = m.width();
     int l = m.length();
     PLCHECK(w>=0);
     TVec<StatsCollector> stats(w, StatsCollector(maxnvalues));
-    Vec v(w);
-    PP<ProgressBar> pbar;
-    if (report_progress)
-        pbar = new ProgressBar("Computing statistics", l);
-    for(int i=0; i<l; i++)
-    {
-        m->getRow(i,v);
-        for(int j=0; j<w; j++)
-            stats[j].update(v[j]);
-        if (report_progress)
-            pbar->update(i);
+
+#ifdef _OPENMP
+    if (n_threads < 0)
+        n_threads = omp_in_parallel() ? 1 : omp_get_max_threads();
+#else
+    n_threads = 1;
+#endif
+    n_threads = max(1, min(n_threads, l));
+
+    if (n_threads > 1 && w > 0 && w < n_threads
+        && (maxnvalues == 0 || maxnvalues == -1)) {
+        TVec< PP<VMatRowCursor> > cursors;
+        try {
+            cursors.resize(n_threads);
+            for (int t = 0; t < n_threads; t++)
+                cursors[t] = m->newRowCursor();
+        } catch (const PLearnError&) {
+            // Some VMatrices cannot be deep-copied to obtain a cursor: use
+            // the column-parallel version, which can read in this thread.
+            cursors.resize(0);
+        }
+        if (cursors.length() > 0) {
+            PP<ProgressBar> pbar;
+            if (report_progress)
+                pbar = new ProgressBar("Computing statistics", l);
+            computeStatsByRows(m, maxnvalues, stats, cursors, pbar);
+            return stats;
+        }
     }
+
+    // Each StatsCollector sees the rows in order, so that the result does
+    // not depend on the number of threads.
+    ColumnStatsConsumer consumer(w > 0 ? stats.data() : 0, n_threads);
+    VMatPipeline(report_progress ? "Computing statistics" : "")
+        .run(m, consumer);
     return stats;
 }
 
@@ -53,8 +53,25 @@ using namespace std;
 class VMat;
 class StatsCollector;
 
-//! Returns the unconditional statistics of each field
-TVec<StatsCollector> computeStats(VMat m, int maxnvalues, bool report_progress = true);
+/**
+ * Returns the unconditional statistics of each field.
+ *
+ * The rows are read in blocks by the worker threads of a VMatPipeline,
+ * ahead of the block being processed. The columns of each block are then
+ * split among the threads, so that each StatsCollector still sees the rows
+ * in order: the result is exactly the same as with a single thread. When
+ * there are fewer columns than threads and the StatsCollectors can be
+ * merged (maxnvalues is 0 or -1), the rows are instead split among the
+ * threads, and the per-thread StatsCollectors are merged at the end (the
+ * sums may then differ in the last bits).
+ *
+ * 'n_threads' is the number of threads updating the statistics; -1 means
+ * the default number of OpenMP threads. Without OpenMP, a single thread is
+ * always used. The number of reading threads is that of VMatPipeline.
+ */
+TVec<StatsCollector> computeStats(VMat m, int maxnvalues,
+                                  bool report_progress = true,
+                                  int n_threads = -1);
 
 
 } // end of namespace PLearn
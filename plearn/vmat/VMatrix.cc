@@ -39,10 +39,13 @@
  ******************************************************* */
 
 #include "VMatrix.h"
+#include "ColumnarVMatrix.h"
 #include "CompactFileVMatrix.h"
 #include "DiskVMatrix.h"
 #include "FileVMatrix.h"
 #include "SubVMatrix.h"
+#include "VMatPipeline.h"
+#include "VMatRowCursor.h"
 #include "VMat_computeStats.h"
 #include <plearn/base/tostring.h>
 #include <plearn/base/lexical_cast.h>
@@ -63,6 +66,51 @@ using namespace std;
 // TODO-PPath   : this class is now PPath compliant
 // TODO-PStream : this class is now PStream compliant
 
+namespace {
+
+//! Checks whether all values streamed by a VMatPipeline are exactly
+//! representable as floats (for savePMAT() with auto_float).
+struct FloatCheckConsumer: public VMatPipelineConsumer
+{
+    bool found_not_equal;
+
+    FloatCheckConsumer(): found_not_equal(false) {}
+
+    virtual void consumeBlock(int slot, int first_row, const Mat& block)
+    {
+        for(int i=0; i<block.length() && !found_not_equal; i++) {
+            const real* v = block[i];
+            for(int j=0; j<block.width(); j++)
+                if( ((double)((float)(v[j])))!=v[j] ){
+                    found_not_equal=true;break;
+                }
+        }
+    }
+};
+
+//! Writes the rows streamed by a VMatPipeline to a FileVMatrix, or appends
+//! them to a DiskVMatrix.
+struct SaveRowsConsumer: public VMatPipelineConsumer
+{
+    FileVMatrix* pmat;
+    DiskVMatrix* dmat;
+
+    SaveRowsConsumer(FileVMatrix* the_pmat, DiskVMatrix* the_dmat):
+        pmat(the_pmat), dmat(the_dmat)
+    {}
+
+    virtual void consumeBlock(int slot, int first_row, const Mat& block)
+    {
+        for(int k=0; k<block.length(); k++)
+            if (pmat)
+                pmat->putRow(first_row+k, block(k));
+            else
+                dmat->appendRow(block(k));
+    }
+};
+
+} // end of anonymous namespace
+
 PLEARN_IMPLEMENT_ABSTRACT_OBJECT(
     VMatrix,
     "Base classes for virtual matrices",
@@ -751,6 +799,14 @@ void VMatrix::getExamples(int i_start, int length, Mat& inputs, Mat& targets,
     }
 }
 
+//////////////////
+// newRowCursor //
+//////////////////
+PP<VMatRowCursor> VMatrix::newRowCursor() const
+{
+    return new DeepCopyVMatRowCursor(this, PLearn::deepCopy(this));
+}
+
 //////////////
 // getExtra //
 //////////////
@@ -2063,17 +2119,9 @@ void VMatrix::savePMAT(const PPath& pmatfile, bool force_float,
 #ifdef USEFLOAT
         PLERROR("VMatrix::savePMAT() - auto_float can't reliably select  float or double when compiled in float. Compile it in double.");
 #endif
-        Vec v(width());
-        bool found_not_equal=false;
-        for(int i=0;i<length();i++){
-            getRow(i,v);
-            for(int j=0;j<width();j++){
-                if( ((double)((float)(v[j])))!=v[j] ){
-                    found_not_equal=true;break;
-                }
-            }
-        }
-        if(!found_not_equal){
+        FloatCheckConsumer check;
+        VMatPipeline().run(this, check);
+        if(!check.found_not_equal){
             force_float=true;
             pout<<"We will store the result matrix in FLOAT format."<<endl;
         }
@@ -2085,16 +2133,10 @@ void VMatrix::savePMAT(const PPath& pmatfile, bool force_float,
     m.setMetaInfoFrom(this);
     // m.setFieldInfos(getFieldInfos());
     // m.copySizesFrom(this);
-    Vec tmpvec(width());
-
-    ProgressBar pb(cout, "Saving to pmat", nsamples);
-
-    for(int i=0; i<nsamples; i++)
-    { 
-        getRow(i,tmpvec);
-        m.putRow(i,tmpvec);
-        pb(i);
-    }
+    // Rows are read by blocks in worker threads while the previous blocks
+    // are written (see VMatPipeline).
+    SaveRowsConsumer save(&m, 0);
+    VMatPipeline("Saving to pmat").run(this, save);
     m.saveFieldInfos();
     m.saveAllStringMappings();
     }// to ensure that m is deleted?
@@ -2115,20 +2157,20 @@ void VMatrix::saveDMAT(const PPath& dmatdir) const
     vm.setMetaInfoFrom(this);
     // vm.setFieldInfos(getFieldInfos());
     // vm.copySizesFrom(this);
-    Vec v(width());
-
-    ProgressBar pb(cout, "Saving to dmat", length());
-
-    for(int i=0;i<length();i++)
-    {
-        getRow(i,v);
-        vm.appendRow(v);
-        pb(i);
-    }
+    SaveRowsConsumer save(0, &vm);
+    VMatPipeline("Saving to dmat").run(this, save);
     vm.saveFieldInfos();
     vm.saveAllStringMappings();
 }
 
+////////////////
+// saveCOLMAT //
+////////////////
+void VMatrix::saveCOLMAT(const PPath& colmatdir, int block_length) const
+{
+    ColumnarVMatrix::writeFrom(this, colmatdir, block_length);
+}
+
 //////////////
 // saveAMAT //
 //////////////
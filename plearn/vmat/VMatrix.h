@@ -58,6 +58,7 @@ namespace PLearn {
 using namespace std;
 
 class VMat;
+class VMatRowCursor;
 
 /**
  *  Base classes for virtual matrices
@@ -332,6 +333,10 @@ public:
     /// Save the VMatrix in DMat format
     virtual void saveDMAT(const PPath& dmatdir) const;
 
+    /// Save the VMatrix as a '.colmat' columnar directory (see
+    /// ColumnarVMatrix), with blocks of 'block_length' rows.
+    virtual void saveCOLMAT(const PPath& colmatdir, int block_length = 1024) const;
+
     /**
      *  Save the content of the matrix in the AMAT ASCII format into a file.
      *  If 'no_header' is set to 'true', then the AMAT header won't be saved,
@@ -502,7 +507,9 @@ public:
     //! may ask for a subset that goes beyond this VMat's length: in such a
     //! case, the rest of the subset will be filled with data found at the
     //! beginning of this VMat.
-    void getExamples(int i_start, int length, Mat& inputs, Mat& targets,
+    //! Subclasses may override this method to fill the matrices more
+    //! efficiently (e.g. by making them point directly to their data).
+    virtual void getExamples(int i_start, int length, Mat& inputs, Mat& targets,
                      Vec& weights, Mat* extra = NULL,
                      bool allow_circular = false);
 
@@ -574,6 +581,16 @@ public:
     //! remote version of getColumn: return newly alloc'd vec
     Vec remote_getColumn(int i) const;
 
+    /**
+     *  Return a new cursor giving read access to the rows of this VMatrix
+     *  independently of its own row buffers, so that several threads may read
+     *  from it concurrently, each with its own cursor (see VMatRowCursor).
+     *  The default version reads from a deep copy of this VMatrix;
+     *  subclasses should override it with a lighter cursor when possible.
+     *  Must be called from the main thread.
+     */
+    virtual PP<VMatRowCursor> newRowCursor() const;
+
     /**
      *  Return true iff the input vector is in this VMat (we compare only the
      *  input part).  If the parameter 'i' is provided, it will be filled with
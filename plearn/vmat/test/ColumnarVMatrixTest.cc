@@ -0,0 +1,280 @@
+// -*- C++ -*-
+
+// ColumnarVMatrixTest.cc
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file ColumnarVMatrixTest.cc */
+
+
+#include "ColumnarVMatrixTest.h"
+#include <plearn/vmat/ColumnarVMatrix.h>
+#include <plearn/vmat/MemoryVMatrix.h>
+#include <plearn/base/byte_order.h>
+#include <plearn/io/fileutils.h>
+#include <plearn/io/pl_io_deprecated.h>
+
+namespace PLearn {
+using namespace std;
+
+PLEARN_IMPLEMENT_OBJECT(
+    ColumnarVMatrixTest,
+    "Round trip of a matrix through a '.colmat' directory",
+    "Each column of the written matrix is designed to be stored with one of\n"
+    "the encodings of ColumnarVMatrix; the values read back, the field names\n"
+    "and the encoding and statistics of each block are checked.\n"
+);
+
+namespace {
+
+//! Exact comparison, where missing values are equal.
+bool sameValues(const Mat& a, const Mat& b)
+{
+    if (a.length() != b.length() || a.width() != b.width())
+        return false;
+    for (int i = 0; i < a.length(); i++)
+        for (int j = 0; j < a.width(); j++)
+            if (is_missing(a(i, j)) ? !is_missing(b(i, j))
+                : !fast_exact_is_equal(a(i, j), b(i, j))) {
+                perr << "Different values at row " << i << ", column " << j
+                     << ": " << a(i, j) << " and " << b(i, j) << endl;
+                return false;
+            }
+    return true;
+}
+
+//! Check the encoding (see ColumnarVMatrix.cc: 0 for double, 1 for
+//! float32, 2 for packed integers and 3 for a dictionary) and the
+//! statistics stored for each block of column j.
+bool checkBlocks(const PPath& dirname, int j, const Mat& data,
+                 int block_length, const TVec<int>& encodings)
+{
+    PPath fname = dirname / (tostring(j) + ".blocks");
+    FILE* f = fopen(fname.absolute().c_str(), "rb");
+    if (!f)
+        return false;
+    bool bigendian = (byte_order() == BIG_ENDIAN_ORDER);
+    bool ok = true;
+    int ints[4];
+    double doubles[4];
+    for (int b = 0; ok && b < encodings.length(); b++) {
+        fread_int(f, ints, 4, bigendian);
+        fread_double(f, doubles, 4, bigendian);
+        int start = b * block_length;
+        int n = min(block_length, data.length() - start);
+        int n_missing = 0;
+        real mn = MISSING_VALUE;
+        real mx = MISSING_VALUE;
+        for (int k = 0; k < n; k++) {
+            real x = data(start + k, j);
+            if (is_missing(x))
+                n_missing++;
+            else {
+                if (is_missing(mn) || x < mn)
+                    mn = x;
+                if (is_missing(mx) || x > mx)
+                    mx = x;
+            }
+        }
+        if (ints[0] != encodings[b]) {
+            perr << "Block " << b << " of column " << j << " has encoding "
+                 << ints[0] << " instead of " << encodings[b] << endl;
+            ok = false;
+        }
+        if (ints[2] != n_missing
+            || (is_missing(mn) ? !is_missing(doubles[2])
+                : !fast_exact_is_equal(doubles[2], mn))
+            || (is_missing(mx) ? !is_missing(doubles[3])
+                : !fast_exact_is_equal(doubles[3], mx))) {
+            perr << "Wrong statistics for block " << b << " of column " << j
+                 << endl;
+            ok = false;
+        }
+    }
+    if (ferror(f) || feof(f))
+        ok = false;
+    fclose(f);
+    return ok;
+}
+
+} // end of anonymous namespace
+
+/////////////////////////
+// ColumnarVMatrixTest //
+/////////////////////////
+ColumnarVMatrixTest::ColumnarVMatrixTest():
+    block_length(8)
+{
+}
+
+///////////
+// build //
+///////////
+void ColumnarVMatrixTest::build()
+{
+    inherited::build();
+    build_();
+}
+
+/////////////////////////////////
+// makeDeepCopyFromShallowCopy //
+/////////////////////////////////
+void ColumnarVMatrixTest::makeDeepCopyFromShallowCopy(CopiesMap& copies)
+{
+    inherited::makeDeepCopyFromShallowCopy(copies);
+}
+
+////////////////////
+// declareOptions //
+////////////////////
+void ColumnarVMatrixTest::declareOptions(OptionList& ol)
+{
+    declareOption(ol, "block_length", &ColumnarVMatrixTest::block_length,
+                  OptionBase::buildoption,
+                  "Number of rows of each block.");
+
+    // Now call the parent class' declareOptions
+    inherited::declareOptions(ol);
+}
+
+////////////
+// build_ //
+////////////
+void ColumnarVMatrixTest::build_()
+{
+}
+
+/////////////
+// perform //
+/////////////
+void ColumnarVMatrixTest::perform()
+{
+    // The encodings below are the most compact ones for blocks of 8 rows,
+    // the last block (5 rows) being shorter.
+    PLCHECK( block_length == 8 );
+    int n = 4 * block_length + 5;
+    int n_blocks = 5;
+    Mat data(n, 5);
+    for (int i = 0; i < n; i++) {
+        // Integers (with a missing value): packed integers.
+        data(i, 0) = i == 5 ? MISSING_VALUE : real(i);
+        // Few distinct values, not exact as float32: dictionary.
+        data(i, 1) = 0.1 * (i % 3 + 1);
+        // Distinct values exact as float32: float32.
+        data(i, 2) = i * 0.5 + 0.25;
+        // Distinct values not exact as float32: double.
+        data(i, 3) = sqrt(real(i + 2));
+        // A constant, except for a block of missing values: packed
+        // integers, with no bits for the constant blocks.
+        data(i, 4) = i / block_length == 2 ? MISSING_VALUE : 7;
+    }
+    MemoryVMatrix* source = new MemoryVMatrix(data);
+    TVec<string> fieldnames;
+    fieldnames.append("int");
+    fieldnames.append("dictionary");
+    fieldnames.append("float");
+    fieldnames.append("double");
+    fieldnames.append("constant");
+    source->declareFieldNames(fieldnames);
+    VMat source_vm = source;
+
+    PPath dirname = "columnar_test.colmat";
+    ColumnarVMatrix::writeFrom(source, dirname, block_length);
+    PP<ColumnarVMatrix> colmat = new ColumnarVMatrix(dirname);
+
+    pout << "Sizes and field names" << endl;
+    bool ok = colmat->length() == n && colmat->width() == data.width()
+        && colmat->blockLength() == block_length
+        && colmat->nBlocks() == n_blocks;
+    for (int j = 0; ok && j < data.width(); j++)
+        ok = colmat->fieldName(j) == fieldnames[j];
+    pout << (ok ? "OK" : "FAILED") << endl;
+
+    pout << "Encodings and block statistics" << endl;
+    TVec<int> encodings(n_blocks);
+    ok = true;
+    int column_encodings[4] = { 2, 3, 1, 0 };
+    for (int j = 0; j < 4; j++) {
+        encodings.fill(column_encodings[j]);
+        ok = checkBlocks(dirname, j, data, block_length, encodings) && ok;
+    }
+    encodings.fill(2);
+    ok = checkBlocks(dirname, 4, data, block_length, encodings) && ok;
+    pout << (ok ? "OK" : "FAILED") << endl;
+
+    pout << "Values read with getMat()" << endl;
+    pout << (sameValues(data, colmat->toMat()) ? "OK" : "FAILED") << endl;
+
+    pout << "Values read with get(), getSubRow() and getColumn()" << endl;
+    ok = true;
+    // Rows in decreasing order, so that the cached blocks change.
+    Mat values(n, data.width());
+    for (int i = n - 1; i >= 0; i--)
+        for (int j = 0; j < data.width(); j++)
+            values(i, j) = colmat->get(i, j);
+    ok = sameValues(data, values) && ok;
+    for (int i = 0; i < n; i++)
+        colmat->getSubRow(i, 1, values(i).subVec(1, 3));
+    ok = sameValues(data, values) && ok;
+    Vec column(n);
+    for (int j = 0; j < data.width(); j++) {
+        colmat->getColumn(j, column);
+        for (int i = 0; i < n; i++)
+            values(i, j) = column[i];
+    }
+    ok = sameValues(data, values) && ok;
+    pout << (ok ? "OK" : "FAILED") << endl;
+
+    pout << "Sub-matrix across blocks" << endl;
+    Mat sub(block_length + 6, 3);
+    colmat->getMat(3, 2, sub);
+    pout << (sameValues(data.subMat(3, 2, block_length + 6, 3), sub)
+             ? "OK" : "FAILED") << endl;
+
+    colmat = 0;
+    force_rmdir(dirname);
+    force_rmdir(dirname + ".metadata");
+}
+
+} // end of namespace PLearn
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
@@ -0,0 +1,258 @@
+// -*- C++ -*-
+
+// FilteredVMatrixTest.cc
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file FilteredVMatrixTest.cc */
+
+
+
+#include "FilteredVMatrixTest.h"
+#include <plearn/vmat/DiskVMatrix.h>
+#include <plearn/vmat/FilteredVMatrix.h>
+#include <plearn/io/fileutils.h>
+#include <plearn/io/IntVecFile.h>
+
+namespace PLearn {
+using namespace std;
+
+PLEARN_IMPLEMENT_OBJECT(
+    FilteredVMatrixTest,
+    "Extension of the FilteredVMatrix index files when the source grows",
+    "Rows are appended to a DiskVMatrix filtered with a metadata directory;\n"
+    "the filtered rows are compared with those of a FilteredVMatrix without\n"
+    "metadata directory, which computes its indices from scratch.\n"
+);
+
+namespace {
+
+//! Program without memory: its index files can be extended.
+const string FILTER_PRG = "%1 1 >";
+
+//! Program selecting the rows whose second column differs from the one of
+//! the previous row, which is kept in the VPL memory (position 0). The
+//! first memput initializes this memory on the first row only.
+const string MEMORY_FILTER_PRG =
+    "0 rowindex 0 == 0 1 ifelse memput %1 0 memget != %1 0 memput";
+
+//! Append rows 'start' to 'end' - 1 to the DiskVMatrix 'dirname', creating
+//! it if 'start' is 0. The first column is the row number.
+void appendSourceRows(const PPath& dirname, int start, int end)
+{
+    PP<DiskVMatrix> dmat = start == 0 ? new DiskVMatrix(dirname, 2)
+                                      : new DiskVMatrix(dirname, true);
+    Vec row(2);
+    for (int i = start; i < end; i++) {
+        row[0] = i;
+        row[1] = (i * i) % 7;
+        dmat->appendRow(row);
+    }
+    dmat->flush();
+}
+
+//! Whether 'filtered' has the same rows as a FilteredVMatrix with the same
+//! program, whose indices are computed in memory.
+bool sameAsRebuild(VMat source, const string& prg, VMat filtered)
+{
+    VMat rebuilt = new FilteredVMatrix(source, prg, "", false);
+    if (filtered.length() != rebuilt.length()
+        || filtered.width() != rebuilt.width()) {
+        perr << "Filtered " << filtered.length() << " rows instead of "
+             << rebuilt.length() << endl;
+        return false;
+    }
+    Mat rows = filtered.toMat();
+    Mat expected = rebuilt.toMat();
+    for (int i = 0; i < rows.length(); i++)
+        if (!fast_exact_is_equal(rows(i, 0), expected(i, 0))) {
+            perr << "Row " << i << " is source row " << rows(i, 0)
+                 << " instead of " << expected(i, 0) << endl;
+            return false;
+        }
+    return true;
+}
+
+//! Append to 'runs' the pairs (count, number of rows) encoding whether each
+//! of the source rows 'start' to 'end' - 1 is selected by FILTER_PRG.
+void appendExpectedRuns(TVec<int>& runs, int start, int end)
+{
+    for (int i = start; i < end; i++) {
+        int count = (i * i) % 7 > 1 ? 1 : 0;
+        if (i > start && runs[runs.length() - 2] == count)
+            runs.lastElement()++;
+        else {
+            runs.append(count);
+            runs.append(1);
+        }
+    }
+}
+
+} // end of anonymous namespace
+
+/////////////////////////
+// FilteredVMatrixTest //
+/////////////////////////
+FilteredVMatrixTest::FilteredVMatrixTest():
+    n_initial_rows(7),
+    n_appended_rows(15)
+{
+}
+
+///////////
+// build //
+///////////
+void FilteredVMatrixTest::build()
+{
+    inherited::build();
+    build_();
+}
+
+/////////////////////////////////
+// makeDeepCopyFromShallowCopy //
+/////////////////////////////////
+void FilteredVMatrixTest::makeDeepCopyFromShallowCopy(CopiesMap& copies)
+{
+    inherited::makeDeepCopyFromShallowCopy(copies);
+}
+
+////////////////////
+// declareOptions //
+////////////////////
+void FilteredVMatrixTest::declareOptions(OptionList& ol)
+{
+    declareOption(ol, "n_initial_rows", &FilteredVMatrixTest::n_initial_rows,
+                  OptionBase::buildoption,
+                  "Number of rows of the source before rows are appended to it.");
+
+    declareOption(ol, "n_appended_rows", &FilteredVMatrixTest::n_appended_rows,
+                  OptionBase::buildoption,
+                  "Number of rows appended to the source.");
+
+    // Now call the parent class' declareOptions
+    inherited::declareOptions(ol);
+}
+
+////////////
+// build_ //
+////////////
+void FilteredVMatrixTest::build_()
+{
+}
+
+/////////////
+// perform //
+/////////////
+void FilteredVMatrixTest::perform()
+{
+    // With these sizes, the last initial row and the first appended row are
+    // both rejected by FILTER_PRG, so that the run-length encoding of an
+    // extended index differs from the one of a rebuilt index. The first
+    // appended row is also selected by MEMORY_FILTER_PRG only when it is
+    // evaluated after the initial rows.
+    PLCHECK( n_initial_rows == 7 && n_appended_rows > 0 );
+    int n = n_initial_rows + n_appended_rows;
+    PPath dirname = "filtered_test.dmat";
+    PPath metadatadir = "filtered_test.filtered";
+    PPath memory_metadatadir = "filtered_test.memory_filtered";
+    force_rmdir(dirname);
+    force_rmdir(dirname + ".metadata");
+    force_rmdir(metadatadir);
+    force_rmdir(memory_metadatadir);
+
+    appendSourceRows(dirname, 0, n_initial_rows);
+    VMat source = new DiskVMatrix(dirname);
+    VMat filtered = new FilteredVMatrix(source, FILTER_PRG, metadatadir,
+                                        false);
+    VMat memory_filtered = new FilteredVMatrix(source, MEMORY_FILTER_PRG,
+                                               memory_metadatadir, false);
+
+    pout << "Index files built from scratch" << endl;
+    bool ok = sameAsRebuild(source, FILTER_PRG, filtered)
+        && sameAsRebuild(source, MEMORY_FILTER_PRG, memory_filtered);
+    pout << (ok ? "OK" : "FAILED") << endl;
+
+    // Release the index files before they are updated.
+    filtered = 0;
+    memory_filtered = 0;
+    source = 0;
+    appendSourceRows(dirname, n_initial_rows, n);
+    source = new DiskVMatrix(dirname);
+
+    pout << "Index files extended with the appended rows" << endl;
+    filtered = new FilteredVMatrix(source, FILTER_PRG, metadatadir, false);
+    ok = sameAsRebuild(source, FILTER_PRG, filtered);
+    // The run-length encoding of the selection is appended to, rather than
+    // rewritten, and the checksum of the indexed rows is saved.
+    TVec<int> expected_runs;
+    appendExpectedRuns(expected_runs, 0, n_initial_rows);
+    appendExpectedRuns(expected_runs, n_initial_rows, n);
+    TVec<int> runs =
+        IntVecFile((metadatadir / "filtered.rle").absolute()).getVec();
+    if (runs.length() != expected_runs.length()
+        || !isfile(metadatadir / "filtered.sum")) {
+        perr << "The index files were not extended" << endl;
+        ok = false;
+    }
+    for (int k = 0; ok && k < runs.length(); k++)
+        ok = runs[k] == expected_runs[k];
+    pout << (ok ? "OK" : "FAILED") << endl;
+
+    pout << "Index files rebuilt for a program using the VPL memory" << endl;
+    memory_filtered = new FilteredVMatrix(source, MEMORY_FILTER_PRG,
+                                          memory_metadatadir, false);
+    ok = sameAsRebuild(source, MEMORY_FILTER_PRG, memory_filtered)
+        && !isfile(memory_metadatadir / "filtered.sum");
+    pout << (ok ? "OK" : "FAILED") << endl;
+
+    filtered = 0;
+    memory_filtered = 0;
+    source = 0;
+    force_rmdir(dirname);
+    force_rmdir(dirname + ".metadata");
+    force_rmdir(metadatadir);
+    force_rmdir(memory_metadatadir);
+}
+
+} // end of namespace PLearn
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
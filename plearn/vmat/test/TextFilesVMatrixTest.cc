@@ -0,0 +1,277 @@
+// -*- C++ -*-
+
+// TextFilesVMatrixTest.cc
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file TextFilesVMatrixTest.cc */
+
+
+#include "TextFilesVMatrixTest.h"
+#include <plearn/vmat/TextFilesVMatrix.h>
+#include <plearn/io/fileutils.h>
+#include <fstream>
+
+namespace PLearn {
+using namespace std;
+
+PLEARN_IMPLEMENT_OBJECT(
+    TextFilesVMatrixTest,
+    "Compares the bulk and per-field parsing of TextFilesVMatrix",
+    "The rows read with getRow() and with the threaded getMat() must be the\n"
+    "same as the ones obtained by splitting each row with getTextFields()\n"
+    "and converting each field with transformStringToValue(), which is the\n"
+    "way rows used to be parsed.\n"
+);
+
+namespace {
+
+//! Write 'text' as is (no newline conversion) into file 'path'.
+void writeTextFile(const string& path, const string& text)
+{
+    ofstream out(path.c_str(), ios::out | ios::binary);
+    out << text;
+}
+
+//! Build a TextFilesVMatrix on the given files, with its own metadatadir
+//! (thus its own mappings).
+PP<TextFilesVMatrix> makeTextFilesVMatrix(
+    const TVec<PPath>& files, const TVec<int>& skipheader,
+    const string& delimiter, const string& quote_delimiter,
+    const TVec< pair<string, string> >& fieldspec,
+    const string& metadatadir, int n_threads)
+{
+    PP<TextFilesVMatrix> txtmat = new TextFilesVMatrix();
+    txtmat->txtfilenames = files;
+    txtmat->skipheader = skipheader;
+    txtmat->delimiter = delimiter;
+    txtmat->quote_delimiter = quote_delimiter;
+    txtmat->fieldspec = fieldspec;
+    txtmat->n_threads = n_threads;
+    txtmat->setOption("metadatadir", metadatadir);
+    txtmat->build();
+    return txtmat;
+}
+
+//! Rows parsed field by field, as TextFilesVMatrix::getNewRow() used to.
+Mat parseFieldByField(const TextFilesVMatrix& txtmat)
+{
+    Mat m(txtmat.length(), txtmat.width());
+    for (int i = 0; i < m.length(); i++) {
+        TVec<string> fields = txtmat.getTextFields(i);
+        for (int k = 0; k < fields.length(); k++)
+            txtmat.transformStringToValue(
+                k, fields[k], m(i).subVec(txtmat.colrange[k].first,
+                                          txtmat.colrange[k].second));
+    }
+    return m;
+}
+
+//! Exact comparison, where missing values are equal.
+bool sameRows(const Mat& a, const Mat& b)
+{
+    if (a.length() != b.length() || a.width() != b.width())
+        return false;
+    for (int i = 0; i < a.length(); i++)
+        for (int j = 0; j < a.width(); j++)
+            if (is_missing(a(i, j)) ? !is_missing(b(i, j))
+                : !fast_exact_is_equal(a(i, j), b(i, j))) {
+                perr << "Different values at row " << i << ", column " << j
+                     << ": " << a(i, j) << " and " << b(i, j) << endl;
+                return false;
+            }
+    return true;
+}
+
+} // end of anonymous namespace
+
+//////////////////////////
+// TextFilesVMatrixTest //
+//////////////////////////
+TextFilesVMatrixTest::TextFilesVMatrixTest():
+    n_threads(4)
+{
+}
+
+///////////
+// build //
+///////////
+void TextFilesVMatrixTest::build()
+{
+    inherited::build();
+    build_();
+}
+
+/////////////////////////////////
+// makeDeepCopyFromShallowCopy //
+/////////////////////////////////
+void TextFilesVMatrixTest::makeDeepCopyFromShallowCopy(CopiesMap& copies)
+{
+    inherited::makeDeepCopyFromShallowCopy(copies);
+}
+
+////////////////////
+// declareOptions //
+////////////////////
+void TextFilesVMatrixTest::declareOptions(OptionList& ol)
+{
+    declareOption(ol, "n_threads", &TextFilesVMatrixTest::n_threads,
+                  OptionBase::buildoption,
+                  "Number of threads used by getMat().");
+
+    // Now call the parent class' declareOptions
+    inherited::declareOptions(ol);
+}
+
+////////////
+// build_ //
+////////////
+void TextFilesVMatrixTest::build_()
+{
+}
+
+/////////////
+// perform //
+/////////////
+void TextFilesVMatrixTest::perform()
+{
+    // Comma-separated files with quoted fields, one with a header and one
+    // with DOS line endings. Row 2 ends with a delimiter (empty last
+    // field) and row 9 only has empty fields.
+    writeTextFile("textfiles_test1.csv",
+        "id,x,name,code,y,note\n"
+        "1,2.5,\"Smith, John\",A,1e3,n1\n"
+        "2,,plain,12,-3.25E-2,\n"
+        "3,nan,\"\",B,NaN,\"x,y\"\n"
+        "4,  7 , \"x\" ,-0.0,+4.,  z  \n"
+        "5,1.7976931348623157e308,\"Smith, John\",B,3.5e-7,\"\n"
+        "6,0x10,A,inf,12345678901234567890,\n"
+        "7,-1.5e-3,\"multi, part, name\",C,2.50,last\n");
+    writeTextFile("textfiles_test2.csv",
+        "8,3,\"Doe, Jane\",A,4,x\r\n"
+        "9,,,,,\r\n"
+        "10,1E-5,plain,\"12\",-0,\"a\"\"b\"\r\n");
+    // Tab-separated file without quote delimiter.
+    writeTextFile("textfiles_test3.txt",
+        "1\ta b\t3.5\n"
+        "2\t\t-4e2\n"
+        "3\t  spaced  \tnan\n"
+        "4\ta b\tword\n"
+        "5\t\"q\"\t-7.25e+01\n");
+
+    TVec<PPath> csv_files;
+    csv_files.append("textfiles_test1.csv");
+    csv_files.append("textfiles_test2.csv");
+    TVec<int> csv_skipheader;
+    csv_skipheader.append(1);
+    csv_skipheader.append(0);
+    TVec< pair<string, string> > csv_spec;
+    csv_spec.append(make_pair(string("id"), string("num")));
+    csv_spec.append(make_pair(string("x"), string("num")));
+    csv_spec.append(make_pair(string("name"), string("char")));
+    csv_spec.append(make_pair(string("code"), string("auto")));
+    csv_spec.append(make_pair(string("y"), string("num")));
+    csv_spec.append(make_pair(string("note"), string("char")));
+
+    TVec<PPath> tsv_files;
+    tsv_files.append("textfiles_test3.txt");
+    TVec< pair<string, string> > tsv_spec;
+    tsv_spec.append(make_pair(string("id"), string("num")));
+    tsv_spec.append(make_pair(string("label"), string("char")));
+    tsv_spec.append(make_pair(string("value"), string("auto")));
+
+    for (int f = 0; f < 2; f++) {
+        bool csv = f == 0;
+        pout << (csv ? "Comma-separated files with quotes"
+                     : "Tab-separated file without quotes") << endl;
+        TVec<PPath> files = csv ? csv_files : tsv_files;
+        TVec<int> skipheader = csv ? csv_skipheader : TVec<int>();
+        string delimiter = csv ? "," : "\t";
+        string quote = csv ? "\"" : "";
+        TVec< pair<string, string> > spec = csv ? csv_spec : tsv_spec;
+
+        PP<TextFilesVMatrix> by_field = makeTextFilesVMatrix(
+            files, skipheader, delimiter, quote, spec,
+            "textfiles_test_ref.metadata", 1);
+        PP<TextFilesVMatrix> by_row = makeTextFilesVMatrix(
+            files, skipheader, delimiter, quote, spec,
+            "textfiles_test_row.metadata", 1);
+        PP<TextFilesVMatrix> by_block = makeTextFilesVMatrix(
+            files, skipheader, delimiter, quote, spec,
+            "textfiles_test_block.metadata", n_threads);
+
+        Mat expected = parseFieldByField(*by_field);
+        pout << (expected.length() == (csv ? 10 : 5) ? "OK" : "FAILED")
+             << endl;
+
+        // Both the mappings and the values must be the same as with the
+        // per-field parsing, also when the mappings are extended by getMat().
+        Mat rows(by_row->length(), by_row->width());
+        for (int i = 0; i < rows.length(); i++)
+            by_row->getRow(i, rows(i));
+        pout << (sameRows(expected, rows) ? "OK" : "FAILED") << endl;
+
+        Mat block(by_block->length(), by_block->width());
+        by_block->getMat(0, 0, block);
+        pout << (sameRows(expected, block) ? "OK" : "FAILED") << endl;
+
+        Mat sub_block(3, by_block->width() - 1);
+        by_block->getMat(1, 1, sub_block);
+        pout << (sameRows(expected.subMat(1, 1, 3, expected.width() - 1),
+                          sub_block) ? "OK" : "FAILED") << endl;
+
+        by_field = 0;
+        by_row = 0;
+        by_block = 0;
+        force_rmdir("textfiles_test_ref.metadata");
+        force_rmdir("textfiles_test_row.metadata");
+        force_rmdir("textfiles_test_block.metadata");
+    }
+
+    rm("textfiles_test1.csv");
+    rm("textfiles_test2.csv");
+    rm("textfiles_test3.txt");
+}
+
+} // end of namespace PLearn
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
@@ -0,0 +1,194 @@
+// -*- C++ -*-
+
+// VMatLanguageTest.cc
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file VMatLanguageTest.cc */
+
+
+#include "VMatLanguageTest.h"
+#include <plearn/vmat/AutoVMatrix.h>
+#include <plearn/vmat/VMatLanguage.h>
+
+namespace PLearn {
+using namespace std;
+
+PLEARN_IMPLEMENT_OBJECT(
+    VMatLanguageTest,
+    "Compares the VPL interpreter with the lowered (fused) program",
+    "Each program in 'programs' is compiled against 'source_matrix' and run\n"
+    "on all its rows with the reference interpreter, with run() and with\n"
+    "runBatch(). The outputs must be exactly the same. The memory used by\n"
+    "'memput' and 'memget' is reset to zero before each pass, so that it is\n"
+    "carried over the rows in the same way.\n"
+);
+
+//////////////////////
+// VMatLanguageTest //
+//////////////////////
+VMatLanguageTest::VMatLanguageTest()
+{
+    // Conditionals ('ifelse'), including a folded one.
+    programs.append("%0 isnan %1 %0 ifelse  %1 0 > 1 -1 ifelse  "
+                    "%0 %1 < %0 %1 ifelse  2 3 > 10 20 ifelse  :out:0:3");
+    // Instructions whose stack effect is only known at run time.
+    programs.append("%0 %1 5 3 %1 isnan select  0 get  %0:%1 2 %0 isnan 1 + vecscalmul  :out:0:3");
+    // Missing values and mappings, applied to a field or to the stack.
+    programs.append("%0 %1 +  %0 missing ==  missing 1 +  "
+                    "%1 { [0 10[ -> 1 ; [10 100] -> 2 ; missing -> -1 ; other -> 3 }  "
+                    "%0 %1 + { [0 10] -> 5 ; other -> 7 }  "
+                    "%0 { missing -> 0 }  %0 %1 max  %0 %1 min  %0 fabs sqrt  :out:0:8");
+    // String values of the source.
+    programs.append("%0 %0.\"a\" ==  %1 %1.\"e\" ==  "
+                    "%0 %0.\"c\" == %1.\"b\" %1.\"f\" ifelse  %0.\"d\" 1 +  "
+                    "%1 { [-1 1] -> 0 ; missing -> 2 ; other -> 1 }  :out:0:4");
+    // Memory carried from one row to the next.
+    programs.append("0 memget %0 isnan 0 %0 ifelse + dup 0 memput  "
+                    "1 memget 1 + dup 1 memput  rowindex 2 memput  2 memget  :out:0:2");
+}
+
+///////////
+// build //
+///////////
+void VMatLanguageTest::build()
+{
+    inherited::build();
+    build_();
+}
+
+/////////////////////////////////
+// makeDeepCopyFromShallowCopy //
+/////////////////////////////////
+void VMatLanguageTest::makeDeepCopyFromShallowCopy(CopiesMap& copies)
+{
+    inherited::makeDeepCopyFromShallowCopy(copies);
+
+    deepCopyField(programs, copies);
+}
+
+////////////////////
+// declareOptions //
+////////////////////
+void VMatLanguageTest::declareOptions(OptionList& ol)
+{
+    declareOption(ol, "source_matrix", &VMatLanguageTest::source_matrix,
+                  OptionBase::buildoption,
+                  "Source matrix the programs are run on.");
+
+    declareOption(ol, "programs", &VMatLanguageTest::programs,
+                  OptionBase::buildoption,
+                  "The VPL programs to test. The default ones cover conditionals,\n"
+                  "missing values, mappings, string values and 'memput' / 'memget'.");
+
+    // Now call the parent class' declareOptions
+    inherited::declareOptions(ol);
+}
+
+////////////
+// build_ //
+////////////
+void VMatLanguageTest::build_()
+{
+}
+
+/////////////
+// perform //
+/////////////
+void VMatLanguageTest::perform()
+{
+    if( source_matrix == "" )
+        PLERROR( "In VMatLanguageTest::perform - You must provide"
+                 " 'source_matrix' option" );
+
+    VMat source_vmat = new AutoVMatrix( source_matrix );
+    source_vmat->build();
+    const int n = source_vmat->length();
+    const Mat source = source_vmat->toMat();
+    const Vec zero_memory(3, real(0));
+
+    pout << "source_matrix = " << source_matrix.canonical() << endl;
+    for( int p=0 ; p<programs.length() ; p++ )
+    {
+        VMatLanguage vpl( source_vmat );
+        TVec<string> fieldnames;
+        vpl.compileString( programs[p], fieldnames );
+        const int w = fieldnames.length();
+        pout << "Program " << p << " (" << w << " outputs): "
+             << programs[p] << endl;
+
+        Mat interpreted(n, w);
+        vpl.setMemory( zero_memory );
+        for( int i=0 ; i<n ; i++ )
+            vpl.runInterpreted( source(i), interpreted(i), i );
+
+        Mat fused(n, w);
+        vpl.setMemory( zero_memory );
+        for( int i=0 ; i<n ; i++ )
+            vpl.run( source(i), fused(i), i );
+
+        Mat batch(n, w);
+        vpl.setMemory( zero_memory );
+        vpl.runBatch( source, batch );
+
+        bool same = true;
+        for( int i=0 ; i<n ; i++ )
+            for( int j=0 ; j<w ; j++ )
+            {
+                const real expected = interpreted(i,j);
+                if( (is_missing(expected) && is_missing(fused(i,j))
+                     && is_missing(batch(i,j)))
+                    || (fast_exact_is_equal(expected, fused(i,j))
+                        && fast_exact_is_equal(expected, batch(i,j))) )
+                    continue;
+                perr << "Row " << i << ", output " << j << ": interpreted = "
+                     << expected << ", run = " << fused(i,j)
+                     << ", runBatch = " << batch(i,j) << endl;
+                same = false;
+            }
+        pout << (same ? "OK" : "FAILED") << endl;
+    }
+}
+
+} // end of namespace PLearn
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
@@ -0,0 +1,249 @@
+// -*- C++ -*-
+
+// VMatPipelineTest.cc
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file VMatPipelineTest.cc */
+
+
+#include "VMatPipelineTest.h"
+#include <plearn/vmat/FileVMatrix.h>
+#include <plearn/vmat/MemoryVMatrix.h>
+#include <plearn/vmat/ProcessingVMatrix.h>
+#include <plearn/vmat/VMatPipeline.h>
+#include <plearn/vmat/VMatRowCursor.h>
+#include <plearn/io/fileutils.h>
+
+namespace PLearn {
+using namespace std;
+
+PLEARN_IMPLEMENT_OBJECT(
+    VMatPipelineTest,
+    "Tests the ordering of the blocks streamed by VMatPipeline",
+    "The blocks must be consumed in the order of the rows with several\n"
+    "workers, with a memory cap below the size of one block, and with a\n"
+    "source that cannot give row cursors (a ProcessingVMatrix using the VPL\n"
+    "memory, which is also saved with and without worker threads).\n"
+);
+
+namespace {
+
+//! Checks that the blocks are consumed in order and hold the expected rows.
+struct OrderCheckConsumer: public VMatPipelineConsumer
+{
+    Mat expected;
+    int next_row;
+    int n_slots;
+    bool ok;
+
+    OrderCheckConsumer(const Mat& the_expected):
+        expected(the_expected), next_row(0), n_slots(0), ok(true)
+    {}
+
+    virtual void start(int the_n_slots, int n_workers)
+    {
+        n_slots = the_n_slots;
+    }
+
+    virtual void consumeBlock(int slot, int first_row, const Mat& block)
+    {
+        if (first_row != next_row) {
+            perr << "Block of row " << first_row << " consumed instead of "
+                 << next_row << endl;
+            ok = false;
+        }
+        for (int i = 0; i < block.length(); i++)
+            for (int j = 0; j < block.width(); j++)
+                if (!fast_exact_is_equal(block(i, j),
+                                         expected(first_row + i, j))) {
+                    perr << "Wrong value at row " << first_row + i
+                         << ", column " << j << endl;
+                    ok = false;
+                }
+        next_row = first_row + block.length();
+    }
+
+    bool success() const
+    {
+        return ok && next_row == expected.length();
+    }
+};
+
+} // end of anonymous namespace
+
+//////////////////////
+// VMatPipelineTest //
+//////////////////////
+VMatPipelineTest::VMatPipelineTest():
+    n_rows(1000)
+{
+}
+
+///////////
+// build //
+///////////
+void VMatPipelineTest::build()
+{
+    inherited::build();
+    build_();
+}
+
+/////////////////////////////////
+// makeDeepCopyFromShallowCopy //
+/////////////////////////////////
+void VMatPipelineTest::makeDeepCopyFromShallowCopy(CopiesMap& copies)
+{
+    inherited::makeDeepCopyFromShallowCopy(copies);
+}
+
+////////////////////
+// declareOptions //
+////////////////////
+void VMatPipelineTest::declareOptions(OptionList& ol)
+{
+    declareOption(ol, "n_rows", &VMatPipelineTest::n_rows,
+                  OptionBase::buildoption,
+                  "Number of rows of the generated source.");
+
+    // Now call the parent class' declareOptions
+    inherited::declareOptions(ol);
+}
+
+////////////
+// build_ //
+////////////
+void VMatPipelineTest::build_()
+{
+}
+
+/////////////
+// perform //
+/////////////
+void VMatPipelineTest::perform()
+{
+    Mat data(n_rows, 3);
+    for (int i = 0; i < n_rows; i++)
+        for (int j = 0; j < 3; j++)
+            data(i, j) = 3 * i + j;
+    VMat source = new MemoryVMatrix(data);
+
+    pout << "Block ordering with 4 workers" << endl;
+    {
+        OrderCheckConsumer check(data);
+        VMatPipeline pipeline;
+        pipeline.block_length = 7;
+        pipeline.n_workers = 4;
+        pipeline.run(source, check);
+        pout << (check.success() ? "OK" : "FAILED") << endl;
+    }
+
+    pout << "Memory cap below one block" << endl;
+    {
+        OrderCheckConsumer check(data);
+        VMatPipeline pipeline;
+        pipeline.block_length = 7;
+        pipeline.n_workers = 4;
+        pipeline.memory_cap = 0;
+        pipeline.run(source, check);
+        pout << (check.success() && check.n_slots == 1 ? "OK" : "FAILED")
+             << endl;
+    }
+
+    // Running sum of the first column, carried in the VPL memory. Row 0
+    // reads the slot it has just set to 0, the other rows the sum so far.
+    VMat processed = new ProcessingVMatrix(
+        source, "0 1 memput  rowindex 0 == 1 0 ifelse memget %0 + "
+                "dup 0 memput :cumsum");
+    Mat cumsum(n_rows, 1);
+    real sum = 0;
+    for (int i = 0; i < n_rows; i++) {
+        sum += data(i, 0);
+        cumsum(i, 0) = sum;
+    }
+
+    pout << "Source without row cursors" << endl;
+    {
+        bool refused = false;
+        try {
+            processed->newRowCursor();
+        } catch (const PLearnError&) {
+            refused = true;
+        }
+        OrderCheckConsumer check(cumsum);
+        VMatPipeline pipeline;
+        pipeline.block_length = 7;
+        pipeline.n_workers = 4;
+        pipeline.run(processed, check);
+        pout << (refused && check.success() ? "OK" : "FAILED") << endl;
+    }
+
+    pout << "Saving with and without workers" << endl;
+    {
+        int old_n_workers = VMatPipeline::default_n_workers;
+        int old_block_length = VMatPipeline::default_block_length;
+        VMatPipeline::default_block_length = 7;
+        VMatPipeline::default_n_workers = 0;
+        processed->savePMAT("pipeline_serial.pmat");
+        VMatPipeline::default_n_workers = 4;
+        processed->savePMAT("pipeline_workers.pmat");
+        VMatPipeline::default_n_workers = old_n_workers;
+        VMatPipeline::default_block_length = old_block_length;
+
+        Mat serial = VMat(new FileVMatrix("pipeline_serial.pmat")).toMat();
+        Mat workers = VMat(new FileVMatrix("pipeline_workers.pmat")).toMat();
+        bool same = serial.length() == n_rows && workers.length() == n_rows;
+        for (int i = 0; same && i < n_rows; i++)
+            same = fast_exact_is_equal(serial(i, 0), cumsum(i, 0))
+                && fast_exact_is_equal(workers(i, 0), cumsum(i, 0));
+        pout << (same ? "OK" : "FAILED") << endl;
+
+        rm("pipeline_serial.pmat");
+        force_rmdir("pipeline_serial.pmat.metadata");
+        rm("pipeline_workers.pmat");
+        force_rmdir("pipeline_workers.pmat.metadata");
+    }
+}
+
+} // end of namespace PLearn
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
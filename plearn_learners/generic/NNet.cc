@@ -44,19 +44,28 @@
 #include <plearn/var/ArgmaxVariable.h>
 #include <plearn/var/BinaryClassificationLossVariable.h>
 #include <plearn/var/ClassificationLossVariable.h>
+#include <plearn/var/ColumnSumVariable.h>
 #include <plearn/var/ConcatColumnsVariable.h>
 #include <plearn/var/CrossEntropyVariable.h>
 #include <plearn/var/DivVariable.h>
 #include <plearn/var/ExpVariable.h>
 #include <plearn/var/LiftOutputVariable.h>
 #include <plearn/var/LogSoftmaxVariable.h>
+#include <plearn/var/LogVariable.h>
 #include <plearn/var/MarginPerceptronCostVariable.h>
+#include <plearn/var/MatrixAffineTransformVariable.h>
+#include <plearn/var/MatrixSoftmaxLossVariable.h>
+#include <plearn/var/MatrixSoftmaxVariable.h>
+#include <plearn/var/MatrixSumOfVariable.h>
+#include <plearn/var/MiniBatchClassificationLossVariable.h>
+#include <plearn/var/MinusVariable.h>
 #include <plearn/var/ConfRatedAdaboostCostVariable.h>
 #include <plearn/var/GradientAdaboostCostVariable.h>
 #include <plearn/var/LogAddVariable.h>
 #include <plearn/var/MulticlassLossVariable.h>
 #include <plearn/var/NegCrossEntropySigmoidVariable.h>
 #include <plearn/var/NegLogPoissonVariable.h>
+#include <plearn/var/NegateElementsVariable.h>
 #include <plearn/var/OneHotSquaredLoss.h>
 #include <plearn/var/PlusConstantVariable.h>
 #include <plearn/var/PlusVariable.h>
@@ -68,12 +77,14 @@
 #include <plearn/var/SoftplusVariable.h>
 #include <plearn/var/SquareVariable.h>
 #include <plearn/var/SquareRootVariable.h>
+#include <plearn/var/SubMatVariable.h>
 #include <plearn/var/SumVariable.h>
 #include <plearn/var/SumAbsVariable.h>
 #include <plearn/var/SumOfVariable.h>
 #include <plearn/var/SumOverBagsVariable.h>
 #include <plearn/var/SumSquareVariable.h>
 #include <plearn/var/TanhVariable.h>
+#include <plearn/var/TimesConstantVariable.h>
 #include <plearn/var/TransposeVariable.h>
 #include <plearn/var/UnaryHardSlopeVariable.h>
 #include <plearn/var/UnfoldedFuncVariable.h>
@@ -131,6 +142,7 @@ first_hidden_layer_is_output(false),
 transpose_first_hidden_layer(false),
 n_non_params_in_first_hidden_layer(0),
 batch_size(1),
+n_train_threads(1),
 initialization_method("uniform_linear"),
 ratio_rank(0)
 {
@@ -349,7 +361,23 @@ void NNet::declareOptions(OptionList& ol)
     declareOption(
         ol, "batch_size", &NNet::batch_size, OptionBase::buildoption, 
         "How many samples to use to estimate the avergage gradient before updating the weights\n"
-        "0 is equivalent to specifying training_set->length() \n");
+        "0 is equivalent to specifying training_set->length() \n"
+        "When > 1, the samples of a minibatch are propagated together with\n"
+        "matrix-matrix products if the network allows it: no\n"
+        "first_hidden_layer, no bags, no rbf layer, no direct in-to-out or\n"
+        "fixed output weights, no input reconstruction penalty, linear, tanh,\n"
+        "sigmoid, softplus or exp hidden transfer functions, one of these or\n"
+        "softmax as output transfer function, and only 'mse', 'NLL' (with\n"
+        "softmax) or 'class_error' costs. computeOutputs() then also\n"
+        "processes batch_size rows at a time.\n");
+
+    declareOption(
+        ol, "n_train_threads", &NNet::n_train_threads,
+        OptionBase::buildoption | OptionBase::nosave,
+        "Number of threads among which the samples of a batch are split\n"
+        "to compute the training cost and its gradient, when the samples\n"
+        "are not propagated together (see 'batch_size'). Each thread works\n"
+        "on its own copy of the network, and the gradients are summed.\n");
 
     declareOption(
         ol, "initialization_method", &NNet::initialization_method, OptionBase::buildoption, 
@@ -546,6 +574,8 @@ void NNet::build_()
                    output, target, sampleweight,
                    operate_on_bags ? bag_size : NULL);
 
+        buildBatchFuncs();
+
     }
 }
 
@@ -662,6 +692,131 @@ void NNet::buildFuncs(const Var& the_input, const Var& the_output, const Var& th
     output_and_target_to_cost->recomputeParents();
 }
 
+/////////////////////
+// buildBatchFuncs //
+/////////////////////
+void NNet::buildBatchFuncs()
+{
+    batch_input = Var();
+    batch_target_and_weight = Var();
+    batch_training_cost = Var();
+    batch_input_to_output = Func();
+
+    if (batch_size <= 1 || operate_on_bags || first_hidden_layer
+        || rbf_layer_size > 0 || direct_in_to_out || fixed_output_weights
+        || first_hidden_layer_is_output || input_reconstruction_penalty > 0)
+        return;
+    // The penalties are added once per sample: they must not depend on it.
+    if (penalties.size() > 0 && propagationPath(input, penalties).length() > 0)
+        return;
+
+    int n = batch_size;
+    int ts = targetsize();
+    Var the_input = Var(n, inputsize(), "batch_input");
+    Var the_target_and_weight = Var(n, ts + max(weightsize_, 0),
+                                    "batch_target_and_weight");
+
+    // The samples are in the columns from now on, as expected by the matrix
+    // variables.
+    Var out = transpose(the_input);
+    if (nhidden > 0) {
+        out = batchTransferFunc(new MatrixAffineTransformVariable(out, w1),
+                                hidden_transfer_func);
+        if (out.isNull())
+            return;
+    }
+    if (nhidden2 > 0) {
+        out = batchTransferFunc(new MatrixAffineTransformVariable(out, w2),
+                                hidden_transfer_func);
+        if (out.isNull())
+            return;
+    }
+    Var before_transfer = new MatrixAffineTransformVariable(out, wout);
+    Var the_output = batchTransferFunc(before_transfer, output_transfer_func);
+    if (the_output.isNull())
+        return;
+
+    Var the_target = new SubMatVariable(the_target_and_weight, 0, 0, n, ts);
+    VarArray cost_sums(cost_funcs.size());
+    Var weights;
+    if (weightsize_ > 0)
+        weights = new SubMatVariable(the_target_and_weight, 0, ts, n, 1);
+    for (int k = 0; k < cost_funcs.size(); k++) {
+        Var cost = getBatchCost(cost_funcs[k], the_output, the_target,
+                                before_transfer);
+        if (cost.isNull())
+            return;
+        if (weights)
+            cost = cost * weights;
+        cost_sums[k] = sum(cost);
+    }
+    Var first_cost = cost_sums[0];
+    if (penalties.size() > 0) {
+        Var penalty = sum(hconcat(penalties));
+        if (weights)
+            first_cost = first_cost + penalty * sum(weights);
+        else
+            first_cost = first_cost + penalty * real(n);
+    }
+
+    batch_input = the_input;
+    batch_target_and_weight = the_target_and_weight;
+    batch_training_cost = hconcat(first_cost & cost_sums);
+    batch_training_cost->setName("batch_training_cost");
+    batch_input_to_output = Func(batch_input, transpose(the_output));
+    batch_input_to_output->batch_size = n;
+}
+
+///////////////////////
+// batchTransferFunc //
+///////////////////////
+Var NNet::batchTransferFunc(const Var& activations,
+                            const string& transfer_func) const
+{
+    if (transfer_func == "" || transfer_func == "none"
+        || transfer_func == "linear")
+        return activations;
+    else if (transfer_func == "tanh")
+        return tanh(activations);
+    else if (transfer_func == "sigmoid")
+        return sigmoid(activations);
+    else if (transfer_func == "softplus")
+        return softplus(activations);
+    else if (transfer_func == "exp")
+        return exp(activations);
+    else if (transfer_func == "softmax")
+        // one softmax per column (sample)
+        return new MatrixSoftmaxVariable(activations);
+    return Var();
+}
+
+//////////////////
+// getBatchCost //
+//////////////////
+Var NNet::getBatchCost(const string& costname, const Var& the_output,
+                       const Var& the_target,
+                       const Var& before_transfer_func) const
+{
+    // the_output is (outputsize x n) and the_target (n x targetsize).
+    if (costname == "mse") {
+        if (the_target->width() != the_output->length())
+            return Var();
+        Var diff = new MinusVariable(the_output, transpose(the_target));
+        return transpose(columnSum(square(diff)));
+    }
+    if (the_target->width() != 1 || the_output->length() <= 1)
+        return Var();
+    if (costname == "NLL" && output_transfer_func == "softmax")
+        // MatrixSoftmaxLossVariable gives the probability of the target
+        return -log(new MatrixSoftmaxLossVariable(before_transfer_func,
+                                                  the_target));
+    else if (costname == "class_error")
+        // the samples must be in the rows, with n rows
+        return new MiniBatchClassificationLossVariable(
+            transpose(the_output), the_target);
+    return Var();
+}
+
 //////////////////////////
 // buildOutputFromInput //
 //////////////////////////
@@ -904,6 +1059,19 @@ void NNet::computeOutput(const Vec& inputv, Vec& outputv) const
     input_to_output->fprop(inputv,outputv);
 }
 
+////////////////////
+// computeOutputs //
+////////////////////
+void NNet::computeOutputs(const Mat& input, Mat& output) const
+{
+    if (!batch_input_to_output) {
+        inherited::computeOutputs(input, output);
+        return;
+    }
+    output.resize(input.length(), outputsize());
+    batch_input_to_output->fprop(input, output);
+}
+
 ///////////////////////////
 // computeOutputAndCosts //
 ///////////////////////////
@@ -1245,6 +1413,10 @@ void NNet::makeDeepCopyFromShallowCopy(CopiesMap& copies)
     deepCopyField(input_to_output, copies);
     deepCopyField(test_costf, copies);
     deepCopyField(output_and_target_to_cost, copies);
+    varDeepCopyField(batch_input, copies);
+    varDeepCopyField(batch_target_and_weight, copies);
+    varDeepCopyField(batch_training_cost, copies);
+    deepCopyField(batch_input_to_output, copies);
     varDeepCopyField(first_hidden_layer, copies);
     deepCopyField(cost_funcs, copies);
     deepCopyField(optimizer, copies);
@@ -1310,11 +1482,21 @@ void NNet::train()
 
     // number of samples seen by optimizer before each optimizer update
     int nsamples = batch_size>0 ? batch_size : n_train;
-    Func paramf = Func(invars, training_cost); // parameterized function to optimize
-    Var totalcost =
-        operate_on_bags ? sumOverBags(train_set, paramf, max_bag_size,
-                                      nsamples, true)
-                        : meanOf(train_set, paramf, nsamples);
+    Var totalcost;
+    if (batch_training_cost && nsamples == batch_size) {
+        // the samples of each minibatch are propagated together
+        Func batch_paramf = Func(batch_input & batch_target_and_weight,
+                                 batch_training_cost);
+        batch_paramf->batch_size = batch_size;
+        totalcost = meanOf(train_set, batch_paramf, nsamples, inputsize());
+    } else {
+        Func paramf = Func(invars, training_cost); // parameterized function to optimize
+        totalcost =
+            operate_on_bags ? sumOverBags(train_set, paramf, max_bag_size,
+                                          nsamples, true)
+                            : meanOf(train_set, paramf, nsamples, false,
+                                     n_train_threads);
+    }
     if(optimizer)
     {
         optimizer->setToOptimize(params, totalcost);  
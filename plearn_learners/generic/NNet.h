@@ -85,6 +85,13 @@ protected:
     //! Number of bags in the training set.
     int n_training_bags;
 
+    //! Graph on minibatches of batch_size samples, built by
+    //! buildBatchFuncs(). The samples are the rows of batch_input and
+    //! batch_target_and_weight, and the columns of the inner variables.
+    Var batch_input;
+    Var batch_target_and_weight;
+    Var batch_training_cost; // sum over the minibatch of training_cost
+
 // to put back later -- blip  Vec paramsvalues; // values of all parameters
 
 public: // to set these values instead of getting them by training
@@ -112,6 +119,7 @@ public:
     mutable Func input_to_output; // input -> output
     mutable Func test_costf; // input & target -> output & test_costs
     mutable Func output_and_target_to_cost; // output & target -> cost
+    mutable Func batch_input_to_output; // minibatch of inputs -> outputs
 
 public:
 
@@ -188,6 +196,8 @@ public:
     int batch_size; // how many samples to use to estimate gradient before an update
     // 0 means the whole training set (default: 1)
 
+    int n_train_threads; // number of threads summing the training gradient
+
     string initialization_method;
     int ratio_rank;
 
@@ -219,6 +229,9 @@ public:
 
     virtual void computeOutput(const Vec& input, Vec& output) const;
 
+    //! Uses the minibatch graph when available.
+    virtual void computeOutputs(const Mat& input, Mat& output) const;
+
     virtual void computeOutputAndCosts(const Vec& input, const Vec& target,
                                        Vec& output, Vec& costs) const;
 
@@ -278,6 +291,23 @@ protected:
     //! Compute the final output from the activations of the output units.
     void applyTransferFunc(const Var& before_transfer_func, Var& output);
 
+    //! Build the graph on minibatches of batch_size samples, which computes
+    //! the same outputs and costs as the main graph with matrix products.
+    //! It is only built when batch_size > 1 and the network, its transfer
+    //! functions and its costs are supported (otherwise the batch variables
+    //! are left null and the samples are processed one at a time).
+    void buildBatchFuncs();
+
+    //! Return the given element-wise transfer function applied on the
+    //! activations of a minibatch, or a null Var if it is not supported.
+    Var batchTransferFunc(const Var& activations,
+                          const string& transfer_func) const;
+
+    //! Return the cost of each sample of a minibatch (a column vector), or
+    //! a null Var if the cost is not supported on minibatches.
+    Var getBatchCost(const string& costname, const Var& output,
+                     const Var& target, const Var& before_transfer_func) const;
+
     //! Fill a matrix of weights according to the 'initialization_method' specified.
     //! The 'clear_first_row' boolean indicates whether we should fill the first
     //! row with zeros.
@@ -50,11 +50,15 @@
 #include <plearn/math/pl_erf.h>
 #include <plearn/vmat/FileVMatrix.h>
 #include <plearn/vmat/MemoryVMatrix.h>
+#include <plearn/vmat/PrefetchVMatrix.h>
+#include <plearn/vmat/RowCursorVMatrix.h>
 #include <plearn/vmat/RowsSubVMatrix.h>
+#include <plearn/vmat/VMatRowCursor.h>
 #include <plearn/misc/PLearnService.h>
 #include <plearn/misc/RemotePLearnServer.h>
 #include <plearn/vmat/PLearnerOutputVMatrix.h>
 #include <plearn/base/RemoteDeclareMethod.h>
+#include <boost/thread.hpp>
 
 namespace PLearn {
 using namespace std;
@@ -72,6 +76,8 @@ PLearner::PLearner()
       save_trainingset_prefix(""),
       parallelize_here(true),
       master_sends_testset_rows(false),
+      n_test_threads(1),
+      prefetch_test_rows(0),
       use_a_separate_random_generator_for_testing(1827),
       finalized(false),
       inputsize_(-1),
@@ -240,6 +246,25 @@ void PLearner::declareOptions(OptionList& ol)
         "For parallel PLearner::test : wether the master should read the testset and\n"
         "send rows to the slaves, or send a serialized description of the testset.\n");
   
+    declareOption(
+        ol, "n_test_threads", &PLearner::n_test_threads,
+        OptionBase::buildoption | OptionBase::nosave,
+        "Number of threads used by test() and use() when no remote server\n"
+        "is used. Each thread works on a deep copy of the learner and on a\n"
+        "contiguous range of rows of the test set, and the statistics\n"
+        "collected by the threads are merged in the order of the rows.\n"
+        "This is ignored for stateful learners (see isStatefulLearner()),\n"
+        "for test sets that cannot give row cursors and for statistics\n"
+        "keeping a limited number of counts (see canTestInThreads()).\n");
+
+    declareOption(
+        ol, "prefetch_test_rows", &PLearner::prefetch_test_rows,
+        OptionBase::buildoption | OptionBase::nosave,
+        "If positive, the sequential test() and use() read the test set\n"
+        "through a PrefetchVMatrix, which computes blocks of this many rows\n"
+        "ahead in a background thread while the learner is computing its\n"
+        "outputs. Useful when the test set is an expensive VMat pipeline.\n");
+
     declareOption(
         ol, "test_minibatch_size", &PLearner::test_minibatch_size,
         OptionBase::buildoption,
@@ -830,8 +855,12 @@ void PLearner::use(VMat testset, VMat outputs) const
     if(nservers>0)
         servers = PLearnService::instance().reserveServers(nservers);
 
-    if(servers.length()==0) 
+    if(servers.length()==0 && canTestInThreads(testset, 0))
+        threadedTest(testset, false, 0, outputs, 0);
+    else if(servers.length()==0) 
     { // sequential code      
+        if (prefetch_test_rows > 0)
+            testset = prefetchTestSet(testset);
         Vec input;
         Vec target;
         real weight;
@@ -1126,8 +1155,12 @@ void PLearner::test(VMat testset, PP<VecStatsCollector> test_stats,
             }
         }
     }
+    else if(parallelize_here && canTestInThreads(testset, test_stats))
+        threadedTest(testset, true, test_stats, testoutputs, testcosts);
     else // Sequential test 
     {
+        if (prefetch_test_rows > 0)
+            testset = prefetchTestSet(testset);
         if (test_minibatch_size==1)
         {
             for (int i = 0; i < len; i++)
@@ -1188,6 +1221,243 @@ void PLearner::test(VMat testset, PP<VecStatsCollector> test_stats,
 
 }
 
+//! Function object run by each thread of PLearner::threadedTest.
+//! Only plain pointers are used, since the reference counts of PLearn
+//! objects are not thread-safe.
+struct PLearnerTestThread
+{
+    const PLearner* learner;
+    VMatRowCursor* cursor;
+    int start;
+    int length;
+    int inputsize;
+    int targetsize;
+    int weightsize;
+    int minibatch_size;
+    bool compute_costs;
+
+    //! Results of the thread (the matrices are empty if not required).
+    VecStatsCollector* stats;
+    Mat* outputs;
+    Mat* costs;
+    string* error;
+
+    //! Shared progress bar (may be null).
+    ProgressBar* pb;
+    boost::mutex* pb_mx;
+    int* rows_done;
+
+    void operator()()
+    {
+        try {
+            run();
+        } catch (const PLearnError& e) {
+            *error = e.message();
+        }
+    }
+
+    void run()
+    {
+        int out_size = learner->outputsize() >= 0 ? learner->outputsize() : 0;
+        int n_costs = compute_costs ? learner->nTestCosts() : 0;
+        // Rows are read by blocks of at least 256 rows, and are given to
+        // the learner by minibatches of 'minibatch_size' rows.
+        int block_size = minibatch_size > 1 ? minibatch_size
+                                            : min(256, length);
+        Mat rows, b_inputs, b_targets, b_outputs, b_costs;
+        Vec input, target, output(out_size), cost(n_costs);
+        for (int i = 0; i < length; i += block_size) {
+            int n = min(block_size, length - i);
+            cursor->getRows(start + i, n, rows);
+            if (minibatch_size > 1) {
+                b_inputs.resize(n, inputsize);
+                b_inputs << rows.subMatColumns(0, inputsize);
+                b_outputs.resize(n, out_size);
+                if (compute_costs) {
+                    b_targets.resize(n, targetsize);
+                    b_targets << rows.subMatColumns(inputsize, targetsize);
+                    b_costs.resize(n, n_costs);
+                    learner->computeOutputsAndCosts(b_inputs, b_targets,
+                                                    b_outputs, b_costs);
+                } else
+                    learner->computeOutputs(b_inputs, b_outputs);
+            }
+            for (int j = 0; j < n; j++) {
+                Vec row = rows(j);
+                if (minibatch_size > 1) {
+                    output = b_outputs(j);
+                    if (compute_costs)
+                        cost = b_costs(j);
+                } else {
+                    input = row.subVec(0, inputsize);
+                    if (compute_costs) {
+                        target = row.subVec(inputsize, targetsize);
+                        learner->computeOutputAndCosts(input, target,
+                                                       output, cost);
+                    } else
+                        learner->computeOutput(input, output);
+                }
+                if (!outputs->isEmpty())
+                    (*outputs)(i + j) << output;
+                if (!costs->isEmpty())
+                    (*costs)(i + j) << cost;
+                if (stats) {
+                    real weight = weightsize > 0
+                        ? row[inputsize + targetsize] : 1;
+                    stats->update(cost, weight);
+                }
+            }
+            if (pb) {
+                boost::mutex::scoped_lock lock(*pb_mx);
+                *rows_done += n;
+                pb->update(*rows_done);
+            }
+        }
+    }
+};
+
+//////////////////////
+// canTestInThreads //
+//////////////////////
+bool PLearner::canTestInThreads(VMat testset,
+                                PP<VecStatsCollector> test_stats) const
+{
+    if (n_test_threads <= 1 || testset.length() <= 1 || isStatefulLearner()
+        || testset->inputsize() < 0)
+        return false;
+    // StatsCollector::merge() cannot merge collectors that store a limited
+    // number of counts.
+    if (test_stats && test_stats->maxnvalues != 0
+        && test_stats->maxnvalues != -1)
+        return false;
+    // Some VMatrices cannot give row cursors (e.g. when rows depend on the
+    // previous ones).
+    try {
+        testset->newRowCursor();
+    } catch (const PLearnError&) {
+        return false;
+    }
+    return true;
+}
+
+/////////////////////
+// prefetchTestSet //
+/////////////////////
+VMat PLearner::prefetchTestSet(VMat testset) const
+{
+    try {
+        testset->newRowCursor();
+    } catch (const PLearnError&) {
+        return testset;
+    }
+    PrefetchVMatrix* prefetched =
+        new PrefetchVMatrix(testset, prefetch_test_rows, 4, false);
+    prefetched->wrap_around = false;
+    prefetched->build();
+    return prefetched;
+}
+
+//////////////////
+// threadedTest //
+//////////////////
+void PLearner::threadedTest(VMat testset, bool compute_costs,
+                            PP<VecStatsCollector> test_stats,
+                            VMat testoutputs, VMat testcosts) const
+{
+    int len = testset.length();
+    int n_threads = min(n_test_threads, len);
+    int out_size = outputsize() >= 0 ? outputsize() : 0;
+    if (!compute_costs) {
+        test_stats = 0;
+        testcosts = 0;
+    }
+
+    PP<ProgressBar> pb;
+    if (report_progress)
+        pb = new ProgressBar(compute_costs ? "Testing learner"
+                                           : "Using learner", len);
+    boost::mutex pb_mx;
+    int rows_done = 0;
+
+    // Everything shared with the threads is created here, in the main
+    // thread.
+    TVec< PP<PLearner> > learners(n_threads);
+    TVec<VMat> datasets(2 * n_threads);
+    TVec< PP<VMatRowCursor> > cursors(n_threads);
+    TVec< PP<VecStatsCollector> > stats(n_threads);
+    TVec<Mat> outputs(n_threads);
+    TVec<Mat> costs(n_threads);
+    TVec<string> errors(n_threads);
+    TVec<PLearnerTestThread> functors(n_threads);
+    TVec<boost::thread*> threads(n_threads);
+    for (int k = 0; k < n_threads; k++) {
+        // Instead of copying the datasets held by the learner, each copy
+        // reads them through its own row cursor.
+        CopiesMap copies;
+        if (train_set) {
+            datasets[2 * k] = new RowCursorVMatrix(train_set);
+            copies[(const VMatrix*) train_set] = (VMatrix*) datasets[2 * k];
+        }
+        if (validation_set && validation_set != train_set) {
+            datasets[2 * k + 1] = new RowCursorVMatrix(validation_set);
+            copies[(const VMatrix*) validation_set] =
+                (VMatrix*) datasets[2 * k + 1];
+        }
+        learners[k] = deepCopy(copies);
+        cursors[k] = testset->newRowCursor();
+        int start = (len * k) / n_threads;
+        int end = (len * (k + 1)) / n_threads;
+        if (test_stats) {
+            CopiesMap stats_copies;
+            stats[k] = test_stats->deepCopy(stats_copies);
+            stats[k]->forget();
+        }
+        if (testoutputs)
+            outputs[k].resize(end - start, out_size);
+        if (testcosts)
+            costs[k].resize(end - start, nTestCosts());
+
+        PLearnerTestThread& f = functors[k];
+        f.learner = learners[k];
+        f.cursor = cursors[k];
+        f.start = start;
+        f.length = end - start;
+        f.inputsize = testset->inputsize();
+        f.targetsize = max(0, testset->targetsize());
+        f.weightsize = max(0, testset->weightsize());
+        f.minibatch_size = test_minibatch_size;
+        f.compute_costs = compute_costs;
+        f.stats = stats[k];
+        f.outputs = &outputs[k];
+        f.costs = &costs[k];
+        f.error = &errors[k];
+        f.pb = pb;
+        f.pb_mx = &pb_mx;
+        f.rows_done = &rows_done;
+    }
+    for (int k = 0; k < n_threads; k++)
+        threads[k] = new boost::thread(functors[k]);
+    for (int k = 0; k < n_threads; k++) {
+        threads[k]->join();
+        delete threads[k];
+    }
+    for (int k = 0; k < n_threads; k++)
+        if (!errors[k].empty())
+            PLERROR("In PLearner::threadedTest - Error in thread %d: %s",
+                    k, errors[k].c_str());
+
+    // Merge the results in the order of the rows.
+    for (int k = 0; k < n_threads; k++) {
+        int start = functors[k].start;
+        if (test_stats)
+            test_stats->merge(*stats[k]);
+        for (int i = 0; i < outputs[k].length(); i++)
+            testoutputs->putOrAppendRow(start + i, outputs[k](i));
+        for (int i = 0; i < costs[k].length(); i++)
+            testcosts->putOrAppendRow(start + i, costs[k](i));
+    }
+}
+
 void PLearner::computeOutput(const Vec& input, Vec& output) const
 {
     PLERROR("PLearner::computeOutput(Vec,Vec) not implemented in subclass %s\n",classname().c_str());
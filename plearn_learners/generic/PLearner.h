@@ -182,6 +182,22 @@ public:
      */
     bool master_sends_testset_rows;
 
+    /**
+     * Number of threads used by PLearner::test and PLearner::use when no
+     * remote server is used. Each thread works on a deep copy of this
+     * learner and on a contiguous range of rows of the test set. Ignored
+     * (i.e. the test is sequential) for stateful learners.
+     */
+    int n_test_threads;
+
+    /**
+     * If positive, the sequential versions of PLearner::test and
+     * PLearner::use read the test set through a PrefetchVMatrix, which
+     * reads blocks of this many rows ahead in a background thread while
+     * the learner computes its outputs.
+     */
+    int prefetch_test_rows;
+
     /**
      * This option allows to perform testing always in the same
      * conditions in terms of the random generator (if testing involves
@@ -696,6 +712,29 @@ protected:
     //! Transforms a shallow copy into a deep copy
     virtual void makeDeepCopyFromShallowCopy(CopiesMap& copies);
 
+    /**
+     * Multithreaded implementation of test (when 'compute_costs' is true)
+     * and use (when it is false, in which case 'test_stats' and 'testcosts'
+     * are ignored), using 'n_test_threads' deep copies of this learner.
+     */
+    void threadedTest(VMat testset, bool compute_costs,
+                      PP<VecStatsCollector> test_stats,
+                      VMat testoutputs, VMat testcosts) const;
+
+    //! Whether threadedTest() can be used on 'testset': 'n_test_threads' is
+    //! above 1, the learner is not stateful, the test set can give row
+    //! cursors and the statistics collected by the threads ('test_stats',
+    //! if not null) can be merged, i.e. do not keep a limited number of
+    //! counts ('maxnvalues' > 0). Otherwise test() and use() are sequential.
+    bool canTestInThreads(VMat testset,
+                          PP<VecStatsCollector> test_stats) const;
+
+    //! Return 'testset' read through a PrefetchVMatrix of blocks of
+    //! 'prefetch_test_rows' rows, which stops at the last row since the test
+    //! set is read once. 'testset' itself is returned if it cannot give row
+    //! cursors.
+    VMat prefetchTestSet(VMat testset) const;
+
 private:
     // List of methods that are called by Remote Method Invocation.  Our
     // convention is to have them start with the remote_ prefix.
@@ -0,0 +1,99 @@
+#include <plearn/vmat/MemoryVMatrix.h>
+#include <plearn/math/VecStatsCollector.h>
+#include <plearn_learners/regressors/LinearRegressor.h>
+
+using namespace PLearn;
+
+//! Test 'learner' with 'n_threads' threads, in a VecStatsCollector keeping
+//! at most 'maxnvalues' counts.
+PP<VecStatsCollector> testWithThreads( LinearRegressor& learner, VMat data,
+                                       int n_threads, int maxnvalues )
+{
+    PP<VecStatsCollector> stats = new VecStatsCollector();
+    stats->maxnvalues = maxnvalues;
+    learner.n_test_threads = n_threads;
+    learner.test( data, stats );
+    stats->finalize();
+    return stats;
+}
+
+bool compare( LinearRegressor& learner, VMat data, int maxnvalues )
+{
+    cout << "maxnvalues = " << maxnvalues << endl;
+    PP<VecStatsCollector> sequential = testWithThreads( learner, data, 1, maxnvalues );
+    PP<VecStatsCollector> threaded   = testWithThreads( learner, data, 4, maxnvalues );
+
+    bool equal = sequential->size() == threaded->size();
+    for ( int k=0; equal && k < sequential->size(); k++ )
+    {
+        const StatsCollector& s = sequential->getStats(k);
+        const StatsCollector& t = threaded->getStats(k);
+        if ( !is_equal( s.nnonmissing(), t.nnonmissing() )
+             || !is_equal( s.mean(), t.mean() )
+             || !is_equal( s.min(), t.min() )
+             || !is_equal( s.max(), t.max() ) )
+        {
+            cerr << "cost " << k << ": mean " << s.mean() << " vs "
+                 << t.mean() << endl;
+            equal = false;
+        }
+    }
+
+    if ( equal )
+        cout << "OK.\n===\n" << endl;
+    else
+        cout << "FAILED!!!" << endl;
+
+    return equal;
+}
+
+int main(int argc, char** argv)
+{
+    try{
+        const int n = 200;
+        Mat m(n, 3);
+        for ( int i=0; i < n; i++ )
+        {
+            m(i,0) = i % 17;
+            m(i,1) = (i * 7) % 11;
+            m(i,2) = 2 * m(i,0) - m(i,1) + (i % 3);
+        }
+        VMat data = new MemoryVMatrix( m );
+        data->defineSizes(2, 1, 0);
+
+        LinearRegressor learner;
+        learner.report_progress = 0;
+        learner.build();
+        learner.setTrainingSet( data, false );
+        learner.train();
+
+        // Statistics that keep a limited number of counts cannot be merged:
+        // the test must then be sequential rather than fail.
+        compare( learner, data, 0 );
+        compare( learner, data, 50 );
+        compare( learner, data, -1 );
+    }
+    catch(const PLearnError& e)
+    {
+        cerr << "FATAL ERROR: " << e.message() << endl;
+    }
+    catch (...) 
+    {
+        cerr << "FATAL ERROR: uncaught unknown exception" << endl;
+    }
+    
+    return 0;
+}
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
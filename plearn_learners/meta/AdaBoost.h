@@ -44,6 +44,7 @@
 #define AdaBoost_INC
 
 #include <plearn_learners/generic/PLearner.h>
+#include <plearn_learners/regressors/RegressionTreeForest.h>
 
 namespace PLearn {
 using namespace std;
@@ -62,6 +63,11 @@ class AdaBoost: public PLearner
     mutable TVec<VMat> saved_testoutputs;
     mutable TVec<int>  saved_last_test_stages;
 
+    //! Flattened copy of the weak learners when they are all
+    //! RegressionTree, kept in sync with weak_learners by updateForest().
+    mutable PP<RegressionTreeForest> forest;
+    mutable TMat<int> forest_leaves;
+
 protected:
     // average weighted error of each learner
     Vec learners_error;
@@ -133,6 +139,10 @@ public:
     // This is usefull to have a test time that is 
     // independent of the number of adaboost itaration
     bool reuse_test_results;
+
+    // Do we predict with a flattened copy of the weak learners when they
+    // are all RegressionTree?
+    bool flatten_trees;
     // ****************
     // * Constructors *
     // ****************
@@ -155,6 +165,11 @@ private:
     void computeOutput_(const Vec& input, Vec& output,
                         const int start=0, const real sum=0.) const;
 
+    //! Add the new weak learners to the forest. Return false if they can't
+    //! be flattened (flatten_trees is false or they are not all
+    //! RegressionTree).
+    bool updateForest() const;
+
 protected: 
     //! Declares this class' options
     // (Please implement in .cc)
@@ -203,6 +218,9 @@ public:
     //! Computes the output from the input
     virtual void computeOutput(const Vec& input, Vec& output) const{
         computeOutput_(input,output,0,0);}
+    //! Computes the outputs of many rows at once, using the forest if
+    //! possible.
+    virtual void computeOutputs(const Mat& input, Mat& output) const;
     virtual void computeOutputAndCosts(const Vec& input, const Vec& target,
                                        Vec& output, Vec& costs) const;
 
@@ -45,6 +45,7 @@
 #include <assert.h>
 #include <plearn/base/stringutils.h>
 #include <plearn/ker/DistanceKernel.h>
+#include <plearn/vmat/VMat_computeNearestNeighbors.h>
 
 namespace PLearn {
 using namespace std;
@@ -71,6 +72,11 @@ PLEARN_IMPLEMENT_OBJECT(
     "The output costs are simply the kernel values for each found training\n"
     "point.  The costs are named 'ker0', 'ker1', ..., 'kerK-1'.\n"
     "\n"
+    "With the default euclidean DistanceKernel, the batch methods (used e.g.\n"
+    "when 'test_minibatch_size' > 1) search all the queries of a batch at\n"
+    "once, computing the distances by blocks with matrix products on\n"
+    "'n_threads' threads.\n"
+    "\n"
 //    "The training set is SAVED with this learner, under the option name\n"
 //    "'train_set'. Otherwise, one would NOT be able to reload the learner\n"
 //    "and carry out test operations!\n"
@@ -81,7 +87,10 @@ Ker ExhaustiveNearestNeighbors::default_kernel = new DistanceKernel();
 ExhaustiveNearestNeighbors::ExhaustiveNearestNeighbors(
     Ker distance_kernel_, bool kernel_is_pseudo_distance_)
     : inherited(),
-      kernel_is_pseudo_distance(kernel_is_pseudo_distance_)
+      euclidean(false),
+      euclidean_pow(false),
+      kernel_is_pseudo_distance(kernel_is_pseudo_distance_),
+      n_threads(-1)
 {
     distance_kernel = distance_kernel_;
 }
@@ -105,6 +114,12 @@ void ExhaustiveNearestNeighbors::declareOptions(OptionList& ol)
         "measure (false). Default = true.  Note that this interpretation is\n"
         "strictly specific to the class ExhaustiveNearestNeighbors.\n");
 
+    declareOption(
+        ol, "n_threads", &ExhaustiveNearestNeighbors::n_threads,
+        OptionBase::buildoption | OptionBase::nosave,
+        "Number of threads used by the batch methods when the distance is\n"
+        "euclidean (-1 means as many as OpenMP provides).");
+
     declareOption(
         ol, "kernel", &GenericNearestNeighbors::distance_kernel,
         OptionBase::buildoption | OptionBase::nosave,
@@ -120,6 +135,15 @@ void ExhaustiveNearestNeighbors::build_()
     if (! distance_kernel)
         PLERROR("ExhaustiveNearestNeighbors::build_: the 'distance_kernel' option "
                 "must be specified");
+
+    euclidean = false;
+    euclidean_pow = false;
+    DistanceKernel* dk =
+        dynamic_cast<DistanceKernel*>((Kernel*) distance_kernel);
+    if (kernel_is_pseudo_distance && dk && dk->isEuclidean()) {
+        euclidean = true;
+        euclidean_pow = dk->pow_distance;
+    }
 }
 
 // ### Nothing to add here, simply calls build_
@@ -138,6 +162,8 @@ void ExhaustiveNearestNeighbors::makeDeepCopyFromShallowCopy(CopiesMap& copies)
     deepCopyField(tmp_indices,      copies);
     deepCopyField(tmp_distances,    copies);
     deepCopyField(cached_inputs,    copies);
+    deepCopyField(batch_indices,    copies);
+    deepCopyField(batch_distances,  copies);
 }
 
 void ExhaustiveNearestNeighbors::setTrainingSet(VMat training_set,
@@ -227,6 +253,58 @@ void ExhaustiveNearestNeighbors::computeOutput(const Vec& input, Vec& output) co
 }
 
 
+void ExhaustiveNearestNeighbors::findNearestNeighborsBatch(const Mat& input) const
+{
+    PLASSERT( euclidean );
+    if(cached_inputs.size()==0)
+        preloadInputCache();
+    computeNearestNeighbors(cached_inputs, input, num_neighbors,
+                            batch_indices, batch_distances, false, n_threads);
+    if (!euclidean_pow) {
+        for (int i=0, n=batch_distances.length(); i<n; i++) {
+            real* distances_i = batch_distances[i];
+            for (int j=0; j<num_neighbors; j++)
+                if (!is_missing(distances_i[j]))
+                    distances_i[j] = sqrt(distances_i[j]);
+        }
+    }
+}
+
+
+void ExhaustiveNearestNeighbors::computeOutputs(const Mat& input, Mat& output) const
+{
+    if (!euclidean) {
+        inherited::computeOutputs(input, output);
+        return;
+    }
+    findNearestNeighborsBatch(input);
+    int n = input.length();
+    output.resize(n, outputsize());
+    for (int i=0; i<n; i++) {
+        int effective_num_neighbors = 0;
+        while (effective_num_neighbors < num_neighbors
+               && batch_indices(i, effective_num_neighbors) >= 0)
+            effective_num_neighbors++;
+        tmp_indices = batch_indices(i).subVec(0, effective_num_neighbors);
+        Vec output_i = output(i);
+        constructOutputVector(tmp_indices, output_i);
+    }
+}
+
+
+void ExhaustiveNearestNeighbors::computeOutputsAndCosts(
+    const Mat& input, const Mat& target, Mat& output, Mat& costs) const
+{
+    if (!euclidean) {
+        inherited::computeOutputsAndCosts(input, target, output, costs);
+        return;
+    }
+    computeOutputs(input, output);
+    costs.resize(input.length(), num_neighbors);
+    costs << batch_distances;
+}
+
+
 void ExhaustiveNearestNeighbors::computeCostsFromOutputs(
     const Vec& input, const Vec& output, const Vec& target, Vec& costs) const
 {
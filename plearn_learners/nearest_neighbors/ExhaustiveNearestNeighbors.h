@@ -104,6 +104,16 @@ protected:
     //! The priority queue for finding the k nearest neighbors
     mutable priority_queue< pair<real,int> > pq;
 
+    //! Neighbors and kernel values found by the batch methods
+    mutable TMat<int> batch_indices;
+    mutable Mat batch_distances;
+
+    //! Whether distance_kernel is a plain L2 DistanceKernel, which the batch
+    //! methods then compute with matrix products, and whether it returns
+    //! the squared distance.
+    bool euclidean;
+    bool euclidean_pow;
+
   
 public:
     //#####  Public Build Options  ############################################
@@ -120,6 +130,10 @@ public:
      */
     bool kernel_is_pseudo_distance;
 
+    //! Number of threads used by the batch methods with an euclidean
+    //! distance (-1 means as many as OpenMP provides).
+    int n_threads;
+
 public:
     //#####  Object Methods  ##################################################
   
@@ -161,6 +175,14 @@ public:
     //! Computes the output from the input.
     virtual void computeOutput(const Vec& input, Vec& output) const;
 
+    //! Batch version of computeOutput; with an euclidean distance, all
+    //! the queries are searched at once with a blocked matrix product.
+    virtual void computeOutputs(const Mat& input, Mat& output) const;
+
+    //! Batch version of computeOutputAndCosts (see computeOutputs).
+    virtual void computeOutputsAndCosts(const Mat& input, const Mat& target,
+                                        Mat& output, Mat& costs) const;
+
     //! Computes the costs from already computed output. 
     virtual void computeCostsFromOutputs(const Vec& input, const Vec& output, 
                                          const Vec& target, Vec& costs) const;
@@ -191,6 +213,10 @@ protected:
     //! (if there are less than K points in the training set, then indices and distances
     //! are resized to the effective number of neighbours found).
     void findNearestNeighbors(const Vec& input, int K, TVec<int>& indices, Vec& distances) const;
+
+    //! Fills batch_indices and batch_distances with the num_neighbors
+    //! nearest neighbors of each row of 'input' (euclidean case only).
+    void findNearestNeighborsBatch(const Mat& input) const;
 };
 
 // Declares a few other classes and functions related to this class.
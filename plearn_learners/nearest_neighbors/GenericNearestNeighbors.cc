@@ -218,6 +218,51 @@ int GenericNearestNeighbors::outputsize() const
     return num_neighbors * base_outputsize;
 }
 
+
+void GenericNearestNeighbors::computeTrainingNeighborhoods(VMat points,
+                                                           int n_neighbors,
+                                                           TMat<int>& neighbors,
+                                                           bool progress) const
+{
+    PP<GenericNearestNeighbors> finder = ::PLearn::deepCopy(this);
+    finder->num_neighbors = n_neighbors;
+    finder->report_progress = progress;
+    finder->copy_input  = false;
+    finder->copy_target = false;
+    finder->copy_weight = false;
+    finder->copy_index  = true;
+    finder->setTrainingSet(points);
+    finder->train();
+
+    int n = points->length();
+    Mat inputs(n, points->inputsize());
+    for (int i = 0; i < n; i++)
+        points->getSubRow(i, 0, inputs(i));
+    // Batch query, so that finders with a parallel search may use it.
+    Mat found(n, n_neighbors);
+    finder->computeOutputs(inputs, found);
+
+    // The point itself normally comes first, but duplicates (or an
+    // approximate search) may return it later or not at all.
+    neighbors.resize(n, n_neighbors);
+    for (int i = 0; i < n; i++) {
+        int* row = neighbors[i];
+        row[0] = i;
+        int n_found = 1;
+        for (int k = 0; k < n_neighbors && n_found < n_neighbors; k++) {
+            if (is_missing(found(i,k)))
+                break;
+            int j = int(found(i,k));
+            if (j != i)
+                row[n_found++] = j;
+        }
+        if (n_found < n_neighbors)
+            PLERROR("In GenericNearestNeighbors::computeTrainingNeighborhoods"
+                    " - Only %d neighbors found for point %d (%d requested)",
+                    n_found, i, n_neighbors);
+    }
+}
+
 void GenericNearestNeighbors::constructOutputVector(const TVec<int>& indices,
                                                     Vec& output,
                                                     const Mat& train_mat_override) const
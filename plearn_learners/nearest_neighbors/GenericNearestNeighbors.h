@@ -157,6 +157,15 @@ public:
     //! may depend on its inputsize(), targetsize() and set options).
     virtual int outputsize() const;
 
+    //! Trains a deep copy of this learner on the input part of 'points'
+    //! and fills row i of 'neighbors' with i itself followed by the
+    //! (n_neighbors - 1) nearest other points.  The copy only outputs the
+    //! indices; this learner is left unchanged.  Used by the VMatrices that
+    //! append or list neighborhoods, to let them use any neighbors finder.
+    void computeTrainingNeighborhoods(VMat points, int n_neighbors,
+                                      TMat<int>& neighbors,
+                                      bool progress = false) const;
+
 private: 
     //! This does the actual building. 
     void build_();
@@ -0,0 +1,630 @@
+// -*- C++ -*-
+
+// HNSWNearestNeighbors.cc
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file HNSWNearestNeighbors.cc */
+
+
+#include "HNSWNearestNeighbors.h"
+#include <plearn/base/ProgressBar.h>
+#include <plearn/base/stringutils.h>
+#include <plearn/ker/DistanceKernel.h>
+#include <plearn/math/PRandom.h>
+#include <plearn/math/simd_kernels.h>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace PLearn {
+using namespace std;
+
+PLEARN_IMPLEMENT_OBJECT(
+    HNSWNearestNeighbors,
+    "Approximate nearest neighbors with a hierarchical navigable small world graph",
+    "Training inserts every example of the training set in a layered proximity\n"
+    "graph: each point is given a random top level (geometrically distributed),\n"
+    "and on each level up to its top it is linked to its 'max_connections'\n"
+    "closest neighbors found so far (2*max_connections on the bottom level),\n"
+    "selected with the diversity heuristic of Malkov & Yashunin.  A query\n"
+    "greedily descends the upper levels and then runs a best-first search of\n"
+    "width 'ef_search' on the bottom level.  Raising 'ef_search' trades latency\n"
+    "for recall; 'ef_construction' plays the same role for the graph quality.\n"
+    "\n"
+    "The 'distance_kernel' must be a (pseudo-)distance, i.e. LOWER for closer\n"
+    "points.  When it is an L2 DistanceKernel (the default), distances are\n"
+    "computed with the vectorized kernels on the cached inputs, and the batch\n"
+    "methods (used e.g. when 'test_minibatch_size' > 1) search the queries on\n"
+    "several threads.\n"
+    "\n"
+    "The output costs are the kernel values of the neighbors found, named\n"
+    "'ker0', 'ker1', ..., 'kerK-1', as with ExhaustiveNearestNeighbors, so this\n"
+    "learner can be used wherever a GenericNearestNeighbors is expected (e.g.\n"
+    "the 'knn' option of KNNClassifier and KNNRegressor).  The graph is saved\n"
+    "as learnt options, together with the training set, so that a reloaded\n"
+    "learner can be queried without retraining.\n"
+    );
+
+HNSWNearestNeighbors::HNSWNearestNeighbors()
+    : max_connections(16),
+      ef_construction(200),
+      ef_search(50),
+      n_threads(-1),
+      entry_point(-1),
+      max_level(-1),
+      euclidean(false),
+      euclidean_pow(false)
+{
+    distance_kernel = new DistanceKernel();
+}
+
+void HNSWNearestNeighbors::declareOptions(OptionList& ol)
+{
+    declareOption(
+        ol, "max_connections", &HNSWNearestNeighbors::max_connections,
+        OptionBase::buildoption,
+        "Number of links of a point on each upper level of the graph (twice\n"
+        "that on the bottom level).  Larger values give a better recall, at\n"
+        "the cost of memory and of slower training and queries.");
+
+    declareOption(
+        ol, "ef_construction", &HNSWNearestNeighbors::ef_construction,
+        OptionBase::buildoption,
+        "Width of the candidate list used when inserting a point in the\n"
+        "graph.  Larger values give a better graph but a slower training.");
+
+    declareOption(
+        ol, "ef_search", &HNSWNearestNeighbors::ef_search,
+        OptionBase::buildoption,
+        "Width of the candidate list used when answering a query (it is\n"
+        "never smaller than 'num_neighbors').  This is the main recall /\n"
+        "latency trade-off and may be changed after training.");
+
+    declareOption(
+        ol, "n_threads", &HNSWNearestNeighbors::n_threads,
+        OptionBase::buildoption | OptionBase::nosave,
+        "Number of threads used by the batch query methods, when the\n"
+        "distance is euclidean (-1 means as many as OpenMP provides).");
+
+    declareOption(
+        ol, "node_level", &HNSWNearestNeighbors::node_level,
+        OptionBase::learntoption,
+        "Top level of each point of the training set.");
+
+    declareOption(
+        ol, "level0_links", &HNSWNearestNeighbors::level0_links,
+        OptionBase::learntoption,
+        "Bottom level adjacency lists, one row per point.");
+
+    declareOption(
+        ol, "level0_count", &HNSWNearestNeighbors::level0_count,
+        OptionBase::learntoption,
+        "Number of links used in each row of 'level0_links'.");
+
+    declareOption(
+        ol, "upper_links", &HNSWNearestNeighbors::upper_links,
+        OptionBase::learntoption,
+        "Upper levels adjacency lists, one row per point and level above 0.");
+
+    declareOption(
+        ol, "upper_count", &HNSWNearestNeighbors::upper_count,
+        OptionBase::learntoption,
+        "Number of links used in each row of 'upper_links'.");
+
+    declareOption(
+        ol, "upper_offset", &HNSWNearestNeighbors::upper_offset,
+        OptionBase::learntoption,
+        "Row of 'upper_links' holding the level 1 links of each point (-1\n"
+        "for points that only live on the bottom level).");
+
+    declareOption(
+        ol, "entry_point", &HNSWNearestNeighbors::entry_point,
+        OptionBase::learntoption,
+        "Point through which every search enters the graph (-1 if empty).");
+
+    declareOption(
+        ol, "max_level", &HNSWNearestNeighbors::max_level,
+        OptionBase::learntoption,
+        "Top level of the entry point.");
+
+    // Now call the parent class' declareOptions
+    inherited::declareOptions(ol);
+}
+
+void HNSWNearestNeighbors::build_()
+{
+    if (!distance_kernel)
+        PLERROR("HNSWNearestNeighbors::build_: the 'distance_kernel' option "
+                "must be specified");
+    if (max_connections < 2)
+        PLERROR("HNSWNearestNeighbors::build_: 'max_connections' must be at "
+                "least 2 (got %d)", max_connections);
+    if (ef_construction < 1 || ef_search < 1)
+        PLERROR("HNSWNearestNeighbors::build_: 'ef_construction' and "
+                "'ef_search' must be positive");
+
+    euclidean = false;
+    euclidean_pow = false;
+    DistanceKernel* dk =
+        dynamic_cast<DistanceKernel*>((Kernel*) distance_kernel);
+    if (dk && dk->isEuclidean()) {
+        euclidean = true;
+        euclidean_pow = dk->pow_distance;
+    }
+}
+
+void HNSWNearestNeighbors::build()
+{
+    inherited::build();
+    build_();
+}
+
+void HNSWNearestNeighbors::makeDeepCopyFromShallowCopy(CopiesMap& copies)
+{
+    inherited::makeDeepCopyFromShallowCopy(copies);
+
+    deepCopyField(node_level,      copies);
+    deepCopyField(level0_links,    copies);
+    deepCopyField(level0_count,    copies);
+    deepCopyField(upper_links,     copies);
+    deepCopyField(upper_count,     copies);
+    deepCopyField(upper_offset,    copies);
+    deepCopyField(cached_inputs,   copies);
+    deepCopyField(dummy_vec,       copies);
+    deepCopyField(tmp_indices,     copies);
+    deepCopyField(batch_indices,   copies);
+    deepCopyField(batch_distances, copies);
+}
+
+void HNSWNearestNeighbors::setTrainingSet(VMat training_set, bool call_forget)
+{
+    inherited::setTrainingSet(training_set, call_forget);
+    cached_inputs.resize(0,0);
+}
+
+void HNSWNearestNeighbors::forget()
+{
+    cached_inputs.resize(0,0);
+    node_level.resize(0);
+    level0_links.resize(0,0);
+    level0_count.resize(0);
+    upper_links.resize(0,0);
+    upper_count.resize(0);
+    upper_offset.resize(0);
+    entry_point = -1;
+    max_level = -1;
+}
+
+void HNSWNearestNeighbors::train()
+{
+    // As in ExhaustiveNearestNeighbors, the training set is only read here,
+    // since it may depend on learners not trained at setTrainingSet time.
+    cached_inputs.resize(0,0);
+    preloadInputCache();
+
+    int n = cached_inputs.length();
+    int m = max_connections;
+    node_level.resize(n);
+    level0_links.resize(n, 2 * m);
+    level0_count.resize(n);
+    level0_count.fill(0);
+    upper_offset.resize(n);
+
+    // Draw all levels first so that the upper adjacency lists can be laid
+    // out contiguously.
+    PRandom rng(seed_);
+    real level_mult = 1 / std::log(real(m));
+    int n_upper = 0;
+    for (int i = 0; i < n; i++) {
+        int level = int(-std::log(1 - rng.uniform_sample()) * level_mult);
+        node_level[i] = level;
+        upper_offset[i] = level > 0 ? n_upper : -1;
+        n_upper += level;
+    }
+    upper_links.resize(n_upper, m);
+    upper_count.resize(n_upper);
+    upper_count.fill(0);
+
+    entry_point = -1;
+    max_level = -1;
+    PP<ProgressBar> pb;
+    if (report_progress)
+        pb = new ProgressBar("Building HNSW graph", n);
+    SearchBuffer buf;
+    for (int i = 0; i < n; i++) {
+        insertNode(i, buf);
+        if (pb)
+            pb->update(i + 1);
+    }
+}
+
+void HNSWNearestNeighbors::SearchBuffer::newSearch(int n)
+{
+    if (int(mark.size()) != n) {
+        mark.assign(n, 0);
+        epoch = 0;
+    }
+    if (++epoch == 0) {
+        // Wrapped around: old marks could collide with the new epoch.
+        mark.assign(n, 0);
+        epoch = 1;
+    }
+}
+
+real HNSWNearestNeighbors::distanceTo(const Vec& input, int i) const
+{
+    PLASSERT( input.size() == cached_inputs.width() );
+    if (euclidean)
+        return simdSquaredDistance(input.data(), cached_inputs[i],
+                                   cached_inputs.width());
+    return distance_kernel(input, cached_inputs(i));
+}
+
+real HNSWNearestNeighbors::nodeDistance(int i, int j) const
+{
+    if (euclidean)
+        return simdSquaredDistance(cached_inputs[i], cached_inputs[j],
+                                   cached_inputs.width());
+    return distance_kernel(cached_inputs(i), cached_inputs(j));
+}
+
+real HNSWNearestNeighbors::kernelValue(real d) const
+{
+    if (euclidean && !euclidean_pow)
+        return std::sqrt(d);
+    return d;
+}
+
+int* HNSWNearestNeighbors::links(int node, int level, int*& count) const
+{
+    if (level == 0) {
+        count = &level0_count[node];
+        return level0_links[node];
+    }
+    PLASSERT( level <= node_level[node] );
+    int row = upper_offset[node] + level - 1;
+    count = &upper_count[row];
+    return upper_links[row];
+}
+
+void HNSWNearestNeighbors::greedySearch(const Vec& input, int level,
+                                        int& node, real& d) const
+{
+    bool moved = true;
+    while (moved) {
+        moved = false;
+        int* count;
+        const int* neighbors = links(node, level, count);
+        for (int k = 0; k < *count; k++) {
+            real dk = distanceTo(input, neighbors[k]);
+            if (dk < d) {
+                d = dk;
+                node = neighbors[k];
+                moved = true;
+            }
+        }
+    }
+}
+
+void HNSWNearestNeighbors::searchLevel(const Vec& input, int node, real d,
+                                       int ef, int level,
+                                       SearchBuffer& buf) const
+{
+    typedef pair<real,int> Candidate;
+    buf.newSearch(cached_inputs.length());
+
+    // 'candidates' pops the closest point still to expand, 'best' the
+    // farthest of the ef closest points found so far.
+    priority_queue< Candidate, vector<Candidate>, greater<Candidate> >
+        candidates;
+    priority_queue<Candidate> best;
+    buf.mark[node] = buf.epoch;
+    candidates.push(Candidate(d, node));
+    best.push(Candidate(d, node));
+
+    while (!candidates.empty()) {
+        Candidate current = candidates.top();
+        if (current.first > best.top().first)
+            break;
+        candidates.pop();
+
+        int* count;
+        const int* neighbors = links(current.second, level, count);
+        for (int k = 0; k < *count; k++) {
+            int j = neighbors[k];
+            if (buf.mark[j] == buf.epoch)
+                continue;
+            buf.mark[j] = buf.epoch;
+            real dj = distanceTo(input, j);
+            if (int(best.size()) < ef || dj < best.top().first) {
+                candidates.push(Candidate(dj, j));
+                best.push(Candidate(dj, j));
+                if (int(best.size()) > ef)
+                    best.pop();
+            }
+        }
+    }
+
+    buf.found.resize(best.size());
+    for (int k = int(best.size()) - 1; k >= 0; k--) {
+        buf.found[k] = best.top();
+        best.pop();
+    }
+}
+
+void HNSWNearestNeighbors::selectNeighbors(int m, SearchBuffer& buf) const
+{
+    buf.selected.clear();
+    if (int(buf.found.size()) <= m) {
+        buf.selected = buf.found;
+        return;
+    }
+    // A candidate is dropped when it is closer to a point already kept than
+    // to the base point: that kept point will lead to it anyway, and the
+    // link is better spent in another direction.
+    for (int k = 0; k < int(buf.found.size())
+             && int(buf.selected.size()) < m; k++)
+    {
+        const pair<real,int>& candidate = buf.found[k];
+        bool keep = true;
+        for (int s = 0; s < int(buf.selected.size()); s++)
+            if (nodeDistance(candidate.second, buf.selected[s].second)
+                < candidate.first)
+            {
+                keep = false;
+                break;
+            }
+        if (keep)
+            buf.selected.push_back(candidate);
+    }
+}
+
+void HNSWNearestNeighbors::insertNode(int i, SearchBuffer& buf)
+{
+    int level = node_level[i];
+    if (entry_point < 0) {
+        entry_point = i;
+        max_level = level;
+        return;
+    }
+
+    Vec input = cached_inputs(i);
+    int node = entry_point;
+    real d = distanceTo(input, node);
+    for (int l = max_level; l > level; l--)
+        greedySearch(input, l, node, d);
+
+    for (int l = min(level, max_level); l >= 0; l--) {
+        searchLevel(input, node, d, ef_construction, l, buf);
+        node = buf.found[0].second;
+        d = buf.found[0].first;
+
+        selectNeighbors(max_connections, buf);
+        int* count;
+        int* own_links = links(i, l, count);
+        *count = int(buf.selected.size());
+        for (int k = 0; k < *count; k++)
+            own_links[k] = buf.selected[k].second;
+
+        // Add the reverse links, shrinking the lists that are full.
+        int max_links = l == 0 ? 2 * max_connections : max_connections;
+        for (int k = 0; k < *count; k++) {
+            int j = own_links[k];
+            int* j_count;
+            int* j_links = links(j, l, j_count);
+            if (*j_count < max_links) {
+                j_links[(*j_count)++] = i;
+                continue;
+            }
+            buf.found.resize(*j_count + 1);
+            buf.found[0] = pair<real,int>(nodeDistance(j, i), i);
+            for (int t = 0; t < *j_count; t++)
+                buf.found[t + 1] =
+                    pair<real,int>(nodeDistance(j, j_links[t]), j_links[t]);
+            sort(buf.found.begin(), buf.found.end());
+            selectNeighbors(max_links, buf);
+            *j_count = int(buf.selected.size());
+            for (int t = 0; t < *j_count; t++)
+                j_links[t] = buf.selected[t].second;
+        }
+    }
+
+    if (level > max_level) {
+        entry_point = i;
+        max_level = level;
+    }
+}
+
+int HNSWNearestNeighbors::findNearestNeighbors(const Vec& input, int K,
+                                               SearchBuffer& buf) const
+{
+    if (entry_point < 0)
+        return 0;
+    if (cached_inputs.length() == 0)
+        preloadInputCache();
+
+    int node = entry_point;
+    real d = distanceTo(input, node);
+    for (int l = max_level; l > 0; l--)
+        greedySearch(input, l, node, d);
+    searchLevel(input, node, d, max(ef_search, K), 0, buf);
+    return min(K, int(buf.found.size()));
+}
+
+void HNSWNearestNeighbors::findNearestNeighborsBatch(
+    const Mat& input, int K, TMat<int>& indices, Mat& distances) const
+{
+    int n = input.length();
+    indices.resize(n, K);
+    distances.resize(n, K);
+    indices.fill(-1);
+    distances.fill(MISSING_VALUE);
+    if (entry_point < 0 || n == 0)
+        return;
+    if (cached_inputs.length() == 0)
+        preloadInputCache();
+
+    // Row Vecs are made here: their reference counts may not be touched by
+    // several threads.
+    TVec<Vec> rows(n);
+    for (int i = 0; i < n; i++)
+        rows[i] = input(i);
+
+    // A generic kernel may keep internal state, so it is only evaluated in
+    // the calling thread.
+#ifdef _OPENMP
+    int nt = 1;
+    if (euclidean && !omp_in_parallel())
+        nt = min(n_threads > 0 ? n_threads : omp_get_max_threads(), n);
+#pragma omp parallel num_threads(nt) if(nt > 1)
+#endif
+    {
+        SearchBuffer buf;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+        for (int i = 0; i < n; i++) {
+            int n_found = findNearestNeighbors(rows[i], K, buf);
+            int* row_indices = indices[i];
+            real* row_distances = distances[i];
+            for (int k = 0; k < n_found; k++) {
+                row_indices[k] = buf.found[k].second;
+                row_distances[k] = kernelValue(buf.found[k].first);
+            }
+        }
+    }
+}
+
+void HNSWNearestNeighbors::computeOutputAndCosts(
+    const Vec& input, const Vec& target, Vec& output, Vec& costs) const
+{
+    int n_found = findNearestNeighbors(input, num_neighbors, search_buffer);
+    tmp_indices.resize(n_found);
+    costs.resize(num_neighbors);
+    for (int k = 0; k < n_found; k++) {
+        tmp_indices[k] = search_buffer.found[k].second;
+        costs[k] = kernelValue(search_buffer.found[k].first);
+    }
+    // Make remaining costs into missing values if the found number of
+    // neighbors is smaller than the requested number of neighbors
+    for (int k = n_found; k < num_neighbors; k++)
+        costs[k] = MISSING_VALUE;
+
+    constructOutputVector(tmp_indices, output);
+}
+
+void HNSWNearestNeighbors::computeOutput(const Vec& input, Vec& output) const
+{
+    int n_found = findNearestNeighbors(input, num_neighbors, search_buffer);
+    tmp_indices.resize(n_found);
+    for (int k = 0; k < n_found; k++)
+        tmp_indices[k] = search_buffer.found[k].second;
+    constructOutputVector(tmp_indices, output);
+}
+
+void HNSWNearestNeighbors::computeOutputs(const Mat& input, Mat& output) const
+{
+    findNearestNeighborsBatch(input, num_neighbors,
+                              batch_indices, batch_distances);
+    int n = input.length();
+    output.resize(n, outputsize());
+    for (int i = 0; i < n; i++) {
+        int n_found = 0;
+        while (n_found < num_neighbors && batch_indices(i, n_found) >= 0)
+            n_found++;
+        tmp_indices = batch_indices(i).subVec(0, n_found);
+        Vec output_i = output(i);
+        constructOutputVector(tmp_indices, output_i);
+    }
+}
+
+void HNSWNearestNeighbors::computeOutputsAndCosts(
+    const Mat& input, const Mat& target, Mat& output, Mat& costs) const
+{
+    computeOutputs(input, output);
+    costs.resize(input.length(), num_neighbors);
+    costs << batch_distances;
+}
+
+void HNSWNearestNeighbors::computeCostsFromOutputs(
+    const Vec& input, const Vec& output, const Vec& target, Vec& costs) const
+{
+    // Not really efficient (the output has probably already been computed).
+    dummy_vec.resize(outputsize());
+    computeOutputAndCosts(input, target, dummy_vec, costs);
+}
+
+TVec<string> HNSWNearestNeighbors::getTestCostNames() const
+{
+    TVec<string> costs(num_neighbors);
+    for (int i=0, n=num_neighbors ; i<n ; ++i)
+        costs[i] = "ker" + tostring(i);
+    return costs;
+}
+
+int HNSWNearestNeighbors::nTestCosts() const
+{
+    return num_neighbors;
+}
+
+TVec<string> HNSWNearestNeighbors::getTrainCostNames() const
+{
+    // No training statistics
+    return TVec<string>();
+}
+
+void HNSWNearestNeighbors::preloadInputCache() const
+{
+    int l = train_set->length();
+    int ninputs = train_set->inputsize();
+    cached_inputs.resize(l,ninputs);
+    for(int i=0; i<l; i++)
+        train_set->getSubRow(i,0,cached_inputs(i));
+}
+
+} // end of namespace PLearn
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
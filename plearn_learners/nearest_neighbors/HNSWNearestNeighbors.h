@@ -0,0 +1,277 @@
+// -*- C++ -*-
+
+// HNSWNearestNeighbors.h
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+/*! \file HNSWNearestNeighbors.h */
+
+
+#ifndef HNSWNearestNeighbors_INC
+#define HNSWNearestNeighbors_INC
+
+// From PLearn
+#include <plearn_learners/nearest_neighbors/GenericNearestNeighbors.h>
+#include <plearn/ker/Kernel.h>
+
+// From C++ stdlib
+#include <utility>                           //!< for pair
+#include <vector>
+
+namespace PLearn {
+
+/**
+ * Approximate nearest neighbors through a Hierarchical Navigable Small World
+ * (HNSW) graph.
+ *
+ * Training inserts every example of the training set in a layered proximity
+ * graph: each point is given a random top level (geometrically distributed),
+ * and on each level up to its top it is linked to its 'max_connections'
+ * closest neighbors found so far (2*max_connections on the bottom level),
+ * selected with the diversity heuristic of Malkov & Yashunin.  A query
+ * greedily descends the upper levels and then runs a best-first search of
+ * width 'ef_search' on the bottom level.  Raising 'ef_search' trades latency
+ * for recall; 'ef_construction' plays the same role for the graph quality.
+ *
+ * The 'distance_kernel' must be a (pseudo-)distance, i.e. LOWER for closer
+ * points.  When it is an L2 DistanceKernel (the default), distances are
+ * computed with the vectorized kernels on the cached inputs, and the batch
+ * methods (computeOutputs / computeOutputsAndCosts) search the queries on
+ * several threads.
+ *
+ * The output costs are the kernel values of the neighbors found, named
+ * 'ker0', 'ker1', ..., 'kerK-1', as with ExhaustiveNearestNeighbors.  The
+ * graph is saved as learnt options, together with the training set, so that
+ * a reloaded learner can be queried without retraining.
+ */
+class HNSWNearestNeighbors: public GenericNearestNeighbors
+{
+    typedef GenericNearestNeighbors inherited;
+
+public:
+    //#####  Public Build Options  ############################################
+
+    //! Number of links of a point on each upper level of the graph (twice
+    //! that on the bottom level).
+    int max_connections;
+
+    //! Width of the candidate list used when inserting a point.
+    int ef_construction;
+
+    //! Width of the candidate list used when answering a query (at least
+    //! num_neighbors).
+    int ef_search;
+
+    //! Number of threads used by the batch query methods (-1 means as many
+    //! as OpenMP provides).
+    int n_threads;
+
+public:
+    //#####  Object Methods  ##################################################
+
+    //! Default constructor.
+    HNSWNearestNeighbors();
+
+    //! Simply calls inherited::build() then build_().
+    virtual void build();
+
+    //! Transforms a shallow copy into a deep copy.
+    virtual void makeDeepCopyFromShallowCopy(CopiesMap& copies);
+
+    PLEARN_DECLARE_OBJECT(HNSWNearestNeighbors);
+
+public:
+    //#####  PLearner Methods  ################################################
+
+    //! Overridden to drop the graph and the input cache.
+    virtual void setTrainingSet(VMat training_set, bool call_forget=true);
+
+    //! Drops the graph and sets 'stage' back to 0.
+    virtual void forget();
+
+    //! Builds the graph over the input part of the training set.
+    virtual void train();
+
+    //! Compute the output and cost from the input
+    virtual void computeOutputAndCosts(const Vec& input, const Vec& target,
+                                       Vec& output, Vec& costs) const;
+
+    //! Computes the output from the input.
+    virtual void computeOutput(const Vec& input, Vec& output) const;
+
+    //! Batch version of computeOutput, searching the rows in parallel.
+    virtual void computeOutputs(const Mat& input, Mat& output) const;
+
+    //! Batch version of computeOutputAndCosts, searching the rows in
+    //! parallel.
+    virtual void computeOutputsAndCosts(const Mat& input, const Mat& target,
+                                        Mat& output, Mat& costs) const;
+
+    //! Computes the costs from already computed output.
+    virtual void computeCostsFromOutputs(const Vec& input, const Vec& output,
+                                         const Vec& target, Vec& costs) const;
+
+    //! Returns 'ker0', ..., 'kerK-1'.
+    virtual TVec<std::string> getTestCostNames() const;
+
+    //! Return num_neighbors
+    virtual int nTestCosts() const;
+
+    //! No training costs.
+    virtual TVec<std::string> getTrainCostNames() const;
+
+protected:
+    //#####  Learnt Options  ##################################################
+
+    //! Top level of each point of the training set.
+    TVec<int> node_level;
+
+    //! Bottom level adjacency lists (one row of 2*max_connections per point)
+    //! and their effective lengths.
+    TMat<int> level0_links;
+    TVec<int> level0_count;
+
+    //! Upper levels adjacency lists (one row of max_connections per point and
+    //! level above 0) and their effective lengths.  The links of point i on
+    //! level l > 0 are in row upper_offset[i] + l - 1.
+    TMat<int> upper_links;
+    TVec<int> upper_count;
+    TVec<int> upper_offset;
+
+    //! Point through which every search enters the graph, and its level.
+    int entry_point;
+    int max_level;
+
+    //#####  Not Options  #####################################################
+
+    //! Visited marks for one search; 'epoch' is bumped instead of clearing
+    //! 'mark' between searches.
+    struct SearchBuffer
+    {
+        std::vector<unsigned int> mark;
+        unsigned int epoch;
+        std::vector< std::pair<real,int> > found;
+        std::vector< std::pair<real,int> > selected;
+
+        SearchBuffer(): epoch(0) {}
+        void newSearch(int n);
+    };
+
+    //! Input part of the training set.
+    mutable Mat cached_inputs;
+
+    //! Whether distance_kernel is a plain L2 DistanceKernel, in which case
+    //! squared distances are computed directly on the cached inputs, and
+    //! whether it returns the squared distance.
+    bool euclidean;
+    bool euclidean_pow;
+
+    //! Search buffer for the single-query methods.
+    mutable SearchBuffer search_buffer;
+
+    //! Internal vectors for the query methods.
+    mutable Vec dummy_vec;
+    mutable TVec<int> tmp_indices;
+    mutable TMat<int> batch_indices;
+    mutable Mat batch_distances;
+
+private:
+    //! This does the actual building.
+    void build_();
+
+protected:
+    //! Declares this class' options.
+    static void declareOptions(OptionList& ol);
+
+    //! Loads the input part of the train_set in cached_inputs
+    void preloadInputCache() const;
+
+    //! Distance (squared in euclidean mode) between 'input' and point i.
+    real distanceTo(const Vec& input, int i) const;
+
+    //! Distance (squared in euclidean mode) between points i and j.
+    real nodeDistance(int i, int j) const;
+
+    //! Converts a distance returned by distanceTo into a kernel value.
+    real kernelValue(real d) const;
+
+    //! Adjacency list of a point on a level, with a pointer to its length.
+    int* links(int node, int level, int*& count) const;
+
+    //! Greedy walk on an upper level: moves 'node' (at distance 'd' from
+    //! the input) to a local minimum of the distance.
+    void greedySearch(const Vec& input, int level, int& node, real& d) const;
+
+    //! Best-first search of width 'ef' on one level, starting from 'node'.
+    //! Fills buf.found with the points found, sorted by increasing distance.
+    void searchLevel(const Vec& input, int node, real d, int ef, int level,
+                     SearchBuffer& buf) const;
+
+    //! Keeps at most 'm' of the sorted candidates in buf.found, preferring
+    //! those not closer to an already kept point than to the base point.
+    //! The result goes to buf.selected.
+    void selectNeighbors(int m, SearchBuffer& buf) const;
+
+    //! Inserts point i, whose level is node_level[i], in the graph.
+    void insertNode(int i, SearchBuffer& buf);
+
+    //! Finds the K approximate nearest neighbors of 'input', which are left
+    //! in the first entries of buf.found.  Returns how many were found
+    //! (less than K only if the training set is smaller than K).
+    int findNearestNeighbors(const Vec& input, int K,
+                             SearchBuffer& buf) const;
+
+    //! Search part of the batch methods: fills row i of 'indices' and
+    //! 'distances' (resized to K columns) with the neighbors of row i of
+    //! 'input', padding with -1 / missing values when fewer are found.
+    void findNearestNeighborsBatch(const Mat& input, int K,
+                                   TMat<int>& indices, Mat& distances) const;
+};
+
+// Declares a few other classes and functions related to this class.
+DECLARE_OBJECT_PTR(HNSWNearestNeighbors);
+
+} // end of namespace PLearn
+
+#endif
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
@@ -39,6 +39,7 @@
 
 #define PL_LOG_MODULE_NAME "DeepBeliefNet"
 #include "DeepBeliefNet.h"
+#include "RBMMatrixConnection.h"
 #include "RBMMatrixTransposeConnection.h"
 #include <plearn/io/pl_log.h>
 #include <plearn/io/load_and_save.h>
@@ -81,6 +82,8 @@ DeepBeliefNet::DeepBeliefNet() :
     prob_salt_noise( 0.5 ),
     online ( false ),
     background_gibbs_update_ratio(0),
+    n_train_threads( 1 ),
+    bulk_sampling( false ),
     gibbs_chain_reinit_freq( INT_MAX ),
     mean_field_contrastive_divergence_ratio( 0 ),
     train_stats_window( -1 ),
@@ -405,6 +408,26 @@ void DeepBeliefNet::declareOptions(OptionList& ol)
                   " top-layer.\n"
                   "Only used if online for the moment.\n");
 
+    declareOption(ol, "n_train_threads", &DeepBeliefNet::n_train_threads,
+                  OptionBase::buildoption | OptionBase::nosave,
+                  "If > 1, the mini-batch up and down passes and the\n"
+                  "contrastive divergence (and background Gibbs chain) updates\n"
+                  "are split among this number of threads: it is forwarded to\n"
+                  "the 'n_threads' option of the RBMMatrixConnection\n"
+                  "connections. The rows of the mini-batch products and of the\n"
+                  "weight statistics are split in fixed blocks, so these\n"
+                  "computations give the same results with any number of\n"
+                  "threads. The sampling of the layers is not affected (see\n"
+                  "'bulk_sampling'). Has no effect without OpenMP.\n");
+
+    declareOption(ol, "bulk_sampling", &DeepBeliefNet::bulk_sampling,
+                  OptionBase::buildoption | OptionBase::nosave,
+                  "If true, the 'bulk_sampling' option of all the layers is\n"
+                  "set, so that they draw the random numbers of a whole\n"
+                  "mini-batch at once. This is much faster, but does not give\n"
+                  "the same samples (hence the same results) as the default\n"
+                  "sampling. When false, the layers are left as they are.\n");
+
     declareOption(ol, "n_layers", &DeepBeliefNet::n_layers,
                   OptionBase::learntoption,
                   "Number of layers");
@@ -792,6 +815,18 @@ void DeepBeliefNet::build_layers_and_connections()
         layers[n_layers-1]->random_gen = random_gen;
         layers[n_layers-1]->forget();
     }
+    // Also reset when n_train_threads is lowered back to 1 on a rebuild.
+    for( int i=0 ; i<n_layers-1 ; i++ )
+    {
+        RBMMatrixConnection* conn =
+            dynamic_cast<RBMMatrixConnection*>(
+                (RBMConnection*) connections[i]);
+        if( conn )
+            conn->n_threads = n_train_threads;
+    }
+    if( bulk_sampling )
+        for( int i=0 ; i<n_layers ; i++ )
+            layers[i]->bulk_sampling = true;
     int last_layer_size = layers[n_layers-1]->size;
     PLASSERT_MSG(last_layer_size >= 0,
                  "Size of last layer must be non-negative");
@@ -226,6 +226,14 @@ public:
     //! Only used if online for the moment
     bool top_layer_joint_cd;
 
+    //! Number of threads used by the RBMMatrixConnection products and
+    //! updates of the mini-batch contrastive divergence steps
+    int n_train_threads;
+
+    //! Whether the layers sample whole mini-batches at once (see the
+    //! 'bulk_sampling' option of RBMLayer)
+    bool bulk_sampling;
+
     //! after how many examples should we re-initialize the Gibbs chains
     //! (if == INT_MAX, the default then NEVER re-initialize except when
     //! stage==0)
@@ -82,7 +82,18 @@ void RBMBinomialLayer::generateSample()
 
     //random_gen->manual_seed(1827);
 
-    if( use_signed_samples )
+    if( bulk_sampling )
+    {
+        if( use_signed_samples )
+        {
+            random_gen->bulk_uniform( sample );
+            for( int i=0 ; i<size ; i++ )
+                sample[i] = (expectation[i]+1)/2 < sample[i] ? -1 : 1;
+        }
+        else
+            random_gen->bulk_binomial( sample, expectation );
+    }
+    else if( use_signed_samples )
         for( int i=0 ; i<size ; i++ )
             sample[i] = 2*random_gen->binomial_sample( (expectation[i]+1)/2 )-1;
     else
@@ -105,7 +116,22 @@ void RBMBinomialLayer::generateSamples()
 
     //random_gen->manual_seed(1827);
 
-    if( use_signed_samples )
+    if( bulk_sampling )
+    {
+        if( use_signed_samples )
+        {
+            random_gen->bulk_uniform( samples );
+            for (int k = 0; k < batch_size; k++) {
+                real* s = samples[k];
+                const real* e = expectations[k];
+                for (int i=0 ; i<size ; i++)
+                    s[i] = (e[i]+1)/2 < s[i] ? -1 : 1;
+            }
+        }
+        else
+            random_gen->bulk_binomial( samples, expectations );
+    }
+    else if( use_signed_samples )
         for (int k = 0; k < batch_size; k++) {
             for (int i=0 ; i<size ; i++)
                 samples(k, i) = 2*random_gen->binomial_sample( (expectations(k, i)+1)/2 )-1;
@@ -119,7 +119,14 @@ void RBMGaussianLayer::generateSample()
             "before calling generateSample()");
 
     computeStdDeviation();
-    if(share_quad_coeff)
+    if( bulk_sampling )
+    {
+        random_gen->bulk_normal( sample );
+        for( int i=0 ; i<size ; i++ )
+            sample[i] = sample[i] * sigma[share_quad_coeff ? 0 : i]
+                        + expectation[i];
+    }
+    else if(share_quad_coeff)
         for( int i=0 ; i<size ; i++ )
             sample[i] = random_gen->gaussian_mu_sigma( expectation[i], sigma[0] );
     else
@@ -138,7 +145,18 @@ void RBMGaussianLayer::generateSamples()
     computeStdDeviation();
     PLASSERT( samples.width() == size && samples.length() == batch_size );
 
-    if(share_quad_coeff)
+    if( bulk_sampling )
+    {
+        random_gen->bulk_normal( samples );
+        for (int k = 0; k < batch_size; k++)
+        {
+            real* s = samples[k];
+            const real* e = expectations[k];
+            for (int i=0 ; i<size ; i++)
+                s[i] = s[i] * sigma[share_quad_coeff ? 0 : i] + e[i];
+        }
+    }
+    else if(share_quad_coeff)
         for (int k = 0; k < batch_size; k++)
             for (int i=0 ; i<size ; i++)
                 samples(k, i) = random_gen->gaussian_mu_sigma( expectations(k, i), sigma[0] );
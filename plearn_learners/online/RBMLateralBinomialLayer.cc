@@ -121,8 +121,11 @@ void RBMLateralBinomialLayer::generateSample()
     PLCHECK_MSG(expectation_is_up_to_date, "Expectation should be computed "
             "before calling generateSample()");
 
-    for( int i=0 ; i<size ; i++ )
-        sample[i] = random_gen->binomial_sample( expectation[i] );
+    if( bulk_sampling )
+        random_gen->bulk_binomial( sample, expectation );
+    else
+        for( int i=0 ; i<size ; i++ )
+            sample[i] = random_gen->binomial_sample( expectation[i] );
 }
 
 /////////////////////
@@ -138,10 +141,13 @@ void RBMLateralBinomialLayer::generateSamples()
 
     PLASSERT( samples.width() == size && samples.length() == batch_size );
 
-    for (int k = 0; k < batch_size; k++) {
-        for (int i=0 ; i<size ; i++)
-            samples(k, i) = random_gen->binomial_sample( expectations(k, i) );
-    }
+    if( bulk_sampling )
+        random_gen->bulk_binomial( samples, expectations );
+    else
+        for (int k = 0; k < batch_size; k++) {
+            for (int i=0 ; i<size ; i++)
+                samples(k, i) = random_gen->binomial_sample( expectations(k, i) );
+        }
 }
 
 ////////////////////////
@@ -59,6 +59,7 @@ RBMLayer::RBMLayer( real the_learning_rate ) :
     bias_decay_parameter(0),
     gibbs_ma_increment(0.1),
     gibbs_initial_ma_coefficient(0.1),
+    bulk_sampling(false),
     batch_size(0),
     expectation_is_up_to_date(false),
     expectations_are_up_to_date(false),
@@ -138,6 +139,13 @@ void RBMLayer::declareOptions(OptionList& ol)
                   OptionBase::buildoption,
                   "Initial moving average coefficient for the negative phase statistics in the Gibbs chain.\n");
 
+    declareOption(ol, "bulk_sampling", &RBMLayer::bulk_sampling,
+                  OptionBase::buildoption | OptionBase::nosave,
+                  "If true, generateSample() and generateSamples() draw all the\n"
+                  "random numbers they need at once, with the bulk methods of\n"
+                  "PRandom (counter-based generator). This is much faster, but\n"
+                  "does not give the same samples as the default sampling.");
+
     declareOption(ol, "bias", &RBMLayer::bias,
                   OptionBase::learntoption,
                   "Biases of the units.");
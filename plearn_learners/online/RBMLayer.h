@@ -87,6 +87,9 @@ public:
     real gibbs_ma_increment;
     real gibbs_initial_ma_coefficient;
 
+    //! Whether samples are drawn with the bulk methods of PRandom
+    bool bulk_sampling;
+
     //#####  Learnt Options  ##################################################
 
     // stores the bias of the unit
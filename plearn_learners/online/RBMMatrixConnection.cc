@@ -40,6 +40,9 @@
 
 #include "RBMMatrixConnection.h"
 #include <plearn/math/TMat_maths.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace PLearn {
 using namespace std;
@@ -53,6 +56,8 @@ RBMMatrixConnection::RBMMatrixConnection( real the_learning_rate ) :
     inherited(the_learning_rate),
     gibbs_ma_increment(0.1),
     gibbs_initial_ma_coefficient(0.1),
+    n_threads(1),
+    sparse_input_threshold(0),
     L1_penalty_factor(0),
     L2_penalty_factor(0),
     L2_decrease_constant(0),
@@ -90,6 +95,26 @@ void RBMMatrixConnection::declareOptions(OptionList& ol)
                   "Initial moving average coefficient for the negative phase "
                   "statistics in the Gibbs chain.\n");
 
+    declareOption(ol, "n_threads", &RBMMatrixConnection::n_threads,
+                  OptionBase::buildoption | OptionBase::nosave,
+                  "Number of threads used to compute the mini-batch products\n"
+                  "(up and down passes) and the mini-batch statistics and\n"
+                  "updates of the weights. The rows of each result are split\n"
+                  "in contiguous blocks, one per thread, so the result does not\n"
+                  "depend on the number of threads. Has no effect when PLearn\n"
+                  "is compiled without OpenMP.\n");
+
+    declareOption(ol, "sparse_input_threshold",
+                  &RBMMatrixConnection::sparse_input_threshold,
+                  OptionBase::buildoption | OptionBase::nosave,
+                  "If > 0, the mini-batches of down values (going up) whose\n"
+                  "fraction of non-zero elements is at most this threshold are\n"
+                  "converted to a compressed sparse row format, and the up pass,\n"
+                  "the statistics and the updates using them are computed with\n"
+                  "sparse products, whose cost is proportional to the number of\n"
+                  "non-zeros instead of down_size. Suited to bag-of-words inputs.\n"
+                  "0 (default) always uses the dense products.\n");
+
     declareOption(ol, "L1_penalty_factor",
                   &RBMMatrixConnection::L1_penalty_factor,
                   OptionBase::buildoption,
@@ -180,8 +205,252 @@ void RBMMatrixConnection::makeDeepCopyFromShallowCopy(CopiesMap& copies)
     deepCopyField(weights_pos_stats, copies);
     deepCopyField(weights_neg_stats, copies);
     deepCopyField(weights_inc, copies);
+    deepCopyField(sparse_row_start, copies);
+    deepCopyField(sparse_columns, copies);
+    deepCopyField(sparse_values, copies);
+}
+
+namespace {
+
+//! The mini-batch products computed by RBMMatrixConnection::parallelProduct
+enum MatrixProductType
+{
+    PRODUCT,                    //!< mat = m1.m2
+    PRODUCT_ACC,                //!< mat += m1.m2
+    PRODUCT_TRANSPOSE,          //!< mat = m1.m2'
+    PRODUCT_TRANSPOSE_ACC,      //!< mat += m1.m2'
+    TRANSPOSE_PRODUCT,          //!< mat = m1'.m2
+    TRANSPOSE_PRODUCT_ACC,      //!< mat += m1'.m2
+    TRANSPOSE_PRODUCT_SCALE_ACC //!< mat = alpha m1'.m2 + beta mat
+};
+
+void matrixProduct(int type, const Mat& mat, const Mat& m1, const Mat& m2,
+                   real alpha, real beta)
+{
+    switch( type )
+    {
+    case PRODUCT:
+        product(mat, m1, m2);
+        break;
+    case PRODUCT_ACC:
+        productAcc(mat, m1, m2);
+        break;
+    case PRODUCT_TRANSPOSE:
+        productTranspose(mat, m1, m2);
+        break;
+    case PRODUCT_TRANSPOSE_ACC:
+        productTransposeAcc(mat, m1, m2);
+        break;
+    case TRANSPOSE_PRODUCT:
+        transposeProduct(mat, m1, m2);
+        break;
+    case TRANSPOSE_PRODUCT_ACC:
+        transposeProductAcc(mat, m1, m2);
+        break;
+    case TRANSPOSE_PRODUCT_SCALE_ACC:
+        transposeProductScaleAcc(mat, m1, m2, alpha, beta);
+        break;
+    default:
+        PLERROR("In RBMMatrixConnection - Unknown product type %d", type);
+    }
+}
+
+} // end of anonymous namespace
+
+/////////////////
+// nThreadsFor //
+/////////////////
+int RBMMatrixConnection::nThreadsFor(int n) const
+{
+    int n_used = 1;
+#ifdef _OPENMP
+    // When called from a parallel region, the nested region would only
+    // have one thread.
+    if( !omp_in_parallel() )
+        n_used = max(1, min(n_threads, n));
+#endif
+    return n_used;
+}
+
+/////////////////////
+// parallelProduct //
+/////////////////////
+void RBMMatrixConnection::parallelProduct(int type, const Mat& mat,
+                                          const Mat& m1, const Mat& m2,
+                                          real alpha, real beta) const
+{
+    int n_blocks = nThreadsFor(mat.length());
+    if( n_blocks == 1 )
+    {
+        matrixProduct(type, mat, m1, m2, alpha, beta);
+        return;
+    }
+
+    // Row i of 'mat' only depends on row i of 'm1' (or on its column i for
+    // the transposed products), so each thread computes a block of rows
+    // with exactly the same operations as the serial version. The views on
+    // the blocks are created here since the reference counting of Mat is
+    // not thread-safe.
+    bool transpose_m1 = type == TRANSPOSE_PRODUCT
+                     || type == TRANSPOSE_PRODUCT_ACC
+                     || type == TRANSPOSE_PRODUCT_SCALE_ACC;
+    TVec<Mat> mat_blocks(n_blocks);
+    TVec<Mat> m1_blocks(n_blocks);
+    int n = mat.length();
+    for( int b=0 ; b<n_blocks ; b++ )
+    {
+        int start = (int)((int64_t)n * b / n_blocks);
+        int length = (int)((int64_t)n * (b+1) / n_blocks) - start;
+        mat_blocks[b] = mat.subMatRows(start, length);
+        m1_blocks[b] = transpose_m1 ? m1.subMatColumns(start, length)
+                                    : m1.subMatRows(start, length);
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(n_blocks) schedule(static, 1)
+#endif
+    for( int b=0 ; b<n_blocks ; b++ )
+        matrixProduct(type, mat_blocks[b], m1_blocks[b], m2, alpha, beta);
+}
+
+////////////////////////
+// sparsifyDownValues //
+////////////////////////
+bool RBMMatrixConnection::sparsifyDownValues(const Mat& down_values) const
+{
+    if( sparse_input_threshold <= 0 )
+        return false;
+
+    int n = down_values.length();
+    int w = down_values.width();
+    int max_nnz = (int)(sparse_input_threshold * (double)n * (double)w);
+    sparse_row_start.resize(n+1);
+    sparse_columns.resize(max_nnz);
+    sparse_values.resize(max_nnz);
+    int* cols = sparse_columns.data();
+    real* vals = sparse_values.data();
+    int nnz = 0;
+    for( int k=0 ; k<n ; k++ )
+    {
+        sparse_row_start[k] = nnz;
+        const real* x = down_values[k];
+        for( int j=0 ; j<w ; j++ )
+            if( x[j] != 0 )
+            {
+                // Give up as soon as the mini-batch is too dense.
+                if( nnz == max_nnz )
+                    return false;
+                cols[nnz] = j;
+                vals[nnz] = x[j];
+                nnz++;
+            }
+    }
+    sparse_row_start[n] = nnz;
+    sparse_columns.resize(nnz);
+    sparse_values.resize(nnz);
+    return true;
 }
 
+//////////////////////
+// sparseUpProducts //
+//////////////////////
+void RBMMatrixConnection::sparseUpProducts(const Mat& activations, int start,
+                                           bool accumulate,
+                                           int band_step) const
+{
+    int n = activations.length();
+    int length = activations.width();
+    int band_width = weights.width();
+    bool full_rows = band_step == 0 && band_width == down_size;
+    PLASSERT( sparse_row_start.length() == n+1 );
+    PLASSERT( start+length <= weights.length() );
+
+    const int* row_start = sparse_row_start.data();
+    const int* cols = sparse_columns.data();
+    const real* vals = sparse_values.data();
+#ifdef _OPENMP
+    int nt = nThreadsFor(n);
+#pragma omp parallel for num_threads(nt) schedule(static) if(nt > 1)
+#endif
+    for( int k=0 ; k<n ; k++ )
+    {
+        real* a_k = activations[k];
+        const int* row_begin = cols + row_start[k];
+        const int* row_end = cols + row_start[k+1];
+        for( int i=0 ; i<length ; i++ )
+        {
+            const real* w_i = weights[start+i];
+            int offset = (start+i) * band_step;
+            const int* begin = row_begin;
+            const int* end = row_end;
+            if( !full_rows )
+            {
+                begin = lower_bound(row_begin, row_end, offset);
+                end = lower_bound(begin, row_end, offset + band_width);
+            }
+            const real* v = vals + (begin - cols);
+            real sum = 0;
+            for( const int* c=begin ; c<end ; c++, v++ )
+                sum += w_i[*c - offset] * *v;
+            if( accumulate )
+                a_k[i] += sum;
+            else
+                a_k[i] = sum;
+        }
+    }
+}
+
+///////////////////////////////
+// sparseTransposeProductAcc //
+///////////////////////////////
+void RBMMatrixConnection::sparseTransposeProductAcc(const Mat& mat,
+                                                    const Mat& up_values,
+                                                    real alpha,
+                                                    int band_step) const
+{
+    int l = mat.length();
+    int n = up_values.length();
+    int band_width = mat.width();
+    bool full_rows = band_step == 0 && band_width == down_size;
+    PLASSERT( up_values.width() == l );
+    PLASSERT( sparse_row_start.length() == n+1 );
+
+    const int* row_start = sparse_row_start.data();
+    const int* cols = sparse_columns.data();
+    const real* vals = sparse_values.data();
+    const real* up_data = up_values.data();
+    int up_mod = up_values.mod();
+    // Each thread updates its own rows of 'mat'.
+#ifdef _OPENMP
+    int nt = nThreadsFor(l);
+#pragma omp parallel for num_threads(nt) schedule(static) if(nt > 1)
+#endif
+    for( int i=0 ; i<l ; i++ )
+    {
+        real* m_i = mat[i];
+        int offset = i * band_step;
+        for( int k=0 ; k<n ; k++ )
+        {
+            real a = alpha * up_data[k*up_mod + i];
+            if( a == 0 )
+                continue;
+            const int* begin = cols + row_start[k];
+            const int* end = cols + row_start[k+1];
+            if( !full_rows )
+            {
+                begin = lower_bound(begin, end, offset);
+                end = lower_bound(begin, end, offset + band_width);
+            }
+            const real* v = vals + (begin - cols);
+            for( const int* c=begin ; c<end ; c++, v++ )
+                m_i[*c - offset] += a * *v;
+        }
+    }
+}
+
+////////////////////////
+// accumulatePosStats //
+////////////////////////
 void RBMMatrixConnection::accumulatePosStats( const Vec& down_values,
                                               const Vec& up_values )
 {
@@ -197,7 +466,11 @@ void RBMMatrixConnection::accumulatePosStats( const Mat& down_values,
     int mbs=down_values.length();
     PLASSERT(up_values.length()==mbs);
     // weights_pos_stats += up_values * down_values'
-    transposeProductAcc(weights_pos_stats, up_values, down_values);
+    if( sparsifyDownValues(down_values) )
+        sparseTransposeProductAcc(weights_pos_stats, up_values, real(1));
+    else
+        parallelProduct(TRANSPOSE_PRODUCT_ACC,
+                        weights_pos_stats, up_values, down_values);
     pos_count+=mbs;
 }
 
@@ -219,7 +492,11 @@ void RBMMatrixConnection::accumulateNegStats( const Mat& down_values,
     int mbs=down_values.length();
     PLASSERT(up_values.length()==mbs);
     // weights_neg_stats += up_values * down_values'
-    transposeProductAcc(weights_neg_stats, up_values, down_values);
+    if( sparsifyDownValues(down_values) )
+        sparseTransposeProductAcc(weights_neg_stats, up_values, real(1));
+    else
+        parallelProduct(TRANSPOSE_PRODUCT_ACC,
+                        weights_neg_stats, up_values, down_values);
     neg_count+=mbs;
 }
 
@@ -355,11 +632,19 @@ void RBMMatrixConnection::update( const Mat& pos_down_values, // v_0
         // We use the average gradient over a mini-batch.
         real avg_lr = learning_rate / pos_down_values.length();
 
-        transposeProductScaleAcc(weights, pos_up_values, pos_down_values,
-                                 avg_lr, real(1));
+        if( sparsifyDownValues(pos_down_values) )
+            sparseTransposeProductAcc(weights, pos_up_values, avg_lr);
+        else
+            parallelProduct(TRANSPOSE_PRODUCT_SCALE_ACC,
+                            weights, pos_up_values, pos_down_values,
+                            avg_lr, real(1));
 
-        transposeProductScaleAcc(weights, neg_up_values, neg_down_values,
-                                 -avg_lr, real(1));
+        if( sparsifyDownValues(neg_down_values) )
+            sparseTransposeProductAcc(weights, neg_up_values, -avg_lr);
+        else
+            parallelProduct(TRANSPOSE_PRODUCT_SCALE_ACC,
+                            weights, neg_up_values, neg_down_values,
+                            -avg_lr, real(1));
     }
     else
     {
@@ -404,26 +689,34 @@ void RBMMatrixConnection::updateCDandGibbs( const Mat& pos_down_values,
     //              +(1-gibbs_chain_statistics_forgetting_factor)
     //               * gibbs_neg_up_values'*gibbs_neg_down_values/minibatch_size
     if (neg_count==0)
-        transposeProductScaleAcc(weights_neg_stats, gibbs_neg_up_values,
-                                 gibbs_neg_down_values,
-                                 normalize_factor, real(0));
+        parallelProduct(TRANSPOSE_PRODUCT_SCALE_ACC,
+                        weights_neg_stats, gibbs_neg_up_values,
+                        gibbs_neg_down_values,
+                        normalize_factor, real(0));
     else
-        transposeProductScaleAcc(weights_neg_stats,
-                                 gibbs_neg_up_values,
-                                 gibbs_neg_down_values,
-                                 normalize_factor*(1-gibbs_ma_coefficient),
-                                 gibbs_ma_coefficient);
+        parallelProduct(TRANSPOSE_PRODUCT_SCALE_ACC,
+                        weights_neg_stats,
+                        gibbs_neg_up_values,
+                        gibbs_neg_down_values,
+                        normalize_factor*(1-gibbs_ma_coefficient),
+                        gibbs_ma_coefficient);
     neg_count++;
 
     // delta w = lrate * ( pos_up_values'*pos_down_values
     //                   - ( background_gibbs_update_ratio*neg_stats
     //                      +(1-background_gibbs_update_ratio)
     //                       * cd_neg_up_values'*cd_neg_down_values/minibatch_size))
-    transposeProductScaleAcc(weights, pos_up_values, pos_down_values,
-                             learning_rate*normalize_factor, real(1));
+    if( sparsifyDownValues(pos_down_values) )
+        sparseTransposeProductAcc(weights, pos_up_values,
+                                  learning_rate*normalize_factor);
+    else
+        parallelProduct(TRANSPOSE_PRODUCT_SCALE_ACC,
+                        weights, pos_up_values, pos_down_values,
+                        learning_rate*normalize_factor, real(1));
     multiplyAcc(weights, weights_neg_stats,
                 -learning_rate*background_gibbs_update_ratio);
-    transposeProductScaleAcc(weights, cd_neg_up_values, cd_neg_down_values,
+    parallelProduct(TRANSPOSE_PRODUCT_SCALE_ACC,
+                    weights, cd_neg_up_values, cd_neg_down_values,
         -learning_rate*(1-background_gibbs_update_ratio)*normalize_factor,
         real(1));
 
@@ -443,7 +736,8 @@ void RBMMatrixConnection::updateGibbs( const Mat& pos_down_values,
     //               * gibbs_neg_up_values'*gibbs_neg_down_values
     static Mat tmp;
     tmp.resize(weights.length(),weights.width());
-    transposeProduct(tmp, gibbs_neg_up_values, gibbs_neg_down_values);
+    parallelProduct(TRANSPOSE_PRODUCT,
+                    tmp, gibbs_neg_up_values, gibbs_neg_down_values);
 
     if (neg_count==0)
         multiply(weights_neg_stats,tmp,normalize_factor);
@@ -468,8 +762,13 @@ void RBMMatrixConnection::updateGibbs( const Mat& pos_down_values,
     }
 
     // delta w = lrate * ( pos_up_values'*pos_down_values/minibatch_size - neg_stats )
-    transposeProductScaleAcc(weights, pos_up_values, pos_down_values,
-                             learning_rate*normalize_factor, real(1));
+    if( sparsifyDownValues(pos_down_values) )
+        sparseTransposeProductAcc(weights, pos_up_values,
+                                  learning_rate*normalize_factor);
+    else
+        parallelProduct(TRANSPOSE_PRODUCT_SCALE_ACC,
+                        weights, pos_up_values, pos_down_values,
+                        learning_rate*normalize_factor, real(1));
     multiplyAcc(weights, weights_neg_stats, -learning_rate);
 
     if(!fast_exact_is_equal(L1_penalty_factor,0) || !fast_exact_is_equal(L2_penalty_factor,0))
@@ -541,27 +840,23 @@ void RBMMatrixConnection::computeProducts(int start, int length,
         PLASSERT( start+length <= up_size );
         // activations(k, i-start) += sum_j weights(i,j) inputs_mat(k, j)
 
-        if( accumulate )
-            productTransposeAcc(activations,
-                    inputs_mat,
-                    weights.subMatRows(start,length));
+        if( sparsifyDownValues(inputs_mat) )
+            sparseUpProducts(activations, start, accumulate);
         else
-            productTranspose(activations,
-                    inputs_mat,
-                    weights.subMatRows(start,length));
+            parallelProduct(accumulate ? PRODUCT_TRANSPOSE_ACC
+                                       : PRODUCT_TRANSPOSE,
+                            activations,
+                            inputs_mat,
+                            weights.subMatRows(start,length));
     }
     else
     {
         PLASSERT( start+length <= down_size );
         // activations(k, i-start) += sum_j weights(j,i) inputs_mat(k, j)
-        if( accumulate )
-            productAcc(activations,
-                    inputs_mat,
-                    weights.subMatColumns(start,length) );
-        else
-            product(activations,
-                    inputs_mat,
-                    weights.subMatColumns(start,length) );
+        parallelProduct(accumulate ? PRODUCT_ACC : PRODUCT,
+                        activations,
+                        inputs_mat,
+                        weights.subMatColumns(start,length) );
     }
 }
 
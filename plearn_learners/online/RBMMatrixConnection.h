@@ -66,6 +66,13 @@ public:
     real gibbs_ma_increment;
     real gibbs_initial_ma_coefficient;
 
+    //! Number of OpenMP threads used by the mini-batch products and updates
+    int n_threads;
+
+    //! Mini-batches of down values with at most this fraction of non-zero
+    //! elements use the sparse products (0 disables them)
+    real sparse_input_threshold;
+
     //#####  Learned Options  #################################################
 
     //! Optional (default=0) factor of L1 regularization term
@@ -98,6 +105,15 @@ public:
     //! Used if momentum != 0.
     Mat weights_inc;
 
+protected:
+    //! Compressed sparse rows of the last mini-batch of down values accepted
+    //! by sparsifyDownValues(): the non-zeros of row k are at positions
+    //! sparse_row_start[k] to sparse_row_start[k+1]-1 of sparse_columns and
+    //! sparse_values, in increasing column order.
+    mutable TVec<int> sparse_row_start;
+    mutable TVec<int> sparse_columns;
+    mutable Vec sparse_values;
+
 public:
     //#####  Public Member Functions  #########################################
 
@@ -280,12 +296,38 @@ protected:
     //! Declares the class options.
     static void declareOptions(OptionList& ol);
 
+    //! Fills the sparse_* fields with 'down_values' and returns true if its
+    //! fraction of non-zero elements is at most sparse_input_threshold.
+    bool sparsifyDownValues(const Mat& down_values) const;
+
+    //! activations(k, i) (+)= sum_j weights(start+i, j) down(k, j), where
+    //! 'down' is the mini-batch stored in the sparse_* fields. Row i of the
+    //! weights covers the down units i*band_step to
+    //! i*band_step+weights.width()-1.
+    void sparseUpProducts(const Mat& activations, int start,
+                          bool accumulate, int band_step=0) const;
+
+    //! mat(i, j) += alpha sum_k up_values(k, i) down(k, j), where 'down' is
+    //! the mini-batch stored in the sparse_* fields (see sparseUpProducts()
+    //! for 'band_step').
+    void sparseTransposeProductAcc(const Mat& mat, const Mat& up_values,
+                                   real alpha, int band_step=0) const;
+
+    //! Number of threads used to process 'n' independent rows.
+    int nThreadsFor(int n) const;
+
 private:
     //#####  Private Member Functions  ########################################
 
     //! This does the actual building.
     void build_();
 
+    //! Computes one of the mini-batch matrix products used by this class,
+    //! splitting the rows of 'mat' among 'n_threads' OpenMP threads.
+    void parallelProduct(int type, const Mat& mat,
+                         const Mat& m1, const Mat& m2,
+                         real alpha=1, real beta=1) const;
+
 private:
     //#####  Private Data Members  ############################################
 
@@ -76,7 +76,15 @@ void RBMMultinomialLayer::generateSample()
     PLCHECK_MSG(expectation_is_up_to_date, "Expectation should be computed "
             "before calling generateSample()");
 
-    int i = random_gen->multinomial_sample( expectation );
+    int i;
+    if( bulk_sampling )
+    {
+        TVec<int> index( 1 );
+        random_gen->bulk_multinomial( expectation.toMat( 1, size ), index );
+        i = index[0];
+    }
+    else
+        i = random_gen->multinomial_sample( expectation );
     fill_one_hot( sample, i, real(0.), real(1.) );
 }
 
@@ -90,11 +98,19 @@ void RBMMultinomialLayer::generateSamples()
 
     PLASSERT( samples.width() == size && samples.length() == batch_size );
 
-    for (int k = 0; k < batch_size; k++)
+    if( bulk_sampling )
     {
-        int i = random_gen->multinomial_sample( expectations(k) );
-        fill_one_hot( samples(k), i, real(0.), real(1.) );
+        TVec<int> indices( batch_size );
+        random_gen->bulk_multinomial( expectations, indices );
+        for (int k = 0; k < batch_size; k++)
+            fill_one_hot( samples(k), indices[k], real(0.), real(1.) );
     }
+    else
+        for (int k = 0; k < batch_size; k++)
+        {
+            int i = random_gen->multinomial_sample( expectations(k) );
+            fill_one_hot( samples(k), i, real(0.), real(1.) );
+        }
 }
 
 void RBMMultinomialLayer::computeExpectation()
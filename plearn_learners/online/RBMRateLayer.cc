@@ -65,11 +65,16 @@ void RBMRateLayer::generateSample()
             "before calling generateSample()");
 
     real exp_i = 0;
+    if( bulk_sampling )
+        random_gen->bulk_normal( sample );
     for( int i=0; i<size; i++)
     {
         exp_i = expectation[i];
-        sample[i] = round(random_gen->gaussian_mu_sigma(
-                              exp_i,exp_i*(1-exp_i/n_spikes)) );
+        if( bulk_sampling )
+            sample[i] = round( sample[i] * exp_i*(1-exp_i/n_spikes) + exp_i );
+        else
+            sample[i] = round(random_gen->gaussian_mu_sigma(
+                                  exp_i,exp_i*(1-exp_i/n_spikes)) );
     }
 }
 
@@ -84,13 +89,19 @@ void RBMRateLayer::generateSamples()
     PLASSERT( samples.width() == size && samples.length() == batch_size );
 
     real exp_i = 0;
+    if( bulk_sampling )
+        random_gen->bulk_normal( samples );
     for (int k = 0; k < batch_size; k++)
     {
         for( int i=0; i<size; i++)
         {
             exp_i = expectations(k,i);
-            samples(k,i) = round(random_gen->gaussian_mu_sigma(
-                                     exp_i,exp_i*(1-exp_i/n_spikes)) );
+            if( bulk_sampling )
+                samples(k,i) = round( samples(k,i) * exp_i*(1-exp_i/n_spikes)
+                                      + exp_i );
+            else
+                samples(k,i) = round(random_gen->gaussian_mu_sigma(
+                                         exp_i,exp_i*(1-exp_i/n_spikes)) );
         }
     }
 }
@@ -155,10 +155,14 @@ void RBMSparse1DMatrixConnection::accumulatePosStats( const Mat& down_values,
     int mbs=down_values.length();
     PLASSERT(up_values.length()==mbs);
     // weights_pos_stats += up_values * down_values'
-    for ( int i=0; i<up_size; i++)
-        transposeProductAcc( weights_pos_stats(i),
-                             down_values.subMatColumns( filterStart(i), filterSize(i) ),
-                             up_values(i));
+    if( sparsifyDownValues(down_values) )
+        sparseTransposeProductAcc(weights_pos_stats, up_values, real(1),
+                                  step_size);
+    else
+        for ( int i=0; i<up_size; i++)
+            transposeProductAcc( weights_pos_stats(i),
+                                 down_values.subMatColumns( filterStart(i), filterSize(i) ),
+                                 up_values(i));
     pos_count+=mbs;
 }
 
@@ -168,10 +172,14 @@ void RBMSparse1DMatrixConnection::accumulateNegStats( const Mat& down_values,
     int mbs=down_values.length();
     PLASSERT(up_values.length()==mbs);
     // weights_neg_stats += up_values * down_values'
-    for ( int i=0; i<up_size; i++)
-        transposeProductAcc( weights_neg_stats(i),
-                             down_values.subMatColumns( filterStart(i), filterSize(i) ),
-                             up_values(i));
+    if( sparsifyDownValues(down_values) )
+        sparseTransposeProductAcc(weights_neg_stats, up_values, real(1),
+                                  step_size);
+    else
+        for ( int i=0; i<up_size; i++)
+            transposeProductAcc( weights_neg_stats(i),
+                                 down_values.subMatColumns( filterStart(i), filterSize(i) ),
+                                 up_values(i));
     neg_count+=mbs;
 }
 
@@ -188,7 +196,9 @@ void RBMSparse1DMatrixConnection::computeProducts(int start, int length,
     {
         PLASSERT( start+length <= up_size );
         // activations(k, i-start) += sum_j weights(i,j) inputs_mat(k, j)
-        if( accumulate )
+        if( sparsifyDownValues(inputs_mat) )
+            sparseUpProducts(activations, start, accumulate, step_size);
+        else if( accumulate )
             for (int i=start; i<start+length; i++)
                 productAcc( activations.column(i-start).toVec(),
                             inputs_mat.subMatColumns( filterStart(i), filterSize(i) ),
@@ -365,18 +375,30 @@ void RBMSparse1DMatrixConnection::update( const Mat& pos_down_values, // v_0
         // We use the average gradient over a mini-batch.
         real avg_lr = learning_rate / pos_down_values.length();
 
+        // Sparse mini-batches update all the rows at once.
+        bool sparse_pos = sparsifyDownValues(pos_down_values);
+        if( sparse_pos )
+            sparseTransposeProductAcc(weights, pos_up_values, avg_lr,
+                                      step_size);
+        bool sparse_neg = sparsifyDownValues(neg_down_values);
+        if( sparse_neg )
+            sparseTransposeProductAcc(weights, neg_up_values, -avg_lr,
+                                      step_size);
+
         for (int i=0; i<up_size; i++) {
             int filter_start= filterStart(i), length= filterSize(i);
 
-            transposeProductScaleAcc( weights(i),
-                                      pos_down_values.subMatColumns( filter_start, length ),
-                                      pos_up_values.column(i).toVec(), 
-                                      avg_lr, real(1));
-
-            transposeProductScaleAcc( weights(i),
-                                      neg_down_values.subMatColumns( filter_start, length ),
-                                      neg_up_values.column(i).toVec(),
-                                      -avg_lr, real(1));
+            if( !sparse_pos )
+                transposeProductScaleAcc( weights(i),
+                                          pos_down_values.subMatColumns( filter_start, length ),
+                                          pos_up_values.column(i).toVec(), 
+                                          avg_lr, real(1));
+
+            if( !sparse_neg )
+                transposeProductScaleAcc( weights(i),
+                                          neg_down_values.subMatColumns( filter_start, length ),
+                                          neg_up_values.column(i).toVec(),
+                                          -avg_lr, real(1));
 
             if( enforce_positive_weights )
                 for (int j=0; j<filter_size; j++)
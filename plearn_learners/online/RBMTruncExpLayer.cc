@@ -81,9 +81,12 @@ void RBMTruncExpLayer::generateSample()
      * C^{-1}(s) = log(1 - s*(1 - exp(a)) / a
      */
 
+    if( bulk_sampling )
+        random_gen->bulk_uniform( sample );
+
     for( int i=0 ; i<size ; i++ )
     {
-        real s = random_gen->uniform_sample();
+        real s = bulk_sampling ? sample[i] : random_gen->uniform_sample();
         real a_i = activation[i];
 
         // Polynomial approximation to avoid numerical instability if a ~ 0
@@ -105,10 +108,14 @@ void RBMTruncExpLayer::generateSamples()
 
     PLASSERT( samples.width() == size && samples.length() == batch_size );
 
+    if( bulk_sampling )
+        random_gen->bulk_uniform( samples );
+
     for (int k = 0; k < batch_size; k++)
         for (int i=0 ; i<size ; i++)
         {
-            real s = random_gen->uniform_sample();
+            real s = bulk_sampling ? samples(k, i)
+                                   : random_gen->uniform_sample();
             real a_i = activations(k,i);
             if( fabs( a_i ) <= 1e-5 )
                 samples(k, i) = s + a_i*( s*(1 - s)/2 );
@@ -51,6 +51,9 @@
 #include <plearn/var/ObjectOptionVariable.h>
 #include <plearn/opt/Optimizer.h>
 #include <plearn/io/pl_log.h>
+#include <plearn/math/PRandom.h>
+#include <plearn/math/TMat_sort.h>
+#include <plearn/vmat/VMat_computeNearestNeighbors.h>
 
 #ifdef USE_BLAS_SPECIALISATIONS
 #include <plearn/math/plapack.h>
@@ -116,6 +119,14 @@ PLEARN_IMPLEMENT_OBJECT(
     "is more computationally expensive and would require substantial updates to\n"
     "the PLearn Kernel class (to efficiently support asymmetric kernel-matrix\n"
     "gradient).  This may come later.\n"
+    "\n"
+    "For very large training sets, the subset-of-regressors (\"sor\") and FITC\n"
+    "(\"fitc\") approximations also work from M inducing points, but optimize\n"
+    "the hyperparameters on the approximate marginal likelihood of the whole\n"
+    "training set, in O(NM^2) time and O(NM) memory.  The inducing points are\n"
+    "either given by 'active_set_indices' or chosen among the training inputs\n"
+    "(see 'inducing_set_size').  Only the inducing inputs are kept after\n"
+    "training, so that predictions take O(M) kernel evaluations.\n"
     );
 
 GaussianProcessRegressor::GaussianProcessRegressor() 
@@ -124,7 +135,9 @@ GaussianProcessRegressor::GaussianProcessRegressor()
       m_compute_confidence(false),
       m_confidence_epsilon(1e-8),
       m_save_gram_matrix(false),
-      m_solution_algorithm("exact")
+      m_solution_algorithm("exact"),
+      m_inducing_set_size(0),
+      m_inducing_selection("kmeans")
 { }
 
 
@@ -213,7 +226,11 @@ void GaussianProcessRegressor::declareOptions(OptionList& ol)
         "Gaussian process solution (requires O(N^3) computation).  If\n"
         "\"projected-process\", use the PP approximation, which requires O(MN^2)\n"
         "computation, where M is given by the size of the active training\n"
-        "examples specified by the \"active-set\" option.  Default=\"exact\".\n");
+        "examples specified by the \"active-set\" option.  If \"sor\" or \"fitc\",\n"
+        "use respectively the subset-of-regressors or FITC approximation, also\n"
+        "in O(MN^2), with hyperparameters optimized on all N examples (their\n"
+        "predictive variances use the projected process, i.e. DTC, form).\n"
+        "Default=\"exact\".\n");
 
     declareOption(
         ol, "active_set_indices", &GaussianProcessRegressor::m_active_set_indices,
@@ -223,6 +240,21 @@ void GaussianProcessRegressor::declareOptions(OptionList& ol)
         "considered to be part of the active set.  Note that these indices must\n"
         "be SORTED IN INCREASING ORDER and should not contain duplicates.\n");
 
+    declareOption(
+        ol, "inducing_set_size", &GaussianProcessRegressor::m_inducing_set_size,
+        OptionBase::buildoption,
+        "With the \"sor\" or \"fitc\" solution algorithms, if 'active_set_indices'\n"
+        "is empty, number of inducing points to select among the training\n"
+        "inputs (default = 0).\n");
+
+    declareOption(
+        ol, "inducing_selection", &GaussianProcessRegressor::m_inducing_selection,
+        OptionBase::buildoption,
+        "How inducing points are selected when 'inducing_set_size' is used:\n"
+        "\"kmeans\" takes the training inputs closest to the centers found by a\n"
+        "few k-means iterations, \"random\" takes random training inputs.\n"
+        "Default = \"kmeans\".\n");
+
     
     //#####  Learnt Options  ##################################################
 
@@ -238,7 +270,11 @@ void GaussianProcessRegressor::declareOptions(OptionList& ol)
         "In the case of the projected-process approximation, this contains\n"
         "the result of the equiation\n"
         "\n"
-        "  (lambda K_mm + K_mn K_nm)^-1 K_mn y\n");
+        "  (lambda K_mm + K_mn K_nm)^-1 K_mn y\n"
+        "\n"
+        "and for the subset-of-regressors and FITC approximations\n"
+        "\n"
+        "  (K_mm + K_mn Lambda^-1 K_nm)^-1 K_mn Lambda^-1 y\n");
 
     declareOption(
         ol, "gram_inverse", &GaussianProcessRegressor::m_gram_inverse,
@@ -303,10 +339,19 @@ void GaussianProcessRegressor::build_()
         m_algorithm_enum = AlgoExact;
     else if (m_solution_algorithm == "projected-process")
         m_algorithm_enum = AlgoProjectedProcess;
+    else if (m_solution_algorithm == "sor")
+        m_algorithm_enum = AlgoSubsetOfRegressors;
+    else if (m_solution_algorithm == "fitc")
+        m_algorithm_enum = AlgoFITC;
     else
         PLERROR("GaussianProcessRegressor::build_: the option solution_algorithm=='%s' "
-                "is not supported.  Value must be in {'exact', 'projected-process'}",
-                m_solution_algorithm.c_str());
+                "is not supported.  Value must be in {'exact', 'projected-process', "
+                "'sor', 'fitc'}", m_solution_algorithm.c_str());
+
+    if (m_inducing_selection != "kmeans" && m_inducing_selection != "random")
+        PLERROR("GaussianProcessRegressor::build_: the option inducing_selection=='%s' "
+                "is not supported.  Value must be in {'kmeans', 'random'}",
+                m_inducing_selection.c_str());
 }
 
 // ### Nothing to add here, simply calls build_
@@ -336,6 +381,7 @@ void GaussianProcessRegressor::makeDeepCopyFromShallowCopy(CopiesMap& copies)
     deepCopyField(m_gram_traintest_inputs,      copies);
     deepCopyField(m_gram_inv_traintest_product, copies);
     deepCopyField(m_sigma_reductor,             copies);
+    deepCopyField(m_inducing_indices,           copies);
 }
 
 
@@ -389,11 +435,14 @@ void GaussianProcessRegressor::train()
 
     // If we use the projected process approximation, make sure that the
     // active-set indices are specified and that they are sorted in increasing
-    // order
-    if (m_algorithm_enum == AlgoProjectedProcess) {
-        if (m_active_set_indices.size() == 0)
-            PLERROR("GaussianProcessRegressor::train: with the projected-process "
-                    "approximation, the active_set_indices option must be specified.");
+    // order.  The sparse approximations may select them instead.
+    if (m_algorithm_enum == AlgoProjectedProcess || usesInducingPoints()) {
+        if (m_active_set_indices.size() == 0 &&
+            ! (usesInducingPoints() && m_inducing_set_size > 0))
+            PLERROR("GaussianProcessRegressor::train: with the %s "
+                    "approximation, the active_set_indices option must be specified%s.",
+                    m_solution_algorithm.c_str(),
+                    usesInducingPoints() ? " (or inducing_set_size)" : "");
         int last_index = -1;
         for (int i=0, n=m_active_set_indices.size() ; i<n ; ++i) {
             int cur_index = m_active_set_indices[i];
@@ -444,6 +493,19 @@ void GaussianProcessRegressor::train()
         selectRows(m_training_inputs, m_active_set_indices, sub_training_inputs);
         selectRows(targets,           m_active_set_indices, sub_training_targets);
     }
+    else {
+        // The sparse approximations use all the examples, and the inducing
+        // points only enter through the NLL variable
+        if (m_active_set_indices.size() > 0)
+            m_inducing_indices = m_active_set_indices.copy();
+        else
+            selectInducingPoints(m_training_inputs, m_inducing_indices);
+        sub_training_inputs = m_training_inputs;
+        sub_training_targets= targets;
+        MODULE_LOG << "Using " << m_inducing_indices.size()
+                   << " inducing points out of " << trainlength
+                   << " training examples" << endl;
+    }
     
     // Optimize hyperparameters
     VarArray hyperparam_vars;
@@ -467,6 +529,17 @@ void GaussianProcessRegressor::train()
         m_training_inputs = sub_training_inputs;
         m_kernel->setDataForKernelMatrix(m_training_inputs);
     }
+    else {
+        m_alpha = nll->alpha();
+        m_gram_inverse = nll->gramInverse();
+        m_subgram_inverse = nll->subgramInverse();
+
+        // Only the inducing inputs are needed from now on
+        Mat inducing_inputs(m_inducing_indices.size(), inputsize);
+        selectRows(m_training_inputs, m_inducing_indices, inducing_inputs);
+        m_training_inputs = inducing_inputs;
+        m_kernel->setDataForKernelMatrix(m_training_inputs);
+    }
 
     if (getTrainStatsCollector()) {
         // Compute train statistics by running a test over the training set.
@@ -588,8 +661,12 @@ bool GaussianProcessRegressor::computeConfidenceFromOutput(
         sigma = sqrt(max(real(0.),
                          base_sigma_sq - sigma_reductor + m_confidence_epsilon));
     }
-    else if (m_algorithm_enum == AlgoProjectedProcess) {
-        // From R&W eq. (8.27).
+    else {
+        // From R&W eq. (8.27), i.e. the deterministic training conditional
+        // (DTC) form. It is also used for FITC and subset-of-regressors: the
+        // exact SoR variance lacks the K** - Q** term (and vanishes far from
+        // the inducing points), and the exact FITC one adds the diagonal
+        // Lambda term of the test point.
         product(m_gram_inverse_product, m_subgram_inverse, m_kernel_evaluations);
         productScaleAcc(m_gram_inverse_product, m_gram_inverse, m_kernel_evaluations,
                         -1.0, 1.0);
@@ -687,7 +764,9 @@ void GaussianProcessRegressor::computeOutputCovMat(
     //
     // Note that all sigma^2's have been absorbed into their respective
     // cached terms, and in particular in this context sigma^2 is emphatically
-    // not equal to the weight decay.
+    // not equal to the weight decay.  This (DTC) form is also used for FITC
+    // and subset-of-regressors, with sigma^2 I replaced by their Lambda,
+    // although the exact SoR covariance only has the last term.
     m_gram_inv_traintest_product.resize(T,N);
     m_sigma_reductor.resize(N,N);
 
@@ -697,7 +776,7 @@ void GaussianProcessRegressor::computeOutputCovMat(
         product(m_sigma_reductor, m_gram_traintest_inputs,
                 m_gram_inv_traintest_product);
     }
-    else if (m_algorithm_enum == AlgoProjectedProcess) {
+    else {
         productTranspose(m_gram_inv_traintest_product, m_subgram_inverse,
                          m_gram_traintest_inputs);
         productTransposeScaleAcc(m_gram_inv_traintest_product, m_gram_inverse,
@@ -747,10 +826,8 @@ GaussianProcessRegressor::hyperOptimize(const Mat& inputs, const Mat& targets,
     if (! m_optimizer || (m_hyperparameters.size() == 0 &&
                           m_ARD_hyperprefix_initval.first.empty()) )
     {
-        return new GaussianProcessNLLVariable(
-            m_kernel, m_weight_decay, inputs, targets,
-            TVec<string>(), VarArray(), m_compute_confidence,
-            m_save_gram_matrix, getExperimentDirectory());
+        return newNLLVariable(inputs, targets, TVec<string>(), VarArray(),
+                              m_compute_confidence);
     }
 
     // Otherwise create Vars that wrap each hyperparameter
@@ -784,9 +861,8 @@ GaussianProcessRegressor::hyperOptimize(const Mat& inputs, const Mat& targets,
     }
 
     // Create the cost-function variable
-    PP<GaussianProcessNLLVariable> nll = new GaussianProcessNLLVariable(
-        m_kernel, m_weight_decay, inputs, targets, hyperparam_names,
-        hyperparam_vars, true, m_save_gram_matrix, getExperimentDirectory());
+    PP<GaussianProcessNLLVariable> nll =
+        newNLLVariable(inputs, targets, hyperparam_names, hyperparam_vars, true);
     nll->setName("GaussianProcessNLLVariable");
 
     // Some logging about the initial values
@@ -822,6 +898,102 @@ GaussianProcessRegressor::hyperOptimize(const Mat& inputs, const Mat& targets,
 }
 
 
+//#####  newNLLVariable  ######################################################
+
+PP<GaussianProcessNLLVariable>
+GaussianProcessRegressor::newNLLVariable(const Mat& inputs, const Mat& targets,
+                                         const TVec<string>& hyperparam_names,
+                                         const VarArray& hyperparam_vars,
+                                         bool allow_bprop) const
+{
+    if (usesInducingPoints())
+        return new GaussianProcessNLLVariable(
+            m_kernel, m_weight_decay, inputs, targets, m_inducing_indices,
+            m_algorithm_enum == AlgoFITC, hyperparam_names, hyperparam_vars,
+            allow_bprop);
+    
+    return new GaussianProcessNLLVariable(
+        m_kernel, m_weight_decay, inputs, targets, hyperparam_names,
+        hyperparam_vars, allow_bprop, m_save_gram_matrix, getExperimentDirectory());
+}
+
+
+//#####  selectInducingPoints  ################################################
+
+void GaussianProcessRegressor::selectInducingPoints(const Mat& inputs,
+                                                    TVec<int>& indices) const
+{
+    const int n = inputs.length();
+    const int m = m_inducing_set_size;
+    if (m <= 0 || m > n)
+        PLERROR("GaussianProcessRegressor::selectInducingPoints: inducing_set_size "
+                "(%d) must be between 1 and the number of training examples (%d)",
+                m, n);
+    if (! random_gen) {
+        random_gen = new PRandom();
+        if (seed_ != 0)
+            random_gen->manual_seed(seed_);
+    }
+    
+    // Random distinct examples, which are also the initial k-means centers
+    TVec<int> permutation(0, n-1, 1);
+    random_gen->shuffleElements(permutation);
+    indices.resize(m);
+    indices << permutation.subVec(0, m);
+
+    if (m_inducing_selection == "kmeans" && m < n) {
+        const int n_iterations = 10;
+        Mat centers(m, inputs.width());
+        selectRows(inputs, indices, centers);
+        Mat new_centers(m, inputs.width());
+        Vec counts(m);
+        TMat<int> assignment;
+        Mat sq_distances;
+        for (int it=0 ; it<n_iterations ; ++it) {
+            computeNearestNeighbors(centers, inputs, 1, assignment, sq_distances);
+            new_centers.clear();
+            counts.clear();
+            for (int i=0 ; i<n ; ++i) {
+                int c = assignment(i,0);
+                new_centers(c) += inputs(i);
+                counts[c]++;
+            }
+            // An empty cluster is restarted from a random example
+            for (int c=0 ; c<m ; ++c) {
+                if (counts[c] > 0)
+                    new_centers(c) /= counts[c];
+                else
+                    new_centers(c) << inputs(random_gen->uniform_multinomial_sample(n));
+            }
+            centers << new_centers;
+        }
+
+        // Snap each center to the closest example not taken yet, in order of
+        // increasing distance, and fall back on the random ones
+        const int K = min(n, 8);
+        TMat<int> neighbors;
+        computeNearestNeighbors(inputs, centers, K, neighbors, sq_distances);
+        TVec<bool> taken(n, false);
+        int n_taken = 0;
+        for (int c=0 ; c<m ; ++c)
+            for (int k=0 ; k<K ; ++k) {
+                int i = neighbors(c,k);
+                if (i >= 0 && ! taken[i]) {
+                    taken[i] = true;
+                    indices[n_taken++] = i;
+                    break;
+                }
+            }
+        for (int p=0 ; p<n && n_taken<m ; ++p)
+            if (! taken[permutation[p]]) {
+                taken[permutation[p]] = true;
+                indices[n_taken++] = permutation[p];
+            }
+    }
+    sortElements(indices);
+}
+
+
 //#####  trainProjectedProcess (LAPACK)  ######################################
 
 void GaussianProcessRegressor::trainProjectedProcess(
@@ -110,6 +110,16 @@ class Optimizer;
  *  is more computationally expensive and would require substantial updates to
  *  the PLearn Kernel class (to efficiently support asymmetric kernel-matrix
  *  gradient).  This may come later.
+ *
+ *  For very large training sets, the subset-of-regressors ("sor") and FITC
+ *  ("fitc") approximations also work from M inducing points, but optimize
+ *  the hyperparameters on the approximate marginal likelihood of the whole
+ *  training set, in O(NM^2) time and O(NM) memory.  The inducing points are
+ *  either given by 'active_set_indices' or chosen among the training inputs
+ *  (see 'inducing_set_size').  Only the inducing inputs are kept after
+ *  training, so that predictions take O(M) kernel evaluations.  Their
+ *  predictive variances use the same deterministic training conditional
+ *  (DTC) form as the projected process, not the exact SoR or FITC ones.
  */
 class GaussianProcessRegressor : public PLearner
 {
@@ -196,7 +206,10 @@ public:
      *  Gaussian process solution (requires O(N^3) computation).  If
      *  "projected-process", use the PP approximation, which requires O(MN^2)
      *  computation, where M is given by the size of the active training
-     *  examples specified by the "active-set" option.  Default="exact".
+     *  examples specified by the "active-set" option.  If "sor" or "fitc",
+     *  use respectively the subset-of-regressors or FITC approximation, also
+     *  in O(MN^2), with hyperparameters optimized on all N examples.
+     *  Default="exact".
      */
     string m_solution_algorithm;
 
@@ -207,6 +220,21 @@ public:
      *  be SORTED IN INCREASING ORDER and should not contain duplicates.
      */
     TVec<int> m_active_set_indices;
+
+    /**
+     *  With the "sor" or "fitc" solution algorithms, if 'active_set_indices'
+     *  is empty, number of inducing points to select among the training
+     *  inputs (default = 0).
+     */
+    int m_inducing_set_size;
+
+    /**
+     *  How inducing points are selected when 'inducing_set_size' is used:
+     *  "kmeans" takes the training inputs closest to the centers found by a
+     *  few k-means iterations, "random" takes random training inputs.
+     *  Default = "kmeans".
+     */
+    string m_inducing_selection;
     
 
 public:
@@ -291,6 +319,16 @@ protected:
     PP<GaussianProcessNLLVariable> hyperOptimize(
         const Mat& inputs, const Mat& targets, VarArray& hyperparam_vars);
 
+    /// Create the NLL variable for the current solution algorithm
+    PP<GaussianProcessNLLVariable> newNLLVariable(
+        const Mat& inputs, const Mat& targets,
+        const TVec<string>& hyperparam_names, const VarArray& hyperparam_vars,
+        bool allow_bprop) const;
+
+    /// Select 'inducing_set_size' inducing points among the given inputs;
+    /// the returned indices are sorted
+    void selectInducingPoints(const Mat& inputs, TVec<int>& indices) const;
+
     /// Update the parameters required for the Projected Process approximation,
     /// assuming hyperparameters have already been optimized.
     void trainProjectedProcess(const Mat& all_training_inputs,
@@ -359,12 +397,25 @@ protected:
     //! Buffer to hold the sigma reductor for m_gram_inverse_product
     mutable Mat m_sigma_reductor;
 
+    //! Indices of the inducing points used by the "sor" and "fitc"
+    //! algorithms during training
+    TVec<int> m_inducing_indices;
+
     //! Solution algorithm in enum form to avoid lengthy string-compare
     //! each time we want to compute a confidence interval
     enum {
         AlgoExact,
-        AlgoProjectedProcess
+        AlgoProjectedProcess,
+        AlgoSubsetOfRegressors,
+        AlgoFITC
     } m_algorithm_enum;
+
+    //! Whether the algorithm is "sor" or "fitc"
+    bool usesInducingPoints() const
+    {
+        return m_algorithm_enum == AlgoSubsetOfRegressors
+            || m_algorithm_enum == AlgoFITC;
+    }
     
 private: 
     /// This does the actual building. 
@@ -62,7 +62,8 @@ LocalMedBoost::LocalMedBoost()
       loss_function_weight(1.0),
       objective_function("l2"),
       regression_tree(1),
-      max_nstages(1)
+      max_nstages(1),
+      flatten_trees(true)
 {
 }
 
@@ -95,6 +96,10 @@ void LocalMedBoost::declareOptions(OptionList& ol)
                   "The template for a RegressionTree base regressor to be boosted thru a wrapper."
                   "This is useful when you want to used a different confidence function."
                   "The regression_tree option needs to be set to 2.\n");
+    declareOption(ol, "flatten_trees", &LocalMedBoost::flatten_trees, OptionBase::buildoption | OptionBase::nosave,
+                  "If set to 1 (the default value) and the regression_tree option is set to 1, the outputs are computed\n"
+                  "with a flattened copy of the tree regressors (a RegressionTreeForest), which is much faster,\n"
+                  "especially for many rows with computeOutputs(). The outputs are the same.\n");
  
     declareOption(ol, "end_stage", &LocalMedBoost::end_stage, OptionBase::learntoption,
                   "The last train stage after end of training\n");
@@ -123,6 +128,8 @@ void LocalMedBoost::makeDeepCopyFromShallowCopy(CopiesMap& copies)
     deepCopyField(loss_function_weight, copies);
     deepCopyField(objective_function, copies);
     deepCopyField(regression_tree, copies);
+    deepCopyField(flatten_trees, copies);
+    deepCopyField(forest, copies);
     deepCopyField(max_nstages, copies);
     deepCopyField(base_regressor_template, copies);
     deepCopyField(tree_regressor_template, copies);
@@ -182,6 +189,7 @@ void LocalMedBoost::train()
         initializeSampleWeight();
         initializeLineSearch();
         bound = 1.0;
+        forest = 0;
         if (regression_tree > 0)
             sorted_train_set = new RegressionTreeRegisters(train_set,
                                                            report_progress,
@@ -604,9 +612,85 @@ void LocalMedBoost::computeOutput(const Vec& inputv, Vec& outputv) const
 {
     if (end_stage < 1)
         PLERROR("LocalMedBoost: No function has been built"); 
-    TVec<real>  base_regressor_outputs;         // vector of base regressor outputs for a sample
-    TVec<real>  base_regressor_confidences;     // vector of base regressor confidences for a sample
-    Vec         base_regressor_outputv;         // vector of a base regressor computed prediction
+    TVec<real>  base_regressor_outputs(end_stage);     // vector of base regressor outputs for a sample
+    TVec<real>  base_regressor_confidences(end_stage); // vector of base regressor confidences for a sample
+    if (updateForest())
+    {
+        const real* pinput = inputv.data();
+        for (int index_t = 0; index_t < end_stage; index_t++)
+        {
+            const real* base_output = forest->getLeaveOutput(forest->getLeave(index_t, pinput));
+            base_regressor_outputs[index_t] = base_output[0];
+            base_regressor_confidences[index_t] = base_output[1];
+        }
+    }
+    else
+    {
+        Vec base_regressor_outputv(2);                 // vector of a base regressor computed prediction
+        for (int index_t = 0; index_t < end_stage; index_t++)
+        {
+            base_regressors[index_t]->computeOutput(inputv, base_regressor_outputv);
+            base_regressor_outputs[index_t] = base_regressor_outputv[0];
+            base_regressor_confidences[index_t] = base_regressor_outputv[1];
+        }
+    }
+    combineBaseOutputs(base_regressor_outputs, base_regressor_confidences, outputv);
+}
+
+void LocalMedBoost::computeOutputs(const Mat& input, Mat& output) const
+{
+    if (end_stage < 1)
+        PLERROR("LocalMedBoost: No function has been built"); 
+    if (!updateForest())
+    {
+        inherited::computeOutputs(input, output);
+        return;
+    }
+    PLASSERT(output.length() == input.length());
+    TMat<int> leaves;
+    forest->computeLeaves(input, leaves);
+    TVec<real> base_regressor_outputs(end_stage);
+    TVec<real> base_regressor_confidences(end_stage);
+    for (int row = 0; row < input.length(); row++)
+    {
+        for (int index_t = 0; index_t < end_stage; index_t++)
+        {
+            const real* base_output = forest->getLeaveOutput(leaves(row, index_t));
+            base_regressor_outputs[index_t] = base_output[0];
+            base_regressor_confidences[index_t] = base_output[1];
+        }
+        Vec outputv = output(row);
+        combineBaseOutputs(base_regressor_outputs, base_regressor_confidences, outputv);
+    }
+}
+
+bool LocalMedBoost::updateForest() const
+{
+    // only the tree regressors are flattened, not the wrappers
+    if (!flatten_trees || regression_tree != 1)
+        return false;
+    if (!forest)
+        forest = new RegressionTreeForest();
+    if (forest->nTrees() > end_stage)
+        forest->clear();
+    for (int index_t = forest->nTrees(); index_t < end_stage; index_t++)
+    {
+        PP<RegressionTree> tree = (PP<RegressionTree>)base_regressors[index_t];
+        if (!tree)
+        {
+            forest->clear();
+            return false;
+        }
+        forest->addTree(*tree);
+    }
+    PLASSERT(forest->outputsize() >= 2);
+    return true;
+}
+
+void LocalMedBoost::combineBaseOutputs(const TVec<real>& base_regressor_outputs,
+                                       const TVec<real>& base_regressor_confidences,
+                                       Vec& outputv) const
+{
     real        sum_alpha;
     real        sum_function_weights;           // sum of all regressor weighted confidences 
     real        norm_sum_function_weights;
@@ -619,9 +703,6 @@ void LocalMedBoost::computeOutput(const Vec& inputv, Vec& outputv) const
     real        output_rob_save;
     int         index_j;                        // index to go thru the base regressor's arrays
     int         index_t;                        // index to go thru the base regressor's arrays
-    base_regressor_outputs.resize(end_stage);
-    base_regressor_confidences.resize(end_stage);
-    base_regressor_outputv.resize(2);
     sum_function_weights = 0.0;
     sum_alpha = 0.0;
     outputv[0] = -1E9;
@@ -630,9 +711,6 @@ void LocalMedBoost::computeOutput(const Vec& inputv, Vec& outputv) const
     output_rob_minus = -1E9;
     for (index_t = 0; index_t < end_stage; index_t++) 
     {
-        base_regressors[index_t]->computeOutput(inputv, base_regressor_outputv);
-        base_regressor_outputs[index_t] = base_regressor_outputv[0];
-        base_regressor_confidences[index_t] = base_regressor_outputv[1];
         if (base_regressor_outputs[index_t] > outputv[0])
         {
             outputv[0] = base_regressor_outputs[index_t];
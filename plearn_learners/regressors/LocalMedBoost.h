@@ -42,6 +42,7 @@
 #define LocalMedBoost_INC
 
 #include <plearn_learners/generic/PLearner.h>
+#include "RegressionTreeForest.h"
 
 namespace PLearn {
 using namespace std;
@@ -67,6 +68,7 @@ private:
     PP<PLearner> base_regressor_template;              // template for a generic regressor as the base learner to be boosted
     PP<RegressionTree> tree_regressor_template;        // template for a tree regressor to be boosted as the base regressor
     PP<BaseRegressorWrapper> tree_wrapper_template;    // template for a tree regressor to be boosted thru a wrapper for a different confidence function
+    bool flatten_trees;                                // indicator to predict with a flattened copy of the tree regressors
   
 /*
   Learnt options: they are sized and initialized if need be, at stage 0
@@ -82,6 +84,7 @@ private:
     TVec<real> function_weights;                        // array of function weights built by the boosting algorithm 
     TVec<real> loss_function;                           // array of the loss function
     TVec<real> sample_weights;                          // array to represent different distributions on the samples of the training set
+    mutable PP<RegressionTreeForest> forest;            // flattened copy of the tree regressors, kept in sync by updateForest()
  
 /*
   Work fields: they are sized and initialized if need be, at buid time
@@ -144,6 +147,7 @@ public:
     virtual TVec<string> getTrainCostNames() const;
     virtual TVec<string> getTestCostNames() const;
     virtual void         computeOutput(const Vec& input, Vec& output) const;
+    virtual void         computeOutputs(const Mat& input, Mat& output) const;
     virtual void         computeOutputAndCosts(const Vec& input, const Vec& target, Vec& output, Vec& costs) const;
     virtual void         computeCostsFromOutputs(const Vec& input, const Vec& output,
                                                  const Vec& target, Vec& costs) const;
@@ -157,6 +161,10 @@ private:
     void         recomputeSampleWeight();
     void         initializeSampleWeight();
     void         verbose(string the_msg, int the_level);
+    bool         updateForest() const;
+    void         combineBaseOutputs(const TVec<real>& base_regressor_outputs,
+                                    const TVec<real>& base_regressor_confidences,
+                                    Vec& outputv) const;
 };
 
 DECLARE_OBJECT_PTR(LocalMedBoost);
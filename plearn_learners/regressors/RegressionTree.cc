@@ -68,7 +68,9 @@ RegressionTree::RegressionTree()
       loss_function_weight(1.0),
       maximum_number_of_nodes(400),
       compute_train_stats(1),
-      complexity_penalty_factor(0.0)
+      complexity_penalty_factor(0.0),
+      nb_bins(0),
+      max_cached_histograms(32)
 {
 }
 
@@ -92,6 +94,26 @@ void RegressionTree::declareOptions(OptionList& ol)
                   "A factor that is multiplied with the square root of the number of leaves.\n"
                   "If the error inprovement for the next split is less than the result, the algorithm proceed to an early stop."
                   "(When set to 0.0, the default value, it has no impact).");
+    declareOption(ol, "nb_bins", &RegressionTree::nb_bins, OptionBase::buildoption,
+                  "If > 0, the inputs are discretized in at most nb_bins bins (at\n"
+                  "most 255) and the splits are searched on per-node histograms\n"
+                  "instead of on the sorted rows. This is much faster on big\n"
+                  "train sets, but the split values are restricted to the bin\n"
+                  "boundaries. (When set to 0, the default value, the exact\n"
+                  "search is used).");
+    declareOption(ol, "max_cached_histograms",
+                  &RegressionTree::max_cached_histograms,
+                  OptionBase::buildoption,
+                  "When nb_bins > 0, the maximum number of unexpanded nodes that\n"
+                  "keep their histograms, to get those of a child by subtraction\n"
+                  "when they are expanded. When the limit is reached, the histograms\n"
+                  "of the node with the smallest error improvement are freed, and\n"
+                  "those of its children will be computed from their rows. Each\n"
+                  "cached node uses inputsize*(nb_bins+1)*statsSize reals.");
+    declareOption(ol, "binner", &RegressionTree::binner, OptionBase::buildoption,
+                  "The binner used to compute the bin boundaries of each input\n"
+                  "when nb_bins > 0. If not provided, equal-frequency bins are\n"
+                  "computed from the train set.");
 
     declareStaticOption(ol, "output_confidence_target",
                   &RegressionTree::output_confidence_target,
@@ -141,6 +163,9 @@ void RegressionTree::makeDeepCopyFromShallowCopy(CopiesMap& copies)
     deepCopyField(maximum_number_of_nodes, copies);
     deepCopyField(compute_train_stats, copies);
     deepCopyField(complexity_penalty_factor, copies);
+    deepCopyField(nb_bins, copies);
+    deepCopyField(max_cached_histograms, copies);
+//    deepCopyField(binner, copies);We don't need to deepCopy it as we only read it
     deepCopyField(multiclass_outputs, copies);
 //    deepCopyField(leave_template, copies);We don't need to deepCopy it as we only read it
     deepCopyField(sorted_train_set, copies);
@@ -149,6 +174,7 @@ void RegressionTree::makeDeepCopyFromShallowCopy(CopiesMap& copies)
     deepCopyField(first_leave, copies);
     deepCopyField(split_cols, copies);
     deepCopyField(split_values, copies);
+    deepCopyField(histogram_nodes, copies);
     //deepCopyField(tmp_vec, copies); not needed as we don't use it.
     
 }
@@ -232,6 +258,7 @@ void RegressionTree::train()
         }
         if (report_progress) pb->update(stage);
     }
+    clearHistograms();
     pb = NULL;
 #ifndef _OPENMP
     verbose("split_cols: "+tostring(split_cols),2);
@@ -297,19 +324,24 @@ void RegressionTree::forget()
 
 void RegressionTree::initialiseTree()
 {
+    clearHistograms();
     if (!sorted_train_set && train_set->classname()=="RegressionTreeRegisters")
     {
         sorted_train_set=(PP<RegressionTreeRegisters>)train_set;
         sorted_train_set->reinitRegisters();
     }
     else if(!sorted_train_set)
+        //in binned mode, the sorted rows are not needed.
         sorted_train_set = new RegressionTreeRegisters(train_set,
                                                        report_progress,
-                                                       verbosity);
+                                                       verbosity,
+                                                       nb_bins <= 0);
     else
     {
         sorted_train_set->reinitRegisters();
     }
+    if (nb_bins > 0)
+        sorted_train_set->setBinning(nb_bins, binner);
     //Set value common value of all leave
     // for optimisation, by default they aren't missing leave
     leave_template->missing_leave = 0;
@@ -363,6 +395,44 @@ PP<RegressionTreeNode> RegressionTree::expandTree()
     return node; 
 }
 
+void RegressionTree::cacheHistograms(PP<RegressionTreeNode> node)
+{
+    //a node that can't be split will never need its histograms.
+    if (node->split_col < 0 || max_cached_histograms <= 0)
+    {
+        node->histograms = Mat();
+        return;
+    }
+    histogram_nodes.append(node);
+    if (histogram_nodes.length() <= max_cached_histograms)
+        return;
+    //free those of the node the least likely to be expanded.
+    int worst = 0;
+    for (int i = 1; i < histogram_nodes.length(); i++)
+        if (histogram_nodes[i]->getErrorImprovment() <
+            histogram_nodes[worst]->getErrorImprovment())
+            worst = i;
+    histogram_nodes[worst]->histograms = Mat();
+    histogram_nodes.remove(worst);
+}
+
+void RegressionTree::uncacheHistograms(RegressionTreeNode* node)
+{
+    for (int i = 0; i < histogram_nodes.length(); i++)
+        if ((RegressionTreeNode*)histogram_nodes[i] == node)
+        {
+            histogram_nodes.remove(i);
+            return;
+        }
+}
+
+void RegressionTree::clearHistograms()
+{
+    for (int i = 0; i < histogram_nodes.length(); i++)
+        histogram_nodes[i]->histograms = Mat();
+    histogram_nodes.resize(0);
+}
+
 TVec<string> RegressionTree::getTrainCostNames() const
 {
     TVec<string> return_msg(5);
@@ -55,6 +55,7 @@ class RegressionTreeNode;
 class RegressionTree: public PLearner
 {
     friend class RegressionTreeNode;
+    friend class RegressionTreeForest;
     typedef PLearner inherited;
   
 private:
@@ -68,6 +69,9 @@ private:
     int maximum_number_of_nodes;
     int compute_train_stats;   
     real complexity_penalty_factor;
+    int nb_bins;
+    int max_cached_histograms;
+    PP<Binner> binner;
     Vec multiclass_outputs;
     PP<RegressionTreeLeave> leave_template;    
     PP<RegressionTreeRegisters> sorted_train_set;
@@ -90,6 +94,9 @@ private:
     TVec<int> split_cols;
     Vec       split_values;
     TVec<PP<RegressionTreeNode> > *nodes;
+    //! The unexpanded nodes that currently keep their histograms (at most
+    //! max_cached_histograms of them).
+    TVec<PP<RegressionTreeNode> > histogram_nodes;
 
     mutable Vec tmp_vec;
     mutable Vec tmp_computeCostsFromOutput;
@@ -127,6 +134,9 @@ private:
     void                   build_();
     void                   initialiseTree();
     PP<RegressionTreeNode> expandTree();
+    void                   cacheHistograms(PP<RegressionTreeNode> node);
+    void                   uncacheHistograms(RegressionTreeNode* node);
+    void                   clearHistograms();
     void                   verbose(string msg, int level);
 };
 
@@ -0,0 +1,246 @@
+// -*- C++ -*-
+
+// RegressionTreeForest.cc
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+#include "RegressionTreeForest.h"
+#include "RegressionTree.h"
+#include "RegressionTreeNode.h"
+#include "RegressionTreeLeave.h"
+
+namespace PLearn {
+using namespace std;
+
+PLEARN_IMPLEMENT_OBJECT(
+    RegressionTreeForest,
+    "Flattened copy of trained regression trees, for fast prediction.",
+    "The nodes of all the trees are packed in contiguous arrays, to avoid\n"
+    "following the pointers of the RegressionTreeNode objects, and many rows\n"
+    "can be evaluated at once with computeLeaves().\n"
+    "It is used by AdaBoost and LocalMedBoost when their base learners are\n"
+    "regression trees.\n");
+
+RegressionTreeForest::RegressionTreeForest()
+{
+}
+
+RegressionTreeForest::~RegressionTreeForest()
+{
+}
+
+void RegressionTreeForest::declareOptions(OptionList& ol)
+{
+    declareOption(ol, "roots", &RegressionTreeForest::roots,
+                  OptionBase::learntoption,
+                  "The root of each tree: the index of a node if >= 0, or\n"
+                  "~leave for a tree reduced to one leave.\n");
+    declareOption(ol, "split_cols", &RegressionTreeForest::split_cols,
+                  OptionBase::learntoption,
+                  "The input column tested by each node.\n");
+    declareOption(ol, "split_values", &RegressionTreeForest::split_values,
+                  OptionBase::learntoption,
+                  "The inputs greater than this value go to the right child.\n");
+    declareOption(ol, "left_children", &RegressionTreeForest::left_children,
+                  OptionBase::learntoption,
+                  "The left child of each node (node index or ~leave).\n");
+    declareOption(ol, "right_children", &RegressionTreeForest::right_children,
+                  OptionBase::learntoption,
+                  "The right child of each node (node index or ~leave).\n");
+    declareOption(ol, "missing_children",
+                  &RegressionTreeForest::missing_children,
+                  OptionBase::learntoption,
+                  "The child of each node for missing inputs (node index or\n"
+                  "~leave).\n");
+    declareOption(ol, "leave_outputs", &RegressionTreeForest::leave_outputs,
+                  OptionBase::learntoption,
+                  "The output of each leave.\n");
+    inherited::declareOptions(ol);
+}
+
+void RegressionTreeForest::makeDeepCopyFromShallowCopy(CopiesMap& copies)
+{
+    inherited::makeDeepCopyFromShallowCopy(copies);
+    deepCopyField(roots, copies);
+    deepCopyField(split_cols, copies);
+    deepCopyField(split_values, copies);
+    deepCopyField(left_children, copies);
+    deepCopyField(right_children, copies);
+    deepCopyField(missing_children, copies);
+    deepCopyField(leave_outputs, copies);
+}
+
+void RegressionTreeForest::build()
+{
+    inherited::build();
+    build_();
+}
+
+void RegressionTreeForest::build_()
+{
+    int n = split_cols.size();
+    if (split_values.size() != n || left_children.size() != n
+        || right_children.size() != n || missing_children.size() != n)
+        PLERROR("In RegressionTreeForest::build_ - the node arrays must all "
+                "have the same size");
+}
+
+void RegressionTreeForest::clear()
+{
+    roots.resize(0);
+    split_cols.resize(0);
+    split_values.resize(0);
+    left_children.resize(0);
+    right_children.resize(0);
+    missing_children.resize(0);
+    leave_outputs.resize(0, leave_outputs.width());
+}
+
+void RegressionTreeForest::addTree(const RegressionTree& tree)
+{
+    if (!tree.root)
+        PLERROR("In RegressionTreeForest::addTree - the tree is not trained");
+    int outputsize = tree.outputsize();
+    if (nTrees() == 0)
+        leave_outputs.resize(0, outputsize);
+    else if (outputsize != leave_outputs.width())
+        PLERROR("In RegressionTreeForest::addTree - all the trees must have "
+                "the same outputsize (%d), got %d",
+                leave_outputs.width(), outputsize);
+    roots.append(addNode(tree.root, outputsize));
+}
+
+int RegressionTreeForest::addNode(const RegressionTreeNode* node,
+                                  int outputsize)
+{
+    if (!node->left_node)
+        return addLeave(node->leave_output);
+
+    //the children are added after the node, so reserve its place
+    int pos = split_cols.size();
+    split_cols.append(node->split_col);
+    split_values.append(node->split_feature_value);
+    left_children.append(0);
+    right_children.append(0);
+    missing_children.append(0);
+
+    int left = addNode(node->left_node, outputsize);
+    int right = addNode(node->right_node, outputsize);
+    int missing = left;
+    if (RTR_HAVE_MISSING)
+    {
+        if (node->missing_is_valid > 0)
+            missing = addNode(node->missing_node, outputsize);
+        else
+        {
+            //the output of the missing leave is fixed once trained
+            Vec output(outputsize);
+            Vec error(3);
+            node->missing_leave->getOutputAndError(output, error);
+            missing = addLeave(output);
+        }
+    }
+    left_children[pos] = left;
+    right_children[pos] = right;
+    missing_children[pos] = missing;
+    return pos;
+}
+
+int RegressionTreeForest::addLeave(const Vec& output)
+{
+    PLASSERT(output.size() == leave_outputs.width());
+    leave_outputs.appendRow(output);
+    return ~(leave_outputs.length() - 1);
+}
+
+void RegressionTreeForest::computeLeaves(const Mat& inputs,
+                                         TMat<int>& leaves,
+                                         int first_tree) const
+{
+    PLASSERT(first_tree >= 0 && first_tree <= nTrees());
+    int n = inputs.length();
+    int n_trees = nTrees() - first_tree;
+    leaves.resize(n, n_trees);
+    if (n == 0 || n_trees == 0)
+        return;
+    int n_blocks = (n + block_size - 1) / block_size;
+
+    //Only raw pointers are used in the loop, as the reference counts of
+    //Vec and Mat are not thread safe.
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if(n_blocks > 1)
+#endif
+    for (int b = 0; b < n_blocks; b++)
+    {
+        int start = b * block_size;
+        int size = min(block_size, n - start);
+        int positions[block_size];
+        for (int t = 0; t < n_trees; t++)
+        {
+            int root = roots[first_tree + t];
+            for (int r = 0; r < size; r++)
+                positions[r] = root;
+            //go down one level for all the rows not yet in a leave, until
+            //all the rows are in a leave
+            bool active = root >= 0;
+            while (active)
+            {
+                active = false;
+                for (int r = 0; r < size; r++)
+                {
+                    int pos = positions[r];
+                    if (pos < 0)
+                        continue;
+                    pos = nextNode(pos, inputs(start + r, split_cols[pos]));
+                    positions[r] = pos;
+                    active = active || pos >= 0;
+                }
+            }
+            for (int r = 0; r < size; r++)
+                leaves(start + r, t) = ~positions[r];
+        }
+    }
+}
+
+} // end of namespace PLearn
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
@@ -0,0 +1,148 @@
+// -*- C++ -*-
+
+// RegressionTreeForest.h
+//
+// Copyright (C) 2026 PLearn contributors
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//  3. The name of the authors may not be used to endorse or promote
+//     products derived from this software without specific prior written
+//     permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+// OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+// NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// This file is part of the PLearn library. For more information on the PLearn
+// library, go to the PLearn Web site at www.plearn.org
+
+#ifndef RegressionTreeForest_INC
+#define RegressionTreeForest_INC
+
+#include <plearn/base/Object.h>
+#include <plearn/math/TMat.h>
+#include <plearn/math/pl_math.h>
+
+namespace PLearn {
+using namespace std;
+class RegressionTree;
+class RegressionTreeNode;
+
+/**
+ * Flattened, read-only copy of a set of trained RegressionTree, for
+ * prediction.
+ *
+ * The nodes of all the trees are packed in contiguous arrays (split column,
+ * split value, left, right and missing child), and the outputs of all the
+ * leaves in one matrix.  A child is either the index of a node (>= 0) or the
+ * code ~leave of a leave (< 0).  The result of a prediction is the leave
+ * reached in each tree, whose output is given by getLeaveOutput().
+ *
+ * The decisions taken are exactly those of
+ * RegressionTreeNode::computeOutputAndNodes(), so the outputs are the same.
+ */
+class RegressionTreeForest: public Object
+{
+    typedef Object inherited;
+
+public:
+
+/*
+  Learnt options: they are filled by addTree()
+*/
+
+    //! The root of each tree (a node index or a leave code).
+    TVec<int> roots;
+    TVec<int> split_cols;
+    Vec split_values;
+    TVec<int> left_children;
+    TVec<int> right_children;
+    TVec<int> missing_children;
+    //! The output of each leave, one per row.
+    Mat leave_outputs;
+
+    RegressionTreeForest();
+    virtual ~RegressionTreeForest();
+
+    PLEARN_DECLARE_OBJECT(RegressionTreeForest);
+
+    static  void declareOptions(OptionList& ol);
+    virtual void makeDeepCopyFromShallowCopy(CopiesMap &copies);
+    virtual void build();
+
+    //! Remove all the trees.
+    void         clear();
+    //! Append a copy of the trained tree.
+    void         addTree(const RegressionTree& tree);
+    inline int   nTrees() const { return roots.size(); }
+    inline int   outputsize() const { return leave_outputs.width(); }
+
+    //! The leave of the given tree reached by the input.
+    inline int   getLeave(int tree, const real* input) const
+    {
+        int pos = roots[tree];
+        while (pos >= 0)
+            pos = nextNode(pos, input[split_cols[pos]]);
+        return ~pos;
+    }
+    inline const real* getLeaveOutput(int leave) const
+    { return leave_outputs[leave]; }
+
+    //! Fill leaves(i,t) with the leave of tree first_tree+t reached by
+    //! row i of inputs, for all the trees from first_tree.  The rows are
+    //! processed by blocks, all the rows of a block going down a tree
+    //! together, and the blocks in parallel with OpenMP.
+    void         computeLeaves(const Mat& inputs, TMat<int>& leaves,
+                               int first_tree = 0) const;
+
+private:
+    //! Number of rows going down a tree together in computeLeaves().
+    static const int block_size = 64;
+
+    void         build_();
+    inline int   nextNode(int pos, real value) const
+    {
+        if (is_missing(value))
+            return missing_children[pos];
+        return value > split_values[pos] ? right_children[pos]
+                                         : left_children[pos];
+    }
+    //! Append the node and its children; return the code of the node.
+    int          addNode(const RegressionTreeNode* node, int outputsize);
+    int          addLeave(const Vec& output);
+};
+
+DECLARE_OBJECT_PTR(RegressionTreeForest);
+
+} // end of namespace PLearn
+
+#endif
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
@@ -295,6 +295,33 @@ void RegressionTreeLeave::removeLeave(PP<RegressionTreeLeave> leave){
                 classname().c_str(), leave->classname().c_str());
 }
 
+int RegressionTreeLeave::statsSize() const
+{
+    if(classname()!="RegressionTreeLeave")
+        PLERROR("In RegressionTreeLeave::statsSize subclass %s must reimplement it.",
+                classname().c_str());
+    return 5;
+}
+
+void RegressionTreeLeave::addRowToStats(real target, real weight,
+                                        real* stats) const
+{
+    stats[0] += 1;
+    stats[1] += weight;
+    stats[2] += target;
+    stats[3] += weight * target;
+    stats[4] += weight * pow(target, 2);
+}
+
+void RegressionTreeLeave::setStats(const real* stats)
+{
+    initStats();
+    length_ = int(stats[0]);
+    weights_sum = stats[1];
+    targets_sum = stats[2];
+    weighted_targets_sum = stats[3];
+    weighted_squared_targets_sum = stats[4];
+}
 
 void RegressionTreeLeave::verbose(string the_msg, int the_level)
 {
@@ -110,6 +110,16 @@ public:
     virtual void         addLeave(PP<RegressionTreeLeave> leave);
     virtual void         removeLeave(PP<RegressionTreeLeave> leave);
 
+    //! The statistics of a leave as an array of statsSize() reals, the
+    //! first one being the length. Used to build histograms of the rows
+    //! in RegressionTreeRegisters.
+    virtual int          statsSize() const;
+    //! Add a row to the statistics array (doesn't change this leave).
+    virtual void         addRowToStats(real target, real weight,
+                                       real* stats) const;
+    //! Set the statistics of this leave from an array.
+    virtual void         setStats(const real* stats);
+
 private:
     void         build_();
     void         verbose(string msg, int level);
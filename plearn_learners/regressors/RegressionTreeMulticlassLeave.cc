@@ -297,6 +297,35 @@ void RegressionTreeMulticlassLeave::removeLeave(PP<RegressionTreeLeave> leave_){
         PLERROR("In %s::addLeave the leave to add should have the same class. It have %s.",
                 classname().c_str(), leave->classname().c_str());
 }
+int RegressionTreeMulticlassLeave::statsSize() const
+{
+    return 2 + multiclass_outputs.length();
+}
+
+void RegressionTreeMulticlassLeave::addRowToStats(real target, real weight,
+                                                  real* stats) const
+{
+    stats[0] += 1;
+    stats[1] += weight;
+    for (int mc_ind = 0; mc_ind < multiclass_outputs.length(); mc_ind++)
+    {
+        if (target == multiclass_outputs[mc_ind])
+        {
+            stats[2 + mc_ind] += weight;
+            return;
+        }
+    }
+    PLERROR("RegressionTreeMultilassLeave: Unknown target: %g\n", target);
+}
+
+void RegressionTreeMulticlassLeave::setStats(const real* stats)
+{
+    initStats();
+    length_ = int(stats[0]);
+    weights_sum = stats[1];
+    for (int mc_ind = 0; mc_ind < multiclass_outputs.length(); mc_ind++)
+        multiclass_weights_sum[mc_ind] = stats[2 + mc_ind];
+}
 
 void RegressionTreeMulticlassLeave::printStats()
 {
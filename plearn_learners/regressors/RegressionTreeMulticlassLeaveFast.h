@@ -87,6 +87,10 @@ public:
     void         printStats();
     virtual void         addLeave(PP<RegressionTreeLeave> leave);
     virtual void         removeLeave(PP<RegressionTreeLeave> leave);
+    virtual int          statsSize() const;
+    virtual void         addRowToStats(real target, real weight,
+                                       real* stats) const;
+    virtual void         setStats(const real* stats);
 
 private:
     void         build_();
@@ -268,6 +268,27 @@ void RegressionTreeMulticlassLeaveProb::removeLeave(PP<RegressionTreeLeave> leav
         PLERROR("In %s::addLeave the leave to add should have the same class. It have %s.",
                 classname().c_str(), leave->classname().c_str());
 }
+int RegressionTreeMulticlassLeaveProb::statsSize() const
+{
+    return 2 + nb_class;
+}
+
+void RegressionTreeMulticlassLeaveProb::addRowToStats(real target, real weight,
+                                                      real* stats) const
+{
+    stats[0] += 1;
+    stats[1] += weight;
+    stats[2 + int(target)] += weight;
+}
+
+void RegressionTreeMulticlassLeaveProb::setStats(const real* stats)
+{
+    initStats();
+    length_ = int(stats[0]);
+    weights_sum = stats[1];
+    for (int i = 0; i < nb_class; i++)
+        multiclass_weights_sum[i] = stats[2 + i];
+}
 
 void RegressionTreeMulticlassLeaveProb::printStats()
 {
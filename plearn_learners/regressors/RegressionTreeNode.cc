@@ -44,6 +44,9 @@
 #include "RegressionTreeNode.h"
 #include "RegressionTreeRegisters.h"
 #include "RegressionTreeLeave.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace PLearn {
 using namespace std;
@@ -89,6 +92,7 @@ void RegressionTreeNode::finalize(){
     right_leave = 0;
     left_leave = 0;
     leave = 0;
+    histograms = Mat();
     //missing_leave used in computeOutputsAndNodes
     if(right_node)
         right_node->finalize();
@@ -205,6 +209,7 @@ void RegressionTreeNode::makeDeepCopyFromShallowCopy(CopiesMap& copies)
     deepCopyField(left_leave, copies);
     deepCopyField(right_node, copies);
     deepCopyField(right_leave, copies);
+    deepCopyField(histograms, copies);
 }
 
 void RegressionTreeNode::build()
@@ -262,162 +267,178 @@ void RegressionTreeNode::initNode(PP<RegressionTree> the_tree,
     leave_output[0] = closest_value;
 }
 
-//#define RCMP
+struct RegressionTreeNode::SplitScratch
+{
+    PP<RegressionTreeLeave> missing_leave;
+    PP<RegressionTreeLeave> left_leave;
+    PP<RegressionTreeLeave> right_leave;
+    //!stats of the whole leave, see RegressionTreeRegisters::bestSplitInRow
+    PP<RegressionTreeLeave> total_leave;
+    TVec<RTR_type> candidate;//list of candidate row to split
+    TVec<RTR_type> registered_row;
+    TVec<pair<RTR_target_t,RTR_weight_t> > registered_target_weight;
+    Vec registered_value;
+    Vec left_error;
+    Vec right_error;
+    Vec missing_error;
+    Vec output;
+};
+
 void RegressionTreeNode::lookForBestSplit()
 {
     if(leave->length()<=1)
         return;
-    TVec<RTR_type> candidate(0, leave->length());//list of candidate row to split
-    TVec<RTR_type> registered_row(leave->length());
-    TVec<pair<RTR_target_t,RTR_weight_t> > registered_target_weight(leave->length());
-    registered_target_weight.resize(leave->length());
-    registered_target_weight.resize(0);
-    Vec registered_value(0, leave->length());
-    tmp_vec.resize(leave->outputsize());
-    Vec left_error(3);
-    Vec right_error(3);
-    Vec missing_error(3);
-    missing_error.clear();
     PP<RegressionTreeRegisters> train_set = tree->getSortedTrainingSet();
+    if(train_set->isBinned()){
+        lookForBestSplitInHistograms();
+        return;
+    }
     bool one_pass_on_data=!train_set->haveMissing();
 
     int inputsize = train_set->inputsize();
-#ifdef RCMP
-    Vec row_split_err(inputsize);
-    Vec row_split_value(inputsize);
-    Vec row_split_balance(inputsize);
-    row_split_err.clear();
-    row_split_value.clear();
-    row_split_balance.clear();
+    if(inputsize<=0)
+        return;
+
+    //The column 0 is done first, as it initialize the total_leave and the
+    //RegressionTreeRegisters cache for this leave. Then the other columns
+    //are done in parallel with one SplitScratch per thread. The best split
+    //is selected afterward in column order, so the result is the same as
+    //with only one thread.
+    int n_threads = 1;
+#ifdef _OPENMP
+    //when called from a parallel region (ex: MultiClassAdaBoost), the
+    //nested region would have only one thread.
+    if(!omp_in_parallel())
+        n_threads = max(1, min(omp_get_max_threads(), inputsize - 1));
 #endif
-    int leave_id = leave->getId();
-    
-    int l_length = 0;
-    real l_weights_sum = 0;
-    real l_targets_sum = 0;
-    real l_weighted_targets_sum = 0;
-    real l_weighted_squared_targets_sum = 0;
+    TVec<SplitScratch> scratch(n_threads);
+    for(int t=0;t<n_threads;t++){
+        SplitScratch& s = scratch[t];
+        if(t==0){
+            s.missing_leave = missing_leave;
+            s.left_leave = left_leave;
+            s.right_leave = right_leave;
+        }else{
+            s.missing_leave = ::PLearn::deepCopy(missing_leave);
+            s.left_leave = ::PLearn::deepCopy(left_leave);
+            s.right_leave = ::PLearn::deepCopy(right_leave);
+        }
+        s.total_leave = ::PLearn::deepCopy(left_leave);
+        s.candidate.resize(0, leave->length());
+        s.registered_row.resize(leave->length());
+        s.registered_target_weight.resize(leave->length());
+        s.registered_target_weight.resize(0);
+        s.registered_value.resize(0, leave->length());
+        s.left_error.resize(3);
+        s.right_error.resize(3);
+        s.missing_error.resize(3);
+        s.missing_error.clear();
+        s.output.resize(leave->outputsize());
+    }
 
-    for (int col = 0; col < inputsize; col++)
+    Vec split_errors(inputsize);
+    Vec split_values(inputsize);
+    TVec<int> split_balances(inputsize);
+    //The length and the sums of the 3 leaves after each column.
+    Mat leaves_sums(inputsize, 5);
+    TVec<string> errors(inputsize);
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(n_threads) if(n_threads > 1)
+#endif
     {
-        missing_leave->initStats();
-        left_leave->initStats();
-        right_leave->initStats();
-        
-        PLASSERT(registered_row.size()==leave->length());
-        PLASSERT(candidate.size()==0);
-        tuple<real,real,int> ret;
-#ifdef NPREFETCH
-        //The ifdef is in case we don't want to use the optimized version with
-        //prefetch of memory. Maybe the optimization is hurtfull for some computer.
-        train_set->getAllRegisteredRow(leave_id, col, registered_row,
-                                       registered_target_weight,
-                                       registered_value);
-
-        PLASSERT(registered_row.size()==leave->length());
-        PLASSERT(candidate.size()==0);
-
-        //we do this optimization in case their is many row with the same value
-        //at the end as with binary variable.
-        int row_idx_end = registered_row.size() - 1;
-        int prev_row=registered_row[row_idx_end];
-        real prev_val=registered_value[row_idx_end];
-        for( ;row_idx_end>0;row_idx_end--)
+        int t = 0;
+#ifdef _OPENMP
+        t = omp_get_thread_num();
+#endif
+        SplitScratch& s = scratch[t];
+#ifdef _OPENMP
+#pragma omp single
+#endif
         {
-            int row=prev_row;
-            real val=prev_val;
-            prev_row = registered_row[row_idx_end - 1];
-            prev_val = registered_value[row_idx_end - 1];
-            if (RTR_HAVE_MISSING && is_missing(val))
-                missing_leave->addRow(row, registered_target_weight[row_idx_end].first,
-                                      registered_target_weight[row_idx_end].second);
-            else if(val==prev_val)
-                right_leave->addRow(row, registered_target_weight[row_idx_end].first,
-                                    registered_target_weight[row_idx_end].second);
-            else
-                break;
+            try {
+                bestSplitInCol(0, s, train_set, one_pass_on_data,
+                               split_errors[0], split_values[0],
+                               split_balances[0], leaves_sums[0]);
+                //the other threads need the total_leave of column 0.
+                for(int t2=0;t2<n_threads;t2++)
+                    if(t2!=t){
+                        scratch[t2].total_leave->initStats();
+                        scratch[t2].total_leave->addLeave(s.total_leave);
+                    }
+            } catch (const PLearnError& e) {
+                errors[0] = e.message();
+            }
         }
-
-        for(int row_idx = 0;row_idx<=row_idx_end;row_idx++)
+        //Only raw pointers and references to shared objects are used in the
+        //threads, as reference counts are not thread safe.
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+        for (int col = 1; col < inputsize; col++)
         {
-            int row=registered_row[row_idx];
-            if (RTR_HAVE_MISSING && is_missing(registered_value[row_idx]))
-                missing_leave->addRow(row, registered_target_weight[row_idx].first,
-                                      registered_target_weight[row_idx].second);
-            else {
-                left_leave->addRow(row, registered_target_weight[row_idx].first,
-                                   registered_target_weight[row_idx].second);
-                candidate.append(row);
+            try {
+                bestSplitInCol(col, s, train_set, one_pass_on_data,
+                               split_errors[col], split_values[col],
+                               split_balances[col], leaves_sums[col]);
+            } catch (const PLearnError& e) {
+                errors[col] = e.message();
             }
         }
+    }
+    for (int col = 0; col < inputsize; col++)
+        if (!errors[col].empty())
+            PLERROR("In RegressionTreeNode::lookForBestSplit - column %d: %s",
+                    col, errors[col].c_str());
 
-        missing_leave->getOutputAndError(tmp_vec, missing_error);
-        ret=bestSplitInRow(col, candidate, left_error,
-                           right_error, missing_error,
-                           right_leave, left_leave,
-                           train_set, registered_value,
-                           registered_target_weight);
-
-#else
-        if(!one_pass_on_data){
-            train_set->getAllRegisteredRowLeave(leave_id, col, registered_row,
-                                                registered_target_weight,
-                                                registered_value,
-                                                missing_leave,
-                                                left_leave,
-                                                right_leave, candidate);
-            PLASSERT(registered_target_weight.size()==candidate.size());
-            PLASSERT(registered_value.size()==candidate.size());
-            PLASSERT(left_leave->length()+right_leave->length()
-                     +missing_leave->length()==leave->length());
-            PLASSERT(candidate.size()>0||(left_leave->length()+right_leave->length()==0));
-            missing_leave->getOutputAndError(tmp_vec, missing_error);
-            ret=bestSplitInRow(col, candidate, left_error,
-                               right_error, missing_error,
-                               right_leave, left_leave,
-                               train_set, registered_value,
-                               registered_target_weight);
-        }else{
-            ret=train_set->bestSplitInRow(leave_id, col, registered_row,
-                                          left_leave,
-                                          right_leave, left_error,
-                                          right_error);
+    for (int col = 0; col < inputsize; col++)
+    {
+        if(col>0 && !one_pass_on_data){
+            for(int k=0;k<leaves_sums.width();k++)
+                PLCHECK(fast_is_equal(leaves_sums(0,k), leaves_sums(col,k)));
         }
-        PLASSERT(registered_row.size()==leave->length());
-#endif
 
-        if(col==0){
-            l_length=left_leave->length()+right_leave->length()+missing_leave->length();
-            l_weights_sum=left_leave->weights_sum+right_leave->weights_sum+missing_leave->weights_sum;
-            l_targets_sum=left_leave->targets_sum+right_leave->targets_sum+missing_leave->targets_sum;
-            l_weighted_targets_sum=left_leave->weighted_targets_sum
-                +right_leave->weighted_targets_sum+missing_leave->weighted_targets_sum;
-            l_weighted_squared_targets_sum=left_leave->weighted_squared_targets_sum
-                +right_leave->weighted_squared_targets_sum+missing_leave->weighted_squared_targets_sum;
-        }else if(!one_pass_on_data){
-            PLCHECK(l_length==left_leave->length()+right_leave->length()
-                    +missing_leave->length());
-            PLCHECK(fast_is_equal(l_weights_sum,
-                                  left_leave->weights_sum+right_leave->weights_sum
-                                  +missing_leave->weights_sum));
-            PLCHECK(fast_is_equal(l_targets_sum,
-                                  left_leave->targets_sum+right_leave->targets_sum
-                                  +missing_leave->targets_sum));
-            PLCHECK(fast_is_equal(l_weighted_targets_sum,
-                                  left_leave->weighted_targets_sum
-                                  +right_leave->weighted_targets_sum
-                                  +missing_leave->weighted_targets_sum));
-            PLCHECK(fast_is_equal(l_weighted_squared_targets_sum,
-                                  left_leave->weighted_squared_targets_sum
-                                  +right_leave->weighted_squared_targets_sum
-                                  +missing_leave->weighted_squared_targets_sum));
-        }
+        real err = split_errors[col];
+        int balance = split_balances[col];
+        if (fast_is_more(err, after_split_error)) continue;
+        else if (fast_is_equal(err, after_split_error) &&
+                 fast_is_more(balance, split_balance)) continue;
+        else if (fast_is_equal(err, REAL_MAX)) continue;
 
-#ifdef RCMP
-        row_split_err[col] = get<0>(ret);
-        row_split_value[col] = get<1>(ret);
-        row_split_balance[col] = get<2>(ret);
-#endif
+        split_col = col;
+        after_split_error = err;
+        split_feature_value = split_values[col];
+        split_balance = balance;
+        PLASSERT(fast_is_less(after_split_error,REAL_MAX)||split_col==-1);
+    }
+    PLASSERT(fast_is_less(after_split_error,REAL_MAX)||split_col==-1);
+
+    EXTREME_MODULE_LOG<<"error after split: "<<after_split_error<<endl;
+    EXTREME_MODULE_LOG<<"split value: "<<split_feature_value<<endl;
+    EXTREME_MODULE_LOG<<"split_col: "<<split_col;
+    if(split_col>=0)
+        EXTREME_MODULE_LOG<<" "<<train_set->fieldName(split_col);
+    EXTREME_MODULE_LOG<<endl;
+}
+
+void RegressionTreeNode::lookForBestSplitInHistograms()
+{
+    PP<RegressionTreeRegisters> train_set = tree->getSortedTrainingSet();
+    if(histograms.isEmpty())
+        train_set->fillHistograms(leave->getId(), leave->length(), leave,
+                                  histograms);
+    Vec left_error(3);
+    Vec right_error(3);
+    Vec missing_error(3);
+    Vec output(leave->outputsize());
+    for (int col = 0; col < train_set->inputsize(); col++)
+    {
+        tuple<real,real,int> ret =
+            train_set->bestSplitInHistogram(col, histograms[col],
+                                            missing_leave, left_leave,
+                                            right_leave, left_error,
+                                            right_error, missing_error,
+                                            output);
         if (fast_is_more(get<0>(ret), after_split_error)) continue;
         else if (fast_is_equal(get<0>(ret), after_split_error) &&
                  fast_is_more(get<2>(ret), split_balance)) continue;
@@ -427,16 +448,125 @@ void RegressionTreeNode::lookForBestSplit()
         after_split_error = get<0>(ret);
         split_feature_value = get<1>(ret);
         split_balance = get<2>(ret);
-        PLASSERT(fast_is_less(after_split_error,REAL_MAX)||split_col==-1);
     }
     PLASSERT(fast_is_less(after_split_error,REAL_MAX)||split_col==-1);
 
     EXTREME_MODULE_LOG<<"error after split: "<<after_split_error<<endl;
     EXTREME_MODULE_LOG<<"split value: "<<split_feature_value<<endl;
-    EXTREME_MODULE_LOG<<"split_col: "<<split_col;
-    if(split_col>=0)
-        EXTREME_MODULE_LOG<<" "<<train_set->fieldName(split_col);
-    EXTREME_MODULE_LOG<<endl;
+    EXTREME_MODULE_LOG<<"split_col: "<<split_col<<endl;
+    tree->cacheHistograms(this);
+}
+
+void RegressionTreeNode::bestSplitInCol(int col, SplitScratch& s,
+                                        const RegressionTreeRegisters* train_set,
+                                        bool one_pass_on_data,
+                                        real& split_error, real& split_value,
+                                        int& balance, real* leaves_sums)
+{
+    s.missing_leave->initStats();
+    s.left_leave->initStats();
+    s.right_leave->initStats();
+
+    PLASSERT(s.registered_row.size()==leave->length());
+    PLASSERT(s.candidate.size()==0);
+    int leave_id = leave->getId();
+    tuple<real,real,int> ret;
+#ifdef NPREFETCH
+    //The ifdef is in case we don't want to use the optimized version with
+    //prefetch of memory. Maybe the optimization is hurtfull for some computer.
+    train_set->getAllRegisteredRow(leave_id, col, s.registered_row,
+                                   s.registered_target_weight,
+                                   s.registered_value);
+
+    PLASSERT(s.registered_row.size()==leave->length());
+    PLASSERT(s.candidate.size()==0);
+
+    //we do this optimization in case their is many row with the same value
+    //at the end as with binary variable.
+    int row_idx_end = s.registered_row.size() - 1;
+    int prev_row=s.registered_row[row_idx_end];
+    real prev_val=s.registered_value[row_idx_end];
+    for( ;row_idx_end>0;row_idx_end--)
+    {
+        int row=prev_row;
+        real val=prev_val;
+        prev_row = s.registered_row[row_idx_end - 1];
+        prev_val = s.registered_value[row_idx_end - 1];
+        if (RTR_HAVE_MISSING && is_missing(val))
+            s.missing_leave->addRow(row, s.registered_target_weight[row_idx_end].first,
+                                    s.registered_target_weight[row_idx_end].second);
+        else if(val==prev_val)
+            s.right_leave->addRow(row, s.registered_target_weight[row_idx_end].first,
+                                  s.registered_target_weight[row_idx_end].second);
+        else
+            break;
+    }
+
+    for(int row_idx = 0;row_idx<=row_idx_end;row_idx++)
+    {
+        int row=s.registered_row[row_idx];
+        if (RTR_HAVE_MISSING && is_missing(s.registered_value[row_idx]))
+            s.missing_leave->addRow(row, s.registered_target_weight[row_idx].first,
+                                    s.registered_target_weight[row_idx].second);
+        else {
+            s.left_leave->addRow(row, s.registered_target_weight[row_idx].first,
+                                 s.registered_target_weight[row_idx].second);
+            s.candidate.append(row);
+        }
+    }
+
+    s.missing_leave->getOutputAndError(s.output, s.missing_error);
+    ret=bestSplitInRow(col, s.candidate, s.left_error,
+                       s.right_error, s.missing_error,
+                       s.right_leave, s.left_leave,
+                       train_set, s.registered_value,
+                       s.registered_target_weight);
+
+#else
+    if(!one_pass_on_data){
+        train_set->getAllRegisteredRowLeave(leave_id, col, s.registered_row,
+                                            s.registered_target_weight,
+                                            s.registered_value,
+                                            s.missing_leave,
+                                            s.left_leave,
+                                            s.right_leave, s.candidate);
+        PLASSERT(s.registered_target_weight.size()==s.candidate.size());
+        PLASSERT(s.registered_value.size()==s.candidate.size());
+        PLASSERT(s.left_leave->length()+s.right_leave->length()
+                 +s.missing_leave->length()==leave->length());
+        PLASSERT(s.candidate.size()>0
+                 ||(s.left_leave->length()+s.right_leave->length()==0));
+        s.missing_leave->getOutputAndError(s.output, s.missing_error);
+        ret=bestSplitInRow(col, s.candidate, s.left_error,
+                           s.right_error, s.missing_error,
+                           s.right_leave, s.left_leave,
+                           train_set, s.registered_value,
+                           s.registered_target_weight);
+    }else{
+        ret=train_set->bestSplitInRow(leave_id, col, s.registered_row,
+                                      s.left_leave, s.right_leave,
+                                      s.total_leave, s.left_error,
+                                      s.right_error, s.output);
+    }
+    PLASSERT(s.registered_row.size()==leave->length());
+#endif
+
+    split_error = get<0>(ret);
+    split_value = get<1>(ret);
+    balance = get<2>(ret);
+
+    leaves_sums[0] = s.left_leave->length()+s.right_leave->length()
+        +s.missing_leave->length();
+    leaves_sums[1] = s.left_leave->weights_sum+s.right_leave->weights_sum
+        +s.missing_leave->weights_sum;
+    leaves_sums[2] = s.left_leave->targets_sum+s.right_leave->targets_sum
+        +s.missing_leave->targets_sum;
+    leaves_sums[3] = s.left_leave->weighted_targets_sum
+        +s.right_leave->weighted_targets_sum
+        +s.missing_leave->weighted_targets_sum;
+    leaves_sums[4] = s.left_leave->weighted_squared_targets_sum
+        +s.right_leave->weighted_squared_targets_sum
+        +s.missing_leave->weighted_squared_targets_sum;
 }
 
 tuple<real,real,int>RegressionTreeNode::bestSplitInRow(
@@ -447,7 +577,7 @@ tuple<real,real,int>RegressionTreeNode::bestSplitInRow(
     const Vec missing_error,
     PP<RegressionTreeLeave> right_leave,
     PP<RegressionTreeLeave> left_leave,
-    PP<RegressionTreeRegisters> train_set,
+    const RegressionTreeRegisters* train_set,
     Vec values,TVec<pair<RTR_target_t,RTR_weight_t> > t_w
     )
 {
@@ -537,7 +667,11 @@ int RegressionTreeNode::expandNode()
     right_leave->initStats();
     TVec<RTR_type>registered_row(leave->length());
     PP<RegressionTreeRegisters> train_set = tree->getSortedTrainingSet();
-    train_set->getAllRegisteredRow(leave->getId(),split_col,registered_row);
+    if(train_set->isBinned())
+        //the rows don't need to be sorted, and there is no sorted rows.
+        train_set->getAllRegisteredRow(leave->getId(),registered_row);
+    else
+        train_set->getAllRegisteredRow(leave->getId(),split_col,registered_row);
 
     for (int row_index = 0;row_index<registered_row.size();row_index++)
     {
@@ -573,13 +707,47 @@ int RegressionTreeNode::expandNode()
     {
         missing_node = new RegressionTreeNode(missing_is_valid);
         missing_node->initNode(tree, missing_leave);
-        missing_node->lookForBestSplit();
     }
     left_node = new RegressionTreeNode(missing_is_valid);
     left_node->initNode(tree, left_leave);
-    left_node->lookForBestSplit();
     right_node = new RegressionTreeNode(missing_is_valid);
     right_node->initNode(tree, right_leave);
+
+    if (train_set->isBinned())
+        tree->uncacheHistograms(this);
+    if (train_set->isBinned() && !histograms.isEmpty())
+    {
+        //the histograms of the biggest child are those of this node minus
+        //those of the other children.
+        RegressionTreeNode* small_node = left_node;
+        RegressionTreeNode* big_node = right_node;
+        if (right_leave->length() < left_leave->length())
+        {
+            small_node = right_node;
+            big_node = left_node;
+        }
+        train_set->fillHistograms(small_node->leave->getId(),
+                                  small_node->leave->length(),
+                                  small_node->leave,
+                                  small_node->histograms);
+        histograms -= small_node->histograms;
+        if (missing_leave->length() > 0)
+        {
+            Mat missing_histograms;
+            train_set->fillHistograms(missing_leave->getId(),
+                                      missing_leave->length(),
+                                      missing_leave, missing_histograms);
+            histograms -= missing_histograms;
+            if (missing_node)
+                missing_node->histograms = missing_histograms;
+        }
+        big_node->histograms = histograms;
+        histograms = Mat();
+    }
+
+    if (missing_node)
+        missing_node->lookForBestSplit();
+    left_node->lookForBestSplit();
     right_node->lookForBestSplit();
     return split_col;
 }
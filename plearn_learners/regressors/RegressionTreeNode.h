@@ -58,6 +58,7 @@ class RegressionTreeNode;
 class RegressionTreeNode: public Object
 {
     friend class RegressionTree;
+    friend class RegressionTreeForest;
     typedef Object inherited;
   
 private:
@@ -87,6 +88,13 @@ private:
     PP<RegressionTreeLeave> left_leave;
     PP<RegressionTreeNode> right_node;
     PP<RegressionTreeLeave> right_leave;
+
+    //!In binned mode, the histograms of the rows of the leave (see
+    //!RegressionTreeRegisters::fillHistograms). They are kept until the
+    //!node is expanded, to get those of a child by subtraction, unless
+    //!the tree frees them (see RegressionTree::max_cached_histograms); the
+    //!children then compute theirs from their rows.
+    Mat histograms;
     
     //only there to reload old version. Put static to use less space.
     static int dummy_int;
@@ -131,14 +139,26 @@ public:
     inline bool         haveChildrenNode(){return left_node;}
     
 private:
+    //! Leaves and buffers used to look for the best split in one column.
+    //! Each thread of lookForBestSplit() has its own.
+    struct SplitScratch;
+
     void         build_();
     void         verbose(string msg, int level); 
+    void         lookForBestSplitInHistograms();
+    //! Look for the best split of the leave on column col.  leaves_sums is
+    //! filled with the length and the sums of the 3 leaves (to check them).
+    void         bestSplitInCol(int col, SplitScratch& scratch,
+                                const RegressionTreeRegisters* train_set,
+                                bool one_pass_on_data,
+                                real& split_error, real& split_value,
+                                int& balance, real* leaves_sums);
     static tuple<real,real,int> bestSplitInRow(int col, TVec<RTR_type>& candidates,
                                                Vec left_error, Vec right_error,
                                                const Vec missing_error,
                                                PP<RegressionTreeLeave> right_leave,
                                                PP<RegressionTreeLeave> left_leave,
-                                               PP<RegressionTreeRegisters> train_set,
+                                               const RegressionTreeRegisters* train_set,
                                                Vec values, 
                                                TVec<pair<RTR_target_t,RTR_weight_t> > t_w
         );
@@ -46,13 +46,20 @@
 #include <plearn/vmat/TransposeVMatrix.h>
 #include <plearn/vmat/MemoryVMatrixNoSave.h>
 #include <plearn/vmat/SubVMatrix.h>
+#include <plearn/vmat/MemoryVMatrix.h>
 #include <plearn/io/fileutils.h>
 #include <plearn/io/load_and_save.h>
 #include <limits>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace PLearn {
 using namespace std;
 
+const unsigned char RegressionTreeRegisters::missing_bin;
+
 PLEARN_IMPLEMENT_OBJECT(RegressionTreeRegisters,
                         "Object to maintain the various registers of a regression tree", 
                         "It is used first, to sort the learner train set on all dimensions of the input samples.\n"
@@ -69,6 +76,7 @@ RegressionTreeRegisters::RegressionTreeRegisters():
     do_sort_rows(true),
     mem_tsource(true),
     have_missing(true),
+    nb_bins(0),
     compact_reg_leave(-1)
 {
     build();
@@ -87,6 +95,7 @@ RegressionTreeRegisters::RegressionTreeRegisters(VMat source_,
     do_sort_rows(do_sort_rows_),
     mem_tsource(mem_tsource_),
     have_missing(true),
+    nb_bins(0),
     compact_reg_leave(-1)
 {
     source = source_;
@@ -109,6 +118,7 @@ RegressionTreeRegisters::RegressionTreeRegisters(VMat source_,
     do_sort_rows(do_sort_rows_),
     mem_tsource(mem_tsource_),
     have_missing(true),
+    nb_bins(0),
     compact_reg_leave(-1)
 {
     source = source_;
@@ -151,6 +161,31 @@ void RegressionTreeRegisters::declareOptions(OptionList& ol)
     declareOption(ol, "tsorted_row", &RegressionTreeRegisters::tsorted_row, OptionBase::nosave,
                   "The matrix holding the sequence of samples in ascending value order for each dimension\n");
 
+    declareOption(ol, "nb_bins", &RegressionTreeRegisters::nb_bins,
+                  OptionBase::buildoption,
+                  "If >0, the input values are quantized in at most nb_bins bins\n"
+                  "(at most 255) and the RegressionTree finds the splits with\n"
+                  "histograms of the bins instead of the sorted rows.\n"
+                  "The sorted rows are then not needed (see do_sort_rows).\n");
+
+    declareOption(ol, "binner", &RegressionTreeRegisters::binner,
+                  OptionBase::buildoption,
+                  "If nb_bins>0, the Binner that gives the cut points of each\n"
+                  "input. If not provided, the cut points are chosen so that\n"
+                  "the bins have about the same number of rows.\n");
+
+    declareOption(ol, "tbinned", &RegressionTreeRegisters::tbinned,
+                  OptionBase::nosave,
+                  "The bin of each value of tsource when nb_bins>0.\n");
+
+    declareOption(ol, "bin_min", &RegressionTreeRegisters::bin_min,
+                  OptionBase::nosave,
+                  "The smallest value of each bin of each input.\n");
+
+    declareOption(ol, "bin_max", &RegressionTreeRegisters::bin_max,
+                  OptionBase::nosave,
+                  "The biggest value of each bin of each input.\n");
+
     inherited::declareOptions(ol);
 }
 
@@ -233,6 +268,8 @@ void RegressionTreeRegisters::build_()
 
     leave_register.resize(length());
     sortRows();
+    if(nb_bins>0)
+        binRows();
 //    compact_reg.resize(length());
 }
 
@@ -413,7 +450,9 @@ void RegressionTreeRegisters::getAllRegisteredRow(RTR_type_id leave_id, int col,
     RTR_type_id* pleave_register = leave_register.data();
     if(reg.size()==length()){
         //get the full row
-        reg<<tsorted_row(col);
+        //(copied through the raw pointer, as this may be called by many
+        //threads and tsorted_row(col) would change the reference count)
+        copy(ptsorted_row, ptsorted_row + length(), preg);
         idx=length();
     }else if(compact_reg.size()==0){
         for(int i=0;i<length() && n> idx;i++){
@@ -463,15 +502,11 @@ tuple<real,real,int> RegressionTreeRegisters::bestSplitInRow(
     RTR_type_id leave_id, int col, TVec<RTR_type> &reg,
     PP<RegressionTreeLeave> left_leave,
     PP<RegressionTreeLeave> right_leave,
-    Vec left_error, Vec right_error) const
+    PP<RegressionTreeLeave> total_leave,
+    Vec left_error, Vec right_error, Vec output) const
 {
     PLCHECK(!haveMissing());
 
-    if(!tmp_leave){
-        tmp_leave = ::PLearn::deepCopy(left_leave);
-        tmp_vec.resize(left_leave->outputsize());
-    }
-
     PLASSERT(tsource_mat.length()==tsource.length());
     getAllRegisteredRow(leave_id,col,reg);
     real * p = tsource_mat[col];
@@ -522,21 +557,21 @@ tuple<real,real,int> RegressionTreeRegisters::bestSplitInRow(
             RTR_weight_t weight = ptw[row].second;
             left_leave->addRow(row, target, weight);
         }
-        tmp_leave->initStats();
-        tmp_leave->addLeave(left_leave);
-        tmp_leave->addLeave(right_leave);
+        total_leave->initStats();
+        total_leave->addLeave(left_leave);
+        total_leave->addLeave(right_leave);
 
     }else{//do 1 pass finding of the best split.
 
         left_leave->initStats();
-        left_leave->addLeave(tmp_leave);
+        left_leave->addLeave(total_leave);
         left_leave->removeLeave(right_leave);
 
-        PLASSERT(tmp_leave->length()==left_leave->length()+right_leave->length());
-        PLASSERT(fast_is_equal(tmp_leave->weights_sum,left_leave->weights_sum+right_leave->weights_sum));
-        PLASSERT(fast_is_equal(tmp_leave->targets_sum,left_leave->targets_sum+right_leave->targets_sum));
-        PLASSERT(fast_is_equal(tmp_leave->weighted_targets_sum,left_leave->weighted_targets_sum+right_leave->weighted_targets_sum));
-        PLASSERT(fast_is_equal(tmp_leave->weighted_squared_targets_sum,
+        PLASSERT(total_leave->length()==left_leave->length()+right_leave->length());
+        PLASSERT(fast_is_equal(total_leave->weights_sum,left_leave->weights_sum+right_leave->weights_sum));
+        PLASSERT(fast_is_equal(total_leave->targets_sum,left_leave->targets_sum+right_leave->targets_sum));
+        PLASSERT(fast_is_equal(total_leave->weighted_targets_sum,left_leave->weighted_targets_sum+right_leave->weighted_targets_sum));
+        PLASSERT(fast_is_equal(total_leave->weighted_squared_targets_sum,
                               left_leave->weighted_squared_targets_sum+right_leave->weighted_squared_targets_sum));
     }
 
@@ -583,8 +618,8 @@ tuple<real,real,int> RegressionTreeRegisters::bestSplitInRow(
 
         row = next_row;
         if (next_feature < row_feature){
-            left_leave->getOutputAndError(tmp_vec, left_error);
-            right_leave->getOutputAndError(tmp_vec, right_error);
+            left_leave->getOutputAndError(output, left_error);
+            right_leave->getOutputAndError(output, right_error);
         }else
             continue;
         real work_error = left_error[0]
@@ -695,6 +730,202 @@ void RegressionTreeRegisters::sortEachDim(int dim)
 
 }
 
+void RegressionTreeRegisters::setBinning(int the_nb_bins,
+                                         PP<Binner> the_binner)
+{
+    if(the_nb_bins==nb_bins && the_binner==binner
+       && tbinned.length()==inputsize())
+        return;
+    nb_bins=the_nb_bins;
+    binner=the_binner;
+    tbinned=TMat<unsigned char>();
+    if(nb_bins>0)
+        binRows();
+}
+
+void RegressionTreeRegisters::binRows()
+{
+    if (tbinned.length() == inputsize() && tbinned.width() == length())
+        return;
+    if(nb_bins>missing_bin)
+        PLERROR("In RegressionTreeRegisters::binRows - nb_bins must be at "
+                "most %d, got %d", int(missing_bin), nb_bins);
+    PLCHECK_MSG(tsource->classname()=="MemoryVMatrixNoSave",tsource->classname().c_str());
+
+    verbose("RegressionTreeRegisters: The train set is being binned", 3);
+    //the cut points of each column: bin k has the values v with
+    //cut_points[k-1] < v <= cut_points[k], as with ManualBinner.
+    TVec<Vec> cut_points(inputsize());
+    if(binner){
+        //the binner may not be thread safe.
+        for(int col=0;col<inputsize();col++){
+            VMat column = new MemoryVMatrix(columnmatrix(tsource_mat(col)));
+            Vec cuts = binner->getBinning(column)->getCutPoints();
+            //the first and last cut points are the bounds of the values.
+            if(cuts.length()>2)
+                cut_points[col] = cuts.subVec(1, cuts.length()-2).copy();
+            if(cut_points[col].length()+1>nb_bins)
+                PLERROR("In RegressionTreeRegisters::binRows - the binner "
+                        "gives %d bins for input %d, more than nb_bins=%d",
+                        cut_points[col].length()+1, col, nb_bins);
+        }
+    }
+
+    tbinned.resize(inputsize(), length());
+    bin_min.resize(inputsize(), nb_bins);
+    bin_max.resize(inputsize(), nb_bins);
+    bin_min.fill(REAL_MAX);
+    bin_max.fill(-REAL_MAX);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for(int col=0;col<inputsize();col++){
+        const real* p = tsource_mat[col];
+        Vec& cuts = cut_points[col];
+        if(!binner){
+            //bins with about the same number of rows.
+            Vec values(0, length());
+            for(int i=0;i<length();i++)
+                if(!is_missing(p[i]))
+                    values.append(p[i]);
+            sortElements(values);
+            int n=values.length();
+            for(int k=1;k<nb_bins && n>0;k++){
+                int idx = max(0, int((double(k)*n)/nb_bins) - 1);
+                real cut=values[idx];
+                if(cut>=values.last())
+                    break;
+                if(cuts.length()==0 || cut>cuts.last())
+                    cuts.append(cut);
+            }
+        }
+        const real* pcuts = cuts.data();
+        int n_cuts = cuts.length();
+        unsigned char* pbin = tbinned[col];
+        real* pmin = bin_min[col];
+        real* pmax = bin_max[col];
+        for(int i=0;i<length();i++){
+            real v=p[i];
+            if(is_missing(v)){
+                pbin[i]=missing_bin;
+                continue;
+            }
+            int bin = int(lower_bound(pcuts, pcuts+n_cuts, v) - pcuts);
+            pbin[i]=(unsigned char)bin;
+            if(v<pmin[bin]) pmin[bin]=v;
+            if(v>pmax[bin]) pmax[bin]=v;
+        }
+    }
+}
+
+void RegressionTreeRegisters::fillHistograms(RTR_type_id leave_id,
+                                             int leave_length,
+                                             const RegressionTreeLeave* leave,
+                                             Mat& histograms) const
+{
+    PLASSERT(isBinned());
+    TVec<RTR_type> reg(leave_length);
+    getAllRegisteredRow(leave_id, reg);
+    int stats_size = leave->statsSize();
+    int n = reg.length();
+
+    //the stats of each row, so that the leave is used only once by row.
+    Mat row_stats(n, stats_size);
+    row_stats.clear();
+    for(int i=0;i<n;i++){
+        int row = reg[i];
+        leave->addRowToStats(target_weight[row].first,
+                             target_weight[row].second, row_stats[i]);
+    }
+
+    histograms.resize(inputsize(), (nb_bins+1)*stats_size);
+    histograms.clear();
+    const RTR_type* preg = reg.data();
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for(int col=0;col<inputsize();col++){
+        real* h = histograms[col];
+        const unsigned char* pbin = tbinned[col];
+        for(int i=0;i<n;i++){
+            int bin = pbin[preg[i]];
+            if(bin==missing_bin)
+                bin = nb_bins;
+            real* hb = h + bin*stats_size;
+            const real* rs = row_stats[i];
+            for(int k=0;k<stats_size;k++)
+                hb[k] += rs[k];
+        }
+    }
+}
+
+tuple<real,real,int> RegressionTreeRegisters::bestSplitInHistogram(
+    int col, const real* histogram,
+    PP<RegressionTreeLeave> missing_leave,
+    PP<RegressionTreeLeave> left_leave,
+    PP<RegressionTreeLeave> right_leave,
+    Vec left_error, Vec right_error, Vec missing_error,
+    Vec output) const
+{
+    int stats_size = left_leave->statsSize();
+    int best_balance=INT_MAX;
+    real best_feature_value = REAL_MAX;
+    real best_split_error = REAL_MAX;
+
+    missing_leave->setStats(histogram + nb_bins*stats_size);
+    missing_leave->getOutputAndError(output, missing_error);
+    real missing_errors = missing_error[0] + missing_error[1];
+
+    //as in bestSplitInRow, we start with all the rows in the left leave and
+    //move them to the right leave, from the biggest values.
+    Vec left_stats(stats_size);
+    Vec right_stats(stats_size);
+    left_stats.clear();
+    right_stats.clear();
+    int last_bin=-1;
+    for(int bin=0;bin<nb_bins;bin++){
+        const real* hb = histogram + bin*stats_size;
+        if(hb[0]==0)
+            continue;
+        last_bin=bin;
+        for(int k=0;k<stats_size;k++)
+            left_stats[k] += hb[k];
+    }
+    if(last_bin<0)
+        return make_tuple(best_split_error, best_feature_value, best_balance);
+
+    int right_bin=last_bin;
+    for(int bin=last_bin-1;bin>=0;bin--){
+        const real* hb = histogram + bin*stats_size;
+        if(hb[0]==0)
+            continue;
+        //move the rows of right_bin to the right leave.
+        const real* hr = histogram + right_bin*stats_size;
+        for(int k=0;k<stats_size;k++){
+            left_stats[k] -= hr[k];
+            right_stats[k] += hr[k];
+        }
+        left_leave->setStats(left_stats.data());
+        right_leave->setStats(right_stats.data());
+        left_leave->getOutputAndError(output, left_error);
+        right_leave->getOutputAndError(output, right_error);
+        real work_error = missing_errors + left_error[0]
+            + left_error[1] + right_error[0] + right_error[1];
+        int work_balance = abs(left_leave->length() -
+                               right_leave->length());
+        real feature_value = 0.5 * (bin_max(col,bin) + bin_min(col,right_bin));
+        right_bin = bin;
+        if (fast_is_more(work_error,best_split_error)) continue;
+        else if (fast_is_equal(work_error,best_split_error) &&
+                 fast_is_more(work_balance,best_balance)) continue;
+
+        best_feature_value = feature_value;
+        best_split_error = work_error;
+        best_balance = work_balance;
+    }
+    return make_tuple(best_split_error, best_feature_value, best_balance);
+}
+
 void RegressionTreeRegisters::printRegisters()
 {
     cout << " register:  ";
@@ -46,6 +46,7 @@
 #include <plearn/base/stringutils.h>
 #include <plearn/math/TMat.h>
 #include <plearn/vmat/VMat.h>
+#include <plearn/math/Binner.h>
 
 //!used to limit the memory used by limiting the length of the dataset.
 //!work with unsigned int, uint16_t, but fail with uint8_t???
@@ -107,16 +108,26 @@ private:
     bool mem_tsource;
     bool have_missing;
 
+    //!if >0, the inputs are quantized in at most nb_bins bins and
+    //!the splits are found with histograms (see fillHistograms())
+    int nb_bins;
+    PP<Binner> binner;
+
+    //!the bin of each input value, transposed as tsource.
+    //!missing values are in the bin missing_bin.
+    TMat<unsigned char> tbinned;
+    //!the smallest and biggest input value of each bin
+    Mat bin_min;
+    Mat bin_max;
+
     mutable vector<bool> compact_reg;
     mutable int compact_reg_leave;
 
-    //!used in bestSplitInRow to save data
-    mutable PP<RegressionTreeLeave> tmp_leave;
-    //!used in bestSplitInRow to don't allocate a new vector each time.
-    mutable Vec tmp_vec;
-
 public:
 
+    //!the bin of the missing values in binned mode
+    static const unsigned char missing_bin = 255;
+
     RegressionTreeRegisters();
     RegressionTreeRegisters(VMat source_, bool report_progress_ = false,
                             bool vebosity_ = false, bool do_sort_rows = true,
@@ -163,11 +174,39 @@ public:
         PP<RegressionTreeLeave> left_leave,
         PP<RegressionTreeLeave> right_leave,
         TVec<RTR_type> &candidate)const;
+    //! total_leave is filled with the stats of the whole leave when col==0
+    //! and is used for the other columns, so column 0 must be done first.
+    //! output is only used as a work buffer.
+    //! When the other columns are done in parallel, each thread must have
+    //! its own leaves and buffers.
     tuple<real,real,int> bestSplitInRow(
         RTR_type_id leave_id, int col, TVec<RTR_type> &reg,
         PP<RegressionTreeLeave> left_leave,
         PP<RegressionTreeLeave> right_leave,
-        Vec left_error, Vec right_error)const;
+        PP<RegressionTreeLeave> total_leave,
+        Vec left_error, Vec right_error, Vec output)const;
+
+    //!Quantize the inputs in at most the_nb_bins bins (at most 255).
+    //!If the_binner is given, it gives the cut points of each input,
+    //!otherwise they are chosen so that the bins have about the same
+    //!number of rows. Nothing is done if it is already done.
+    void         setBinning(int the_nb_bins, PP<Binner> the_binner = 0);
+    inline bool  isBinned()const{return nb_bins > 0;}
+    //!Fill histograms with the stats of the rows of the leave, for each
+    //!input (row) and each bin (nb_bins+1 blocks of leave->statsSize()
+    //!reals, the last one for the missing values).
+    void         fillHistograms(RTR_type_id leave_id, int leave_length,
+                                const RegressionTreeLeave* leave,
+                                Mat& histograms)const;
+    //!Like bestSplitInRow, but using the histogram of column col.
+    //!The leaves are only used as work objects.
+    tuple<real,real,int> bestSplitInHistogram(
+        int col, const real* histogram,
+        PP<RegressionTreeLeave> missing_leave,
+        PP<RegressionTreeLeave> left_leave,
+        PP<RegressionTreeLeave> right_leave,
+        Vec left_error, Vec right_error, Vec missing_error,
+        Vec output)const;
     void         printRegisters();
     void         getExample(int i, Vec& input, Vec& target, real& weight);
     inline virtual void put(int i, int j, real value)
@@ -188,6 +227,7 @@ private:
     void         build_();
     void         sortRows();
     void         sortEachDim(int dim);
+    void         binRows();
     void         verbose(string msg, int level);
     void         checkMissing();
 
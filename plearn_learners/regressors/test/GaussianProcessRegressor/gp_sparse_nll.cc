@@ -0,0 +1,185 @@
+#include <plearn/var/GaussianProcessNLLVariable.h>
+#include <plearn/var/ObjectOptionVariable.h>
+#include <plearn/ker/SummationKernel.h>
+#include <plearn/ker/SquaredExponentialARDKernel.h>
+#include <plearn/ker/IIDNoiseKernel.h>
+
+using namespace PLearn;
+
+//! Gradient of 'nll' with respect to each of 'vars', computed by bprop.
+Vec bpropGradient( Var nll, const VarArray& vars )
+{
+    nll->fprop();
+    for ( int j=0; j < vars.size(); j++ )
+        vars[j]->gradient.clear();
+    nll->gradient[0] = 1.0;
+    nll->bprop();
+    Vec g(vars.size());
+    for ( int j=0; j < vars.size(); j++ )
+        g[j] = vars[j]->gradient[0];
+    return g;
+}
+
+//! Gradient of 'nll' with respect to each of 'vars', computed by central
+//! finite differences on the values of the variables.
+Vec finiteDifferenceGradient( Var nll, const VarArray& vars, PLearn::real h )
+{
+    Vec g(vars.size());
+    for ( int j=0; j < vars.size(); j++ )
+    {
+        PLearn::real x = vars[j]->value[0];
+        vars[j]->value[0] = x + h;
+        nll->fprop();
+        PLearn::real f_plus = nll->value[0];
+        vars[j]->value[0] = x - h;
+        nll->fprop();
+        PLearn::real f_minus = nll->value[0];
+        vars[j]->value[0] = x;
+        g[j] = (f_plus - f_minus) / (2 * h);
+    }
+    nll->fprop();
+    return g;
+}
+
+//! Whether a and b are equal up to 'tolerance' (relative when above 1).
+bool close( PLearn::real a, PLearn::real b, PLearn::real tolerance )
+{
+    return fabs(a - b) <= tolerance * max(PLearn::real(1), max(fabs(a), fabs(b)));
+}
+
+bool report( bool ok )
+{
+    if ( ok )
+        cout << "OK.\n===\n" << endl;
+    else
+        cout << "FAILED!!!" << endl;
+    return ok;
+}
+
+//! Compare the bprop of the sparse NLL with finite differences.
+bool checkGradient( const string& name, Var nll, const VarArray& vars )
+{
+    cout << name << ": gradient vs finite differences" << endl;
+    Vec bprop_g = bpropGradient(nll, vars);
+    Vec fd_g = finiteDifferenceGradient(nll, vars, 1e-4);
+    bool ok = true;
+    for ( int j=0; j < vars.size(); j++ )
+        if ( !close(bprop_g[j], fd_g[j], 1e-4) )
+        {
+            cerr << vars[j]->getName() << ": " << bprop_g[j] << " vs "
+                 << fd_g[j] << endl;
+            ok = false;
+        }
+    return report(ok);
+}
+
+//! Compare the value and gradient of a sparse NLL whose inducing points
+//! are all the inputs with those of the exact NLL.
+bool checkAgainstExact( const string& name, Var sparse, Var exact,
+                        const VarArray& vars )
+{
+    cout << name << " with all points inducing: same as exact" << endl;
+    Vec exact_g = bpropGradient(exact, vars);
+    PLearn::real exact_nll = exact->value[0];
+    Vec sparse_g = bpropGradient(sparse, vars);
+    bool ok = close(sparse->value[0], exact_nll, 1e-4);
+    if ( !ok )
+        cerr << "nll: " << sparse->value[0] << " vs " << exact_nll << endl;
+    for ( int j=0; j < vars.size(); j++ )
+        if ( !close(sparse_g[j], exact_g[j], 1e-3) )
+        {
+            cerr << vars[j]->getName() << ": " << sparse_g[j] << " vs "
+                 << exact_g[j] << endl;
+            ok = false;
+        }
+    return report(ok);
+}
+
+int main(int argc, char** argv)
+{
+    try{
+        const int n = 12;
+        Mat inputs(n, 2);
+        Mat targets(n, 1);
+        for ( int i=0; i < n; i++ )
+        {
+            inputs(i,0) = 0.5 * i;
+            inputs(i,1) = (i * 7) % 5 - 2;
+            targets(i,0) = sin(inputs(i,0)) + 0.3 * inputs(i,1);
+        }
+
+        PP<SquaredExponentialARDKernel> smooth = new SquaredExponentialARDKernel();
+        smooth->m_isp_signal_sigma = 0.3;
+        smooth->m_isp_input_sigma = Vec(2, 0.0);
+        smooth->build();
+        PP<IIDNoiseKernel> noise = new IIDNoiseKernel();
+        noise->m_isp_noise_sigma = -1.0;
+        noise->build();
+        PP<SummationKernel> kernel = new SummationKernel();
+        kernel->m_terms.append(get_pointer(smooth));
+        kernel->m_terms.append(get_pointer(noise));
+        kernel->build();
+
+        TVec<string> names;
+        names.append("terms[0].isp_signal_sigma");
+        names.append("terms[0].isp_input_sigma[0]");
+        names.append("terms[0].isp_input_sigma[1]");
+        names.append("terms[1].isp_noise_sigma");
+        TVec<string> values;
+        values.append("0.3");
+        values.append("0.2");
+        values.append("-0.4");
+        values.append("-1.0");
+        VarArray vars(names.size());
+        for ( int j=0; j < names.size(); j++ )
+        {
+            vars[j] = new ObjectOptionVariable((Kernel*)kernel, names[j], values[j]);
+            vars[j]->setName(names[j]);
+        }
+
+        const PLearn::real weight_decay = 0.01;
+        TVec<int> some_points;
+        for ( int i=0; i < n; i += 3 )
+            some_points.append(i);
+        TVec<int> all_points(0, n-1, 1);
+
+        Var sor = new GaussianProcessNLLVariable(
+            kernel, weight_decay, inputs, targets, some_points, false, names, vars);
+        Var fitc = new GaussianProcessNLLVariable(
+            kernel, weight_decay, inputs, targets, some_points, true, names, vars);
+        checkGradient("SoR", sor, vars);
+        checkGradient("FITC", fitc, vars);
+
+        Var exact = new GaussianProcessNLLVariable(
+            kernel, weight_decay, inputs, targets, names, vars);
+        Var sor_all = new GaussianProcessNLLVariable(
+            kernel, weight_decay, inputs, targets, all_points, false, names, vars);
+        Var fitc_all = new GaussianProcessNLLVariable(
+            kernel, weight_decay, inputs, targets, all_points, true, names, vars);
+        checkAgainstExact("SoR", sor_all, exact, vars);
+        checkAgainstExact("FITC", fitc_all, exact, vars);
+    }
+    catch(const PLearnError& e)
+    {
+        cerr << "FATAL ERROR: " << e.message() << endl;
+    }
+    catch (...)
+    {
+        cerr << "FATAL ERROR: uncaught unknown exception" << endl;
+    }
+
+    return 0;
+}
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
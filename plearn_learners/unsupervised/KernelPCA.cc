@@ -62,6 +62,9 @@ PLEARN_IMPLEMENT_OBJECT(KernelPCA,
                         "Kernel Principal Component Analysis",
                         "Perform PCA in a feature space phi(x), defined by a kernel K such that\n"
                         " K(x,y) = < phi(x), phi(y) >\n"
+                        "With an 'approximation', the approximate feature map is centered on\n"
+                        "the training set instead of normalizing the kernel (the 'remove_bias'\n"
+                        "options are then ignored).\n"
     );
 
 ////////////////////
@@ -111,6 +114,17 @@ void KernelPCA::build()
 ////////////
 void KernelPCA::build_()
 {
+    if (approximation != "none") {
+        // The additive normalization would need the whole Gram matrix: the
+        // approximate feature map of 'kpca_kernel' is centered instead.
+        if (kpca_kernel)
+            this->kernel = kpca_kernel;
+        center_approximate_features = true;
+        approximate_kernel_is_distance = kernel_is_distance;
+        return;
+    }
+    center_approximate_features = false;
+    approximate_kernel_is_distance = false;
     // Obtain the "real" kernel by additive normalization of 'kpca_kernel'.
     // We have to do this iff:
     // 1. A 'kpca_kernel' is provided, and
@@ -118,9 +132,10 @@ void KernelPCA::build_()
     //    2.a. the 'kernel' option is not set, or
     //    2.b. the 'kernel' option is not an AdditiveNormalization acting on 'kpca_kernel'.
     // This is to ensure that a loaded 'kernel' won't be overwritten.
+    AdditiveNormalizationKernel* normalized_kernel =
+        dynamic_cast<AdditiveNormalizationKernel*>((Kernel*) kernel);
     if (kpca_kernel &&
-        (!kernel ||
-         (dynamic_cast<AdditiveNormalizationKernel*>((Kernel*) kernel))->source_kernel != kpca_kernel)) {
+        (!normalized_kernel || normalized_kernel->source_kernel != kpca_kernel)) {
         this->kernel = new AdditiveNormalizationKernel
             (kpca_kernel, remove_bias, remove_bias_in_evaluate, kernel_is_distance);
     }
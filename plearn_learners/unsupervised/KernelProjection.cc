@@ -43,10 +43,31 @@
 #include "KernelProjection.h"
 #include <time.h>               //!< For clock().
 #include <plearn/math/plapack.h>            //!< For eigenVecOfSymmMat.
+#include <plearn/math/PRandom.h>
+#include <plearn/math/TMat_sort.h>
+#include <plearn/base/ProgressBar.h>
+#include <plearn/ker/GaussianKernel.h>
 
 namespace PLearn {
 using namespace std;
 
+namespace {
+
+//! Coefficient of the random Fourier features of a GaussianKernel
+//! K(x,y) = c exp(-||x-y||^2 / sigma^2), which are sqrt(2c/D) cos(w.x + b),
+//! where D is the number of features.
+real randomFeatureCoefficient(const Kernel* kernel, int n_features)
+{
+    const GaussianKernel* gk = dynamic_cast<const GaussianKernel*>(kernel);
+    if (!gk)
+        PLERROR("In KernelProjection - The 'random_features' approximation requires "
+                "a GaussianKernel (got a %s)", kernel->classname().c_str());
+    real c = gk->scale_by_sigma ? gk->sigma * gk->sigma / 2 : 1;
+    return sqrt(2 * c / n_features);
+}
+
+} // end of anonymous namespace
+
 //////////////////////
 // KernelProjection //
 //////////////////////
@@ -54,20 +75,36 @@ KernelProjection::KernelProjection()
     : n_comp_kept(-1),
       n_examples(-1),
       first_output(true),
+      center_approximate_features(false),
+      approximate_kernel_is_distance(false),
       compute_costs(false),
       free_extra_components(true),
       ignore_n_first(0),
       min_eigenvalue(-REAL_MAX),
       n_comp(1),
       n_comp_for_cost(-1),
-      normalize("none")
-  
+      normalize("none"),
+      approximation("none"),
+      approximation_size(1000)
 {
 }
 
 PLEARN_IMPLEMENT_OBJECT(KernelProjection,
                         "Performs dimensionality reduction by learning eigenfunctions of a kernel.", 
-                        ""
+                        "The exact method computes the full Gram matrix of the training set,\n"
+                        "which takes O(n^2) memory. The 'approximation' option instead uses an\n"
+                        "explicit feature map phi of dimension D <= 'approximation_size', such\n"
+                        "that K(x,y) ~= phi(x).phi(y), and only needs the D x D covariance of the\n"
+                        "training features, computed by blocks in O(n D^2) time:\n"
+                        " - 'nystrom': phi(x) = S^-1/2 U' k_m(x), where k_m(x) holds the kernel\n"
+                        "   evaluations between x and m random training examples (landmarks),\n"
+                        "   and K_mm = U S U' (works with any kernel; when the kernel is a\n"
+                        "   squared distance, K_mm and k_m(x) are first double-centered with\n"
+                        "   respect to the landmarks, as in landmark MDS);\n"
+                        " - 'random_features': random Fourier features sqrt(2/D) cos(w.x + b)\n"
+                        "   (requires a GaussianKernel).\n"
+                        "Outputs keep the same semantics as in the exact case, with the Gram\n"
+                        "matrix replaced by its approximation.\n"
     );
 
 ////////////////////
@@ -106,6 +143,16 @@ void KernelProjection::declareOptions(OptionList& ol)
     declareOption(ol, "ignore_n_first", &KernelProjection::ignore_n_first, OptionBase::buildoption,
                   "Will ignore the first 'ignore_n_first' eigenvectors, if this option is > 0.");
 
+    declareOption(ol, "approximation", &KernelProjection::approximation, OptionBase::buildoption,
+                  "How the Gram matrix is handled:\n"
+                  " - 'none'           : the exact Gram matrix is computed\n"
+                  " - 'nystrom'        : Nystrom approximation from random landmarks\n"
+                  " - 'random_features': random Fourier features (GaussianKernel only)");
+
+    declareOption(ol, "approximation_size", &KernelProjection::approximation_size, OptionBase::buildoption,
+                  "Number of landmarks (with 'nystrom') or of random features (with\n"
+                  "'random_features').");
+
     // Learnt options.
 
     declareOption(ol, "eigenvalues", &KernelProjection::eigenvalues, OptionBase::learntoption,
@@ -121,13 +168,36 @@ void KernelProjection::declareOptions(OptionList& ol)
     declareOption(ol, "n_examples", &KernelProjection::n_examples, OptionBase::learntoption,
                   "The number of points in the training set.");
 
+    declareOption(ol, "landmarks", &KernelProjection::landmarks, OptionBase::learntoption,
+                  "Indices of the landmarks in the training set ('nystrom' only).");
+
+    declareOption(ol, "landmark_map", &KernelProjection::landmark_map, OptionBase::learntoption,
+                  "The m x D matrix U S^-1/2 mapping the kernel evaluations with the\n"
+                  "landmarks to the features ('nystrom' only).");
+
+    declareOption(ol, "landmark_mean", &KernelProjection::landmark_mean, OptionBase::learntoption,
+                  "Mean squared distance between each landmark and all landmarks, used\n"
+                  "to double-center the kernel evaluations ('nystrom' with a distance\n"
+                  "kernel only).");
+
+    declareOption(ol, "random_weights", &KernelProjection::random_weights, OptionBase::learntoption,
+                  "The D x inputsize random frequencies w ('random_features' only).");
+
+    declareOption(ol, "random_offsets", &KernelProjection::random_offsets, OptionBase::learntoption,
+                  "The D random phases b ('random_features' only).");
+
+    declareOption(ol, "feature_mean", &KernelProjection::feature_mean, OptionBase::learntoption,
+                  "Mean of the approximate features on the training set, when they are\n"
+                  "centered (e.g. by KernelPCA).");
+
     // Now call the parent class' declareOptions
     inherited::declareOptions(ol);
 
     // Hide unused options.
 
     redeclareOption(ol, "seed", &KernelProjection::seed_, OptionBase::nosave,
-                    "No seed used here.");
+                    "Only used to draw the landmarks or random features of the\n"
+                    "approximate methods.");
 
 }
 
@@ -150,6 +220,12 @@ void KernelProjection::build_()
     }
     first_output = true;  // Safer.
     last_input.resize(0);
+    if (approximation != "none" && approximation != "nystrom"
+        && approximation != "random_features")
+        PLERROR("In KernelProjection::build_ - Unknown value for 'approximation': %s",
+                approximation.c_str());
+    if (approximation != "none" && approximation_size <= 0)
+        PLERROR("In KernelProjection::build_ - 'approximation_size' must be positive");
 }
 
 /////////////////////////////
@@ -205,15 +281,26 @@ void KernelProjection::computeOutput(const Vec& input, Vec& output) const
     static real* result_ptr;
     if (first_output) {
         // Initialize k_x_xi, used_eigenvectors and result correctly.
-        k_x_xi.resize(n_examples);
+        if (approximation == "none")
+            k_x_xi.resize(n_examples);
         used_eigenvectors = eigenvectors.subMatRows(0, n_comp_kept);
         result.resize(n_comp_kept,1);
         first_output = false;
     }
-    // Compute the K(x,x_i).
-    kernel->evaluate_all_i_x(input, k_x_xi);
-    // Compute the output.
-    rowSum(used_eigenvectors * k_x_xi, result);
+    if (approximation == "none") {
+        // Compute the K(x,x_i).
+        kernel->evaluate_all_i_x(input, k_x_xi);
+        // Compute the output.
+        rowSum(used_eigenvectors * k_x_xi, result);
+    } else {
+        // With K ~= Phi Phi' and Phi'Phi = V S V', the dot product of the
+        // kernel evaluations K(x,x_i) with the i-th eigenvector Phi v_i /
+        // sqrt(s_i) of the Gram matrix is sqrt(s_i) v_i.phi(x).
+        computeApproximateFeatures(input, approx_features);
+        for (int i = 0; i < n_comp_kept; i++)
+            result(i,0) = sqrt(max(eigenvalues[i], real(0)))
+                * dot(used_eigenvectors(i), approx_features);
+    }
     output.resize(n_comp_kept);
     result_ptr = result[0];
     if (normalize == "none") {
@@ -255,6 +342,12 @@ void KernelProjection::forget()
     // Free memory.
     eigenvectors = Mat();
     eigenvalues = Vec();
+    landmarks.resize(0);
+    landmark_map = Mat();
+    landmark_mean = Vec();
+    random_weights = Mat();
+    random_offsets = Vec();
+    feature_mean = Vec();
 }
     
 //////////////////////
@@ -296,6 +389,14 @@ void KernelProjection::makeDeepCopyFromShallowCopy(CopiesMap& copies)
     deepCopyField(kernel, copies);
     deepCopyField(eigenvalues, copies);
     deepCopyField(eigenvectors, copies);
+    deepCopyField(landmarks, copies);
+    deepCopyField(landmark_map, copies);
+    deepCopyField(landmark_mean, copies);
+    deepCopyField(random_weights, copies);
+    deepCopyField(random_offsets, copies);
+    deepCopyField(feature_mean, copies);
+    deepCopyField(approx_features, copies);
+    deepCopyField(approx_k, copies);
 }
 
 
@@ -333,19 +434,24 @@ void KernelProjection::train()
         PLWARNING("In KernelProjection::train - Learner has already been trained");
         return;
     }
-    Mat gram(n_examples,n_examples);
-    // (1) Compute the Gram matrix.
-    if (report_progress) {
-        kernel->report_progress = true;
-    }
-    clock_t time_for_gram = clock();
-    kernel->computeGramMatrix(gram);
-    time_for_gram = clock() - time_for_gram;
-    if (verbosity >= 3) {
-        pout << flush;
+    if (approximation != "none") {
+        // (1) and (2) on the approximate Gram matrix.
+        trainApproximation();
+    } else {
+        Mat gram(n_examples,n_examples);
+        // (1) Compute the Gram matrix.
+        if (report_progress) {
+            kernel->report_progress = true;
+        }
+        clock_t time_for_gram = clock();
+        kernel->computeGramMatrix(gram);
+        time_for_gram = clock() - time_for_gram;
+        if (verbosity >= 3) {
+            pout << flush;
+        }
+        // (2) Compute its eigenvectors and eigenvalues.
+        eigenVecOfSymmMat(gram, n_comp + ignore_n_first, eigenvalues, eigenvectors);
     }
-    // (2) Compute its eigenvectors and eigenvalues.
-    eigenVecOfSymmMat(gram, n_comp + ignore_n_first, eigenvalues, eigenvectors);
     if (ignore_n_first > 0) {
         eigenvalues = eigenvalues.subVec(ignore_n_first, eigenvalues.length() - ignore_n_first);
         eigenvectors = eigenvectors.subMatRows(ignore_n_first, eigenvectors.length() - ignore_n_first);
@@ -368,6 +474,187 @@ void KernelProjection::train()
     stage = 1;
 }
 
+////////////////////////
+// trainApproximation //
+////////////////////////
+void KernelProjection::trainApproximation()
+{
+    const int n = n_examples;
+    if (!random_gen) {
+        random_gen = new PRandom();
+        if (seed_ != 0)
+            random_gen->manual_seed(seed_);
+    }
+
+    // Draw the feature map.
+    int dim;
+    if (approximation == "nystrom") {
+        const int m = min(approximation_size, n);
+        TVec<int> permutation(0, n - 1, 1);
+        random_gen->shuffleElements(permutation);
+        landmarks.resize(m);
+        landmarks << permutation.subVec(0, m);
+        sortElements(landmarks);
+
+        // K_mm = U S U', and the map is U S^-1/2 restricted to the (numerically)
+        // positive eigenvalues.
+        Mat gram_mm(m, m);
+        for (int a = 0; a < m; a++)
+            for (int b = 0; b <= a; b++)
+                gram_mm(a,b) = gram_mm(b,a) =
+                    kernel->evaluate_i_j(landmarks[a], landmarks[b]);
+        if (approximate_kernel_is_distance) {
+            // Landmark MDS: the dot products are obtained by double-centering
+            // the squared distances with respect to the landmarks, and the
+            // same means are used for all other points.
+            landmark_mean.resize(m);
+            columnMean(gram_mm, landmark_mean);
+            for (int a = 0; a < m; a++)
+                doubleCenterLandmarkRow(gram_mm[a]);
+        } else
+            landmark_mean = Vec();
+        Vec landmark_eigenvalues;
+        Mat landmark_eigenvectors;
+        eigenVecOfSymmMat(gram_mm, m, landmark_eigenvalues, landmark_eigenvectors, false);
+        real threshold = landmark_eigenvalues.length() > 0
+            ? max(landmark_eigenvalues[0], real(0)) * 1e-10 : 0;
+        dim = 0;
+        while (dim < landmark_eigenvalues.length()
+               && landmark_eigenvalues[dim] > threshold)
+            dim++;
+        landmark_map.resize(m, dim);
+        for (int c = 0; c < dim; c++) {
+            real inv_sqrt = 1 / sqrt(landmark_eigenvalues[c]);
+            for (int a = 0; a < m; a++)
+                landmark_map(a,c) = landmark_eigenvectors(c,a) * inv_sqrt;
+        }
+        random_weights = Mat();
+        random_offsets = Vec();
+    } else {
+        const GaussianKernel* gk = dynamic_cast<const GaussianKernel*>((Kernel*) kernel);
+        if (!gk)
+            PLERROR("In KernelProjection::trainApproximation - The 'random_features' "
+                    "approximation requires a GaussianKernel");
+        if (approximate_kernel_is_distance)
+            PLERROR("In KernelProjection::trainApproximation - The 'random_features' "
+                    "approximation cannot be used with a distance kernel");
+        // exp(-||x-y||^2 / sigma^2) is the characteristic function of a
+        // normal distribution of variance 2 / sigma^2.
+        dim = approximation_size;
+        random_weights.resize(dim, inputsize());
+        random_gen->fill_random_normal(random_weights, 0, sqrt(2.0) / gk->sigma);
+        random_offsets.resize(dim);
+        for (int j = 0; j < dim; j++)
+            random_offsets[j] = 2 * M_PI * random_gen->uniform_sample();
+        landmarks.resize(0);
+        landmark_map = Mat();
+        landmark_mean = Vec();
+    }
+
+    // Covariance Phi'Phi of the training features, by blocks of examples.
+    // Its eigenvalues are those of the approximate Gram matrix Phi Phi'.
+    const int block_size = 1024;
+    Mat cov(dim, dim);
+    Vec feature_sum(dim);
+    Vec block_sum(dim);
+    Mat features, buffer;
+    PP<ProgressBar> pb = report_progress
+        ? new ProgressBar("Computing approximate feature covariance for " + classname(), n)
+        : 0;
+    for (int start = 0; start < n; start += block_size) {
+        features.resize(min(block_size, n - start), dim);
+        computeTrainingFeatures(start, features, buffer);
+        transposeProductAcc(cov, features, features);
+        columnSum(features, block_sum);
+        feature_sum += block_sum;
+        if (pb)
+            pb->update(start + features.length());
+    }
+    if (center_approximate_features) {
+        feature_mean.resize(dim);
+        feature_mean << feature_sum;
+        feature_mean /= real(n);
+        externalProductScaleAcc(cov, feature_mean, feature_mean, real(-n));
+    } else
+        feature_mean = Vec();
+
+    eigenVecOfSymmMat(cov, min(n_comp + ignore_n_first, dim), eigenvalues, eigenvectors);
+}
+
+////////////////////////////////
+// computeApproximateFeatures //
+////////////////////////////////
+void KernelProjection::computeApproximateFeatures(const Vec& input, Vec& features) const
+{
+    if (approximation == "nystrom") {
+        const int m = landmarks.length();
+        approx_k.resize(m);
+        for (int a = 0; a < m; a++)
+            approx_k[a] = kernel->evaluate_i_x(landmarks[a], input);
+        if (approximate_kernel_is_distance)
+            doubleCenterLandmarkRow(approx_k.data());
+        features.resize(landmark_map.width());
+        transposeProduct(features, landmark_map, approx_k);
+    } else {
+        const int dim = random_weights.length();
+        const real coef = randomFeatureCoefficient(kernel, dim);
+        features.resize(dim);
+        product(features, random_weights, input);
+        for (int j = 0; j < dim; j++)
+            features[j] = coef * cos(features[j] + random_offsets[j]);
+    }
+    if (feature_mean.length() > 0)
+        features -= feature_mean;
+}
+
+/////////////////////////////
+// computeTrainingFeatures //
+/////////////////////////////
+void KernelProjection::computeTrainingFeatures(int start, Mat& features, Mat& buffer) const
+{
+    const int len = features.length();
+    if (approximation == "nystrom") {
+        const int m = landmarks.length();
+        buffer.resize(len, m);
+        for (int i = 0; i < len; i++) {
+            real* buffer_i = buffer[i];
+            for (int a = 0; a < m; a++)
+                buffer_i[a] = kernel->evaluate_i_j(landmarks[a], start + i);
+            if (approximate_kernel_is_distance)
+                doubleCenterLandmarkRow(buffer_i);
+        }
+        product(features, buffer, landmark_map);
+    } else {
+        const int dim = random_weights.length();
+        const real coef = randomFeatureCoefficient(kernel, dim);
+        buffer.resize(len, inputsize());
+        train_set->getMat(start, 0, buffer);
+        productTranspose(features, buffer, random_weights);
+        for (int i = 0; i < len; i++) {
+            real* features_i = features[i];
+            for (int j = 0; j < dim; j++)
+                features_i[j] = coef * cos(features_i[j] + random_offsets[j]);
+        }
+    }
+}
+
+/////////////////////////////
+// doubleCenterLandmarkRow //
+/////////////////////////////
+void KernelProjection::doubleCenterLandmarkRow(real* k) const
+{
+    const int m = landmark_mean.length();
+    real row_mean = 0;
+    real total_mean = 0;
+    for (int a = 0; a < m; a++) {
+        row_mean += k[a];
+        total_mean += landmark_mean[a];
+    }
+    const real offset = (total_mean - row_mean) / m;
+    for (int a = 0; a < m; a++)
+        k[a] = -0.5 * (k[a] - landmark_mean[a] + offset);
+}
+
 } // end of namespace PLearn
 
 
@@ -78,6 +78,20 @@ protected:
 
     mutable Vec last_input;   //!< The last input given when computing costs.
     mutable Vec last_output;  //!< The last output computed when computing costs.
+
+    //! Whether the approximate feature map should be centered on the
+    //! training set (set by subclasses such as KernelPCA, whose kernel is
+    //! otherwise normalized over the whole training set).
+    bool center_approximate_features;
+
+    //! Whether the kernel is a squared distance in the approximate modes
+    //! (set by subclasses such as KernelPCA). With 'nystrom', the landmark
+    //! evaluations are then double-centered (landmark MDS).
+    bool approximate_kernel_is_distance;
+
+    //! Buffers for the approximate feature map.
+    mutable Vec approx_features;
+    mutable Vec approx_k;
     
 public:
 
@@ -93,6 +107,8 @@ public:
     int n_comp;
     int n_comp_for_cost;
     string normalize;
+    string approximation;
+    int approximation_size;
   
     // ************************
     // * public learnt options *
@@ -100,6 +116,12 @@ public:
 
     Vec eigenvalues;
     Mat eigenvectors;
+    TVec<int> landmarks;
+    Mat landmark_map;
+    Vec landmark_mean;
+    Mat random_weights;
+    Vec random_offsets;
+    Vec feature_mean;
   
     // ****************
     // * Constructors *
@@ -122,6 +144,23 @@ protected:
     //! Declares this class' options.
     static void declareOptions(OptionList& ol);
 
+    //! Train with the approximation given by the 'approximation' option.
+    void trainApproximation();
+
+    //! Compute the approximate feature map phi(x) of an input, such that
+    //! K(x,y) ~= phi(x).phi(y) (before centering).
+    void computeApproximateFeatures(const Vec& input, Vec& features) const;
+
+    //! Compute the approximate feature map of the training examples
+    //! 'start' to 'start + features.length() - 1' (in the rows of
+    //! 'features'), using 'inputs' as a buffer for their inputs.
+    void computeTrainingFeatures(int start, Mat& features, Mat& inputs) const;
+
+    //! Double-center in place the squared distances 'k' between a point and
+    //! the m landmarks, with respect to 'landmark_mean':
+    //! k_a <- -1/2 (k_a - mean(k) - landmark_mean_a + mean(landmark_mean)).
+    void doubleCenterLandmarkRow(real* k) const;
+
 public:
 
     //! Return the eigenvalues of this learner.
@@ -0,0 +1,132 @@
+#include <plearn/vmat/MemoryVMatrix.h>
+#include <plearn_learners/unsupervised/Isomap.h>
+
+using namespace PLearn;
+
+//! A point on a spiral, whose geodesic structure is one-dimensional.
+void spiralPoint(PLearn::real t, Vec& point)
+{
+    point.resize(2);
+    point[0] = t * cos(t);
+    point[1] = t * sin(t);
+}
+
+//! Compare the outputs of both learners on the given inputs, up to the sign
+//! of each component (fixed by the first input).
+bool compare( Isomap& exact, Isomap& landmark, Mat inputs, const string& what )
+{
+    cout << what << endl;
+    Vec out_exact, out_landmark;
+    Vec sign;
+    PLearn::real scale = 0;
+    Mat outputs_exact(inputs.length(), exact.outputsize());
+    Mat outputs_landmark(inputs.length(), landmark.outputsize());
+    if ( outputs_exact.width() != outputs_landmark.width() )
+    {
+        cout << "FAILED!!! (" << outputs_exact.width() << " vs "
+             << outputs_landmark.width() << " components)" << endl;
+        return false;
+    }
+    for ( int i=0; i < inputs.length(); i++ )
+    {
+        exact.computeOutput   ( inputs(i), out_exact    );
+        landmark.computeOutput( inputs(i), out_landmark );
+        outputs_exact(i)    << out_exact;
+        outputs_landmark(i) << out_landmark;
+        for ( int j=0; j < out_exact.length(); j++ )
+            scale = max( scale, fabs(out_exact[j]) );
+    }
+    sign.resize(outputs_exact.width());
+    for ( int j=0; j < sign.length(); j++ )
+        sign[j] = outputs_exact(0,j) * outputs_landmark(0,j) < 0 ? -1 : 1;
+
+    bool equal = true;
+    for ( int i=0; i < inputs.length(); i++ )
+        for ( int j=0; j < sign.length(); j++ )
+            if ( fabs( outputs_exact(i,j) - sign[j] * outputs_landmark(i,j) )
+                 > 1e-6 * scale )
+            {
+                cerr << "exact(" << i << "," << j << ") = "
+                     << outputs_exact(i,j) << endl
+                     << "landmark(" << i << "," << j << ") = "
+                     << outputs_landmark(i,j) << endl
+                     << endl;
+                equal = false;
+            }
+
+    if ( equal )
+        cout << "OK.\n===\n" << endl;
+    else
+        cout << "FAILED!!!" << endl;
+
+    return equal;
+}
+
+int main(int argc, char** argv)
+{
+    try{
+        const int n = 40;
+        Mat train(n, 2);
+        Mat test(n - 1, 2);
+        Vec point;
+        for ( int i=0; i < n; i++ )
+        {
+            spiralPoint( 3 + 6 * PLearn::real(i) / (n - 1), point );
+            train(i) << point;
+        }
+        for ( int i=0; i < n - 1; i++ )
+        {
+            spiralPoint( 3 + 6 * (i + 0.5) / (n - 1), point );
+            test(i) << point;
+        }
+        VMat data = new MemoryVMatrix( train );
+        data->defineSizes(2, 0, 0);
+
+        Isomap exact;
+        exact.knn             = 4;
+        exact.n_comp          = 2;
+        exact.report_progress = 0;
+        exact.build();
+
+        // With as many landmarks as training points, landmark MDS recovers
+        // the exact (double-centered) Gram matrix.
+        Isomap landmark;
+        landmark.knn                = 4;
+        landmark.n_comp             = 2;
+        landmark.approximation      = "nystrom";
+        landmark.approximation_size = n;
+        landmark.report_progress    = 0;
+        landmark.build();
+
+        exact.setTrainingSet   ( data, false );
+        landmark.setTrainingSet( data, false );
+        exact.train();
+        landmark.train();
+
+        compare( exact, landmark, train, "Training points" );
+        compare( exact, landmark, test,  "Test points" );
+    }
+    catch(const PLearnError& e)
+    {
+        cerr << "FATAL ERROR: " << e.message() << endl;
+    }
+    catch (...) 
+    {
+        cerr << "FATAL ERROR: uncaught unknown exception" << endl;
+    }
+    
+    return 0;
+}
+
+
+/*
+  Local Variables:
+  mode:c++
+  c-basic-offset:4
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0))
+  indent-tabs-mode:nil
+  fill-column:79
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=79 :
@@ -0,0 +1,117 @@
+// Benchmark of the vectorised kernels of plearn/math/simd_kernels.h: each
+// kernel is timed with the scalar version and with every instruction set
+// supported by the CPU (including the reordered reductions enabled by
+// PLEARN_SIMD_REORDER), and the results are compared to the scalar ones.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <sys/time.h>
+#include <plearn/math/simd_kernels.h>
+
+#ifdef USEDOUBLE
+#define real double
+#define TABLE simd_double_kernels
+#elif USEFLOAT
+#define real float
+#define TABLE simd_float_kernels
+#else
+#error "USEDOUBLE or USEFLOAT must be defined"
+#endif
+
+using namespace PLearn;
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+static const int n_kernels = 8;
+static const char* kernel_names[n_kernels] = {
+    "dot", "sum", "sumsquare", "squared_distance", "l1_distance",
+    "multiply_acc", "scale", "add_acc"
+};
+
+//! Run kernel k once, and return its result. For the kernels that modify
+//! their first argument, return the sum of the output if 'sum_output' is
+//! true, and 0 otherwise.
+static real runKernel(int k, real* x, const real* y, int n, bool sum_output)
+{
+    switch (k) {
+    case 0: return TABLE.dot(x, y, n);
+    case 1: return TABLE.sum(x, n);
+    case 2: return TABLE.sumsquare(x, n);
+    case 3: return TABLE.squared_distance(x, y, n);
+    case 4: return TABLE.l1_distance(x, y, n);
+    case 5: TABLE.multiply_acc(x, y, real(1e-3), n); break;
+    case 6: TABLE.scale(x, real(1.0001), n); break;
+    case 7: TABLE.add_acc(x, y, n); break;
+    }
+    real res = 0;
+    if (sum_output)
+        for (int i = 0; i < n; i++)
+            res += x[i];
+    return res;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <size> <Nb iter>\n", argv[0]);
+        exit(0);
+    }
+    const int n = strtol(argv[1], 0, 0);
+    const int nb_iter = strtol(argv[2], 0, 0);
+    real* x0 = (real*) malloc(sizeof(real) * (n + 1));
+    real* x = (real*) malloc(sizeof(real) * (n + 1));
+    real* y = (real*) malloc(sizeof(real) * (n + 1));
+    srand(1827);
+    for (int i = 0; i < n; i++) {
+        x0[i] = real(rand()) / RAND_MAX - 0.5;
+        y[i] = real(rand()) / RAND_MAX - 0.5;
+    }
+
+    int best = simdBestInstructionSet();
+    printf("size=%d iterations=%d best instruction set: %s\n", n, nb_iter,
+           simdInstructionSetName(SimdInstructionSet(best)));
+    printf("%-18s", "kernel");
+    for (int isa = SIMD_SCALAR; isa <= best; isa++)
+        printf(" %12s", simdInstructionSetName(SimdInstructionSet(isa)));
+    printf("   max rel. diff\n");
+
+    for (int k = 0; k < n_kernels; k++) {
+        printf("%-18s", kernel_names[k]);
+        real scalar_res = 0;
+        double max_diff = 0;
+        for (int isa = SIMD_SCALAR; isa <= best; isa++) {
+            setSimdInstructionSet(SimdInstructionSet(isa), true);
+            // Results are compared on a single call from the same input.
+            for (int i = 0; i < n; i++)
+                x[i] = x0[i];
+            real res = runKernel(k, x, y, n, true);
+            if (isa == SIMD_SCALAR)
+                scalar_res = res;
+            else if (scalar_res != 0) {
+                double diff = fabs((res - scalar_res) / scalar_res);
+                if (diff > max_diff)
+                    max_diff = diff;
+            }
+            double start = now();
+            real acc = 0;
+            for (int it = 0; it < nb_iter; it++)
+                acc += runKernel(k, x, y, n, false);
+            double elapsed = now() - start;
+            // 'acc' is printed so that the calls are not optimised away.
+            if (acc == real(0.12345))
+                printf("!");
+            printf(" %9.3f ns", 1e9 * elapsed / nb_iter);
+        }
+        printf("   %.2e\n", max_diff);
+    }
+    free(x0);
+    free(x);
+    free(y);
+    return 0;
+}